@@ -0,0 +1,219 @@
+#include "led_bench.h"
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int
+compare_u64(void const * const a, void const * const b)
+{
+    uint64_t const * const ua = a;
+    uint64_t const * const ub = b;
+
+    return (*ua > *ub) - (*ua < *ub);
+}
+
+void
+summarise_samples(
+    uint64_t * const samples,
+    size_t const num_samples,
+    struct bench_result_st * const result)
+{
+    uint64_t total_ns = 0;
+
+    for (size_t i = 0; i < num_samples; i++)
+    {
+        total_ns += samples[i];
+    }
+
+    qsort(samples, num_samples, sizeof *samples, compare_u64);
+
+    result->iterations = num_samples;
+    result->mean_ns = total_ns / num_samples;
+    result->ops_per_sec = (total_ns > 0) ? (double)num_samples * 1e9 / (double)total_ns : 0.0;
+    result->p50_ns = samples[(num_samples * 50) / 100];
+    result->p99_ns = samples[(num_samples * 99) / 100];
+}
+
+void
+print_result(struct bench_result_st const * const result)
+{
+    fprintf(stdout,
+            "{\"benchmark\": \"%s\", \"mode\": \"%s\", \"leds\": %zu, "
+            "\"iterations\": %zu, \"mean_ns\": %" PRIu64 ", "
+            "\"p50_ns\": %" PRIu64 ", \"p99_ns\": %" PRIu64 ", "
+            "\"ops_per_sec\": %.0f",
+            result->benchmark,
+            result->mode,
+            result->num_leds,
+            result->iterations,
+            result->mean_ns,
+            result->p50_ns,
+            result->p99_ns,
+            result->ops_per_sec);
+    if (result->allocations_counted)
+    {
+        fprintf(stdout, ", \"allocations_per_op\": %.3f", result->allocations_per_op);
+    }
+    fprintf(stdout, "}\n");
+}
+
+static bool
+parse_led_counts(
+    char const * const arg, size_t * const led_counts, size_t * const num_led_counts)
+{
+    bool success;
+    char const * cursor = arg;
+
+    *num_led_counts = 0;
+
+    while (*cursor != '\0')
+    {
+        char * end;
+        unsigned long const count = strtoul(cursor, &end, 10);
+
+        if (end == cursor || count == 0 || *num_led_counts >= MAX_LED_COUNTS)
+        {
+            success = false;
+            goto done;
+        }
+
+        led_counts[*num_led_counts] = count;
+        (*num_led_counts)++;
+
+        cursor = (*end == ',') ? end + 1 : end;
+        if (*end != ',' && *end != '\0')
+        {
+            success = false;
+            goto done;
+        }
+    }
+
+    success = *num_led_counts > 0;
+
+done:
+    return success;
+}
+
+static void
+usage(FILE * const fp)
+{
+    fprintf(fp,
+            "usage:\n"
+            "\tled_bench [options]\n"
+            "\t-h?           - help    - what you see below\n"
+            "\t-i <count>    - iterations per response benchmark (default 100000)\n"
+            "\t-l <n,n,...>  - LED counts for the response benchmarks (default 1,20,200)\n"
+            "\t-c <count>    - iterations per control path benchmark (default 1000)\n"
+            "\t-L <n,n,...>  - LED counts for the control path benchmarks\n"
+            "\t                (default 19,100,1000,10000)\n"
+            "\n"
+            "Results are written to stdout, one JSON object per line.\n"
+            "\n");
+}
+
+int
+main(int argc, char * argv[])
+{
+    int c;
+    int result;
+    uint64_t * samples = NULL;
+    struct bench_config_st config =
+    {
+        .iterations = 100000,
+        .num_led_counts = 3,
+        .led_counts = { 1, 20, 200 },
+        .control_iterations = 1000,
+        .num_control_led_counts = 4,
+        .control_led_counts = { 19, 100, 1000, 10000 }
+    };
+
+    while ((c = getopt(argc, argv, "?hi:l:c:L:")) != -1)
+    {
+        switch (c)
+        {
+        case '?':
+        case 'h':
+            usage(stdout);
+            result = EXIT_SUCCESS;
+            goto done;
+
+        case 'i':
+            config.iterations = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'l':
+            if (!parse_led_counts(optarg, config.led_counts, &config.num_led_counts))
+            {
+                usage(stderr);
+                result = EXIT_FAILURE;
+                goto done;
+            }
+            break;
+
+        case 'c':
+            config.control_iterations = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'L':
+            if (!parse_led_counts(
+                    optarg, config.control_led_counts, &config.num_control_led_counts))
+            {
+                usage(stderr);
+                result = EXIT_FAILURE;
+                goto done;
+            }
+            break;
+
+        default:
+            usage(stderr);
+            result = EXIT_FAILURE;
+            goto done;
+
+        }
+    }
+
+    if (config.iterations == 0 || config.control_iterations == 0)
+    {
+        usage(stderr);
+        result = EXIT_FAILURE;
+        goto done;
+    }
+
+    samples =
+        calloc(
+            (config.iterations > config.control_iterations)
+            ? config.iterations
+            : config.control_iterations,
+            sizeof *samples);
+    if (samples == NULL)
+    {
+        fprintf(stderr, "Unable to allocate sample buffer\n");
+        result = EXIT_FAILURE;
+        goto done;
+    }
+
+    result =
+        (run_response_benchmarks(&config, samples) && run_control_benchmarks(&config, samples))
+        ? EXIT_SUCCESS
+        : EXIT_FAILURE;
+
+done:
+    free(samples);
+
+    return result;
+}
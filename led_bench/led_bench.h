@@ -0,0 +1,68 @@
+#ifndef LED_BENCH_H__
+#define LED_BENCH_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_LED_COUNTS 16
+
+struct bench_config_st
+{
+    size_t iterations;
+    size_t num_led_counts;
+    size_t led_counts[MAX_LED_COUNTS];
+    /* The control path benchmarks fan out to every LED, so run fewer times. */
+    size_t control_iterations;
+    size_t num_control_led_counts;
+    size_t control_led_counts[MAX_LED_COUNTS];
+};
+
+struct bench_result_st
+{
+    char const * benchmark;
+    char const * mode;
+    size_t num_leds;
+    size_t iterations;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    double ops_per_sec;
+    /* Only reported by the benchmarks that count allocations. */
+    bool allocations_counted;
+    double allocations_per_op;
+};
+
+/*
+ * The number of heap allocations made by led_bench and the daemon's modules
+ * since it started. The compiler assumes that allocating doesn't change
+ * globals, so this must be volatile to be read again after allocating.
+ */
+extern size_t volatile heap_allocations;
+
+uint64_t
+monotonic_ns(void);
+
+/* Sorts the samples. */
+void
+summarise_samples(
+    uint64_t * samples, size_t num_samples, struct bench_result_st * result);
+
+void
+print_result(struct bench_result_st const * result);
+
+/*
+ * Benchmarks get and set requests for every LED, made through the daemon's
+ * ubus handlers, for each of the configured LED counts.
+ */
+bool
+run_response_benchmarks(struct bench_config_st const * config, uint64_t * samples);
+
+/*
+ * Benchmarks requests to the daemon's LED control path, using an in-memory
+ * backend for each of the configured LED counts.
+ */
+bool
+run_control_benchmarks(struct bench_config_st const * config, uint64_t * samples);
+
+#endif /* LED_BENCH_H__ */
@@ -0,0 +1,69 @@
+#include "led_bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * led_bench is linked with --wrap for each of these functions (see
+ * CMakeLists.txt), so calls to them from the benchmark and from the daemon's
+ * modules come here. Allocations made inside shared libraries such as
+ * libubox aren't counted.
+ */
+
+size_t volatile heap_allocations;
+
+void *
+__real_malloc(size_t size);
+
+void *
+__real_calloc(size_t nmemb, size_t size);
+
+void *
+__real_realloc(void * ptr, size_t size);
+
+char *
+__real_strdup(char const * s);
+
+void *
+__wrap_malloc(size_t size);
+
+void *
+__wrap_calloc(size_t nmemb, size_t size);
+
+void *
+__wrap_realloc(void * ptr, size_t size);
+
+char *
+__wrap_strdup(char const * s);
+
+void *
+__wrap_malloc(size_t const size)
+{
+    heap_allocations++;
+
+    return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t const nmemb, size_t const size)
+{
+    heap_allocations++;
+
+    return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void * const ptr, size_t const size)
+{
+    heap_allocations++;
+
+    return __real_realloc(ptr, size);
+}
+
+char *
+__wrap_strdup(char const * const s)
+{
+    heap_allocations++;
+
+    return __real_strdup(s);
+}
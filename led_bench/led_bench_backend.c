@@ -0,0 +1,150 @@
+#include "led_bench_backend.h"
+
+#include <ubus_utils/ubus_utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct led
+{
+    char name[16];
+    enum led_state_t state;
+};
+
+struct platform_leds_st
+{
+    size_t num_leds;
+    struct led leds[];
+};
+
+static size_t configured_num_leds;
+
+static enum led_state_t
+get_led_state(led_handle_st * const led_handle, led_st const * const led)
+{
+    UNUSED_ARG(led_handle);
+
+    return led->state;
+}
+
+static bool
+set_led_state(
+    led_handle_st * const led_handle, led_st * const led, enum led_state_t const state)
+{
+    UNUSED_ARG(led_handle);
+
+    led->state = state;
+
+    return true;
+}
+
+static char const *
+get_led_name(led_st const * const led)
+{
+    return led->name;
+}
+
+static enum led_colour_t
+get_led_colour(led_st const * const led)
+{
+    UNUSED_ARG(led);
+
+    return LED_COLOUR_GREEN;
+}
+
+static led_handle_st *
+led_open(void)
+{
+    static int const dummy = 0;
+
+    /* Nothing to do, but NULL indicates an error. */
+    return (led_handle_st *)&dummy;
+}
+
+static void
+led_close(led_handle_st * const led_handle)
+{
+    UNUSED_ARG(led_handle);
+}
+
+static led_st *
+iterate_leds(
+    platform_leds_st * const platform_leds,
+    bool (*cb)(led_st * led, void * user_ctx),
+    void * user_ctx)
+{
+    led_st * led = NULL;
+
+    for (size_t i = 0; i < platform_leds->num_leds; i++)
+    {
+        if (!cb(&platform_leds->leds[i], user_ctx))
+        {
+            led = &platform_leds->leds[i];
+            break;
+        }
+    }
+
+    return led;
+}
+
+static void
+iterate_supported_states(
+    void (*cb)(enum led_state_t state, void * user_ctx), void * user_ctx)
+{
+    cb(LED_OFF, user_ctx);
+    cb(LED_ON, user_ctx);
+    cb(LED_SLOW_FLASH, user_ctx);
+    cb(LED_FAST_FLASH, user_ctx);
+}
+
+static platform_leds_st *
+leds_init(void)
+{
+    platform_leds_st * const platform_leds =
+        calloc(1, sizeof *platform_leds + configured_num_leds * sizeof platform_leds->leds[0]);
+
+    if (platform_leds == NULL)
+    {
+        goto done;
+    }
+
+    platform_leds->num_leds = configured_num_leds;
+    for (size_t i = 0; i < platform_leds->num_leds; i++)
+    {
+        struct led * const led = &platform_leds->leds[i];
+
+        snprintf(led->name, sizeof led->name, "%zu", i + 1);
+        led->state = LED_OFF;
+    }
+
+done:
+    return platform_leds;
+}
+
+static void
+leds_deinit(platform_leds_st * const platform_leds)
+{
+    free(platform_leds);
+}
+
+struct platform_led_methods_st const *
+led_bench_backend_methods(size_t const num_leds)
+{
+    static struct platform_led_methods_st const methods =
+    {
+        .get_led_state = get_led_state,
+        .set_led_state = set_led_state,
+        .get_led_name = get_led_name,
+        .get_led_colour = get_led_colour,
+        .open = led_open,
+        .close = led_close,
+        .iterate_leds = iterate_leds,
+        .iterate_supported_states = iterate_supported_states,
+        .init = leds_init,
+        .deinit = leds_deinit
+    };
+
+    configured_num_leds = num_leds;
+
+    return &methods;
+}
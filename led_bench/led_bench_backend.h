@@ -0,0 +1,17 @@
+#ifndef LED_BENCH_BACKEND_H__
+#define LED_BENCH_BACKEND_H__
+
+#include <platform_specific.h>
+
+#include <stddef.h>
+
+/*
+ * An in-memory LED backend with num_leds green LEDs named "1" to
+ * "<num_leds>", so that the daemon's control path can be benchmarked
+ * without LED hardware or the overhead of a real backend. The number of
+ * LEDs is fixed when the methods' init() is called.
+ */
+struct platform_led_methods_st const *
+led_bench_backend_methods(size_t num_leds);
+
+#endif /* LED_BENCH_BACKEND_H__ */
@@ -0,0 +1,38 @@
+#include "led_bench_ubus.h"
+
+#include <ubus_utils/ubus_utils.h>
+
+#include <libubus.h>
+
+#include <stddef.h>
+
+static led_bench_reply_cb reply_cb;
+static void * reply_cb_context;
+
+int
+__wrap_ubus_send_reply(
+    struct ubus_context * ctx, struct ubus_request_data * req, struct blob_attr * msg);
+
+int
+__wrap_ubus_send_reply(
+    struct ubus_context * const ctx,
+    struct ubus_request_data * const req,
+    struct blob_attr * const msg)
+{
+    UNUSED_ARG(ctx);
+    UNUSED_ARG(req);
+
+    if (reply_cb != NULL)
+    {
+        reply_cb(msg, reply_cb_context);
+    }
+
+    return UBUS_STATUS_OK;
+}
+
+void
+led_bench_ubus_set_reply_cb(led_bench_reply_cb const cb, void * const context)
+{
+    reply_cb = cb;
+    reply_cb_context = context;
+}
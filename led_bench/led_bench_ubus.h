@@ -0,0 +1,18 @@
+#ifndef LED_BENCH_UBUS_H__
+#define LED_BENCH_UBUS_H__
+
+#include <libubox/blob.h>
+
+/*
+ * The daemon's ubus handlers are called in-process (see
+ * ledcmd_ubus_call()), without a connection to ubus to send their replies
+ * on. Executables calling them are linked with --wrap=ubus_send_reply, so
+ * each reply is passed to the callback set here, or discarded if there
+ * isn't one. The reply is only valid for the duration of the callback.
+ */
+typedef void (*led_bench_reply_cb)(struct blob_attr * msg, void * context);
+
+void
+led_bench_ubus_set_reply_cb(led_bench_reply_cb cb, void * context);
+
+#endif /* LED_BENCH_UBUS_H__ */
@@ -0,0 +1,381 @@
+#include <lib_led/lib_led.h>
+#include <lib_led/lib_led_command_ring.h>
+#include <lib_led/lib_led_control.h>
+#include <lib_led/lib_led_fast_path.h>
+
+#include <libubus.h>
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Measures the latency from a producer queuing an update on a shared memory
+ * command ring to the daemon applying it, and how many updates the daemon
+ * coalesces. Each commit toggles a window of the daemon's LEDs between on
+ * and off. Requires a running daemon with the fast path enabled, and changes
+ * the state of its LEDs.
+ */
+
+/* The time allowed for the daemon to drain the ring at the end of the run. */
+#define DRAIN_TIMEOUT_MS 5000
+
+struct bench_config_st
+{
+    char const * ubus_path;
+    char const * socket_path;
+    size_t max_leds;
+    uint32_t num_records;
+    size_t records_per_commit;
+    size_t commits;
+    unsigned commit_interval_us;
+};
+
+struct bench_leds_st
+{
+    uint32_t * ids;
+    size_t num_leds;
+    size_t max_leds;
+    led_command_ring_client_st const * ring;
+};
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void
+add_led_id(char const * const led_name, void * const user_context)
+{
+    struct bench_leds_st * const leds = user_context;
+
+    if (led_name != NULL && leds->num_leds < leds->max_leds)
+    {
+        leds->ids[leds->num_leds] = led_command_ring_led_id(leds->ring, led_name);
+        if (leds->ids[leds->num_leds] != 0)
+        {
+            leds->num_leds++;
+        }
+    }
+}
+
+/*
+ * The upper bound of the bucket containing the given fraction of the
+ * latencies. Bucket n holds latencies less than 2^n ns.
+ */
+static uint64_t
+latency_percentile_ns(struct led_command_ring_stats_st const * const stats, double const fraction)
+{
+    uint64_t const target = (uint64_t)((double)stats->latency_count * fraction);
+    uint64_t seen = 0;
+    size_t bucket;
+
+    for (bucket = 0; bucket < LED_COMMAND_RING_LATENCY_BUCKETS - 1; bucket++)
+    {
+        seen += stats->latency_buckets[bucket];
+        if (seen > target)
+        {
+            break;
+        }
+    }
+
+    return (bucket == 0) ? 0 : 1ULL << bucket;
+}
+
+static void
+print_result(
+    struct bench_config_st const * const config,
+    size_t const num_leds,
+    struct led_command_ring_stats_st const * const stats,
+    uint64_t const records,
+    uint64_t const elapsed_ns)
+{
+    double const elapsed_s = (double)elapsed_ns / 1e9;
+
+    fprintf(stdout,
+            "{\"benchmark\": \"command_ring\", \"leds\": %zu, \"ring_records\": %" PRIu32 ", "
+            "\"records_per_commit\": %zu, \"commits\": %zu, \"records\": %" PRIu64 ", "
+            "\"records_per_sec\": %.0f, \"applied\": %" PRIu64 ", \"coalesced\": %" PRIu64 ", "
+            "\"invalid\": %" PRIu64 ", \"backpressure\": %" PRIu64 ", "
+            "\"overruns\": %" PRIu64 ", \"wakeups\": %" PRIu64 ", "
+            "\"latency_mean_ns\": %" PRIu64 ", \"latency_p50_ns\": %" PRIu64 ", "
+            "\"latency_p99_ns\": %" PRIu64 ", \"latency_max_ns\": %" PRIu64 "}\n",
+            num_leds,
+            stats->num_records,
+            config->records_per_commit,
+            config->commits,
+            records,
+            (elapsed_s > 0) ? (double)records / elapsed_s : 0.0,
+            stats->records_applied,
+            stats->records_coalesced,
+            stats->records_invalid,
+            stats->backpressure_count,
+            stats->overruns,
+            stats->wakeups,
+            (stats->latency_count > 0) ? stats->latency_total_ns / stats->latency_count : 0,
+            latency_percentile_ns(stats, 0.5),
+            latency_percentile_ns(stats, 0.99),
+            stats->latency_max_ns);
+}
+
+static bool
+wait_for_drain(led_command_ring_client_st const * const ring)
+{
+    bool drained = false;
+    struct led_command_ring_stats_st stats;
+
+    for (unsigned waited_ms = 0; waited_ms < DRAIN_TIMEOUT_MS && !drained; waited_ms++)
+    {
+        led_command_ring_get_stats(ring, &stats);
+        drained = stats.pending == 0;
+        if (!drained)
+        {
+            usleep(1000);
+        }
+    }
+
+    return drained;
+}
+
+static bool
+bench_command_ring(
+    struct bench_config_st const * const config,
+    struct bench_leds_st const * const leds,
+    led_command_ring_client_st * const ring)
+{
+    bool success = true;
+    uint64_t records = 0;
+    size_t next_led = 0;
+    uint64_t const start_ns = monotonic_ns();
+
+    for (size_t i = 0; i < config->commits && success; i++)
+    {
+        for (size_t j = 0; j < config->records_per_commit; j++)
+        {
+            uint32_t const state =
+                ((i + j) % 2 == 0) ? LED_FAST_PATH_STATE_ON : LED_FAST_PATH_STATE_OFF;
+
+            /* A full ring is counted by the daemon's statistics, not treated as a failure. */
+            if (led_command_ring_push_id(ring, leds->ids[next_led], state))
+            {
+                records++;
+            }
+            next_led = (next_led + 1) % leds->num_leds;
+        }
+
+        success = led_command_ring_commit(ring);
+        if (config->commit_interval_us > 0)
+        {
+            usleep(config->commit_interval_us);
+        }
+    }
+
+    if (!success || !wait_for_drain(ring))
+    {
+        fprintf(stderr, "The daemon didn't drain the command ring\n");
+        success = false;
+        goto done;
+    }
+
+    uint64_t const elapsed_ns = monotonic_ns() - start_ns;
+    struct led_command_ring_stats_st stats;
+
+    led_command_ring_get_stats(ring, &stats);
+    if (stats.ids_stale)
+    {
+        fprintf(stderr, "The daemon's LED IDs changed during the run\n");
+        success = false;
+        goto done;
+    }
+
+    print_result(config, leds->num_leds, &stats, records, elapsed_ns);
+
+done:
+    return success;
+}
+
+static bool
+run_benchmark(struct bench_config_st const * const config)
+{
+    bool success;
+    struct ubus_context * ubus_ctx = NULL;
+    ledcmd_ctx_st * ledcmd_ctx = NULL;
+    led_fast_path_st * fast_path = NULL;
+    led_command_ring_client_st * ring = NULL;
+    struct bench_leds_st leds =
+    {
+        .ids = calloc(config->max_leds, sizeof *leds.ids),
+        .num_leds = 0,
+        .max_leds = config->max_leds
+    };
+
+    if (leds.ids == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    ubus_ctx = ubus_connect(config->ubus_path);
+    if (ubus_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to connect to UBUS\n");
+        success = false;
+        goto done;
+    }
+
+    ledcmd_ctx = led_init(ubus_ctx);
+    if (ledcmd_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to connect to LED daemon\n");
+        success = false;
+        goto done;
+    }
+
+    fast_path = led_fast_path_connect(ledcmd_ctx, config->socket_path);
+    if (fast_path == NULL)
+    {
+        fprintf(stderr, "Unable to connect to the fast path socket %s\n", config->socket_path);
+        success = false;
+        goto done;
+    }
+
+    ring = led_command_ring_open(fast_path, config->num_records, NULL, NULL);
+    if (ring == NULL)
+    {
+        fprintf(stderr, "Unable to register a command ring\n");
+        success = false;
+        goto done;
+    }
+
+    leds.ring = ring;
+    if (!led_get_names(ledcmd_ctx, add_led_id, &leds) || leds.num_leds == 0)
+    {
+        fprintf(stderr, "Unable to list the daemon's LEDs\n");
+        success = false;
+        goto done;
+    }
+
+    success = bench_command_ring(config, &leds, ring);
+
+done:
+    led_command_ring_close(ring);
+    led_fast_path_close(fast_path);
+    free(leds.ids);
+    led_deinit(ledcmd_ctx);
+    if (ubus_ctx != NULL)
+    {
+        ubus_free(ubus_ctx);
+    }
+
+    return success;
+}
+
+static void
+usage(FILE * const fp)
+{
+    fprintf(fp,
+            "usage:\n"
+            "\tled_command_ring_bench [options] -f <socket>\n"
+            "\t-h?           - help    - what you see below\n"
+            "\t-u <path>     - ubus socket path\n"
+            "\t-f <path>     - the daemon's fast path socket path\n"
+            "\t-n <count>    - LEDs to update (default 8)\n"
+            "\t-s <count>    - ring records (default %u)\n"
+            "\t-r <count>    - records per commit (default 16)\n"
+            "\t-i <count>    - commits (default 100000)\n"
+            "\t-d <us>       - delay between commits (default 0)\n"
+            "\n"
+            "Results are written to stdout as a JSON object. Latency percentiles\n"
+            "are the upper bounds of power of two histogram buckets.\n"
+            "\n",
+            LED_COMMAND_RING_DEFAULT_RECORDS);
+}
+
+int
+main(int argc, char * argv[])
+{
+    int c;
+    int result;
+    struct bench_config_st config =
+    {
+        .ubus_path = NULL,
+        .socket_path = NULL,
+        .max_leds = 8,
+        .num_records = LED_COMMAND_RING_DEFAULT_RECORDS,
+        .records_per_commit = 16,
+        .commits = 100000,
+        .commit_interval_us = 0
+    };
+
+    while ((c = getopt(argc, argv, "?hu:f:n:s:r:i:d:")) != -1)
+    {
+        switch (c)
+        {
+        case '?':
+        case 'h':
+            usage(stdout);
+            result = EXIT_SUCCESS;
+            goto done;
+
+        case 'u':
+            config.ubus_path = optarg;
+            break;
+
+        case 'f':
+            config.socket_path = optarg;
+            break;
+
+        case 'n':
+            config.max_leds = strtoul(optarg, NULL, 10);
+            break;
+
+        case 's':
+            config.num_records = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'r':
+            config.records_per_commit = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'i':
+            config.commits = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'd':
+            config.commit_interval_us = strtoul(optarg, NULL, 10);
+            break;
+
+        default:
+            usage(stderr);
+            result = EXIT_FAILURE;
+            goto done;
+
+        }
+    }
+
+    if (config.socket_path == NULL
+        || config.max_leds == 0
+        || config.records_per_commit == 0
+        || config.commits == 0)
+    {
+        usage(stderr);
+        result = EXIT_FAILURE;
+        goto done;
+    }
+
+    result = run_benchmark(&config) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+done:
+    return result;
+}
@@ -0,0 +1,795 @@
+#include "led_bench.h"
+#include "led_bench_backend.h"
+
+#include <led_control.h>
+#include <led_daemon_ubus.h>
+
+#include <lib_led/string_constants.h>
+#include <ubus_utils/ubus_utils.h>
+
+#include <libubox/blobmsg.h>
+#include <libubus.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Benchmarks of the daemon's LED control path. Requests are made by calling
+ * the led_ops directly, as the ubus and fast path handlers do, so the
+ * results exclude the transport and message handling costs. The response
+ * benchmarks call the ubus handlers in-process, so include the cost of
+ * parsing requests and building responses.
+ */
+
+#define BENCH_ALIAS_NAME "bench_all"
+#define BENCH_PATTERN_A "bench_a"
+#define BENCH_PATTERN_B "bench_b"
+#define BENCH_LOCK_ID "led_bench"
+/* The number of LEDs used by the benchmark patterns. */
+#define BENCH_PATTERN_LEDS 8
+/* The duration of each step of the benchmark patterns. */
+#define BENCH_PATTERN_STEP_MS 1000
+
+struct control_bench_st
+{
+    ledcmd_ctx_st * ledcmd_ctx;
+    struct led_ops_st const * led_ops;
+    size_t num_leds;
+    uint32_t * led_ids;
+    size_t failures;
+    ledcmd_ubus_context_st * ubus_ctx;
+    /* ubus requests naming every LED: a get, and a set to off and to on. */
+    struct blob_buf get_all_request;
+    struct blob_buf set_all_requests[2];
+};
+
+typedef void (*control_op_fn)(struct control_bench_st * bench, size_t iteration);
+
+struct control_benchmark_st
+{
+    char const * benchmark;
+    char const * mode;
+    control_op_fn op;
+    /*
+     * Handles and pattern contexts are pooled, so these requests must make no
+     * heap allocations. Locking an LED copies its lock ID, so isn't one.
+     */
+    bool allocation_free;
+    /*
+     * Make one request before counting allocations, as the first response
+     * grows the daemon's response buffer to its high-water mark.
+     */
+    bool warm_up;
+};
+
+static void
+set_state_result(
+    char const * const led_name,
+    bool const success,
+    char const * const state,
+    char const * const error_msg,
+    void * const user_context)
+{
+    UNUSED_ARG(led_name);
+    UNUSED_ARG(state);
+    UNUSED_ARG(error_msg);
+
+    struct control_bench_st * const bench = user_context;
+
+    bench->failures += !success;
+}
+
+static void
+get_state_result(
+    char const * const led_name,
+    bool const success,
+    char const * const led_state,
+    char const * const lock_id,
+    char const * const led_priority,
+    char const * const error_msg,
+    void * const result_context)
+{
+    UNUSED_ARG(led_name);
+    UNUSED_ARG(led_state);
+    UNUSED_ARG(lock_id);
+    UNUSED_ARG(led_priority);
+    UNUSED_ARG(error_msg);
+
+    struct control_bench_st * const bench = result_context;
+
+    bench->failures += !success;
+}
+
+static void
+priority_result(
+    char const * const led_name,
+    bool const success,
+    char const * const lock_id,
+    char const * const error_msg,
+    void * const result_context)
+{
+    UNUSED_ARG(led_name);
+    UNUSED_ARG(lock_id);
+    UNUSED_ARG(error_msg);
+
+    struct control_bench_st * const bench = result_context;
+
+    bench->failures += !success;
+}
+
+static void
+pattern_result(bool const success, char const * const error_msg, void * const result_context)
+{
+    UNUSED_ARG(error_msg);
+
+    struct control_bench_st * const bench = result_context;
+
+    bench->failures += !success;
+}
+
+static void
+resolve_led_cb(char const * const led_name, uint32_t const led_id, void * const result_context)
+{
+    struct control_bench_st * const bench = result_context;
+    char * end;
+    unsigned long const led_number = strtoul(led_name, &end, 10);
+
+    /* The backend's LEDs are numbered from 1. Aliases aren't numeric. */
+    if (*end == '\0' && led_number >= 1 && led_number <= bench->num_leds)
+    {
+        bench->led_ids[led_number - 1] = led_id;
+    }
+}
+
+static char const *
+led_name(size_t const index, char * const buf, size_t const buf_size)
+{
+    snprintf(buf, buf_size, "%zu", index + 1);
+
+    return buf;
+}
+
+/* Each LED is turned on in one pass over the LEDs, then off in the next. */
+static enum led_state_t
+toggled_state(struct control_bench_st const * const bench, size_t const iteration)
+{
+    return ((iteration / bench->num_leds) % 2 == 0) ? LED_ON : LED_OFF;
+}
+
+static void
+set_state(
+    struct control_bench_st * const bench,
+    char const * const name,
+    uint32_t const led_id,
+    enum led_state_t const state)
+{
+    struct led_ops_st const * const led_ops = bench->led_ops;
+    led_ops_handle * const handle = led_ops->open(bench->ledcmd_ctx);
+    struct set_state_req_st const request =
+    {
+        .led_name = name,
+        .led_id = led_id,
+        .state = state,
+        .flash_type = LED_FLASH_TYPE_NONE
+    };
+
+    if (!led_ops->set_state(handle, &request, set_state_result, bench))
+    {
+        bench->failures++;
+    }
+    led_ops->close(handle);
+}
+
+static void
+op_set_single(struct control_bench_st * const bench, size_t const iteration)
+{
+    char buf[16];
+
+    set_state(
+        bench,
+        led_name(iteration % bench->num_leds, buf, sizeof buf),
+        LED_ID_NONE,
+        toggled_state(bench, iteration));
+}
+
+static void
+op_set_single_id(struct control_bench_st * const bench, size_t const iteration)
+{
+    set_state(
+        bench,
+        NULL,
+        bench->led_ids[iteration % bench->num_leds],
+        toggled_state(bench, iteration));
+}
+
+static void
+op_get_single(struct control_bench_st * const bench, size_t const iteration)
+{
+    struct led_ops_st const * const led_ops = bench->led_ops;
+    led_ops_handle * const handle = led_ops->open(bench->ledcmd_ctx);
+    char buf[16];
+
+    if (!led_ops->get_state(
+            handle,
+            led_name(iteration % bench->num_leds, buf, sizeof buf),
+            LED_ID_NONE,
+            get_state_result,
+            bench))
+    {
+        bench->failures++;
+    }
+    led_ops->close(handle);
+}
+
+static void
+op_set_all(struct control_bench_st * const bench, size_t const iteration)
+{
+    set_state(bench, _led_all, LED_ID_NONE, (iteration % 2 == 0) ? LED_ON : LED_OFF);
+}
+
+static void
+op_set_alias(struct control_bench_st * const bench, size_t const iteration)
+{
+    set_state(bench, BENCH_ALIAS_NAME, LED_ID_NONE, (iteration % 2 == 0) ? LED_ON : LED_OFF);
+}
+
+static void
+change_priority(
+    struct control_bench_st * const bench,
+    char const * const name,
+    char const * const priority,
+    char const * const lock_id)
+{
+    struct led_ops_st const * const led_ops = bench->led_ops;
+    led_ops_handle * const handle = led_ops->open(bench->ledcmd_ctx);
+
+    if (!led_ops->activate_priority(
+            handle, name, LED_ID_NONE, priority, lock_id, priority_result, bench)
+        || !led_ops->deactivate_priority(
+            handle, name, LED_ID_NONE, priority, lock_id, priority_result, bench))
+    {
+        bench->failures++;
+    }
+    led_ops->close(handle);
+}
+
+static void
+op_activate_deactivate(struct control_bench_st * const bench, size_t const iteration)
+{
+    char buf[16];
+
+    change_priority(
+        bench,
+        led_name(iteration % bench->num_leds, buf, sizeof buf),
+        _led_priority_alternate,
+        NULL);
+}
+
+static void
+op_lock_unlock_all(struct control_bench_st * const bench, size_t const iteration)
+{
+    UNUSED_ARG(iteration);
+
+    change_priority(bench, _led_all, _led_priority_locked, BENCH_LOCK_ID);
+}
+
+static void
+op_pattern_play_stop(struct control_bench_st * const bench, size_t const iteration)
+{
+    UNUSED_ARG(iteration);
+
+    struct led_ops_st const * const led_ops = bench->led_ops;
+    bool const retrigger = false;
+
+    if (!led_ops->play_pattern(
+            bench->ledcmd_ctx, BENCH_PATTERN_A, retrigger, pattern_result, bench)
+        || !led_ops->stop_pattern(bench->ledcmd_ctx, BENCH_PATTERN_A, pattern_result, bench))
+    {
+        bench->failures++;
+    }
+}
+
+/*
+ * The patterns use the same LEDs, so each one played pre-empts the other,
+ * which was left playing by the previous iteration.
+ */
+static void
+op_pattern_evict(struct control_bench_st * const bench, size_t const iteration)
+{
+    struct led_ops_st const * const led_ops = bench->led_ops;
+    bool const retrigger = false;
+
+    if (!led_ops->play_pattern(
+            bench->ledcmd_ctx,
+            (iteration % 2 == 0) ? BENCH_PATTERN_B : BENCH_PATTERN_A,
+            retrigger,
+            pattern_result,
+            bench))
+    {
+        bench->failures++;
+    }
+}
+
+static void
+ubus_call(
+    struct control_bench_st * const bench,
+    char const * const method,
+    struct blob_buf const * const request)
+{
+    if (ledcmd_ubus_call(bench->ubus_ctx, method, request->head) != UBUS_STATUS_OK)
+    {
+        bench->failures++;
+    }
+}
+
+static void
+op_ubus_get_all(struct control_bench_st * const bench, size_t const iteration)
+{
+    UNUSED_ARG(iteration);
+
+    ubus_call(bench, _led_get, &bench->get_all_request);
+}
+
+static void
+op_ubus_set_all(struct control_bench_st * const bench, size_t const iteration)
+{
+    ubus_call(bench, _led_set, &bench->set_all_requests[iteration % 2]);
+}
+
+/* Builds a request naming every LED. The state is NULL for a get request. */
+static void
+build_all_leds_request(
+    struct blob_buf * const request, size_t const num_leds, char const * const state)
+{
+    blob_buf_init(request, 0);
+
+    void * const array_cookie = blobmsg_open_array(request, _led_leds);
+
+    for (size_t i = 0; i < num_leds; i++)
+    {
+        char buf[16];
+        void * const cookie = blobmsg_open_table(request, NULL);
+
+        blobmsg_add_string(request, _led_name, led_name(i, buf, sizeof buf));
+        if (state != NULL)
+        {
+            blobmsg_add_string(request, _led_state, state);
+        }
+        blobmsg_close_table(request, cookie);
+    }
+
+    blobmsg_close_array(request, array_cookie);
+}
+
+static void
+write_pattern(FILE * const fp, char const * const name, size_t const num_leds, bool const last)
+{
+    static char const * const states[] = { "on", "off" };
+
+    fprintf(fp, "{\"name\": \"%s\", \"repeat\": true, \"pattern\": [", name);
+    for (size_t s = 0; s < ARRAY_SIZE(states); s++)
+    {
+        fprintf(fp,
+                "%s{\"time_ms\": %u, \"leds\": [",
+                (s > 0) ? ", " : "",
+                BENCH_PATTERN_STEP_MS);
+        for (size_t i = 0; i < num_leds; i++)
+        {
+            fprintf(fp,
+                    "%s{\"name\": \"%zu\", \"state\": \"%s\"}",
+                    (i > 0) ? ", " : "",
+                    i + 1,
+                    states[s]);
+        }
+        fprintf(fp, "]}");
+    }
+    fprintf(fp, "]}%s", last ? "" : ", ");
+}
+
+/* Writes an alias for num_leds LEDs, starting with first_led. */
+static bool
+write_alias_file(
+    char const * const directory,
+    char const * const alias_name,
+    size_t const first_led,
+    size_t const num_leds)
+{
+    bool success;
+    char path[256];
+
+    snprintf(path, sizeof path, "%s/aliases.json", directory);
+
+    FILE * const fp = fopen(path, "w");
+
+    if (fp == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    fprintf(fp, "{\"aliases\": [{\"name\": \"%s\", \"aliases\": [", alias_name);
+    for (size_t i = 0; i < num_leds; i++)
+    {
+        fprintf(fp, "%s\"%zu\"", (i > 0) ? ", " : "", first_led + i);
+    }
+    fprintf(fp, "]}]}\n");
+    fclose(fp);
+
+    success = true;
+
+done:
+    return success;
+}
+
+static bool
+write_config_files(char const * const directory, size_t const num_leds)
+{
+    bool success;
+    char path[256];
+    FILE * fp;
+
+    snprintf(path, sizeof path, "%s/patterns.json", directory);
+    fp = fopen(path, "w");
+    if (fp == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    size_t const pattern_leds = (num_leds < BENCH_PATTERN_LEDS) ? num_leds : BENCH_PATTERN_LEDS;
+
+    fprintf(fp, "{\"patterns\": [");
+    write_pattern(fp, BENCH_PATTERN_A, pattern_leds, false);
+    write_pattern(fp, BENCH_PATTERN_B, pattern_leds, true);
+    fprintf(fp, "]}\n");
+    fclose(fp);
+
+    success = write_alias_file(directory, BENCH_ALIAS_NAME, 1, num_leds);
+
+done:
+    return success;
+}
+
+static void
+remove_config_files(char const * const directory)
+{
+    char path[256];
+
+    snprintf(path, sizeof path, "%s/patterns.json", directory);
+    unlink(path);
+    snprintf(path, sizeof path, "%s/aliases.json", directory);
+    unlink(path);
+    rmdir(directory);
+}
+
+static bool
+run_benchmark(
+    size_t const iterations,
+    struct control_bench_st * const bench,
+    struct control_benchmark_st const * const benchmark,
+    uint64_t * const samples)
+{
+    bool success;
+
+    bench->failures = 0;
+    if (benchmark->warm_up)
+    {
+        benchmark->op(bench, 0);
+    }
+
+    size_t const initial_allocations = heap_allocations;
+
+    for (size_t i = 0; i < iterations; i++)
+    {
+        uint64_t const start_ns = monotonic_ns();
+
+        benchmark->op(bench, i);
+
+        samples[i] = monotonic_ns() - start_ns;
+    }
+
+    size_t const allocations = heap_allocations - initial_allocations;
+
+    if (bench->failures > 0)
+    {
+        fprintf(stderr,
+                "%s/%s: %zu operations failed\n",
+                benchmark->benchmark,
+                benchmark->mode,
+                bench->failures);
+        success = false;
+        goto done;
+    }
+
+    if (benchmark->allocation_free && allocations > 0)
+    {
+        fprintf(stderr,
+                "%s/%s: %zu heap allocations in %zu operations\n",
+                benchmark->benchmark,
+                benchmark->mode,
+                allocations,
+                iterations);
+        success = false;
+        goto done;
+    }
+
+    struct bench_result_st result =
+    {
+        .benchmark = benchmark->benchmark,
+        .mode = benchmark->mode,
+        .num_leds = bench->num_leds,
+        .allocations_counted = true,
+        .allocations_per_op = (double)allocations / iterations
+    };
+
+    summarise_samples(samples, iterations, &result);
+    print_result(&result);
+    success = true;
+
+done:
+    return success;
+}
+
+/*
+ * Plays a pattern on the virtual clock, advancing the clock by one step at a
+ * time, so the cost of the pattern engine is measured without waiting for
+ * its timers. Each advance must play exactly one step.
+ */
+static bool
+run_pattern_simulation(
+    struct bench_config_st const * const config,
+    struct control_bench_st * const bench,
+    uint64_t * const samples)
+{
+    bool success;
+    struct led_ops_st const * const led_ops = bench->led_ops;
+    bool const retrigger = false;
+    size_t missed_steps = 0;
+
+    /* Timers can't be moved to the virtual clock, so stop any playing patterns. */
+    led_ops->stop_pattern(bench->ledcmd_ctx, BENCH_PATTERN_A, pattern_result, bench);
+    led_ops->stop_pattern(bench->ledcmd_ctx, BENCH_PATTERN_B, pattern_result, bench);
+    bench->failures = 0;
+
+    if (!led_clock_use_virtual(true))
+    {
+        fprintf(stderr, "Unable to switch to the virtual clock\n");
+        success = false;
+        goto done;
+    }
+
+    led_ops->play_pattern(bench->ledcmd_ctx, BENCH_PATTERN_A, retrigger, pattern_result, bench);
+
+    uint64_t const initial_steps = led_daemon_stats.pattern_steps;
+    size_t const initial_allocations = heap_allocations;
+
+    for (size_t i = 0; i < config->iterations; i++)
+    {
+        uint64_t const start_ns = monotonic_ns();
+        size_t const fired = led_clock_advance((uint64_t)BENCH_PATTERN_STEP_MS * 1000000ULL);
+
+        samples[i] = monotonic_ns() - start_ns;
+        missed_steps += fired != 1;
+    }
+
+    uint64_t const steps = led_daemon_stats.pattern_steps - initial_steps;
+
+    size_t const allocations = heap_allocations - initial_allocations;
+
+    led_ops->stop_pattern(bench->ledcmd_ctx, BENCH_PATTERN_A, pattern_result, bench);
+
+    if (bench->failures > 0 || missed_steps > 0 || steps != config->iterations)
+    {
+        fprintf(stderr,
+                "pattern/simulated: %" PRIu64 " steps played in %zu advances of the clock\n",
+                steps,
+                config->iterations);
+        success = false;
+        goto done;
+    }
+
+    /* Stepping a pattern must make no heap allocations. */
+    if (allocations > 0)
+    {
+        fprintf(stderr,
+                "pattern/simulated: %zu heap allocations in %zu steps\n",
+                allocations,
+                config->iterations);
+        success = false;
+        goto done;
+    }
+
+    struct bench_result_st result =
+    {
+        .benchmark = "pattern",
+        .mode = "simulated",
+        .num_leds = bench->num_leds,
+        .allocations_counted = true,
+        .allocations_per_op = (double)allocations / config->iterations
+    };
+
+    summarise_samples(samples, config->iterations, &result);
+    print_result(&result);
+    success = true;
+
+done:
+    led_clock_use_virtual(false);
+
+    return success;
+}
+
+/*
+ * Initialises the control path and the ubus handlers with num_leds LEDs,
+ * configured in directory, which must be a template for mkdtemp().
+ */
+static bool
+bench_init(
+    struct control_bench_st * const bench, char * const directory, size_t const num_leds)
+{
+    bool success;
+
+    bench->num_leds = num_leds;
+    bench->led_ids = calloc(num_leds, sizeof *bench->led_ids);
+    if (bench->led_ids == NULL || mkdtemp(directory) == NULL)
+    {
+        fprintf(stderr, "Unable to create the benchmark configuration\n");
+        success = false;
+        goto done;
+    }
+
+    if (!write_config_files(directory, num_leds))
+    {
+        fprintf(stderr, "Unable to write the benchmark configuration\n");
+        success = false;
+        goto done;
+    }
+
+    bench->ledcmd_ctx =
+        ledcmd_control_init(directory, directory, led_bench_backend_methods(num_leds));
+    if (bench->ledcmd_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to initialise the LED control path\n");
+        success = false;
+        goto done;
+    }
+    bench->led_ops = ledcmd_control_ops();
+    bench->led_ops->resolve_leds(bench->ledcmd_ctx, resolve_led_cb, bench);
+
+    bench->ubus_ctx = ledcmd_ubus_init_unconnected(bench->led_ops, bench->ledcmd_ctx);
+    if (bench->ubus_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to initialise the ubus handlers\n");
+        success = false;
+        goto done;
+    }
+    build_all_leds_request(&bench->get_all_request, num_leds, NULL);
+    build_all_leds_request(&bench->set_all_requests[0], num_leds, _led_off);
+    build_all_leds_request(&bench->set_all_requests[1], num_leds, _led_on);
+
+    success = true;
+
+done:
+    return success;
+}
+
+static void
+bench_deinit(struct control_bench_st * const bench, char const * const directory)
+{
+    blob_buf_free(&bench->get_all_request);
+    blob_buf_free(&bench->set_all_requests[0]);
+    blob_buf_free(&bench->set_all_requests[1]);
+    ledcmd_ubus_deinit(bench->ubus_ctx);
+    ledcmd_deinit(bench->ledcmd_ctx);
+    remove_config_files(directory);
+    free(bench->led_ids);
+}
+
+static bool
+run_benchmarks_for_led_count(
+    struct bench_config_st const * const config,
+    size_t const num_leds,
+    uint64_t * const samples)
+{
+    static struct control_benchmark_st const benchmarks[] =
+    {
+        { .benchmark = "set", .mode = "single", .op = op_set_single, .allocation_free = true },
+        { .benchmark = "set", .mode = "single_id", .op = op_set_single_id, .allocation_free = true },
+        { .benchmark = "get", .mode = "single", .op = op_get_single, .allocation_free = true },
+        { .benchmark = "set", .mode = "all", .op = op_set_all, .allocation_free = true },
+        { .benchmark = "set", .mode = "alias", .op = op_set_alias, .allocation_free = true },
+        {
+            .benchmark = "priority",
+            .mode = "activate_deactivate",
+            .op = op_activate_deactivate,
+            .allocation_free = true
+        },
+        { .benchmark = "lock", .mode = "lock_unlock_all", .op = op_lock_unlock_all },
+        {
+            .benchmark = "pattern",
+            .mode = "play_stop",
+            .op = op_pattern_play_stop,
+            .allocation_free = true
+        },
+        { .benchmark = "pattern", .mode = "evict", .op = op_pattern_evict, .allocation_free = true }
+    };
+    bool success;
+    char directory[] = "/tmp/led_bench.XXXXXX";
+    struct control_bench_st bench = { .num_leds = 0 };
+
+    success = bench_init(&bench, directory, num_leds);
+    for (size_t i = 0; i < ARRAY_SIZE(benchmarks) && success; i++)
+    {
+        if (benchmarks[i].op == op_pattern_evict)
+        {
+            /* The first iteration pre-empts this. */
+            bench.led_ops->play_pattern(
+                bench.ledcmd_ctx, BENCH_PATTERN_A, false, pattern_result, &bench);
+        }
+        success =
+            run_benchmark(config->control_iterations, &bench, &benchmarks[i], samples);
+    }
+    if (success)
+    {
+        success = run_pattern_simulation(config, &bench, samples);
+    }
+
+    bench_deinit(&bench, directory);
+
+    return success;
+}
+
+bool
+run_control_benchmarks(struct bench_config_st const * const config, uint64_t * const samples)
+{
+    bool success = true;
+
+    for (size_t i = 0; i < config->num_control_led_counts && success; i++)
+    {
+        success =
+            run_benchmarks_for_led_count(config, config->control_led_counts[i], samples);
+    }
+
+    return success;
+}
+
+bool
+run_response_benchmarks(struct bench_config_st const * const config, uint64_t * const samples)
+{
+    static struct control_benchmark_st const benchmarks[] =
+    {
+        {
+            .benchmark = "get_response",
+            .mode = "ubus",
+            .op = op_ubus_get_all,
+            .allocation_free = true,
+            .warm_up = true
+        },
+        {
+            .benchmark = "set_response",
+            .mode = "ubus",
+            .op = op_ubus_set_all,
+            .allocation_free = true,
+            .warm_up = true
+        }
+    };
+    bool success = true;
+
+    for (size_t i = 0; i < config->num_led_counts && success; i++)
+    {
+        char directory[] = "/tmp/led_bench.XXXXXX";
+        struct control_bench_st bench = { .num_leds = 0 };
+
+        success = bench_init(&bench, directory, config->led_counts[i]);
+        for (size_t b = 0; b < ARRAY_SIZE(benchmarks) && success; b++)
+        {
+            success = run_benchmark(config->iterations, &bench, &benchmarks[b], samples);
+        }
+
+        bench_deinit(&bench, directory);
+    }
+
+    return success;
+}
@@ -0,0 +1,1392 @@
+#include "led_bench_backend.h"
+#include "led_bench_ubus.h"
+
+#include <led_command_ring.h>
+#include <led_control.h>
+#include <led_daemon_ubus.h>
+#include <led_journal.h>
+#include <led_journal_format.h>
+
+#include <lib_led/led_fast_path_layout.h>
+#include <lib_led/led_status_page_layout.h>
+#include <lib_led/lib_led_status_page.h>
+#include <lib_led/string_constants.h>
+#include <ubus_utils/ubus_utils.h>
+
+#include <libubox/blobmsg.h>
+#include <libubox/uloop.h>
+#include <libubus.h>
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Checks of the daemon's behaviour, run by ctest. Each test starts the
+ * daemon's control path in-process with the in-memory backend, and makes
+ * requests by calling the ubus handlers with ledcmd_ubus_call(), or the
+ * led_ops directly.
+ */
+
+#define TEST_DIRECTORY_TEMPLATE "/tmp/led_daemon_tests.XXXXXX"
+#define TEST_STATUS_PAGE_NAME "/led_daemon_tests_status"
+#define TEST_LEDS 4
+/* LED 1 is also an alias for the other LEDs. */
+#define SHARED_NAME_LEDS 3
+#define TEST_RING_RECORDS LED_COMMAND_RING_MIN_RECORDS
+/* How long uloop is run for the daemon to drain a command ring. */
+#define TEST_RING_DRAIN_MS 10
+/* More changes than the daemon keeps in its change history. */
+#define CHANGE_HISTORY_OVERRUN 1000
+#define SHARED_NAME_ALIASES \
+    "{\"aliases\": [{\"name\": \"1\", \"aliases\": [\"2\", \"3\"]}]}"
+
+struct test_daemon_st
+{
+    char directory[sizeof TEST_DIRECTORY_TEMPLATE];
+    size_t num_leds;
+    ledcmd_ctx_st * ledcmd_ctx;
+    struct led_ops_st const * led_ops;
+    ledcmd_ubus_context_st * ubus_ctx;
+};
+
+struct led_ids_st
+{
+    size_t num_leds;
+    uint32_t ids[TEST_LEDS];
+};
+
+struct changes_result_st
+{
+    size_t num_changes;
+    char const * led_name;
+    enum led_state_t state;
+};
+
+/* The per-operation results in a batch reply. */
+struct batch_results_st
+{
+    size_t num_ops;
+    size_t num_led_results;
+    uint32_t succeeded;
+    uint32_t failed;
+};
+
+/* The calls and errors reported by the stats method for each method. */
+struct method_calls_st
+{
+    char const * method;
+    uint64_t calls;
+    uint64_t errors;
+    bool found;
+};
+
+struct method_stats_st
+{
+    struct method_calls_st * methods;
+    size_t num_methods;
+    /* Methods reported with calls that aren't in methods. */
+    size_t unexpected_calls;
+};
+
+struct name_ids_st
+{
+    char const * name;
+    size_t num_ids;
+    uint32_t led_id;
+};
+
+struct test_st
+{
+    char const * name;
+    bool (*run)(void);
+};
+
+static char const * const led_names[TEST_LEDS] = { "1", "2", "3", "4" };
+
+static void
+resolve_led_cb(char const * const led_name, uint32_t const led_id, void * const result_context)
+{
+    struct led_ids_st * const led_ids = result_context;
+    unsigned long const led_number = strtoul(led_name, NULL, 10);
+
+    if (led_number >= 1 && led_number <= led_ids->num_leds)
+    {
+        led_ids->ids[led_number - 1] = led_id;
+    }
+}
+
+static void
+count_name_ids_cb(char const * const led_name, uint32_t const led_id, void * const result_context)
+{
+    struct name_ids_st * const name_ids = result_context;
+
+    if (strcasecmp(led_name, name_ids->name) == 0)
+    {
+        name_ids->num_ids++;
+        name_ids->led_id = led_id;
+    }
+}
+
+static void
+set_state_cb(
+    char const * const led_name,
+    bool const success,
+    char const * const state,
+    char const * const error_msg,
+    void * const user_context)
+{
+    UNUSED_ARG(led_name);
+    UNUSED_ARG(state);
+    UNUSED_ARG(error_msg);
+
+    bool * const all_succeeded = user_context;
+
+    *all_succeeded = *all_succeeded && success;
+}
+
+static void
+change_cb(
+    char const * const led_name,
+    struct led_status_st const * const status,
+    void * const result_context)
+{
+    struct changes_result_st * const result = result_context;
+
+    result->num_changes++;
+    result->led_name = led_name;
+    result->state = status->state;
+}
+
+static void
+led_on_cb(
+    char const * const led_name,
+    bool const success,
+    char const * const led_state,
+    char const * const lock_id,
+    char const * const led_priority,
+    char const * const error_msg,
+    void * const result_context)
+{
+    UNUSED_ARG(lock_id);
+    UNUSED_ARG(led_priority);
+    UNUSED_ARG(error_msg);
+
+    bool * const on = result_context;
+    unsigned long const led_number = strtoul(led_name, NULL, 10);
+
+    if (success && led_number >= 1 && led_number <= TEST_LEDS)
+    {
+        on[led_number - 1] = strcasecmp(led_state, _led_on) == 0;
+    }
+}
+
+/* Writes an alias file for the daemon, unless aliases is NULL. */
+static bool
+write_aliases(char const * const directory, char const * const aliases)
+{
+    bool success;
+    char path[256];
+
+    if (aliases == NULL)
+    {
+        success = true;
+        goto done;
+    }
+
+    snprintf(path, sizeof path, "%s/aliases.json", directory);
+
+    FILE * const fp = fopen(path, "w");
+
+    if (fp == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    fputs(aliases, fp);
+    fclose(fp);
+
+    success = true;
+
+done:
+    return success;
+}
+
+static void
+test_daemon_stop(struct test_daemon_st * const daemon)
+{
+    char path[256];
+
+    ledcmd_ubus_deinit(daemon->ubus_ctx);
+    ledcmd_deinit(daemon->ledcmd_ctx);
+    snprintf(path, sizeof path, "%s/aliases.json", daemon->directory);
+    unlink(path);
+    rmdir(daemon->directory);
+}
+
+/*
+ * Starts the control path with num_leds LEDs, named "1" to "<num_leds>", and
+ * the aliases given as JSON (which may be NULL), without patterns.
+ */
+static bool
+test_daemon_start(
+    struct test_daemon_st * const daemon, size_t const num_leds, char const * const aliases)
+{
+    bool success;
+
+    memset(daemon, 0, sizeof *daemon);
+    strcpy(daemon->directory, TEST_DIRECTORY_TEMPLATE);
+    daemon->num_leds = num_leds;
+
+    if (mkdtemp(daemon->directory) == NULL || !write_aliases(daemon->directory, aliases))
+    {
+        fprintf(stderr, "Unable to write the daemon's configuration\n");
+        success = false;
+        goto done;
+    }
+
+    char const * const patterns_directory = NULL;
+
+    daemon->ledcmd_ctx = ledcmd_control_init(
+        patterns_directory, daemon->directory, led_bench_backend_methods(num_leds));
+    daemon->led_ops = ledcmd_control_ops();
+    if (daemon->ledcmd_ctx != NULL)
+    {
+        daemon->ubus_ctx = ledcmd_ubus_init_unconnected(daemon->led_ops, daemon->ledcmd_ctx);
+    }
+    if (daemon->ubus_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to start the daemon\n");
+        success = false;
+        goto done;
+    }
+
+    success = true;
+
+done:
+    if (!success)
+    {
+        test_daemon_stop(daemon);
+    }
+
+    return success;
+}
+
+static void
+resolve_led_ids(struct test_daemon_st const * const daemon, struct led_ids_st * const led_ids)
+{
+    memset(led_ids, 0, sizeof *led_ids);
+    led_ids->num_leds = daemon->num_leds;
+    daemon->led_ops->resolve_leds(daemon->ledcmd_ctx, resolve_led_cb, led_ids);
+}
+
+/* Reads whether each LED is on. */
+static void
+read_leds_on(struct test_daemon_st const * const daemon, bool * const on)
+{
+    struct led_ops_st const * const led_ops = daemon->led_ops;
+    led_ops_handle * const handle = led_ops->open(daemon->ledcmd_ctx);
+
+    memset(on, 0, daemon->num_leds * sizeof *on);
+    led_ops->get_state(handle, _led_all, LED_ID_NONE, led_on_cb, on);
+    led_ops->close(handle);
+}
+
+static bool
+leds_on_are(
+    struct test_daemon_st const * const daemon,
+    bool const * const expected,
+    char const * const test_name)
+{
+    bool on[TEST_LEDS];
+    bool success = true;
+
+    read_leds_on(daemon, on);
+    for (size_t i = 0; i < daemon->num_leds; i++)
+    {
+        if (on[i] != expected[i])
+        {
+            fprintf(stderr,
+                    "%s: LED %s is %s\n",
+                    test_name,
+                    led_names[i],
+                    on[i] ? "on" : "off");
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+/* Sets an LED or alias, given by name or by ID, to state. */
+static bool
+set_state(
+    struct test_daemon_st const * const daemon,
+    char const * const name,
+    uint32_t const led_id,
+    enum led_state_t const state)
+{
+    struct led_ops_st const * const led_ops = daemon->led_ops;
+    led_ops_handle * const handle = led_ops->open(daemon->ledcmd_ctx);
+    struct set_state_req_st const request =
+    {
+        .led_name = name,
+        .led_id = led_id,
+        .state = state,
+        .flash_type = LED_FLASH_TYPE_NONE
+    };
+    bool all_succeeded = true;
+    bool const success =
+        led_ops->set_state(handle, &request, set_state_cb, &all_succeeded) && all_succeeded;
+
+    led_ops->close(handle);
+
+    return success;
+}
+
+static void
+get_changes(
+    struct test_daemon_st const * const daemon,
+    struct led_changes_info_st const * const since,
+    struct led_changes_info_st * const info,
+    struct changes_result_st * const result)
+{
+    memset(result, 0, sizeof *result);
+    daemon->led_ops->get_changes(
+        daemon->ledcmd_ctx, since->epoch, since->seq, info, change_cb, result);
+}
+
+static void
+add_string_array(
+    struct blob_buf * const buf,
+    char const * const name,
+    char const * const * const strings,
+    size_t const num_strings)
+{
+    void * const cookie = blobmsg_open_array(buf, name);
+
+    for (size_t i = 0; i < num_strings; i++)
+    {
+        blobmsg_add_string(buf, NULL, strings[i]);
+    }
+
+    blobmsg_close_array(buf, cookie);
+}
+
+static void
+add_u32_array(
+    struct blob_buf * const buf,
+    char const * const name,
+    uint32_t const * const values,
+    size_t const num_values)
+{
+    void * const cookie = blobmsg_open_array(buf, name);
+
+    for (size_t i = 0; i < num_values; i++)
+    {
+        blobmsg_add_u32(buf, NULL, values[i]);
+    }
+
+    blobmsg_close_array(buf, cookie);
+}
+
+static void
+batch_reply_cb(struct blob_attr * const msg, void * const context)
+{
+    struct batch_results_st * const results = context;
+    enum
+    {
+        OP_LEDS,
+        OP_SUCCEEDED,
+        OP_FAILED,
+        OP_MAX__
+    };
+    struct blobmsg_policy const op_policy[OP_MAX__] =
+    {
+        [OP_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY },
+        [OP_SUCCEEDED] = { .name = _led_succeeded, .type = BLOBMSG_TYPE_INT32 },
+        [OP_FAILED] = { .name = _led_failed, .type = BLOBMSG_TYPE_INT32 }
+    };
+    struct blobmsg_policy const results_policy =
+        { .name = _led_results, .type = BLOBMSG_TYPE_ARRAY };
+    struct blob_attr * results_attr;
+    struct blob_attr * cur;
+    int rem;
+
+    memset(results, 0, sizeof *results);
+    blobmsg_parse(&results_policy, 1, &results_attr, blob_data(msg), blob_len(msg));
+    if (results_attr == NULL)
+    {
+        goto done;
+    }
+
+    blobmsg_for_each_attr(cur, results_attr, rem)
+    {
+        struct blob_attr * fields[OP_MAX__];
+
+        blobmsg_parse(op_policy, OP_MAX__, fields, blobmsg_data(cur), blobmsg_data_len(cur));
+        results->num_ops++;
+        int const num_led_results =
+            (fields[OP_LEDS] != NULL)
+            ? blobmsg_check_array(fields[OP_LEDS], BLOBMSG_TYPE_TABLE)
+            : 0;
+
+        if (num_led_results > 0)
+        {
+            results->num_led_results += num_led_results;
+        }
+        results->succeeded += blobmsg_get_u32_or_default(fields[OP_SUCCEEDED], 0);
+        results->failed += blobmsg_get_u32_or_default(fields[OP_FAILED], 0);
+    }
+
+done:
+    return;
+}
+
+/* Sends a batch that sets LED 1 and gets LED 2, with the verbosity given. */
+static int
+batch_set_and_get(
+    struct test_daemon_st const * const daemon,
+    char const * const verbosity,
+    struct batch_results_st * const results)
+{
+    struct blob_buf buf;
+    void * cookie;
+
+    memset(&buf, 0, sizeof buf);
+    blob_buf_init(&buf, 0);
+    cookie = blobmsg_open_array(&buf, _led_ops);
+
+    void * const set_cookie = blobmsg_open_table(&buf, NULL);
+
+    blobmsg_add_string(&buf, _led_op, _led_set);
+    blobmsg_add_string(&buf, _led_name, led_names[0]);
+    blobmsg_add_string(&buf, _led_state, _led_on);
+    blobmsg_close_table(&buf, set_cookie);
+
+    void * const get_cookie = blobmsg_open_table(&buf, NULL);
+
+    blobmsg_add_string(&buf, _led_op, _led_get);
+    blobmsg_add_string(&buf, _led_name, led_names[1]);
+    blobmsg_close_table(&buf, get_cookie);
+    blobmsg_close_array(&buf, cookie);
+    blobmsg_add_string(&buf, _led_verbosity, verbosity);
+
+    led_bench_ubus_set_reply_cb(batch_reply_cb, results);
+
+    int const result = ledcmd_ubus_call(daemon->ubus_ctx, _led_batch, buf.head);
+
+    led_bench_ubus_set_reply_cb(NULL, NULL);
+    blob_buf_free(&buf);
+
+    return result;
+}
+
+static void
+end_uloop_cb(struct uloop_timeout * const timeout)
+{
+    UNUSED_ARG(timeout);
+
+    uloop_end();
+}
+
+/* Wakes the daemon's side of a command ring and gives it time to drain it. */
+static void
+drain_command_ring(led_command_ring_st const * const ring)
+{
+    uint64_t const one = 1;
+    struct uloop_timeout timeout = { .cb = end_uloop_cb };
+
+    if (write(led_command_ring_eventfd(ring), &one, sizeof one) == sizeof one)
+    {
+        uloop_timeout_set(&timeout, TEST_RING_DRAIN_MS);
+        uloop_run();
+        /* In case uloop was interrupted. */
+        uloop_timeout_cancel(&timeout);
+    }
+}
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void
+queue_ring_record(
+    struct led_command_ring_header_st * const header,
+    uint32_t const led_id,
+    uint32_t const state)
+{
+    uint32_t const head = header->producer.head;
+
+    header->records[head & (TEST_RING_RECORDS - 1)] = (struct led_command_record_st)
+    {
+        .led_id = led_id,
+        .state = state,
+        .timestamp_ns = monotonic_ns()
+    };
+    __atomic_store_n(&header->producer.head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void
+stats_reply_cb(struct blob_attr * const msg, void * const context)
+{
+    struct method_stats_st * const stats = context;
+    enum
+    {
+        CALLS,
+        ERRORS,
+        CALLS_MAX__
+    };
+    struct blobmsg_policy const calls_policy[CALLS_MAX__] =
+    {
+        [CALLS] = { .name = _led_calls, .type = BLOBMSG_TYPE_INT64 },
+        [ERRORS] = { .name = _led_errors, .type = BLOBMSG_TYPE_INT64 }
+    };
+    struct blobmsg_policy const methods_policy =
+        { .name = _led_methods, .type = BLOBMSG_TYPE_TABLE };
+    struct blob_attr * methods_attr;
+    struct blob_attr * cur;
+    int rem;
+
+    blobmsg_parse(&methods_policy, 1, &methods_attr, blob_data(msg), blob_len(msg));
+
+    blobmsg_for_each_attr(cur, methods_attr, rem)
+    {
+        struct blob_attr * fields[CALLS_MAX__];
+        struct method_calls_st * expected = NULL;
+
+        blobmsg_parse(calls_policy, CALLS_MAX__, fields, blobmsg_data(cur), blobmsg_data_len(cur));
+
+        uint64_t const calls = (fields[CALLS] != NULL) ? blobmsg_get_u64(fields[CALLS]) : 0;
+        uint64_t const errors = (fields[ERRORS] != NULL) ? blobmsg_get_u64(fields[ERRORS]) : 0;
+
+        for (size_t i = 0; i < stats->num_methods; i++)
+        {
+            if (strcmp(blobmsg_name(cur), stats->methods[i].method) == 0)
+            {
+                expected = &stats->methods[i];
+                break;
+            }
+        }
+
+        if (expected != NULL)
+        {
+            expected->found = expected->calls == calls && expected->errors == errors;
+        }
+        else if (calls != 0 || errors != 0)
+        {
+            stats->unexpected_calls++;
+        }
+    }
+}
+
+/* Sends a set_many request naming the LEDs, with the states given by name. */
+static int
+set_many_by_name(
+    struct test_daemon_st const * const daemon,
+    char const * const * const states,
+    size_t const num_states)
+{
+    struct blob_buf buf;
+
+    memset(&buf, 0, sizeof buf);
+    blob_buf_init(&buf, 0);
+    add_string_array(&buf, _led_names, led_names, daemon->num_leds);
+    add_string_array(&buf, _led_states, states, num_states);
+
+    int const result = ledcmd_ubus_call(daemon->ubus_ctx, _led_set_many, buf.head);
+
+    blob_buf_free(&buf);
+
+    return result;
+}
+
+/* Sends a set_many request with the LEDs' IDs and the states' values. */
+static int
+set_many_by_value(
+    struct test_daemon_st const * const daemon,
+    uint32_t const * const led_ids,
+    uint32_t const * const states,
+    size_t const num_states)
+{
+    struct blob_buf buf;
+
+    memset(&buf, 0, sizeof buf);
+    blob_buf_init(&buf, 0);
+    add_u32_array(&buf, _led_ids, led_ids, daemon->num_leds);
+    add_u32_array(&buf, _led_states, states, num_states);
+
+    int const result = ledcmd_ubus_call(daemon->ubus_ctx, _led_set_many, buf.head);
+
+    blob_buf_free(&buf);
+
+    return result;
+}
+
+static bool
+test_set_many_state_per_led(void)
+{
+    bool success;
+    struct test_daemon_st daemon;
+    char const * const states[TEST_LEDS] = { _led_on, _led_off, _led_on, _led_off };
+    bool const expected[TEST_LEDS] = { true, false, true, false };
+
+    if (!test_daemon_start(&daemon, TEST_LEDS, NULL))
+    {
+        success = false;
+        goto done;
+    }
+
+    success =
+        set_many_by_name(&daemon, states, TEST_LEDS) == UBUS_STATUS_OK
+        && leds_on_are(&daemon, expected, __func__);
+
+    test_daemon_stop(&daemon);
+
+done:
+    return success;
+}
+
+static bool
+test_set_many_single_state(void)
+{
+    bool success;
+    struct test_daemon_st daemon;
+    char const * const state = _led_on;
+    bool const expected[TEST_LEDS] = { true, true, true, true };
+
+    if (!test_daemon_start(&daemon, TEST_LEDS, NULL))
+    {
+        success = false;
+        goto done;
+    }
+
+    success =
+        set_many_by_name(&daemon, &state, 1) == UBUS_STATUS_OK
+        && leds_on_are(&daemon, expected, __func__);
+
+    test_daemon_stop(&daemon);
+
+done:
+    return success;
+}
+
+static bool
+test_set_many_ids_and_values(void)
+{
+    bool success;
+    struct test_daemon_st daemon;
+    struct led_ids_st led_ids;
+    uint32_t const states[TEST_LEDS] =
+    {
+        LED_FAST_PATH_STATE_OFF,
+        LED_FAST_PATH_STATE_ON,
+        LED_FAST_PATH_STATE_OFF,
+        LED_FAST_PATH_STATE_ON
+    };
+    bool const expected[TEST_LEDS] = { false, true, false, true };
+
+    if (!test_daemon_start(&daemon, TEST_LEDS, NULL))
+    {
+        success = false;
+        goto done;
+    }
+
+    resolve_led_ids(&daemon, &led_ids);
+    success =
+        set_many_by_value(&daemon, led_ids.ids, states, TEST_LEDS) == UBUS_STATUS_OK
+        && leds_on_are(&daemon, expected, __func__);
+
+    test_daemon_stop(&daemon);
+
+done:
+    return success;
+}
+
+/* An ID of 0 (LED_ID_NONE) is rejected, and no LED is changed. */
+static bool
+test_set_many_rejects_id_none(void)
+{
+    bool success;
+    struct test_daemon_st daemon;
+    struct led_ids_st led_ids;
+    uint32_t const state = LED_FAST_PATH_STATE_ON;
+    bool const expected[TEST_LEDS] = { false, false, false, false };
+
+    if (!test_daemon_start(&daemon, TEST_LEDS, NULL))
+    {
+        success = false;
+        goto done;
+    }
+
+    resolve_led_ids(&daemon, &led_ids);
+    led_ids.ids[TEST_LEDS - 1] = LED_ID_NONE;
+
+    int const result = set_many_by_value(&daemon, led_ids.ids, &state, 1);
+
+    if (result != UBUS_STATUS_INVALID_ARGUMENT)
+    {
+        fprintf(stderr, "%s: set_many returned %d\n", __func__, result);
+        success = false;
+    }
+    else
+    {
+        success = leds_on_are(&daemon, expected, __func__);
+    }
+
+    test_daemon_stop(&daemon);
+
+done:
+    return success;
+}
+
+/*
+ * A name that is both an LED and an alias has one ID, and sets the same LEDs
+ * whether the name or the ID is used.
+ */
+static bool
+test_shared_name(void)
+{
+    bool success;
+    struct test_daemon_st daemon;
+    struct name_ids_st name_ids = { .name = led_names[0] };
+    bool const expected[SHARED_NAME_LEDS] = { true, true, true };
+
+    if (!test_daemon_start(&daemon, SHARED_NAME_LEDS, SHARED_NAME_ALIASES))
+    {
+        success = false;
+        goto done;
+    }
+
+    daemon.led_ops->resolve_leds(daemon.ledcmd_ctx, count_name_ids_cb, &name_ids);
+    if (name_ids.num_ids != 1)
+    {
+        fprintf(stderr, "%s: %zu IDs for %s\n", __func__, name_ids.num_ids, name_ids.name);
+        success = false;
+    }
+    else
+    {
+        success =
+            set_state(&daemon, name_ids.name, LED_ID_NONE, LED_ON)
+            && leds_on_are(&daemon, expected, __func__)
+            && set_state(&daemon, _led_all, LED_ID_NONE, LED_OFF)
+            && set_state(&daemon, NULL, name_ids.led_id, LED_ON)
+            && leds_on_are(&daemon, expected, __func__);
+    }
+
+    test_daemon_stop(&daemon);
+
+done:
+    return success;
+}
+
+/*
+ * get_changes reports only the LEDs that changed since the sequence number
+ * supplied, and reports every LED when the changes are from a previous
+ * instance of the daemon or are no longer available.
+ */
+static bool
+test_get_changes(void)
+{
+    bool success;
+    struct test_daemon_st daemon;
+    char const * const name = led_names[0];
+    struct led_changes_info_st const never_synced = { .epoch = 0, .seq = 0 };
+    struct led_changes_info_st synced;
+    struct led_changes_info_st info;
+    struct changes_result_st result;
+
+    if (!test_daemon_start(&daemon, TEST_LEDS, NULL))
+    {
+        success = false;
+        goto done;
+    }
+
+    get_changes(&daemon, &never_synced, &synced, &result);
+    if (!synced.resync || result.num_changes != TEST_LEDS)
+    {
+        fprintf(stderr, "%s: a first sync reported %zu LEDs\n", __func__, result.num_changes);
+        success = false;
+        goto stop;
+    }
+
+    success = set_state(&daemon, name, LED_ID_NONE, LED_ON);
+    get_changes(&daemon, &synced, &synced, &result);
+    success = set_state(&daemon, name, LED_ID_NONE, LED_OFF) && success;
+    get_changes(&daemon, &synced, &info, &result);
+    if (!success
+        || info.resync
+        || info.seq == synced.seq
+        || result.num_changes != 1
+        || strcmp(result.led_name, name) != 0
+        || result.state != LED_OFF)
+    {
+        fprintf(stderr,
+                "%s: %zu LEDs reported after one changed\n",
+                __func__,
+                result.num_changes);
+        success = false;
+        goto stop;
+    }
+    synced = info;
+
+    get_changes(&daemon, &synced, &info, &result);
+    if (info.resync || result.num_changes != 0)
+    {
+        fprintf(stderr,
+                "%s: %zu LEDs reported when none changed\n",
+                __func__,
+                result.num_changes);
+        success = false;
+        goto stop;
+    }
+
+    struct led_changes_info_st const other_instance =
+    {
+        .epoch = synced.epoch + 1,
+        .seq = synced.seq
+    };
+
+    get_changes(&daemon, &other_instance, &info, &result);
+    if (!info.resync)
+    {
+        fprintf(stderr, "%s: a sync with a previous epoch wasn't a resync\n", __func__);
+        success = false;
+        goto stop;
+    }
+
+    for (size_t i = 0; i < CHANGE_HISTORY_OVERRUN && success; i++)
+    {
+        success = set_state(&daemon, name, LED_ID_NONE, (i % 2 == 0) ? LED_ON : LED_OFF);
+        get_changes(&daemon, &info, &info, &result);
+    }
+    get_changes(&daemon, &synced, &info, &result);
+    if (!success || !info.resync)
+    {
+        fprintf(stderr,
+                "%s: a sync older than the change history wasn't a resync\n",
+                __func__);
+        success = false;
+        goto stop;
+    }
+
+    success = true;
+
+stop:
+    test_daemon_stop(&daemon);
+
+done:
+    return success;
+}
+
+/*
+ * Each instance of the daemon has a different epoch, even when they start in
+ * the same second, and the epoch is never the one clients use before their
+ * first sync.
+ */
+static bool
+test_epoch_differs(void)
+{
+    bool success;
+    struct test_daemon_st daemon;
+    struct led_changes_info_st const never_synced = { .epoch = 0, .seq = 0 };
+    struct led_changes_info_st first;
+    struct led_changes_info_st second;
+    struct changes_result_st result;
+
+    if (!test_daemon_start(&daemon, TEST_LEDS, NULL))
+    {
+        success = false;
+        goto done;
+    }
+    get_changes(&daemon, &never_synced, &first, &result);
+    test_daemon_stop(&daemon);
+
+    if (!test_daemon_start(&daemon, TEST_LEDS, NULL))
+    {
+        success = false;
+        goto done;
+    }
+    get_changes(&daemon, &never_synced, &second, &result);
+    test_daemon_stop(&daemon);
+
+    success = first.epoch != 0 && second.epoch != 0 && first.epoch != second.epoch;
+    if (!success)
+    {
+        fprintf(stderr,
+                "%s: epochs %" PRIu32 " and %" PRIu32 "\n",
+                __func__,
+                first.epoch,
+                second.epoch);
+    }
+
+done:
+    return success;
+}
+
+/*
+ * Writes a status page with one LED, as a daemon that stopped part way
+ * through an update would leave it.
+ */
+static bool
+write_abandoned_status_page(char const * const name)
+{
+    bool success;
+    static char const strings[] = "1\0on";
+    struct status_page_st
+    {
+        struct led_status_page_header_st header;
+        struct led_status_page_entry_st entry;
+        char strings[sizeof strings];
+    } page;
+    int const fd = shm_open(name, O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0600);
+
+    if (fd < 0)
+    {
+        success = false;
+        goto done;
+    }
+
+    uint32_t const strings_offset = offsetof(struct status_page_st, strings);
+
+    memset(&page, 0, sizeof page);
+    page.header = (struct led_status_page_header_st)
+    {
+        .magic = LED_STATUS_PAGE_MAGIC,
+        .version = LED_STATUS_PAGE_VERSION,
+        .seqlock = 1,
+        .num_leds = 1,
+        .entries_offset = offsetof(struct status_page_st, entry),
+        .size = sizeof page
+    };
+    page.entry = (struct led_status_page_entry_st)
+    {
+        .name_offset = strings_offset,
+        .state_offset = strings_offset + strlen(strings) + 1,
+        .priority_offset = strings_offset
+    };
+    memcpy(page.strings, strings, sizeof strings);
+
+    success = write(fd, &page, sizeof page) == sizeof page;
+    close(fd);
+
+done:
+    return success;
+}
+
+/* A read of a page whose seqlock is never released fails, rather than spinning. */
+static bool
+test_status_page_abandoned_update(void)
+{
+    bool success;
+    led_status_page_map_st * map = NULL;
+    struct led_page_status_st status;
+
+    if (!write_abandoned_status_page(TEST_STATUS_PAGE_NAME))
+    {
+        fprintf(stderr, "%s: unable to write the status page\n", __func__);
+        success = false;
+        goto done;
+    }
+
+    map = led_status_page_map(TEST_STATUS_PAGE_NAME);
+    if (map == NULL)
+    {
+        fprintf(stderr, "%s: unable to map the status page\n", __func__);
+        success = false;
+        goto done;
+    }
+
+    success = !led_status_page_read(map, 0, &status, NULL);
+
+done:
+    led_status_page_unmap(map);
+    shm_unlink(TEST_STATUS_PAGE_NAME);
+
+    return success;
+}
+
+/*
+ * A batch applies its verbosity to each operation: with "summary", each
+ * operation reports counts instead of per-LED results.
+ */
+static bool
+test_batch_verbosity(void)
+{
+    bool success;
+    struct test_daemon_st daemon;
+    struct batch_results_st full;
+    struct batch_results_st summary;
+    struct batch_results_st unknown;
+
+    if (!test_daemon_start(&daemon, TEST_LEDS, NULL))
+    {
+        success = false;
+        goto done;
+    }
+
+    int const full_result = batch_set_and_get(&daemon, _led_verbosity_full, &full);
+    int const summary_result = batch_set_and_get(&daemon, _led_verbosity_summary, &summary);
+    int const unknown_result = batch_set_and_get(&daemon, "terse", &unknown);
+
+    success =
+        full_result == UBUS_STATUS_OK
+        && full.num_ops == 2
+        && full.num_led_results == 2
+        && summary_result == UBUS_STATUS_OK
+        && summary.num_ops == 2
+        && summary.num_led_results == 0
+        && summary.succeeded == 2
+        && summary.failed == 0
+        && unknown_result == UBUS_STATUS_INVALID_ARGUMENT;
+    if (!success)
+    {
+        fprintf(stderr,
+                "%s: full %d (%zu LED results), summary %d (%zu LED results, "
+                "%" PRIu32 " succeeded), unknown %d\n",
+                __func__,
+                full_result,
+                full.num_led_results,
+                summary_result,
+                summary.num_led_results,
+                summary.succeeded,
+                unknown_result);
+    }
+
+    test_daemon_stop(&daemon);
+
+done:
+    return success;
+}
+
+/*
+ * The daemon ignores a producer that overwrites the command ring's size, tail
+ * and LED ID generation, and discards the records when head is moved further
+ * ahead of tail than the size of the ring. The producer can't resize the ring.
+ */
+static bool
+test_hostile_command_ring(void)
+{
+    bool success;
+    struct test_daemon_st daemon;
+    struct led_ids_st led_ids;
+    struct led_command_ring_request_st const request =
+    {
+        .magic = LED_COMMAND_RING_MAGIC,
+        .version = LED_COMMAND_RING_VERSION,
+        .num_records = TEST_RING_RECORDS
+    };
+    struct led_command_ring_header_st * header = MAP_FAILED;
+    size_t const size = sizeof *header + TEST_RING_RECORDS * sizeof header->records[0];
+    led_command_ring_st * ring = NULL;
+
+    if (!test_daemon_start(&daemon, TEST_LEDS, NULL))
+    {
+        success = false;
+        goto done;
+    }
+
+    uloop_init();
+    resolve_led_ids(&daemon, &led_ids);
+    ring = led_command_ring_create(&request, daemon.led_ops, daemon.ledcmd_ctx);
+
+    if (ring != NULL)
+    {
+        header = mmap(
+            NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, led_command_ring_memfd(ring), 0);
+    }
+    if (header == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: unable to create a command ring\n", __func__);
+        success = false;
+        goto stop;
+    }
+
+    int const memfd = led_command_ring_memfd(ring);
+
+    if (ftruncate(memfd, size / 2) == 0 || ftruncate(memfd, 2 * size) == 0)
+    {
+        fprintf(stderr, "%s: the producer could resize the ring\n", __func__);
+        success = false;
+        goto stop;
+    }
+
+    struct led_command_ring_consumer_st const * const consumer = &header->consumer;
+
+    header->num_records = UINT32_MAX;
+    header->generation = ~header->generation;
+    header->consumer.tail = TEST_RING_RECORDS / 2;
+    queue_ring_record(header, led_ids.ids[0], LED_FAST_PATH_STATE_ON);
+    drain_command_ring(ring);
+    if (consumer->records_applied != 1 || consumer->ids_stale || consumer->overruns != 0)
+    {
+        fprintf(stderr,
+                "%s: %" PRIu64 " records applied from a ring with a rewritten header\n",
+                __func__,
+                consumer->records_applied);
+        success = false;
+        goto stop;
+    }
+
+    for (uint32_t i = 0; i < 2 * TEST_RING_RECORDS + 1; i++)
+    {
+        queue_ring_record(header, led_ids.ids[i % TEST_LEDS], LED_FAST_PATH_STATE_OFF);
+    }
+    drain_command_ring(ring);
+    if (consumer->overruns != 1 || consumer->records_applied != 1)
+    {
+        fprintf(stderr,
+                "%s: %" PRIu64 " records applied after an overrun\n",
+                __func__,
+                consumer->records_applied - 1);
+        success = false;
+        goto stop;
+    }
+
+    /* The ring is usable again once the daemon has caught up. */
+    queue_ring_record(header, led_ids.ids[0], LED_FAST_PATH_STATE_OFF);
+    drain_command_ring(ring);
+    if (consumer->records_applied != 2)
+    {
+        fprintf(stderr, "%s: a record wasn't applied after an overrun\n", __func__);
+        success = false;
+        goto stop;
+    }
+
+    success = true;
+
+stop:
+    if (header != MAP_FAILED)
+    {
+        munmap(header, size);
+    }
+    led_command_ring_free(ring);
+    uloop_done();
+    test_daemon_stop(&daemon);
+
+done:
+    return success;
+}
+
+/*
+ * Reads the method names of the records in a request journal into methods,
+ * separated by spaces, with "-" for the daemon's session markers.
+ */
+static bool
+read_journal_methods(char const * const path, char * const methods, size_t const methods_size)
+{
+    bool success;
+    FILE * const fp = fopen(path, "r");
+    struct led_journal_header_st header;
+    struct led_journal_record_st record;
+    size_t used = 0;
+
+    methods[0] = '\0';
+
+    if (fp == NULL
+        || fread(&header, sizeof header, 1, fp) != 1
+        || header.magic != LED_JOURNAL_MAGIC
+        || header.version != LED_JOURNAL_VERSION)
+    {
+        success = false;
+        goto done;
+    }
+
+    while (fread(&record, sizeof record, 1, fp) == 1)
+    {
+        char method[32] = "-";
+
+        if (record.method_len >= sizeof method
+            || (record.method_len > 0 && fread(method, record.method_len, 1, fp) != 1)
+            || fseek(fp, record.args_len, SEEK_CUR) != 0)
+        {
+            success = false;
+            goto done;
+        }
+        if (record.method_len > 0)
+        {
+            method[record.method_len] = '\0';
+        }
+        used += snprintf(methods + used, methods_size - used, "%s%s", (used > 0) ? " " : "", method);
+        if (used >= methods_size)
+        {
+            success = false;
+            goto done;
+        }
+    }
+
+    success = true;
+
+done:
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+
+    return success;
+}
+
+/*
+ * Reopening the journal appends to it after a session marker, and requests
+ * that don't change LED state aren't journalled.
+ */
+static bool
+test_journal_append(void)
+{
+    bool success;
+    struct test_daemon_st daemon;
+    struct blob_buf empty;
+    char path[256];
+    char methods[64] = "";
+    char const * const expected = "set - set";
+
+    memset(&empty, 0, sizeof empty);
+    blob_buf_init(&empty, 0);
+
+    if (!test_daemon_start(&daemon, TEST_LEDS, NULL))
+    {
+        success = false;
+        goto done;
+    }
+
+    snprintf(path, sizeof path, "%s/journal.bin", daemon.directory);
+
+    bool opened = true;
+
+    for (size_t session = 0; session < 2 && opened; session++)
+    {
+        opened = led_journal_open(path, 1);
+        ledcmd_ubus_call(daemon.ubus_ctx, _led_set, empty.head);
+        ledcmd_ubus_call(daemon.ubus_ctx, _led_list, empty.head);
+        ledcmd_ubus_call(daemon.ubus_ctx, _led_stats_reset, empty.head);
+        led_journal_close();
+    }
+
+    success = opened
+        && !led_journal_open(path, LED_JOURNAL_MAX_RECORDS_PER_WRITE + 1)
+        && read_journal_methods(path, methods, sizeof methods)
+        && strcmp(methods, expected) == 0;
+    if (!success)
+    {
+        fprintf(stderr, "%s: journal has \"%s\", expected \"%s\"\n", __func__, methods, expected);
+    }
+
+    unlink(path);
+    test_daemon_stop(&daemon);
+
+done:
+    blob_buf_free(&empty);
+
+    return success;
+}
+
+/*
+ * Each method's calls and errors are counted against that method, whatever
+ * the order of the methods in the daemon's method table.
+ */
+static bool
+test_method_dispatch(void)
+{
+    bool success;
+    struct test_daemon_st daemon;
+    struct blob_buf empty;
+    /* The stats request's own call is counted once it has replied. */
+    struct method_calls_st methods[] =
+    {
+        { .method = _led_list, .calls = 2, .errors = 0 },
+        { .method = _led_set, .calls = 1, .errors = 1 },
+        { .method = _led_stats, .calls = 0, .errors = 0 }
+    };
+    struct method_stats_st stats =
+    {
+        .methods = methods,
+        .num_methods = ARRAY_SIZE(methods)
+    };
+
+    memset(&empty, 0, sizeof empty);
+    blob_buf_init(&empty, 0);
+
+    if (!test_daemon_start(&daemon, TEST_LEDS, NULL))
+    {
+        success = false;
+        goto done;
+    }
+
+    bool const calls_made =
+        ledcmd_ubus_call(daemon.ubus_ctx, _led_list, empty.head) == UBUS_STATUS_OK
+        && ledcmd_ubus_call(daemon.ubus_ctx, _led_list, empty.head) == UBUS_STATUS_OK
+        && ledcmd_ubus_call(daemon.ubus_ctx, _led_set, empty.head) != UBUS_STATUS_OK;
+
+    led_bench_ubus_set_reply_cb(stats_reply_cb, &stats);
+
+    int const result = ledcmd_ubus_call(daemon.ubus_ctx, _led_stats, empty.head);
+
+    led_bench_ubus_set_reply_cb(NULL, NULL);
+
+    success = calls_made && result == UBUS_STATUS_OK && stats.unexpected_calls == 0;
+    for (size_t i = 0; i < ARRAY_SIZE(methods); i++)
+    {
+        if (!methods[i].found)
+        {
+            fprintf(stderr, "%s: unexpected stats for %s\n", __func__, methods[i].method);
+            success = false;
+        }
+    }
+    if (stats.unexpected_calls > 0)
+    {
+        fprintf(stderr, "%s: %zu other methods have calls\n", __func__, stats.unexpected_calls);
+    }
+
+    test_daemon_stop(&daemon);
+
+done:
+    blob_buf_free(&empty);
+
+    return success;
+}
+
+int
+main(void)
+{
+    static struct test_st const tests[] =
+    {
+        { .name = "set_many_state_per_led", .run = test_set_many_state_per_led },
+        { .name = "set_many_single_state", .run = test_set_many_single_state },
+        { .name = "set_many_ids_and_values", .run = test_set_many_ids_and_values },
+        { .name = "set_many_rejects_id_none", .run = test_set_many_rejects_id_none },
+        { .name = "shared_name", .run = test_shared_name },
+        { .name = "get_changes", .run = test_get_changes },
+        { .name = "epoch_differs", .run = test_epoch_differs },
+        { .name = "status_page_abandoned_update", .run = test_status_page_abandoned_update },
+        { .name = "batch_verbosity", .run = test_batch_verbosity },
+        { .name = "hostile_command_ring", .run = test_hostile_command_ring },
+        { .name = "method_dispatch", .run = test_method_dispatch },
+        { .name = "journal_append", .run = test_journal_append }
+    };
+    size_t failures = 0;
+
+    for (size_t i = 0; i < ARRAY_SIZE(tests); i++)
+    {
+        bool const passed = tests[i].run();
+
+        fprintf(stdout, "%s: %s\n", passed ? "PASS" : "FAIL", tests[i].name);
+        failures += !passed;
+    }
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,355 @@
+#include <lib_led/lib_led.h>
+#include <lib_led/lib_led_control.h>
+#include <lib_led/lib_led_fast_path.h>
+#include <lib_led/led_fast_path_layout.h>
+#include <lib_led/string_constants.h>
+
+#include <libubus.h>
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Compares the rate at which LED states can be set over the daemon's fast
+ * path socket with the rate of set_many requests over ubus. Each iteration
+ * toggles the same LEDs between on and off. Requires a running daemon with
+ * the fast path enabled, and changes the state of its LEDs.
+ */
+
+struct bench_config_st
+{
+    char const * ubus_path;
+    char const * socket_path;
+    size_t max_leds;
+    size_t fast_path_iterations;
+    size_t ubus_iterations;
+};
+
+struct bench_leds_st
+{
+    char * names[LED_FAST_PATH_MAX_ENTRIES];
+    size_t num_leds;
+    size_t max_leds;
+};
+
+struct set_context_st
+{
+    bool success;
+};
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void
+print_result(
+    char const * const mode,
+    size_t const num_leds,
+    size_t const iterations,
+    uint64_t const elapsed_ns)
+{
+    double const elapsed_s = (double)elapsed_ns / 1e9;
+
+    fprintf(stdout,
+            "{\"benchmark\": \"set\", \"mode\": \"%s\", \"leds\": %zu, "
+            "\"iterations\": %zu, \"mean_ns\": %" PRIu64 ", "
+            "\"updates_per_sec\": %.0f}\n",
+            mode,
+            num_leds,
+            iterations,
+            elapsed_ns / iterations,
+            (elapsed_s > 0) ? (double)iterations / elapsed_s : 0.0);
+}
+
+static void
+add_led_name(char const * const led_name, void * const user_context)
+{
+    struct bench_leds_st * const leds = user_context;
+
+    if (led_name != NULL && leds->num_leds < leds->max_leds)
+    {
+        leds->names[leds->num_leds] = strdup(led_name);
+        if (leds->names[leds->num_leds] != NULL)
+        {
+            leds->num_leds++;
+        }
+    }
+}
+
+static void
+free_led_names(struct bench_leds_st * const leds)
+{
+    for (size_t i = 0; i < leds->num_leds; i++)
+    {
+        free(leds->names[i]);
+    }
+}
+
+static char const *
+toggled_state(size_t const iteration)
+{
+    return (iteration % 2 == 0) ? _led_on : _led_off;
+}
+
+static void
+build_updates(
+    struct bench_leds_st const * const leds,
+    size_t const iteration,
+    struct led_fast_path_update_st * const updates)
+{
+    for (size_t i = 0; i < leds->num_leds; i++)
+    {
+        updates[i].led_name = leds->names[i];
+        updates[i].state = toggled_state(iteration);
+    }
+}
+
+static bool
+bench_fast_path(
+    struct bench_config_st const * const config,
+    struct bench_leds_st const * const leds,
+    led_fast_path_st * const fast_path,
+    bool const wait_for_ack)
+{
+    bool success = true;
+    struct led_fast_path_update_st updates[LED_FAST_PATH_MAX_ENTRIES];
+    uint64_t const start_ns = monotonic_ns();
+
+    for (size_t i = 0; i < config->fast_path_iterations && success; i++)
+    {
+        build_updates(leds, i, updates);
+        /* The last frame is always acknowledged, so all have been applied. */
+        success =
+            (wait_for_ack || i + 1 == config->fast_path_iterations)
+            ? led_fast_path_set_and_wait(fast_path, updates, leds->num_leds, NULL, NULL)
+            : led_fast_path_set(fast_path, updates, leds->num_leds, NULL, NULL);
+    }
+
+    uint64_t const elapsed_ns = monotonic_ns() - start_ns;
+
+    if (!success)
+    {
+        fprintf(stderr, "Fast path request failed\n");
+        goto done;
+    }
+
+    print_result(
+        wait_for_ack ? "fast_path_ack" : "fast_path",
+        leds->num_leds,
+        config->fast_path_iterations,
+        elapsed_ns);
+
+done:
+    return success;
+}
+
+static void
+set_result_cb(struct led_get_set_result_st const * const result, void * const user_context)
+{
+    struct set_context_st * const context = user_context;
+
+    context->success = context->success && result->success;
+}
+
+static bool
+bench_ubus_set_many(
+    struct bench_config_st const * const config,
+    struct bench_leds_st const * const leds,
+    ledcmd_ctx_st const * const ledcmd_ctx)
+{
+    bool success = true;
+    uint64_t const start_ns = monotonic_ns();
+
+    for (size_t i = 0; i < config->ubus_iterations && success; i++)
+    {
+        char const * const state = toggled_state(i);
+        struct set_context_st context = { .success = true };
+
+        success =
+            led_set_many_request(
+                ledcmd_ctx,
+                (char const * const *)leds->names,
+                leds->num_leds,
+                &state,
+                1,
+                NULL,
+                NULL,
+                NULL,
+                0,
+                set_result_cb,
+                &context)
+            && context.success;
+    }
+
+    uint64_t const elapsed_ns = monotonic_ns() - start_ns;
+
+    if (!success)
+    {
+        fprintf(stderr, "ubus set_many request failed\n");
+        goto done;
+    }
+
+    print_result("ubus_set_many", leds->num_leds, config->ubus_iterations, elapsed_ns);
+
+done:
+    return success;
+}
+
+static bool
+run_benchmarks(struct bench_config_st const * const config)
+{
+    bool success;
+    struct ubus_context * ubus_ctx = NULL;
+    ledcmd_ctx_st * ledcmd_ctx = NULL;
+    led_fast_path_st * fast_path = NULL;
+    struct bench_leds_st leds =
+    {
+        .num_leds = 0,
+        .max_leds = config->max_leds
+    };
+
+    ubus_ctx = ubus_connect(config->ubus_path);
+    if (ubus_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to connect to UBUS\n");
+        success = false;
+        goto done;
+    }
+
+    ledcmd_ctx = led_init(ubus_ctx);
+    if (ledcmd_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to connect to LED daemon\n");
+        success = false;
+        goto done;
+    }
+
+    if (!led_get_names(ledcmd_ctx, add_led_name, &leds) || leds.num_leds == 0)
+    {
+        fprintf(stderr, "Unable to list the daemon's LEDs\n");
+        success = false;
+        goto done;
+    }
+
+    fast_path = led_fast_path_connect(ledcmd_ctx, config->socket_path);
+    if (fast_path == NULL)
+    {
+        fprintf(stderr, "Unable to connect to the fast path socket %s\n", config->socket_path);
+        success = false;
+        goto done;
+    }
+
+    success =
+        bench_fast_path(config, &leds, fast_path, false)
+        && bench_fast_path(config, &leds, fast_path, true)
+        && bench_ubus_set_many(config, &leds, ledcmd_ctx);
+
+done:
+    led_fast_path_close(fast_path);
+    free_led_names(&leds);
+    led_deinit(ledcmd_ctx);
+    if (ubus_ctx != NULL)
+    {
+        ubus_free(ubus_ctx);
+    }
+
+    return success;
+}
+
+static void
+usage(FILE * const fp)
+{
+    fprintf(fp,
+            "usage:\n"
+            "\tled_fast_path_bench [options] -f <socket>\n"
+            "\t-h?           - help    - what you see below\n"
+            "\t-u <path>     - ubus socket path\n"
+            "\t-f <path>     - the daemon's fast path socket path\n"
+            "\t-n <count>    - LEDs set by each request (default 8)\n"
+            "\t-i <count>    - fast path frames (default 100000)\n"
+            "\t-g <count>    - ubus set_many requests (default 10000)\n"
+            "\n"
+            "Results are written to stdout, one JSON object per line.\n"
+            "\n");
+}
+
+int
+main(int argc, char * argv[])
+{
+    int c;
+    int result;
+    struct bench_config_st config =
+    {
+        .ubus_path = NULL,
+        .socket_path = NULL,
+        .max_leds = 8,
+        .fast_path_iterations = 100000,
+        .ubus_iterations = 10000
+    };
+
+    while ((c = getopt(argc, argv, "?hu:f:n:i:g:")) != -1)
+    {
+        switch (c)
+        {
+        case '?':
+        case 'h':
+            usage(stdout);
+            result = EXIT_SUCCESS;
+            goto done;
+
+        case 'u':
+            config.ubus_path = optarg;
+            break;
+
+        case 'f':
+            config.socket_path = optarg;
+            break;
+
+        case 'n':
+            config.max_leds = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'i':
+            config.fast_path_iterations = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'g':
+            config.ubus_iterations = strtoul(optarg, NULL, 10);
+            break;
+
+        default:
+            usage(stderr);
+            result = EXIT_FAILURE;
+            goto done;
+
+        }
+    }
+
+    if (config.socket_path == NULL
+        || config.max_leds == 0
+        || config.max_leds > LED_FAST_PATH_MAX_ENTRIES
+        || config.fast_path_iterations == 0
+        || config.ubus_iterations == 0)
+    {
+        usage(stderr);
+        result = EXIT_FAILURE;
+        goto done;
+    }
+
+    result = run_benchmarks(&config) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+done:
+    return result;
+}
@@ -0,0 +1,1136 @@
+#include <lib_led/lib_led.h>
+#include <lib_led/lib_led_batch.h>
+#include <lib_led/lib_led_control.h>
+#include <lib_led/lib_led_pattern.h>
+#include <lib_led/string_constants.h>
+#include <ubus_utils/ubus_utils.h>
+
+#include <libubus.h>
+#include <libubox/uloop.h>
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Generates load on a running daemon from a number of concurrent lib_led
+ * clients, each with its own ubus connection and requests in flight, and
+ * reports the throughput and latency of each type of request. The clients
+ * are shared between one or more worker processes, each running its own
+ * uloop. Set and activate requests change the state of the daemon's LEDs,
+ * so this is intended for use against a daemon running the test backend
+ * on a private ubusd socket.
+ */
+
+/* Bucket n holds latencies less than 2^n ns. */
+#define LATENCY_BUCKETS 40
+/* Failed requests that took at least lib_led's request timeout timed out. */
+#define REQUEST_TIMEOUT_NS (1000ULL * 1000000ULL)
+
+enum loadgen_op_t
+{
+    LOADGEN_OP_GET,
+    LOADGEN_OP_SET,
+    LOADGEN_OP_ACTIVATE,
+    LOADGEN_OP_PATTERN,
+    LOADGEN_OP_COUNT
+};
+
+static char const * const op_names[LOADGEN_OP_COUNT] =
+{
+    [LOADGEN_OP_GET] = "get",
+    [LOADGEN_OP_SET] = "set",
+    [LOADGEN_OP_ACTIVATE] = "activate",
+    [LOADGEN_OP_PATTERN] = "pattern"
+};
+
+struct op_stats_st
+{
+    uint64_t requests;
+    uint64_t failures;
+    uint64_t timeouts;
+    uint64_t send_failures;
+    uint64_t latency_total_ns;
+    uint64_t latency_max_ns;
+    uint64_t latency_buckets[LATENCY_BUCKETS];
+};
+
+/* Written by each worker to the parent process when it has finished. */
+struct worker_stats_st
+{
+    uint64_t elapsed_ns;
+    size_t clients_connected;
+    struct op_stats_st ops[LOADGEN_OP_COUNT];
+};
+
+struct loadgen_config_st
+{
+    char const * ubus_path;
+    size_t num_clients;
+    size_t num_workers;
+    unsigned duration_s;
+    size_t in_flight;
+    unsigned weights[LOADGEN_OP_COUNT];
+    char * pattern_name;
+    pid_t daemon_pid;
+};
+
+struct loadgen_leds_st
+{
+    char * * names;
+    size_t num_leds;
+};
+
+struct loadgen_worker_st;
+
+struct loadgen_client_st
+{
+    struct loadgen_worker_st * worker;
+    struct ubus_context * ubus_ctx;
+    ledcmd_ctx_st * ledcmd_ctx;
+    unsigned seed;
+    /* The LED activated at the alternate priority, if activated is set. */
+    size_t activated_led;
+    bool activated;
+};
+
+struct loadgen_request_st
+{
+    struct loadgen_client_st * client;
+    enum loadgen_op_t op;
+    uint64_t start_ns;
+    bool failed;
+};
+
+struct loadgen_worker_st
+{
+    struct loadgen_config_st const * config;
+    struct loadgen_leds_st const * leds;
+    struct loadgen_client_st * clients;
+    size_t num_clients;
+    unsigned total_weight;
+    size_t in_flight;
+    bool stopping;
+    struct uloop_timeout stop_timer;
+    struct worker_stats_st stats;
+};
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t
+latency_bucket(uint64_t const latency_ns)
+{
+    size_t bucket = 0;
+
+    while (bucket < LATENCY_BUCKETS - 1 && latency_ns >= (1ULL << bucket))
+    {
+        bucket++;
+    }
+
+    return bucket;
+}
+
+static void
+record_result(
+    struct op_stats_st * const stats, uint64_t const latency_ns, bool const success)
+{
+    stats->requests++;
+    if (!success)
+    {
+        stats->failures++;
+        if (latency_ns >= REQUEST_TIMEOUT_NS)
+        {
+            stats->timeouts++;
+        }
+    }
+    stats->latency_total_ns += latency_ns;
+    if (latency_ns > stats->latency_max_ns)
+    {
+        stats->latency_max_ns = latency_ns;
+    }
+    stats->latency_buckets[latency_bucket(latency_ns)]++;
+}
+
+static void
+get_set_result_cb(struct led_get_set_result_st const * const result, void * const user_context)
+{
+    struct loadgen_request_st * const request = user_context;
+
+    if (!result->success)
+    {
+        request->failed = true;
+    }
+}
+
+static void
+play_pattern_result_cb(bool const success, char const * const error_msg, void * const user_ctx)
+{
+    struct loadgen_request_st * const request = user_ctx;
+
+    UNUSED_ARG(error_msg);
+
+    if (!success)
+    {
+        request->failed = true;
+    }
+}
+
+static void
+issue_request(struct loadgen_client_st * client);
+
+static void
+request_complete_cb(bool const success, void * const user_context)
+{
+    struct loadgen_request_st * const request = user_context;
+    struct loadgen_client_st * const client = request->client;
+    struct loadgen_worker_st * const worker = client->worker;
+
+    record_result(
+        &worker->stats.ops[request->op],
+        monotonic_ns() - request->start_ns,
+        success && !request->failed);
+    free(request);
+    worker->in_flight--;
+
+    if (!worker->stopping)
+    {
+        issue_request(client);
+    }
+    else if (worker->in_flight == 0)
+    {
+        uloop_end();
+    }
+}
+
+static enum loadgen_op_t
+choose_op(struct loadgen_client_st * const client)
+{
+    struct loadgen_worker_st const * const worker = client->worker;
+    unsigned choice = rand_r(&client->seed) % worker->total_weight;
+    enum loadgen_op_t op;
+
+    for (op = 0; op < LOADGEN_OP_COUNT - 1; op++)
+    {
+        if (choice < worker->config->weights[op])
+        {
+            break;
+        }
+        choice -= worker->config->weights[op];
+    }
+
+    return op;
+}
+
+static bool
+send_request(struct loadgen_request_st * const request)
+{
+    bool sent;
+    struct loadgen_client_st * const client = request->client;
+    struct loadgen_worker_st const * const worker = client->worker;
+    struct loadgen_leds_st const * const leds = worker->leds;
+    size_t const led = rand_r(&client->seed) % leds->num_leds;
+
+    switch (request->op)
+    {
+    case LOADGEN_OP_GET:
+        sent = led_get_set_request_async(
+            client->ledcmd_ctx, _led_get, NULL, leds->names[led], NULL, NULL, NULL, 0,
+            get_set_result_cb, request_complete_cb, request);
+        break;
+
+    case LOADGEN_OP_SET:
+        sent = led_get_set_request_async(
+            client->ledcmd_ctx,
+            _led_set,
+            (rand_r(&client->seed) % 2 == 0) ? _led_on : _led_off,
+            leds->names[led],
+            NULL,
+            NULL,
+            NULL,
+            0,
+            get_set_result_cb,
+            request_complete_cb,
+            request);
+        break;
+
+    case LOADGEN_OP_ACTIVATE:
+        /* Each client alternates between activating and deactivating an LED. */
+        if (!client->activated)
+        {
+            client->activated_led = led;
+        }
+        sent = led_get_set_request_async(
+            client->ledcmd_ctx,
+            client->activated ? _led_deactivate : _led_activate,
+            NULL,
+            leds->names[client->activated_led],
+            NULL,
+            _led_priority_alternate,
+            NULL,
+            0,
+            get_set_result_cb,
+            request_complete_cb,
+            request);
+        if (sent)
+        {
+            client->activated = !client->activated;
+        }
+        break;
+
+    case LOADGEN_OP_PATTERN:
+        sent = led_play_pattern_async(
+            client->ledcmd_ctx, worker->config->pattern_name, true,
+            play_pattern_result_cb, request_complete_cb, request);
+        break;
+
+    case LOADGEN_OP_COUNT:
+    default:
+        sent = false;
+        break;
+    }
+
+    return sent;
+}
+
+/*
+ * A request that couldn't be sent is counted, and the client then has one
+ * fewer request in flight for the rest of the run.
+ */
+static void
+issue_request(struct loadgen_client_st * const client)
+{
+    struct loadgen_worker_st * const worker = client->worker;
+    struct loadgen_request_st * const request = calloc(1, sizeof *request);
+
+    if (request == NULL)
+    {
+        goto done;
+    }
+
+    request->client = client;
+    request->op = choose_op(client);
+    request->start_ns = monotonic_ns();
+
+    if (!send_request(request))
+    {
+        worker->stats.ops[request->op].send_failures++;
+        free(request);
+        goto done;
+    }
+
+    worker->in_flight++;
+
+done:
+    return;
+}
+
+static void
+stop_timer_cb(struct uloop_timeout * const timer)
+{
+    struct loadgen_worker_st * const worker =
+        container_of(timer, struct loadgen_worker_st, stop_timer);
+
+    /* Stop issuing requests, and wait for those in flight to complete. */
+    worker->stopping = true;
+    if (worker->in_flight == 0)
+    {
+        uloop_end();
+    }
+}
+
+static void
+disconnect_clients(struct loadgen_worker_st * const worker)
+{
+    for (size_t i = 0; i < worker->num_clients; i++)
+    {
+        struct loadgen_client_st * const client = &worker->clients[i];
+
+        led_deinit(client->ledcmd_ctx);
+        if (client->ubus_ctx != NULL)
+        {
+            ubus_free(client->ubus_ctx);
+        }
+    }
+    free(worker->clients);
+    worker->clients = NULL;
+}
+
+static bool
+connect_clients(struct loadgen_worker_st * const worker, unsigned const seed)
+{
+    bool success;
+
+    worker->clients = calloc(worker->num_clients, sizeof *worker->clients);
+    if (worker->clients == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    for (size_t i = 0; i < worker->num_clients; i++)
+    {
+        struct loadgen_client_st * const client = &worker->clients[i];
+
+        client->worker = worker;
+        client->seed = seed + i;
+        client->ubus_ctx = ubus_connect(worker->config->ubus_path);
+        if (client->ubus_ctx == NULL)
+        {
+            fprintf(stderr, "Unable to connect to UBUS\n");
+            success = false;
+            goto done;
+        }
+        ubus_add_uloop(client->ubus_ctx);
+
+        client->ledcmd_ctx = led_init(client->ubus_ctx);
+        if (client->ledcmd_ctx == NULL)
+        {
+            fprintf(stderr, "Unable to connect to LED daemon\n");
+            success = false;
+            goto done;
+        }
+        worker->stats.clients_connected++;
+    }
+
+    success = true;
+
+done:
+    return success;
+}
+
+static bool
+run_worker(
+    struct loadgen_config_st const * const config,
+    struct loadgen_leds_st const * const leds,
+    size_t const num_clients,
+    unsigned const seed,
+    struct worker_stats_st * const stats)
+{
+    bool success;
+    struct loadgen_worker_st worker =
+    {
+        .config = config,
+        .leds = leds,
+        .num_clients = num_clients,
+        .stop_timer.cb = stop_timer_cb
+    };
+
+    for (size_t op = 0; op < LOADGEN_OP_COUNT; op++)
+    {
+        worker.total_weight += config->weights[op];
+    }
+
+    uloop_init();
+
+    if (!connect_clients(&worker, seed))
+    {
+        success = false;
+        goto done;
+    }
+
+    uint64_t const start_ns = monotonic_ns();
+
+    uloop_timeout_set(&worker.stop_timer, config->duration_s * 1000);
+    for (size_t i = 0; i < worker.num_clients; i++)
+    {
+        for (size_t j = 0; j < config->in_flight; j++)
+        {
+            issue_request(&worker.clients[i]);
+        }
+    }
+
+    if (worker.in_flight > 0)
+    {
+        uloop_run();
+    }
+    uloop_timeout_cancel(&worker.stop_timer);
+
+    worker.stats.elapsed_ns = monotonic_ns() - start_ns;
+    success = true;
+
+done:
+    disconnect_clients(&worker);
+    uloop_done();
+    *stats = worker.stats;
+
+    return success;
+}
+
+static bool
+write_all(int const fd, void const * const buf, size_t const len)
+{
+    char const * cursor = buf;
+    size_t remaining = len;
+
+    while (remaining > 0)
+    {
+        ssize_t const written = write(fd, cursor, remaining);
+
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            break;
+        }
+        cursor += written;
+        remaining -= written;
+    }
+
+    return remaining == 0;
+}
+
+static bool
+read_all(int const fd, void * const buf, size_t const len)
+{
+    char * cursor = buf;
+    size_t remaining = len;
+
+    while (remaining > 0)
+    {
+        ssize_t const count = read(fd, cursor, remaining);
+
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            break;
+        }
+        cursor += count;
+        remaining -= count;
+    }
+
+    return remaining == 0;
+}
+
+static void
+merge_stats(struct worker_stats_st * const total, struct worker_stats_st const * const stats)
+{
+    if (stats->elapsed_ns > total->elapsed_ns)
+    {
+        total->elapsed_ns = stats->elapsed_ns;
+    }
+    total->clients_connected += stats->clients_connected;
+
+    for (size_t op = 0; op < LOADGEN_OP_COUNT; op++)
+    {
+        struct op_stats_st * const to = &total->ops[op];
+        struct op_stats_st const * const from = &stats->ops[op];
+
+        to->requests += from->requests;
+        to->failures += from->failures;
+        to->timeouts += from->timeouts;
+        to->send_failures += from->send_failures;
+        to->latency_total_ns += from->latency_total_ns;
+        if (from->latency_max_ns > to->latency_max_ns)
+        {
+            to->latency_max_ns = from->latency_max_ns;
+        }
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+        {
+            to->latency_buckets[i] += from->latency_buckets[i];
+        }
+    }
+}
+
+/*
+ * Each worker is a separate process with its own uloop, and writes its
+ * statistics to the parent over a pipe once its clients have finished.
+ */
+static bool
+run_workers(
+    struct loadgen_config_st const * const config,
+    struct loadgen_leds_st const * const leds,
+    struct worker_stats_st * const total)
+{
+    bool success = true;
+    pid_t * const pids = calloc(config->num_workers, sizeof *pids);
+    int * const fds = calloc(config->num_workers, sizeof *fds);
+    size_t num_started = 0;
+
+    if (pids == NULL || fds == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+
+    for (size_t i = 0; i < config->num_workers; i++)
+    {
+        /* Share the clients as evenly as possible between the workers. */
+        size_t const num_clients =
+            config->num_clients / config->num_workers
+            + ((i < config->num_clients % config->num_workers) ? 1 : 0);
+        int pipe_fds[2];
+
+        if (pipe(pipe_fds) < 0)
+        {
+            success = false;
+            break;
+        }
+
+        pid_t const pid = fork();
+
+        if (pid < 0)
+        {
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+            success = false;
+            break;
+        }
+
+        if (pid == 0)
+        {
+            struct worker_stats_st stats;
+
+            close(pipe_fds[0]);
+            bool const worker_success =
+                run_worker(config, leds, num_clients, (unsigned)(getpid() * 7919), &stats);
+            bool const written = write_all(pipe_fds[1], &stats, sizeof stats);
+
+            close(pipe_fds[1]);
+            _exit((worker_success && written) ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+
+        close(pipe_fds[1]);
+        pids[num_started] = pid;
+        fds[num_started] = pipe_fds[0];
+        num_started++;
+    }
+
+    for (size_t i = 0; i < num_started; i++)
+    {
+        struct worker_stats_st stats;
+        int status;
+
+        if (read_all(fds[i], &stats, sizeof stats))
+        {
+            merge_stats(total, &stats);
+        }
+        else
+        {
+            success = false;
+        }
+        close(fds[i]);
+
+        if (waitpid(pids[i], &status, 0) < 0
+            || !WIFEXITED(status)
+            || WEXITSTATUS(status) != EXIT_SUCCESS)
+        {
+            success = false;
+        }
+    }
+
+done:
+    free(fds);
+    free(pids);
+
+    return success;
+}
+
+/* The user and system CPU time used by the given process. */
+static bool
+process_cpu_s(pid_t const pid, double * const cpu_s)
+{
+    bool success;
+    char path[64];
+    char buf[1024];
+    FILE * fp;
+
+    snprintf(path, sizeof path, "/proc/%d/stat", (int)pid);
+    fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    size_t const len = fread(buf, 1, sizeof buf - 1, fp);
+
+    fclose(fp);
+    buf[len] = '\0';
+
+    /* The command name may contain spaces, so skip past the last ')'. */
+    char const * const fields = strrchr(buf, ')');
+    unsigned long utime;
+    unsigned long stime;
+
+    success =
+        fields != NULL
+        && sscanf(
+               fields + 1,
+               " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+               &utime, &stime) == 2;
+    if (success)
+    {
+        *cpu_s = (double)(utime + stime) / (double)sysconf(_SC_CLK_TCK);
+    }
+
+done:
+    return success;
+}
+
+/* The upper bound of the bucket containing the given fraction of latencies. */
+static uint64_t
+latency_percentile_ns(struct op_stats_st const * const stats, double const fraction)
+{
+    uint64_t const target = (uint64_t)((double)stats->requests * fraction);
+    uint64_t seen = 0;
+    size_t bucket;
+
+    for (bucket = 0; bucket < LATENCY_BUCKETS - 1; bucket++)
+    {
+        seen += stats->latency_buckets[bucket];
+        if (seen > target)
+        {
+            break;
+        }
+    }
+
+    return (bucket == 0) ? 0 : 1ULL << bucket;
+}
+
+static void
+print_op_result(
+    struct loadgen_config_st const * const config,
+    struct worker_stats_st const * const total,
+    enum loadgen_op_t const op)
+{
+    struct op_stats_st const * const stats = &total->ops[op];
+    double const elapsed_s = (double)total->elapsed_ns / 1e9;
+    bool first = true;
+
+    fprintf(stdout,
+            "{\"loadgen\": \"%s\", \"clients\": %zu, \"workers\": %zu, \"in_flight\": %zu, "
+            "\"requests\": %" PRIu64 ", \"failures\": %" PRIu64 ", \"timeouts\": %" PRIu64 ", "
+            "\"send_failures\": %" PRIu64 ", \"requests_per_sec\": %.0f, "
+            "\"mean_ns\": %" PRIu64 ", \"p50_ns\": %" PRIu64 ", \"p90_ns\": %" PRIu64 ", "
+            "\"p99_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64 ", \"histogram\": [",
+            op_names[op],
+            total->clients_connected,
+            config->num_workers,
+            config->in_flight,
+            stats->requests,
+            stats->failures,
+            stats->timeouts,
+            stats->send_failures,
+            (elapsed_s > 0) ? (double)stats->requests / elapsed_s : 0.0,
+            (stats->requests > 0) ? stats->latency_total_ns / stats->requests : 0,
+            latency_percentile_ns(stats, 0.5),
+            latency_percentile_ns(stats, 0.9),
+            latency_percentile_ns(stats, 0.99),
+            stats->latency_max_ns);
+
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        if (stats->latency_buckets[i] > 0)
+        {
+            fprintf(stdout,
+                    "%s[%" PRIu64 ", %" PRIu64 "]",
+                    first ? "" : ", ",
+                    (uint64_t)1 << i,
+                    stats->latency_buckets[i]);
+            first = false;
+        }
+    }
+
+    fprintf(stdout, "]}\n");
+}
+
+static void
+print_summary(
+    struct loadgen_config_st const * const config,
+    struct worker_stats_st const * const total,
+    bool const have_cpu,
+    double const daemon_cpu_s)
+{
+    double const elapsed_s = (double)total->elapsed_ns / 1e9;
+    uint64_t requests = 0;
+    uint64_t failures = 0;
+    uint64_t timeouts = 0;
+
+    for (size_t op = 0; op < LOADGEN_OP_COUNT; op++)
+    {
+        requests += total->ops[op].requests;
+        failures += total->ops[op].failures;
+        timeouts += total->ops[op].timeouts;
+    }
+
+    fprintf(stdout,
+            "{\"loadgen\": \"total\", \"clients\": %zu, \"workers\": %zu, \"in_flight\": %zu, "
+            "\"elapsed_s\": %.3f, \"requests\": %" PRIu64 ", \"failures\": %" PRIu64 ", "
+            "\"timeouts\": %" PRIu64 ", \"requests_per_sec\": %.0f",
+            total->clients_connected,
+            config->num_workers,
+            config->in_flight,
+            elapsed_s,
+            requests,
+            failures,
+            timeouts,
+            (elapsed_s > 0) ? (double)requests / elapsed_s : 0.0);
+    if (have_cpu)
+    {
+        fprintf(stdout,
+                ", \"daemon_cpu_s\": %.3f, \"daemon_cpu_percent\": %.1f",
+                daemon_cpu_s,
+                (elapsed_s > 0) ? 100.0 * daemon_cpu_s / elapsed_s : 0.0);
+    }
+    fprintf(stdout, "}\n");
+}
+
+static void
+add_led_name(char const * const led_name, void * const user_context)
+{
+    struct loadgen_leds_st * const leds = user_context;
+
+    if (led_name == NULL || strcmp(led_name, _led_all) == 0)
+    {
+        goto done;
+    }
+
+    char * * const names = realloc(leds->names, (leds->num_leds + 1) * sizeof *names);
+
+    if (names == NULL)
+    {
+        goto done;
+    }
+    leds->names = names;
+    leds->names[leds->num_leds] = strdup(led_name);
+    if (leds->names[leds->num_leds] != NULL)
+    {
+        leds->num_leds++;
+    }
+
+done:
+    return;
+}
+
+static void
+save_first_pattern(char const * const pattern_name, void * const user_context)
+{
+    char * * const first_pattern = user_context;
+
+    if (*first_pattern == NULL && pattern_name != NULL)
+    {
+        *first_pattern = strdup(pattern_name);
+    }
+}
+
+static void
+free_led_names(struct loadgen_leds_st * const leds)
+{
+    for (size_t i = 0; i < leds->num_leds; i++)
+    {
+        free(leds->names[i]);
+    }
+    free(leds->names);
+}
+
+/*
+ * Find the LEDs to use, and a pattern to play if none was specified, before
+ * the workers are started.
+ */
+static bool
+query_daemon(struct loadgen_config_st * const config, struct loadgen_leds_st * const leds)
+{
+    bool success;
+    struct ubus_context * const ubus_ctx = ubus_connect(config->ubus_path);
+    ledcmd_ctx_st * ledcmd_ctx = NULL;
+
+    if (ubus_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to connect to UBUS\n");
+        success = false;
+        goto done;
+    }
+
+    ledcmd_ctx = led_init(ubus_ctx);
+    if (ledcmd_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to connect to LED daemon\n");
+        success = false;
+        goto done;
+    }
+
+    if (!led_get_names(ledcmd_ctx, add_led_name, leds) || leds->num_leds == 0)
+    {
+        fprintf(stderr, "Unable to list the daemon's LEDs\n");
+        success = false;
+        goto done;
+    }
+
+    if (config->weights[LOADGEN_OP_PATTERN] > 0 && config->pattern_name == NULL)
+    {
+        led_list_patterns(ledcmd_ctx, save_first_pattern, &config->pattern_name);
+        if (config->pattern_name == NULL)
+        {
+            fprintf(stderr, "The daemon has no patterns, so none will be played\n");
+            config->weights[LOADGEN_OP_PATTERN] = 0;
+        }
+    }
+
+    success = true;
+
+done:
+    led_deinit(ledcmd_ctx);
+    if (ubus_ctx != NULL)
+    {
+        ubus_free(ubus_ctx);
+    }
+
+    return success;
+}
+
+static bool
+run_loadgen(struct loadgen_config_st * const config)
+{
+    bool success;
+    struct loadgen_leds_st leds = { 0 };
+    struct worker_stats_st total = { 0 };
+    double cpu_start_s = 0;
+    double cpu_end_s = 0;
+
+    if (!query_daemon(config, &leds))
+    {
+        success = false;
+        goto done;
+    }
+
+    unsigned total_weight = 0;
+
+    for (size_t op = 0; op < LOADGEN_OP_COUNT; op++)
+    {
+        total_weight += config->weights[op];
+    }
+    if (total_weight == 0)
+    {
+        fprintf(stderr, "No requests to make\n");
+        success = false;
+        goto done;
+    }
+
+    bool have_cpu =
+        config->daemon_pid > 0 && process_cpu_s(config->daemon_pid, &cpu_start_s);
+
+    success = run_workers(config, &leds, &total);
+
+    have_cpu = have_cpu && process_cpu_s(config->daemon_pid, &cpu_end_s);
+
+    for (enum loadgen_op_t op = 0; op < LOADGEN_OP_COUNT; op++)
+    {
+        if (config->weights[op] > 0)
+        {
+            print_op_result(config, &total, op);
+        }
+    }
+    print_summary(config, &total, have_cpu, cpu_end_s - cpu_start_s);
+
+done:
+    free_led_names(&leds);
+
+    return success;
+}
+
+/* Parses a mix such as "get=40,set=40,activate=10,pattern=10". */
+static bool
+parse_mix(char const * const arg, unsigned * const weights)
+{
+    bool success;
+    char * const mix = strdup(arg);
+    char * saveptr = NULL;
+
+    if (mix == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    memset(weights, 0, LOADGEN_OP_COUNT * sizeof *weights);
+
+    for (char * item = strtok_r(mix, ",", &saveptr);
+         item != NULL;
+         item = strtok_r(NULL, ",", &saveptr))
+    {
+        char * const equals = strchr(item, '=');
+        enum loadgen_op_t op;
+
+        if (equals == NULL)
+        {
+            success = false;
+            goto done;
+        }
+        *equals = '\0';
+
+        for (op = 0; op < LOADGEN_OP_COUNT; op++)
+        {
+            if (strcmp(item, op_names[op]) == 0)
+            {
+                break;
+            }
+        }
+        if (op == LOADGEN_OP_COUNT)
+        {
+            success = false;
+            goto done;
+        }
+
+        char * end;
+
+        weights[op] = strtoul(equals + 1, &end, 10);
+        if (end == equals + 1 || *end != '\0')
+        {
+            success = false;
+            goto done;
+        }
+    }
+
+    success = true;
+
+done:
+    free(mix);
+
+    return success;
+}
+
+static void
+usage(FILE * const fp)
+{
+    fprintf(fp,
+            "usage:\n"
+            "\tled_loadgen [options]\n"
+            "\t-h?           - help    - what you see below\n"
+            "\t-u <path>     - ubus socket path\n"
+            "\t-c <count>    - concurrent clients (default 20)\n"
+            "\t-w <count>    - worker processes to share the clients (default 1)\n"
+            "\t-q <count>    - requests in flight per client (default 1)\n"
+            "\t-d <seconds>  - duration (default 10)\n"
+            "\t-m <mix>      - relative weights of each request type\n"
+            "\t                (default get=40,set=40,activate=10,pattern=10)\n"
+            "\t-p <name>     - pattern to play (default the first listed)\n"
+            "\t-P <pid>      - daemon process ID, to report its CPU time\n"
+            "\n"
+            "Results are written to stdout, one JSON object per request type and\n"
+            "a summary. Latency percentiles and histogram entries are the upper\n"
+            "bounds of power of two buckets.\n"
+            "\n");
+}
+
+int
+main(int argc, char * argv[])
+{
+    int c;
+    int result;
+    struct loadgen_config_st config =
+    {
+        .ubus_path = NULL,
+        .num_clients = 20,
+        .num_workers = 1,
+        .duration_s = 10,
+        .in_flight = 1,
+        .weights =
+        {
+            [LOADGEN_OP_GET] = 40,
+            [LOADGEN_OP_SET] = 40,
+            [LOADGEN_OP_ACTIVATE] = 10,
+            [LOADGEN_OP_PATTERN] = 10
+        },
+        .pattern_name = NULL,
+        .daemon_pid = 0
+    };
+
+    while ((c = getopt(argc, argv, "?hu:c:w:q:d:m:p:P:")) != -1)
+    {
+        switch (c)
+        {
+        case '?':
+        case 'h':
+            usage(stdout);
+            result = EXIT_SUCCESS;
+            goto done;
+
+        case 'u':
+            config.ubus_path = optarg;
+            break;
+
+        case 'c':
+            config.num_clients = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'w':
+            config.num_workers = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'q':
+            config.in_flight = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'd':
+            config.duration_s = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'm':
+            if (!parse_mix(optarg, config.weights))
+            {
+                usage(stderr);
+                result = EXIT_FAILURE;
+                goto done;
+            }
+            break;
+
+        case 'p':
+            free(config.pattern_name);
+            config.pattern_name = strdup(optarg);
+            break;
+
+        case 'P':
+            config.daemon_pid = strtol(optarg, NULL, 10);
+            break;
+
+        default:
+            usage(stderr);
+            result = EXIT_FAILURE;
+            goto done;
+
+        }
+    }
+
+    if (config.num_clients == 0
+        || config.num_workers == 0
+        || config.num_workers > config.num_clients
+        || config.in_flight == 0
+        || config.duration_s == 0)
+    {
+        usage(stderr);
+        result = EXIT_FAILURE;
+        goto done;
+    }
+
+    result = run_loadgen(&config) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+done:
+    free(config.pattern_name);
+
+    return result;
+}
@@ -0,0 +1,266 @@
+#include <lib_led/lib_led.h>
+#include <lib_led/lib_led_control.h>
+#include <lib_led/lib_led_status_page.h>
+#include <lib_led/led_status_page_layout.h>
+#include <lib_led/string_constants.h>
+
+#include <libubus.h>
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Compares the rate at which the status of the daemon's LEDs can be read
+ * from the shared status page with the rate of "get" requests over ubus.
+ * Requires a running daemon.
+ */
+
+struct bench_config_st
+{
+    char const * ubus_path;
+    char const * status_page_name;
+    size_t page_iterations;
+    size_t ubus_iterations;
+};
+
+struct get_context_st
+{
+    bool success;
+};
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void
+print_result(
+    char const * const mode,
+    size_t const num_leds,
+    size_t const iterations,
+    uint64_t const elapsed_ns)
+{
+    double const elapsed_s = (double)elapsed_ns / 1e9;
+
+    fprintf(stdout,
+            "{\"benchmark\": \"get\", \"mode\": \"%s\", \"leds\": %zu, "
+            "\"iterations\": %zu, \"mean_ns\": %" PRIu64 ", "
+            "\"reads_per_sec\": %.0f}\n",
+            mode,
+            num_leds,
+            iterations,
+            elapsed_ns / iterations,
+            (elapsed_s > 0) ? (double)iterations / elapsed_s : 0.0);
+}
+
+static bool
+bench_status_page(
+    struct bench_config_st const * const config,
+    led_status_page_map_st const * const map)
+{
+    bool success = true;
+    size_t const num_leds = led_status_page_num_leds(map);
+    size_t locked_leds = 0;
+    uint64_t const start_ns = monotonic_ns();
+
+    for (size_t i = 0; i < config->page_iterations && success; i++)
+    {
+        struct led_page_status_st status;
+
+        success = led_status_page_read(map, i % num_leds, &status, NULL);
+        /* Use the result so that the read isn't optimised away. */
+        locked_leds += success && status.locked;
+    }
+
+    uint64_t const elapsed_ns = monotonic_ns() - start_ns;
+
+    if (!success)
+    {
+        fprintf(stderr, "Status page read failed\n");
+        goto done;
+    }
+
+    print_result("status_page", num_leds, config->page_iterations, elapsed_ns);
+    fprintf(stderr, "%zu locked LED reads\n", locked_leds);
+
+done:
+    return success;
+}
+
+static void
+get_result_cb(struct led_get_set_result_st const * const result, void * const user_context)
+{
+    struct get_context_st * const context = user_context;
+
+    context->success = context->success && result->success;
+}
+
+static bool
+bench_ubus_get(
+    struct bench_config_st const * const config,
+    ledcmd_ctx_st const * const ledcmd_ctx,
+    led_status_page_map_st const * const map)
+{
+    bool success = true;
+    size_t const num_leds = led_status_page_num_leds(map);
+    uint64_t const start_ns = monotonic_ns();
+
+    for (size_t i = 0; i < config->ubus_iterations && success; i++)
+    {
+        struct led_page_status_st status;
+        struct get_context_st context = { .success = true };
+
+        led_status_page_read(map, i % num_leds, &status, NULL);
+        success =
+            led_get_set_request(
+                ledcmd_ctx, _led_get, NULL, status.led_name, NULL, NULL, NULL, 0,
+                get_result_cb, &context)
+            && context.success;
+    }
+
+    uint64_t const elapsed_ns = monotonic_ns() - start_ns;
+
+    if (!success)
+    {
+        fprintf(stderr, "ubus get request failed\n");
+        goto done;
+    }
+
+    print_result("ubus", num_leds, config->ubus_iterations, elapsed_ns);
+
+done:
+    return success;
+}
+
+static bool
+run_benchmarks(struct bench_config_st const * const config)
+{
+    bool success;
+    struct ubus_context * ubus_ctx = NULL;
+    ledcmd_ctx_st * ledcmd_ctx = NULL;
+    led_status_page_map_st * const map = led_status_page_map(config->status_page_name);
+
+    if (map == NULL || led_status_page_num_leds(map) == 0)
+    {
+        fprintf(stderr, "Unable to map the LED status page\n");
+        success = false;
+        goto done;
+    }
+
+    ubus_ctx = ubus_connect(config->ubus_path);
+    if (ubus_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to connect to UBUS\n");
+        success = false;
+        goto done;
+    }
+
+    ledcmd_ctx = led_init(ubus_ctx);
+    if (ledcmd_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to connect to LED daemon\n");
+        success = false;
+        goto done;
+    }
+
+    success =
+        bench_status_page(config, map)
+        && bench_ubus_get(config, ledcmd_ctx, map);
+
+done:
+    led_deinit(ledcmd_ctx);
+    if (ubus_ctx != NULL)
+    {
+        ubus_free(ubus_ctx);
+    }
+    led_status_page_unmap(map);
+
+    return success;
+}
+
+static void
+usage(FILE * const fp)
+{
+    fprintf(fp,
+            "usage:\n"
+            "\tled_status_page_bench [options]\n"
+            "\t-h?           - help    - what you see below\n"
+            "\t-u <path>     - ubus socket path\n"
+            "\t-s <name>     - status page name (default " LED_STATUS_PAGE_DEFAULT_NAME ")\n"
+            "\t-i <count>    - status page reads (default 10000000)\n"
+            "\t-g <count>    - ubus get requests (default 10000)\n"
+            "\n"
+            "Results are written to stdout, one JSON object per line.\n"
+            "\n");
+}
+
+int
+main(int argc, char * argv[])
+{
+    int c;
+    int result;
+    struct bench_config_st config =
+    {
+        .ubus_path = NULL,
+        .status_page_name = NULL,
+        .page_iterations = 10000000,
+        .ubus_iterations = 10000
+    };
+
+    while ((c = getopt(argc, argv, "?hu:s:i:g:")) != -1)
+    {
+        switch (c)
+        {
+        case '?':
+        case 'h':
+            usage(stdout);
+            result = EXIT_SUCCESS;
+            goto done;
+
+        case 'u':
+            config.ubus_path = optarg;
+            break;
+
+        case 's':
+            config.status_page_name = optarg;
+            break;
+
+        case 'i':
+            config.page_iterations = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'g':
+            config.ubus_iterations = strtoul(optarg, NULL, 10);
+            break;
+
+        default:
+            usage(stderr);
+            result = EXIT_FAILURE;
+            goto done;
+
+        }
+    }
+
+    if (config.page_iterations == 0 || config.ubus_iterations == 0)
+    {
+        usage(stderr);
+        result = EXIT_FAILURE;
+        goto done;
+    }
+
+    result = run_benchmarks(&config) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+done:
+    return result;
+}
@@ -0,0 +1,621 @@
+#include "ledcmd_batch.h"
+
+#include <lib_led/lib_led_batch.h>
+#include <lib_led/lib_led_control.h>
+#include <lib_led/lib_led_pattern.h>
+#include <lib_led/string_constants.h>
+#include <ubus_utils/ubus_utils.h>
+
+#include <libubox/blobmsg_json.h>
+#include <libubox/uloop.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Stop reading commands while this many requests are awaiting responses. */
+#define MAX_REQUESTS_IN_FLIGHT 32
+#define MAX_LINE_LENGTH 1024
+
+struct ledcmd_batch_st
+{
+    struct ledcmd_ctx_st const * ctx;
+    struct uloop_fd input;
+    bool input_registered;
+    /* Set at the end of the input, or once a quit command is read. */
+    bool input_done;
+    bool quit;
+    /*
+     * Responses may be processed while a pattern request is sent, so this
+     * prevents the lines being processed reentrantly.
+     */
+    bool processing_lines;
+    /* Set when a line is too long, until the newline that ends it. */
+    bool discarding;
+    char buf[MAX_LINE_LENGTH];
+    size_t buf_len;
+    unsigned line_number;
+    size_t in_flight;
+    bool success;
+};
+
+struct batch_request_st
+{
+    struct ledcmd_batch_st * session;
+    struct blob_buf reply;
+    void * leds_cookie;
+    bool success;
+};
+
+struct batch_command_st
+{
+    char const * name;
+    /* The request sent to the daemon, or NULL for pattern commands. */
+    char const * cmd;
+    /* The state to set, if implied by the command. */
+    char const * state;
+};
+
+static struct batch_command_st const batch_commands[] =
+{
+    { .name = "get", .cmd = _led_get },
+    { .name = "set", .cmd = _led_set },
+    { .name = "on", .cmd = _led_set, .state = _led_on },
+    { .name = "off", .cmd = _led_set, .state = _led_off },
+    { .name = "flash", .cmd = _led_set, .state = _led_flash },
+    { .name = "fast-flash", .cmd = _led_set, .state = _led_fast_flash },
+    { .name = "activate", .cmd = _led_activate },
+    { .name = "deactivate", .cmd = _led_deactivate },
+    { .name = "play" },
+    { .name = "stop" }
+};
+
+static void process_buffered_lines(struct ledcmd_batch_st * session);
+
+static void
+print_reply(struct blob_buf * const reply)
+{
+    char * const json = blobmsg_format_json(reply->head, true);
+
+    if (json != NULL)
+    {
+        fprintf(stdout, "%s\n", json);
+        fflush(stdout);
+        free(json);
+    }
+}
+
+static void
+reply_init(
+    struct blob_buf * const reply,
+    unsigned const line_number,
+    char const * const command)
+{
+    blob_buf_full_init(reply, 0);
+    blobmsg_add_u32(reply, _led_line, line_number);
+    if (command != NULL)
+    {
+        blobmsg_add_string(reply, _led_command, command);
+    }
+}
+
+static void
+report_error(
+    struct ledcmd_batch_st * const session,
+    char const * const command,
+    char const * const error_msg)
+{
+    struct blob_buf reply = { 0 };
+
+    reply_init(&reply, session->line_number, command);
+    blobmsg_add_u8(&reply, _led_success, false);
+    blobmsg_add_string(&reply, _led_error, error_msg);
+    print_reply(&reply);
+    blob_buf_free(&reply);
+
+    session->success = false;
+}
+
+/*
+ * The session is finished once every line read has been processed and
+ * answered. Responses processed during a pattern request may complete the
+ * last request in flight while further lines are still buffered, so uloop
+ * isn't ended until those lines have been processed too.
+ */
+static void
+check_finished(struct ledcmd_batch_st const * const session)
+{
+    if (session->input_done
+        && session->in_flight == 0
+        && !session->processing_lines
+        && memchr(session->buf, '\n', session->buf_len) == NULL)
+    {
+        uloop_end();
+    }
+}
+
+static void
+request_result_cb(
+    struct led_get_set_result_st const * const result,
+    void * const user_context)
+{
+    struct batch_request_st * const request = user_context;
+    struct blob_buf * const reply = &request->reply;
+    void * const cookie = blobmsg_open_table(reply, NULL);
+
+    if (result->led_name != NULL)
+    {
+        blobmsg_add_string(reply, _led_name, result->led_name);
+    }
+    if (result->led_state != NULL)
+    {
+        blobmsg_add_string(reply, _led_state, result->led_state);
+    }
+    if (result->led_priority != NULL)
+    {
+        blobmsg_add_string(reply, _led_priority, result->led_priority);
+    }
+    blobmsg_add_u8(reply, _led_success, result->success);
+    if (result->error_msg != NULL)
+    {
+        blobmsg_add_string(reply, _led_error, result->error_msg);
+    }
+    if (result->lock_id != NULL)
+    {
+        blobmsg_add_string(reply, _led_lock_id, result->lock_id);
+    }
+
+    blobmsg_close_table(reply, cookie);
+
+    if (!result->success)
+    {
+        request->success = false;
+    }
+}
+
+static void
+request_complete_cb(bool const success, void * const user_context)
+{
+    struct batch_request_st * const request = user_context;
+    struct ledcmd_batch_st * const session = request->session;
+    struct blob_buf * const reply = &request->reply;
+
+    blobmsg_close_array(reply, request->leds_cookie);
+    if (!success)
+    {
+        blobmsg_add_string(reply, _led_error, "No response from LED daemon");
+    }
+    blobmsg_add_u8(reply, _led_success, success && request->success);
+    print_reply(reply);
+
+    if (!success || !request->success)
+    {
+        session->success = false;
+    }
+
+    blob_buf_free(reply);
+    free(request);
+
+    session->in_flight--;
+    process_buffered_lines(session);
+    check_finished(session);
+}
+
+static void
+send_led_request(
+    struct ledcmd_batch_st * const session,
+    struct batch_command_st const * const command,
+    char const * const led_name,
+    char const * const state,
+    char const * const lock_id,
+    char const * const led_priority)
+{
+    struct batch_request_st * const request = calloc(1, sizeof *request);
+
+    if (request == NULL)
+    {
+        report_error(session, command->name, "Out of memory");
+        goto done;
+    }
+
+    request->session = session;
+    request->success = true;
+    reply_init(&request->reply, session->line_number, command->name);
+    request->leds_cookie = blobmsg_open_array(&request->reply, _led_leds);
+
+    if (!led_get_set_request_async(
+            session->ctx,
+            command->cmd,
+            state,
+            led_name,
+            lock_id,
+            led_priority,
+            NULL,
+            0,
+            request_result_cb,
+            request_complete_cb,
+            request))
+    {
+        blob_buf_free(&request->reply);
+        free(request);
+        report_error(session, command->name, "Unable to send request");
+        goto done;
+    }
+
+    session->in_flight++;
+
+done:
+    return;
+}
+
+struct pattern_result_st
+{
+    bool success;
+    struct blob_buf * reply;
+};
+
+static void
+pattern_result_cb(bool const success, char const * const error_msg, void * const user_ctx)
+{
+    struct pattern_result_st * const result = user_ctx;
+
+    result->success = success;
+    if (error_msg != NULL)
+    {
+        blobmsg_add_string(result->reply, _led_error, error_msg);
+    }
+}
+
+/*
+ * Pattern requests are rare enough that they are simply sent synchronously.
+ * Responses to any LED requests in flight continue to be processed while
+ * waiting.
+ */
+static void
+send_pattern_request(
+    struct ledcmd_batch_st * const session,
+    struct batch_command_st const * const command,
+    char const * const pattern_name,
+    bool const retrigger)
+{
+    struct blob_buf reply = { 0 };
+    struct pattern_result_st result =
+    {
+        .success = false,
+        .reply = &reply
+    };
+
+    reply_init(&reply, session->line_number, command->name);
+    blobmsg_add_string(&reply, _led_pattern_name, pattern_name);
+
+    bool const sent =
+        strcmp(command->name, "play") == 0
+        ? led_play_pattern(session->ctx, pattern_name, retrigger, pattern_result_cb, &result)
+        : led_stop_pattern(session->ctx, pattern_name, pattern_result_cb, &result);
+    bool const success = sent && result.success;
+
+    blobmsg_add_u8(&reply, _led_success, success);
+    print_reply(&reply);
+    blob_buf_free(&reply);
+
+    if (!success)
+    {
+        session->success = false;
+    }
+}
+
+static struct batch_command_st const *
+batch_command_lookup(char const * const name)
+{
+    struct batch_command_st const * command = NULL;
+
+    for (size_t i = 0; i < ARRAY_SIZE(batch_commands); i++)
+    {
+        if (strcmp(name, batch_commands[i].name) == 0)
+        {
+            command = &batch_commands[i];
+            break;
+        }
+    }
+
+    return command;
+}
+
+/*
+ * A command line is of the form:
+ *     <command> <LED or pattern name> [<state>] [priority=<priority>]
+ *         [lock_id=<lock ID>] [retrigger]
+ * where the state is only given to the "set" command.
+ */
+static void
+process_line(struct ledcmd_batch_st * const session, char * const line)
+{
+    char * saveptr = NULL;
+    char const * const name = strtok_r(line, " \t\r", &saveptr);
+
+    session->line_number++;
+
+    if (name == NULL || name[0] == '#')
+    {
+        goto done;
+    }
+
+    if (strcmp(name, "quit") == 0)
+    {
+        session->quit = true;
+        session->input_done = true;
+        goto done;
+    }
+
+    struct batch_command_st const * const command = batch_command_lookup(name);
+
+    if (command == NULL)
+    {
+        report_error(session, name, "Unknown command");
+        goto done;
+    }
+
+    char const * const target = strtok_r(NULL, " \t\r", &saveptr);
+    char const * state = command->state;
+    char const * lock_id = NULL;
+    char const * led_priority = NULL;
+    bool retrigger = false;
+    char * arg;
+
+    while ((arg = strtok_r(NULL, " \t\r", &saveptr)) != NULL)
+    {
+        char * const value = strchr(arg, '=');
+
+        if (value != NULL)
+        {
+            *value = '\0';
+        }
+
+        if (value != NULL && strcmp(arg, _led_lock_id) == 0)
+        {
+            lock_id = value + 1;
+        }
+        else if (value != NULL && strcmp(arg, _led_priority) == 0)
+        {
+            led_priority = value + 1;
+        }
+        else if (value == NULL && strcmp(arg, _led_pattern_retrigger) == 0)
+        {
+            retrigger = true;
+        }
+        else if (value == NULL && state == NULL && strcmp(command->name, "set") == 0)
+        {
+            state = arg;
+        }
+        else
+        {
+            report_error(session, name, "Invalid argument");
+            goto done;
+        }
+    }
+
+    if (target == NULL || (strcmp(command->name, "set") == 0 && state == NULL))
+    {
+        report_error(session, name, "Missing argument");
+        goto done;
+    }
+
+    if (command->cmd == NULL)
+    {
+        send_pattern_request(session, command, target, retrigger);
+    }
+    else
+    {
+        send_led_request(session, command, target, state, lock_id, led_priority);
+    }
+
+done:
+    return;
+}
+
+static void
+update_input_registration(struct ledcmd_batch_st * const session)
+{
+    bool const want_input =
+        !session->input_done
+        && session->in_flight < MAX_REQUESTS_IN_FLIGHT
+        && memchr(session->buf, '\n', session->buf_len) == NULL;
+
+    if (want_input && !session->input_registered)
+    {
+        uloop_fd_add(&session->input, ULOOP_READ);
+        session->input_registered = true;
+    }
+    else if (!want_input && session->input_registered)
+    {
+        uloop_fd_delete(&session->input);
+        session->input_registered = false;
+    }
+}
+
+static void
+process_buffered_lines(struct ledcmd_batch_st * const session)
+{
+    if (session->processing_lines)
+    {
+        goto done;
+    }
+
+    session->processing_lines = true;
+
+    while (!session->quit && session->in_flight < MAX_REQUESTS_IN_FLIGHT)
+    {
+        char * const newline = memchr(session->buf, '\n', session->buf_len);
+
+        if (newline == NULL)
+        {
+            break;
+        }
+
+        *newline = '\0';
+        if (session->discarding)
+        {
+            session->discarding = false;
+        }
+        else
+        {
+            process_line(session, session->buf);
+        }
+
+        size_t const consumed = newline + 1 - session->buf;
+
+        session->buf_len -= consumed;
+        memmove(session->buf, newline + 1, session->buf_len);
+    }
+
+    if (session->quit)
+    {
+        /* Anything following a quit command is ignored. */
+        session->buf_len = 0;
+    }
+
+    session->processing_lines = false;
+    update_input_registration(session);
+
+done:
+    return;
+}
+
+static void
+input_cb(struct uloop_fd * const fd, unsigned int const events)
+{
+    UNUSED_ARG(events);
+
+    struct ledcmd_batch_st * const session =
+        container_of(fd, struct ledcmd_batch_st, input);
+    size_t const space = sizeof(session->buf) - session->buf_len;
+    ssize_t const bytes_read = read(fd->fd, session->buf + session->buf_len, space);
+
+    if (bytes_read < 0)
+    {
+        if (errno == EINTR || errno == EAGAIN)
+        {
+            goto done;
+        }
+        session->input_done = true;
+    }
+    else if (bytes_read == 0)
+    {
+        /* Treat an unterminated last line as if it had been terminated. */
+        if (session->buf_len > 0 && session->buf_len < sizeof(session->buf))
+        {
+            session->buf[session->buf_len++] = '\n';
+        }
+        session->input_done = true;
+    }
+    else
+    {
+        session->buf_len += bytes_read;
+    }
+
+    process_buffered_lines(session);
+
+    if (session->buf_len == sizeof(session->buf))
+    {
+        /*
+         * The buffer is full, and holds only part of a line. The rest of the
+         * line is discarded when it arrives.
+         */
+        session->line_number++;
+        report_error(session, NULL, "Line too long");
+        session->buf_len = 0;
+        session->discarding = true;
+        update_input_registration(session);
+    }
+
+done:
+    check_finished(session);
+}
+
+/*
+ * A FIFO is opened for writing as well as reading so that the end of the
+ * input isn't seen each time a writer closes it. Commands can then be
+ * written to it by any number of processes in turn, until one sends "quit".
+ */
+static int
+open_input(char const * const input_path)
+{
+    int fd;
+    struct stat st;
+
+    if (input_path == NULL || strcmp(input_path, "-") == 0)
+    {
+        fd = STDIN_FILENO;
+        goto done;
+    }
+
+    if (stat(input_path, &st) == 0 && S_ISFIFO(st.st_mode))
+    {
+        fd = open(input_path, O_RDWR | O_CLOEXEC);
+    }
+    else
+    {
+        fd = open(input_path, O_RDONLY | O_CLOEXEC);
+    }
+
+done:
+    return fd;
+}
+
+bool
+ledcmd_run_batch(
+    struct ubus_context * const ubus_ctx,
+    struct ledcmd_ctx_st const * const ctx,
+    char const * const input_path)
+{
+    bool success;
+    struct ledcmd_batch_st session =
+    {
+        .ctx = ctx,
+        .input.cb = input_cb,
+        .success = true
+    };
+
+    session.input.fd = open_input(input_path);
+    if (session.input.fd < 0)
+    {
+        fprintf(stderr, "Unable to open %s: %s\n", input_path, strerror(errno));
+        success = false;
+        goto done;
+    }
+
+    uloop_init();
+    ubus_add_uloop(ubus_ctx);
+
+    update_input_registration(&session);
+    uloop_run();
+
+    /*
+     * uloop_run() only returns early when interrupted, in which case
+     * responses to some requests may still be outstanding. No more commands
+     * are read, but the requests in flight are allowed to complete (or time
+     * out), as they must before the caller calls led_deinit().
+     */
+    session.quit = true;
+    session.input_done = true;
+    update_input_registration(&session);
+    while (session.in_flight > 0)
+    {
+        uloop_run();
+    }
+    uloop_done();
+
+    success = session.success;
+
+done:
+    if (session.input.fd > STDIN_FILENO)
+    {
+        close(session.input.fd);
+    }
+
+    return success;
+}
@@ -0,0 +1,22 @@
+#ifndef LEDCMD_BATCH_H__
+#define LEDCMD_BATCH_H__
+
+#include <lib_led/lib_led.h>
+
+#include <libubus.h>
+
+#include <stdbool.h>
+
+/*
+ * Read newline delimited commands from input_path (stdin if NULL or "-")
+ * until the end of the input or a "quit" command, and print the result of
+ * each as a line of JSON. LED requests are sent without waiting for the
+ * responses to the earlier ones. Returns true if every command succeeded.
+ */
+bool
+ledcmd_run_batch(
+    struct ubus_context * ubus_ctx,
+    struct ledcmd_ctx_st const * ctx,
+    char const * input_path);
+
+#endif /* LEDCMD_BATCH_H__ */
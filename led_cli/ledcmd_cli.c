@@ -1,4 +1,7 @@
+#include "ledcmd_batch.h"
+
 #include <lib_led/lib_led.h>
+#include <lib_led/lib_led_batch.h>
 #include <lib_led/lib_led_control.h>
 #include <lib_led/string_constants.h>
 #include <ubus_utils/ubus_utils.h>
@@ -47,70 +50,152 @@ print_led_states(struct ledcmd_ctx_st const * const ledcmd_ctx)
     }
 }
 
+/*
+ * The LED operations on the command line are collected into a single batch
+ * and sent to the daemon in one request. Each operation records its own
+ * outcome so that the failures can be reported once the results arrive.
+ */
+struct cli_op_st
+{
+    char const * led_name;
+    /* Non-NULL for activate/deactivate operations. */
+    char const * lock_action;
+    bool is_get_request;
+    /* Failures of this operation don't affect the exit status. */
+    bool ignore_failure;
+    bool got_result;
+    bool failed;
+};
+
+struct cli_batch_st
+{
+    led_batch_st * batch;
+    struct cli_op_st * ops;
+    size_t num_ops;
+};
+
 static void
-handle_lock_result(
-    struct led_lock_result_st const * const lock_result,
+cli_op_result_handler(
+    struct led_get_set_result_st const * const result,
     void * const user_context)
 {
-    bool * const lock_succeeded = user_context;
+    struct cli_op_st * const op = user_context;
+
+    op->got_result = true;
 
-    if (lock_result->success)
+    if (!result->success)
     {
-        *lock_succeeded = true;
-        goto done;
+        if (result->error_msg != NULL)
+        {
+            fprintf(stdout, "Error: %s", result->error_msg);
+            if (result->lock_id != NULL)
+            {
+                fprintf(stdout,
+                        op->lock_action != NULL
+                        ? ". LED is locked with ID: %s"
+                        : ". Locked with ID: %s",
+                        result->lock_id);
+            }
+            fputs("\n", stdout);
+        }
+        op->failed = true;
+    }
+    else if (op->is_get_request)
+    {
+        if (result->led_name != NULL && result->led_state != NULL)
+        {
+            fprintf(stdout, "%s %s\n", result->led_name, result->led_state);
+        }
     }
+}
 
-    if (lock_result->error_msg == NULL)
+static struct cli_op_st *
+add_cli_op(
+    struct cli_batch_st * const cli_batch,
+    char const * const cmd,
+    char const * const state,
+    char const * const led_name,
+    char const * const lock_id,
+    char const * const led_priority,
+    char const * const flash_type,
+    uint32_t const flash_time_ms)
+{
+    struct cli_op_st * const op = &cli_batch->ops[cli_batch->num_ops];
+
+    op->led_name = led_name;
+    if (!led_batch_add_op(
+            cli_batch->batch,
+            cmd,
+            led_name,
+            state,
+            lock_id,
+            led_priority,
+            flash_type,
+            flash_time_ms,
+            cli_op_result_handler,
+            op))
     {
-        goto done;
+        fprintf(stderr, "failed to queue %s request for led: %s\n", cmd, led_name);
+        return NULL;
     }
+    cli_batch->num_ops++;
+
+    return op;
+}
 
-    fprintf(stdout, "Error: %s", lock_result->error_msg);
+static bool
+add_get_set_op(
+    struct cli_batch_st * const cli_batch,
+    char const * const cmd,
+    char const * const state,
+    char const * const led_name,
+    char const * const lock_id,
+    char const * const led_priority,
+    bool const brief)
+{
+    uint32_t const flash_time_ms = brief ? 50 : 0;
+    char const * const flash_type = brief ? _led_flash_type_one_shot : NULL;
+    struct cli_op_st * const op = add_cli_op(
+        cli_batch, cmd, state, led_name, lock_id, led_priority, flash_type, flash_time_ms);
 
-    if (lock_result->lock_id != NULL)
+    if (op != NULL)
     {
-        fprintf(stdout, ". LED is locked with ID: %s", lock_result->lock_id);
+        op->is_get_request = strcmp(cmd, _led_get) == 0;
     }
-    fputs("\n", stdout);
 
-done:
-    return;
+    return op != NULL;
 }
 
+/*
+ * Unlike the other operations, a failure to activate or deactivate a LED
+ * doesn't prevent the operations that follow from being attempted.
+ */
 static bool
-activate_or_deactivate_led(
-    struct ledcmd_ctx_st const * const ctx,
+add_lock_op(
+    struct cli_batch_st * const cli_batch,
     bool const lock_led,
     char const * const led_priority,
     char const * const lock_id,
-    char const * const led_name)
+    char const * const led_name,
+    bool const ignore_failure)
 {
-    bool lock_succeeded = false;
-    bool const success =
-        led_activate_or_deactivate(
-        ctx,
-        lock_led,
-        led_name,
-        led_priority,
-        lock_id,
-        handle_lock_result,
-        &lock_succeeded)
-        && lock_succeeded;
-
-    if (!success)
-    {
-        char const * const lock_action =
-            lock_led ? _led_activate : _led_deactivate;
+    char const * const lock_action = lock_led ? _led_activate : _led_deactivate;
+    struct cli_op_st * const op = add_cli_op(
+        cli_batch, lock_action, NULL, led_name, lock_id, led_priority, NULL, 0);
 
-        fprintf(stderr, "failed to %s led: %s\n", lock_action, led_name);
+    if (op != NULL)
+    {
+        op->lock_action = lock_action;
+        op->ignore_failure = ignore_failure;
+        led_batch_set_op_stop_on_error(cli_batch->batch, false);
     }
 
-    return success;
+    return op != NULL;
 }
 
 static bool
-activate_or_deactivate_leds(
-    struct ledcmd_ctx_st const * const ctx,
+add_lock_ops(
+    struct cli_batch_st * const cli_batch,
     bool activate_leds,
     char const * const led_priority,
     char const * const lock_id,
@@ -129,16 +214,64 @@ activate_or_deactivate_leds(
         goto done;
     }
 
-    /* Assume success unless any request command failed. */
+    for (size_t i = 0; i < argc; i++)
+    {
+        if (!add_lock_op(cli_batch, activate_leds, led_priority, lock_id, argv[i], false))
+        {
+            success = false;
+            goto done;
+        }
+    }
+
     success = true;
 
-    for (size_t i = 0; i < argc; i++)
+done:
+    return success;
+}
+
+static bool
+cli_op_succeeded(struct cli_op_st const * const op)
+{
+    /* Lock operations only succeed if the daemon reported a result. */
+    return !op->failed && (op->got_result || op->lock_action == NULL);
+}
+
+/* Send the batch, and report the operations that failed. */
+static bool
+submit_cli_batch(struct cli_batch_st * const cli_batch)
+{
+    bool success = true;
+
+    if (cli_batch->num_ops == 0)
+    {
+        goto done;
+    }
+
+    bool const submitted = led_batch_submit(cli_batch->batch, NULL, NULL);
+
+    cli_batch->batch = NULL;
+    if (!submitted)
+    {
+        fprintf(stderr, "LED request failed\n");
+        success = false;
+        goto done;
+    }
+
+    for (size_t i = 0; i < cli_batch->num_ops; i++)
     {
-        if (!activate_or_deactivate_led(
-                ctx, activate_leds, led_priority, lock_id, argv[i]))
+        struct cli_op_st const * const op = &cli_batch->ops[i];
+
+        if (cli_op_succeeded(op))
+        {
+            continue;
+        }
+        if (op->lock_action != NULL)
+        {
+            fprintf(stderr, "failed to %s led: %s\n", op->lock_action, op->led_name);
+        }
+        if (!op->ignore_failure)
         {
             success = false;
-            /* Continue even if a lock/unlock attempt fails. */
         }
     }
 
@@ -179,166 +312,6 @@ print_led_names(struct ledcmd_ctx_st const * const ctx)
     }
 }
 
-struct led_get_set_context_st
-{
-    bool success;
-    bool const is_get_request;
-};
-
-static void
-led_get_set_handler(
-    struct led_get_set_result_st const * const result,
-    void * const user_context)
-{
-    struct led_get_set_context_st * const context = user_context;
-
-    if (!result->success)
-    {
-        if (result->error_msg != NULL)
-        {
-            fprintf(stdout, "Error: %s", result->error_msg);
-            if (result->lock_id != NULL)
-            {
-                fprintf(stdout, ". Locked with ID: %s", result->lock_id);
-            }
-            fputs("\n", stdout);
-        }
-        context->success = false;
-    }
-    else if (context->is_get_request)
-    {
-        if (result->led_name != NULL && result->led_state != NULL)
-        {
-            fprintf(stdout, "%s %s\n", result->led_name, result->led_state);
-        }
-    }
-}
-
-static bool
-get_set_request(
-    struct ledcmd_ctx_st const * const ledcmd_ctx,
-    char const * const cmd,
-    char const * const state,
-    char const * const led_name,
-    char const * const lock_id,
-    char const * const led_priority,
-    bool const brief)
-{
-    struct led_get_set_context_st context =
-    {
-        .success = true,
-        .is_get_request = strcmp(cmd, _led_get) == 0
-    };
-    uint32_t const flash_time_ms = brief ? 50 : 0;
-    char const * const flash_type = brief ? _led_flash_type_one_shot : NULL;
-
-    bool const success = led_get_set_request(
-        ledcmd_ctx,
-        cmd,
-        state,
-        led_name,
-        lock_id,
-        led_priority,
-        flash_type,
-        flash_time_ms,
-        led_get_set_handler,
-        &context);
-
-    return success && context.success;
-}
-
-#define led_query(ledcmd_ctx, led_name) \
-    ({ \
-        bool _res; \
-        do { \
-            _res = get_set_request( \
-                ledcmd_ctx, _led_get, NULL, led_name, NULL, NULL, false); \
-        } while (0); \
-        _res; \
-    })
-
-#define led_set_common(ledcmd_ctx, state, led_name, lock_id, led_priority, brief) \
-    ({ \
-        bool _res; \
-        do { \
-            _res = get_set_request( \
-                ledcmd_ctx, _led_set, state, led_name, lock_id, led_priority, brief); \
-        } while (0); \
-        _res; \
-    })
-
-
-#define led_activate_alternate_priority(ledcmd_ctx, led_name) \
-    ({ \
-        bool _res; \
-        do { \
-            _res = activate_or_deactivate_led( \
-                ledcmd_ctx, true, _led_priority_alternate, NULL, led_name); \
-        } while (0); \
-        _res; \
-    })
-
-#define led_deactivate_alternate_priority(ledcmd_ctx, led_name) \
-    ({ \
-        bool _res; \
-        do { \
-            _res = activate_or_deactivate_led( \
-                ledcmd_ctx, false, _led_priority_alternate, NULL, led_name); \
-        } while (0); \
-        _res; \
-    })
-
-
-#define led_on_brief(ledcmd_ctx, led_name, lock_id, led_priority) \
-    ({ \
-        bool _res; \
-        do { \
-            _res = led_set_common( \
-                ledcmd_ctx, _led_off, led_name, lock_id, led_priority, true); \
-        } while (0); \
-        _res; \
-    })
-
-#define led_on(ledcmd_ctx, led_name, lock_id, led_priority) \
-    ({ \
-        bool _res; \
-        do { \
-            _res = led_set_common( \
-                ledcmd_ctx, _led_on, led_name, lock_id, led_priority, false); \
-        } while (0); \
-        _res; \
-    })
-
-#define led_off(ledcmd_ctx, led_name, lock_id, led_priority) \
-    ({ \
-        bool _res; \
-        do { \
-            _res = led_set_common( \
-                ledcmd_ctx, _led_off, led_name, lock_id, led_priority, false); \
-        } while (0); \
-        _res; \
-    })
-
-#define led_flash(ledcmd_ctx, led_name, lock_id, led_priority) \
-    ({ \
-        bool _res; \
-        do { \
-            _res = led_set_common( \
-                ledcmd_ctx, _led_flash, led_name, lock_id, led_priority, false); \
-        } while (0); \
-        _res; \
-    })
-
-#define led_fast_flash(ledcmd_ctx, led_name, lock_id, led_priority) \
-    ({ \
-        bool _res; \
-        do { \
-            _res = led_set_common( \
-                ledcmd_ctx, _led_fast_flash, led_name, lock_id, led_priority, false); \
-        } while (0); \
-        _res; \
-    })
-
 /*
  * TODO: Could possibly get this app to read supported features from the
  * daemon.
@@ -352,7 +325,8 @@ usage(FILE * const fp)
             "\tledcmd [-h?]\n"
             "\tledcmd [-u <UBUS socket>] [-lL]\n"
             "\tledcmd [-u <UBUS socket>] [-k|-K] <lock ID> <LED name> ...\n"
-            "\tledcmd [-u <UBUS socket>] [-i <lock ID>] ((-s|-o|-O|-f|-F|-q) <LED name>) ...\n\n"
+            "\tledcmd [-u <UBUS socket>] [-i <lock ID>] ((-s|-o|-O|-f|-F|-q) <LED name>) ...\n"
+            "\tledcmd [-u <UBUS socket>] -b|--batch [<file or FIFO>]\n\n"
             "\t-h?            help    - what you see below\n"
             "\t-u <socket>    UBUS socket path (otherwise uses default)\n"
             "\t-k             acquire - acquire exclusive access to this LED, locked by <lock ID>\n"
@@ -370,9 +344,25 @@ usage(FILE * const fp)
             "\t-N             altoff  - set LED to normal mode\n"
             "\t-a             altbit  - alt LED mode applies to following commands\n"
             "\t-A             ~altbit - alt LED mode does not apply to following commands\n"
+            "\t-b, --batch    batch   - read commands, one per line, from stdin or a file\n"
+            "\n"
+            "In batch mode each line holds one of the commands\n"
+            "\tget|on|off|flash|fast-flash|activate|deactivate <LED name>\n"
+            "\tset <LED name> <state>\n"
+            "\tplay|stop <pattern>\n"
+            "\tquit\n"
+            "optionally followed by priority=<priority>, lock_id=<lock ID> or, for\n"
+            "play, retrigger. The result of each is printed as a line of JSON.\n"
             "\n");
 }
 
+enum cli_listing_t
+{
+    CLI_LISTING_NONE,
+    CLI_LISTING_NAMES,
+    CLI_LISTING_STATES
+};
+
 int
 main(int argc, char * argv[])
 {
@@ -383,6 +373,21 @@ main(int argc, char * argv[])
     char const * ubus_path = NULL;
     struct ubus_context * ubus_ctx = NULL;
     struct ledcmd_ctx_st * ctx = NULL;
+    struct cli_batch_st cli_batch =
+    {
+        .batch = NULL,
+        .ops = NULL,
+        .num_ops = 0
+    };
+    enum cli_listing_t listing = CLI_LISTING_NONE;
+    bool batch_mode = false;
+    bool stop_parsing = false;
+
+    static struct option const long_options[] =
+    {
+        { "batch", no_argument, NULL, 'b' },
+        { NULL, 0, NULL, 0 }
+    };
 
     /*
      * Two passes over the command line args are required because some options
@@ -391,7 +396,7 @@ main(int argc, char * argv[])
      */
 
     opterr = 0;
-    while ((c = getopt(argc, argv, "u:")) != -1)
+    while ((c = getopt_long(argc, argv, "u:", long_options, NULL)) != -1)
     {
         switch (c)
         {
@@ -417,18 +422,40 @@ main(int argc, char * argv[])
         goto done;
     }
 
+    /*
+     * The LED operations are performed in command line order, and the
+     * operations that follow a failed one are skipped, but all are sent to
+     * the daemon in a single request once the command line has been parsed.
+     * There can be no more operations than there are arguments.
+     */
+    cli_batch.batch = led_batch_begin(ctx, NULL);
+    cli_batch.ops = calloc(argc, sizeof *cli_batch.ops);
+    if (cli_batch.batch == NULL || cli_batch.ops == NULL)
+    {
+        fprintf(stderr, "Unable to allocate LED request\n");
+        result = EXIT_FAILURE;
+        goto done;
+    }
+    led_batch_set_stop_on_error(cli_batch.batch, true);
+
     opterr = 1;
     optind = 1;
-    while ((c = getopt(argc, argv, "aAn:N:lLs:o:O:f:F:q:k:K:i:u:")) != -1)
+    while (!stop_parsing
+           && (c = getopt_long(
+                   argc, argv, "aAbn:N:lLs:o:O:f:F:q:k:K:i:u:", long_options, NULL)) != -1)
     {
+        bool added = true;
+
         switch (c)
         {
         case 'n':
-            led_activate_alternate_priority(ctx, optarg);
+            added = add_lock_op(
+                &cli_batch, true, _led_priority_alternate, NULL, optarg, true);
             break;
 
         case 'N':
-            led_deactivate_alternate_priority(ctx, optarg);
+            added = add_lock_op(
+                &cli_batch, false, _led_priority_alternate, NULL, optarg, true);
             break;
 
         case 'a':
@@ -440,26 +467,15 @@ main(int argc, char * argv[])
             break;
 
         case 'k':
-        {
-            int const num_args = argc - optind;
-
-            result =
-                activate_or_deactivate_leds(
-                ctx, true, _led_priority_locked, optarg, num_args, &argv[optind])
-                ? EXIT_SUCCESS
-                : EXIT_FAILURE;
-            goto done;
-        }
-
         case 'K':
         {
             int const num_args = argc - optind;
 
-            result =
-                activate_or_deactivate_leds(ctx, false, _led_priority_locked, optarg, num_args, &argv[optind])
-                ? EXIT_SUCCESS
-                : EXIT_FAILURE;
-            goto done;
+            added = add_lock_ops(
+                &cli_batch, c == 'k', _led_priority_locked, optarg, num_args, &argv[optind]);
+            /* The remaining arguments are all LED names. */
+            stop_parsing = true;
+            break;
         }
 
         case 'i':
@@ -474,62 +490,49 @@ main(int argc, char * argv[])
             break;
 
         case 's':
-            if (!led_on_brief(ctx, optarg, lock_id, led_priority))
-            {
-                result = EXIT_FAILURE;
-                goto done;
-            }
+            added = add_get_set_op(
+                &cli_batch, _led_set, _led_off, optarg, lock_id, led_priority, true);
             break;
 
         case 'o':
-            if (!led_on(ctx, optarg, lock_id, led_priority))
-            {
-                result = EXIT_FAILURE;
-                goto done;
-            }
+            added = add_get_set_op(
+                &cli_batch, _led_set, _led_on, optarg, lock_id, led_priority, false);
             break;
 
         case 'O':
-            if (!led_off(ctx, optarg, lock_id, led_priority))
-            {
-                result = EXIT_FAILURE;
-                goto done;
-            }
+            added = add_get_set_op(
+                &cli_batch, _led_set, _led_off, optarg, lock_id, led_priority, false);
             break;
 
         case 'f':
-            if (!led_flash(ctx, optarg, lock_id, led_priority))
-            {
-                result = EXIT_FAILURE;
-                goto done;
-            }
+            added = add_get_set_op(
+                &cli_batch, _led_set, _led_flash, optarg, lock_id, led_priority, false);
             break;
 
         case 'F':
-            if (!led_fast_flash(ctx, optarg, lock_id, led_priority))
-            {
-                result = EXIT_FAILURE;
-                goto done;
-            }
+            added = add_get_set_op(
+                &cli_batch, _led_set, _led_fast_flash, optarg, lock_id, led_priority, false);
             break;
 
         case 'q':
-            if (!led_query(ctx, optarg))
-            {
-                result = EXIT_FAILURE;
-                goto done;
-            }
+            added = add_get_set_op(
+                &cli_batch, _led_get, NULL, optarg, NULL, NULL, false);
             break;
 
         case 'l':
-            print_led_names(ctx);
-            result = EXIT_SUCCESS;
-            goto done;
+            listing = CLI_LISTING_NAMES;
+            stop_parsing = true;
+            break;
 
         case 'L':
-            print_led_states(ctx);
-            result = EXIT_SUCCESS;
-            goto done;
+            listing = CLI_LISTING_STATES;
+            stop_parsing = true;
+            break;
+
+        case 'b':
+            batch_mode = true;
+            stop_parsing = true;
+            break;
 
         case 'u':
             /* UBUS path. Ignore, as it's not needed in this pass of the args. */
@@ -541,14 +544,50 @@ main(int argc, char * argv[])
             goto done;
 
         }
+
+        if (!added)
+        {
+            result = EXIT_FAILURE;
+            goto done;
+        }
+    }
+
+    if (!submit_cli_batch(&cli_batch))
+    {
+        result = EXIT_FAILURE;
+        goto done;
+    }
+
+    /* Listings are printed after the operations that preceded them. */
+    switch (listing)
+    {
+    case CLI_LISTING_NAMES:
+        print_led_names(ctx);
+        break;
+
+    case CLI_LISTING_STATES:
+        print_led_states(ctx);
+        break;
+
+    case CLI_LISTING_NONE:
+        break;
+    }
+
+    if (batch_mode)
+    {
+        char const * const input_path = (optind < argc) ? argv[optind] : NULL;
+
+        result = ledcmd_run_batch(ubus_ctx, ctx, input_path) ? EXIT_SUCCESS : EXIT_FAILURE;
+        goto done;
     }
 
     result = EXIT_SUCCESS;
 
 done:
+    led_batch_free(cli_batch.batch);
+    free(cli_batch.ops);
     led_deinit(ctx);
     ubus_free(ubus_ctx);
 
     return result;
 }
-
@@ -0,0 +1,70 @@
+#ifndef LED_CLOCK_H__
+#define LED_CLOCK_H__
+
+#include <libubox/avl.h>
+#include <libubox/uloop.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The clock and timers used by the flash and pattern engines. Normally these
+ * are the monotonic clock and uloop timers. With the virtual clock, time only
+ * passes when led_clock_advance() is called, which fires the timers that
+ * become due in order, without sleeping, so that long pattern sequences can
+ * be simulated and benchmarked in-process.
+ */
+
+struct led_timer_st;
+
+typedef void (*led_timer_cb)(struct led_timer_st * timer);
+
+struct led_timer_st
+{
+    led_timer_cb cb;
+    /* Used with the real clock. */
+    struct uloop_timeout timeout;
+    /* Used with the virtual clock. */
+    struct avl_node node;
+    uint64_t expires_ns;
+    /* Orders timers that expire at the same time by when they were set. */
+    uint64_t seq;
+    bool pending;
+};
+
+/* A zeroed timer may also be used once its callback has been set. */
+void
+led_timer_init(struct led_timer_st * timer, led_timer_cb cb);
+
+void
+led_timer_set(struct led_timer_st * timer, uint32_t time_ms);
+
+void
+led_timer_cancel(struct led_timer_st * timer);
+
+bool
+led_timer_pending(struct led_timer_st const * timer);
+
+uint64_t
+led_clock_now_ns(void);
+
+/*
+ * Switch between the real and virtual clocks. The virtual clock starts at the
+ * current monotonic time. Switch while no timers are pending, as timers stay
+ * with the clock that set them. Fails if any virtual timers are pending.
+ */
+bool
+led_clock_use_virtual(bool use_virtual);
+
+bool
+led_clock_is_virtual(void);
+
+/*
+ * Advance the virtual clock, firing the timers that become due, including any
+ * set by the callbacks. Returns the number of timers fired.
+ */
+size_t
+led_clock_advance(uint64_t ns);
+
+#endif /* LED_CLOCK_H__ */
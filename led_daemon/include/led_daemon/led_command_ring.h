@@ -0,0 +1,32 @@
+#ifndef LED_COMMAND_RING_H__
+#define LED_COMMAND_RING_H__
+
+#include "led_control.h"
+
+#include <lib_led/led_command_ring_layout.h>
+
+/*
+ * The daemon's side of a producer's shared memory command ring (see
+ * lib_led/led_command_ring_layout.h). The ring is drained from uloop when
+ * the producer signals the eventfd, and the most recent update for each LED
+ * is applied with the set_state operation.
+ */
+typedef struct led_command_ring_st led_command_ring_st;
+
+led_command_ring_st *
+led_command_ring_create(
+    struct led_command_ring_request_st const * request,
+    struct led_ops_st const * led_ops,
+    void * led_ops_context);
+
+void
+led_command_ring_free(led_command_ring_st * ring);
+
+/* The descriptors to pass to the producer. They remain owned by the ring. */
+int
+led_command_ring_memfd(led_command_ring_st const * ring);
+
+int
+led_command_ring_eventfd(led_command_ring_st const * ring);
+
+#endif /* LED_COMMAND_RING_H__ */
@@ -2,11 +2,13 @@
 #define LED_CONTROL_H__
 
 #include "led_states.h"
+#include "led_clock.h"
 #include "led_priority_context.h"
 #include "led_patterns.h"
 #include "flash_types.h"
 #include "platform_specific.h"
 #include "priorities.h"
+#include "led_stats.h"
 
 #include <ubus_utils/ubus_connection.h>
 #include <libubus.h>
@@ -26,7 +28,9 @@ struct flash_context_st
     enum flash_type_t type;
     uint32_t current_time;
 
-    struct uloop_timeout timer;
+    struct led_timer_st timer;
+    /* When the timer is due to fire, used to measure its lateness. */
+    uint64_t scheduled_ns;
     struct platform_led_methods_st const * methods;
 };
 
@@ -36,13 +40,33 @@ struct led_state_context_st
     enum led_priority_t priority;
     /* Save the last state set in each priority. */
     enum led_state_t state;
+    /*
+     * The state most recently requested for this priority. Unlike 'state'
+     * this doesn't follow the individual on/off steps of a flashing LED.
+     */
+    enum led_state_t requested_state;
 
     struct flash_context_st flash;
 };
 
+/* The externally visible status of an LED, as reported when it changes. */
+struct led_status_st
+{
+    enum led_state_t state;
+    enum led_priority_t priority;
+    bool locked;
+};
+
 struct led_ctx_st
 {
     struct avl_node node;
+    /* Linked into the list of LEDs to check for changes. */
+    struct list_head changed_node;
+    struct led_status_st notified_status;
+    /* The change sequence number at which notified_status last changed. */
+    uint32_t last_changed_seq;
+    /* The index of this LED's entry in the shared status page. */
+    uint32_t status_page_index;
 
     led_st * led; /* platform specific LED context. */
 
@@ -54,9 +78,26 @@ struct led_ctx_st
 
 typedef struct ledcmd_ctx_st ledcmd_ctx_st;
 
+typedef void (*led_change_cb)(
+    char const * led_name,
+    struct led_status_st const * status,
+    void * result_context);
+
+typedef void (*led_changes_iterate_fn)(
+    void * iterate_context,
+    led_change_cb result_cb,
+    void * result_context);
+
+/*
+ * Requests may identify an LED or alias by the numeric ID returned by
+ * resolve_leds rather than by name. LED_ID_NONE means the name is used.
+ */
+#define LED_ID_NONE 0
+
 struct set_state_req_st
 {
     char const * led_name;
+    uint32_t led_id;
     char const * lock_id;
     /* Used as the final state when doing timed flashing. */
     enum led_state_t state;
@@ -66,6 +107,32 @@ struct set_state_req_st
     bool flash_forever;
 };
 
+/*
+ * The result of a query for the LEDs that changed since a sequence number.
+ * If resync is set, the changes were no longer available, or the sequence
+ * number refers to a previous instance of the daemon (identified by its
+ * epoch), and all LEDs are reported instead.
+ */
+struct led_changes_info_st
+{
+    uint32_t epoch;
+    uint32_t seq;
+    bool resync;
+};
+
+enum led_pattern_event_t
+{
+    LED_PATTERN_EVENT_STARTED,
+    /* The last step has played and the pattern is starting again. */
+    LED_PATTERN_EVENT_STEP_WRAPPED,
+    /* The pattern stopped by itself after playing the requested times. */
+    LED_PATTERN_EVENT_FINISHED,
+    /* The pattern was stopped by a request. */
+    LED_PATTERN_EVENT_STOPPED,
+    /* The pattern was stopped so that another using the same LEDs could play. */
+    LED_PATTERN_EVENT_PREEMPTED
+};
+
 typedef struct led_ops_handle_st led_ops_handle;
 
 typedef led_ops_handle * (*led_ops_open_fn)(void * led_ops_context);
@@ -97,6 +164,7 @@ typedef void (*get_state_result_cb)(
 typedef bool (*led_ops_get_state_fn)(
     led_ops_handle * led_ops_handle,
     char const * led_name,
+    uint32_t led_id,
     get_state_result_cb result_cb,
     void * result_context);
 
@@ -110,6 +178,7 @@ typedef void (*activate_priority_result_cb)(
 typedef bool (*led_ops_activate_priority_fn)(
     led_ops_handle * led_ops_handle,
     char const * led_name,
+    uint32_t led_id,
     char const * led_priority,
     char const * lock_id,
     activate_priority_result_cb result_cb,
@@ -125,6 +194,7 @@ typedef void (*deactivate_priority_result_cb)(
 typedef bool (*led_ops_deactivate_priority_fn)(
     led_ops_handle * led_ops_handle,
     char const * led_name,
+    uint32_t led_id,
     char const * led_priority,
     char const * lock_id,
     deactivate_priority_result_cb result_cb,
@@ -171,6 +241,51 @@ typedef bool (*led_ops_compare_leds_fn)(
     char const * const led_b_name,
     char const * const led_b_priority);
 
+typedef void (*resolve_leds_cb)(
+    char const * led_name,
+    uint32_t led_id,
+    void * result_context);
+
+/* Returns the generation of the IDs passed to the callback. */
+typedef uint32_t (*led_ops_resolve_leds_fn)(
+    void * led_ops_context,
+    resolve_leds_cb result_cb,
+    void * result_context);
+
+typedef uint32_t (*led_ops_led_id_generation_fn)(void * led_ops_context);
+
+typedef void (*pattern_timing_cb)(
+    char const * pattern_name,
+    struct led_histogram_st const * lateness,
+    void * result_context);
+
+/* Report the lateness of the timers of each pattern that has played. */
+typedef void (*led_ops_pattern_timing_fn)(
+    void * led_ops_context,
+    pattern_timing_cb result_cb,
+    void * result_context);
+
+typedef void (*led_ops_pattern_timing_reset_fn)(void * led_ops_context);
+
+typedef bool (*led_ops_led_id_is_valid_fn)(
+    led_ops_handle * led_ops_handle,
+    uint32_t led_id);
+
+typedef void (*led_ops_get_changes_fn)(
+    void * led_ops_context,
+    uint32_t epoch,
+    uint32_t since_seq,
+    struct led_changes_info_st * info,
+    led_change_cb result_cb,
+    void * result_context);
+
+/* preempted_by is the name of the pattern that pre-empted this one, or NULL. */
+typedef void (*led_ops_pattern_event_fn)(
+    void * led_ops_context,
+    char const * pattern_name,
+    enum led_pattern_event_t event,
+    char const * preempted_by);
+
 struct led_ops_st
 {
     led_ops_open_fn open;
@@ -185,6 +300,13 @@ struct led_ops_st
     led_ops_play_pattern_fn play_pattern;
     led_ops_stop_pattern_fn stop_pattern;
     led_ops_compare_leds_fn compare_leds;
+    led_ops_resolve_leds_fn resolve_leds;
+    led_ops_led_id_generation_fn led_id_generation;
+    led_ops_led_id_is_valid_fn led_id_is_valid;
+    led_ops_get_changes_fn get_changes;
+    led_ops_pattern_event_fn pattern_event;
+    led_ops_pattern_timing_fn pattern_timing;
+    led_ops_pattern_timing_reset_fn pattern_timing_reset;
 };
 
 ledcmd_ctx_st *
@@ -192,7 +314,24 @@ ledcmd_init(
     char const * ubus_path,
     char const * patterns_directory,
     char const * aliases_directory,
-    char const * const backend_path);
+    char const * const backend_path,
+    char const * status_page_name,
+    char const * fast_path_socket);
+
+/*
+ * Initialise the LED control path with the given backend methods, but
+ * without the ubus, status page and fast path interfaces. Requests are made
+ * by calling the operations returned by ledcmd_control_ops() directly, so
+ * the control path can be benchmarked in-process. Free with ledcmd_deinit().
+ */
+ledcmd_ctx_st *
+ledcmd_control_init(
+    char const * patterns_directory,
+    char const * aliases_directory,
+    struct platform_led_methods_st const * methods);
+
+struct led_ops_st const *
+ledcmd_control_ops(void);
 
 void
 ledcmd_deinit(ledcmd_ctx_st * context);
@@ -15,8 +15,48 @@ ledcmd_ubus_init(
     struct led_ops_st const * const led_ops,
     void * const led_ops_context);
 
+/*
+ * Set up the ubus methods without connecting to ubus, so that their handlers
+ * can be called in-process with ledcmd_ubus_call(). Replies are passed to
+ * ubus_send_reply(), so the caller must supply its own (e.g. by linking with
+ * --wrap=ubus_send_reply). Free with ledcmd_ubus_deinit().
+ */
+ledcmd_ubus_context_st *
+ledcmd_ubus_init_unconnected(
+    struct led_ops_st const * const led_ops,
+    void * const led_ops_context);
+
+/*
+ * Call the handler of the named method as ubus would, with the request's
+ * message. Returns the handler's ubus status, or UBUS_STATUS_METHOD_NOT_FOUND
+ * if there is no such method.
+ */
+int
+ledcmd_ubus_call(
+    ledcmd_ubus_context_st * ledcmd_ubus_context,
+    char const * method,
+    struct blob_attr * msg);
+
 void
 ledcmd_ubus_deinit(ledcmd_ubus_context_st * ledcmd_ubus_context);
 
+/*
+ * Notify subscribers of the LEDs that changed in the most recent burst of
+ * requests. iterate is called to supply the changed LEDs.
+ */
+void
+ledcmd_ubus_notify_led_changes(
+    ledcmd_ubus_context_st * ledcmd_ubus_context,
+    uint32_t seq,
+    led_changes_iterate_fn iterate,
+    void * iterate_context);
+
+void
+ledcmd_ubus_send_pattern_event(
+    ledcmd_ubus_context_st * ledcmd_ubus_context,
+    char const * pattern_name,
+    enum led_pattern_event_t event,
+    char const * preempted_by);
+
 #endif /* LED_DAEMON_UBUS_H__ */
 
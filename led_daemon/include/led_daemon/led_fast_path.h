@@ -0,0 +1,25 @@
+#ifndef LED_FAST_PATH_H__
+#define LED_FAST_PATH_H__
+
+#include "led_control.h"
+
+/*
+ * A UNIX SOCK_SEQPACKET socket on which LED states may be set with binary
+ * frames (see lib_led/led_fast_path_layout.h) rather than ubus requests.
+ * The frames are applied with the same set_state operation as ubus "set"
+ * requests. Access is controlled by the socket's file mode, so only the
+ * owner and group of the daemon may connect.
+ */
+typedef struct led_fast_path_st led_fast_path_st;
+
+/* Returns NULL if socket_path is NULL or empty, or on failure. */
+led_fast_path_st *
+led_fast_path_create(
+    char const * socket_path,
+    struct led_ops_st const * led_ops,
+    void * led_ops_context);
+
+void
+led_fast_path_free(led_fast_path_st * fast_path);
+
+#endif /* LED_FAST_PATH_H__ */
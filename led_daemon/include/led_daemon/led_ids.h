@@ -0,0 +1,51 @@
+#ifndef LED_IDS_H__
+#define LED_IDS_H__
+
+#include "led_control.h"
+#include "led_aliases.h"
+
+#include <libubox/avl.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Numeric IDs for each LED and alias. IDs are assigned in order when the
+ * daemon starts, LEDs first and then aliases, and are never reassigned while
+ * it is running. An alias with the same name as an LED shares the LED's ID.
+ * The generation is derived from the names the IDs were assigned to, so a
+ * client may keep using IDs it has already resolved for as long as the
+ * generation reported by the daemon doesn't change.
+ */
+typedef struct led_ids_st led_ids_st;
+
+struct led_id_target_st
+{
+    char const * name;
+    /* Requests for aliases also report a result against the alias name. */
+    bool is_alias;
+    size_t num_leds;
+    struct led_ctx_st * * leds;
+};
+
+led_ids_st *
+led_ids_create(struct avl_tree * all_leds, led_aliases_st const * led_aliases);
+
+void
+led_ids_free(led_ids_st * led_ids);
+
+uint32_t
+led_ids_generation(led_ids_st const * led_ids);
+
+/* Returns NULL if led_id doesn't identify an LED or alias. */
+struct led_id_target_st const *
+led_ids_lookup(led_ids_st const * led_ids, uint32_t led_id);
+
+void
+led_ids_iterate(
+    led_ids_st const * led_ids,
+    void (*cb)(char const * name, uint32_t led_id, void * user_ctx),
+    void * user_ctx);
+
+#endif /* LED_IDS_H__ */
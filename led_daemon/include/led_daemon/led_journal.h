@@ -0,0 +1,28 @@
+#ifndef LED_JOURNAL_H__
+#define LED_JOURNAL_H__
+
+#include <libubox/blob.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define LED_JOURNAL_MAX_RECORDS_PER_WRITE 4096
+
+/*
+ * Open a journal of the incoming requests at the given path, appending to it
+ * if it already exists. Requests are collected in a preallocated buffer,
+ * which is appended to the file in one write per records_per_write requests
+ * (1 to LED_JOURNAL_MAX_RECORDS_PER_WRITE), or after a second if fewer arrive.
+ */
+bool
+led_journal_open(char const * path, size_t records_per_write);
+
+/* Append a request to the journal, if it is open. */
+void
+led_journal_record(char const * method, struct blob_attr const * msg);
+
+/* Write any buffered requests and close the journal. */
+void
+led_journal_close(void);
+
+#endif /* LED_JOURNAL_H__ */
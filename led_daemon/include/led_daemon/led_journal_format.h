@@ -0,0 +1,36 @@
+#ifndef LED_JOURNAL_FORMAT_H__
+#define LED_JOURNAL_FORMAT_H__
+
+#include <stdint.h>
+
+/*
+ * The layout of the request journal written by the daemon. All values are in
+ * host byte order. The file starts with a header, and each request follows as
+ * a record, then the method name (not NUL terminated), then the request's
+ * arguments as the blob_attr received from ubus (args_len may be 0).
+ * The daemon appends to an existing journal, and marks each time it reopens
+ * the journal with a record that has no method name or arguments, so
+ * timestamps are only comparable between markers.
+ */
+
+#define LED_JOURNAL_MAGIC 0x4a44454cU /* "LEDJ" */
+#define LED_JOURNAL_VERSION 2
+
+struct led_journal_header_st
+{
+    uint32_t magic;
+    uint32_t version;
+    /* CLOCK_MONOTONIC time at which the journal was opened. */
+    uint64_t start_ns;
+};
+
+struct led_journal_record_st
+{
+    /* CLOCK_MONOTONIC time at which the request was received. */
+    uint64_t timestamp_ns;
+    uint16_t method_len;
+    uint16_t reserved;
+    uint32_t args_len;
+};
+
+#endif /* LED_JOURNAL_FORMAT_H__ */
@@ -32,6 +32,15 @@ led_pattern_list_patterns(
     list_patterns_cb cb,
     void * user_ctx);
 
+void
+led_pattern_list_timing(
+    led_patterns_context_st * patterns_context,
+    pattern_timing_cb cb,
+    void * user_ctx);
+
+void
+led_pattern_reset_timing(led_patterns_context_st * patterns_context);
+
 void
 led_patterns_deinit(led_patterns_context_st * patterns_context);
 
@@ -40,7 +49,7 @@ led_patterns_deinit(led_patterns_context_st * patterns_context);
  * led_ops: callbacks for opening/getting/setting/closing LEDs
  * led_ops_context: The context to pass to led_ops->opn().
  * Returns: An opaque type to be passed when requesting a pattern to be played,
- * and when de-initialising.
+ * and when de-initialising, or NULL on failure.
  */
 led_patterns_context_st *
 led_patterns_init(
@@ -29,6 +29,8 @@ struct pattern_step_st
 struct led_pattern_st
 {
     char const * name;
+    /* Identifies the pattern among those loaded, from 0 to the count - 1. */
+    size_t index;
     bool repeat;
     unsigned play_count;
     size_t num_steps;
@@ -58,6 +60,9 @@ void
 led_pattern_list(
     led_patterns_st const * led_patterns, list_patterns_cb cb, void * user_ctx);
 
+size_t
+led_patterns_count(led_patterns_st const * led_patterns);
+
 void
 free_patterns(led_patterns_st const * led_patterns);
 
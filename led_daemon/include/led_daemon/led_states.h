@@ -27,5 +27,8 @@ led_state_query_name(enum led_state_t state);
 enum led_state_t
 led_state_by_query_name(char const * name);
 
+enum led_state_t
+led_state_by_value(int value);
+
 #endif /* LED_STATES_H__ */
 
@@ -0,0 +1,118 @@
+#ifndef LED_STATS_H__
+#define LED_STATS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Latency histograms with logarithmic buckets, in the style of HDR
+ * histograms. Each power of two range of values is divided into
+ * LED_HISTOGRAM_SUB_BUCKETS linear sub-buckets, so each bucket's width is at
+ * most 1/8 of the values it holds. Values of 2^LED_HISTOGRAM_MAX_BITS ns
+ * (about 17 seconds) or more are counted in the last bucket.
+ */
+#define LED_HISTOGRAM_SUB_BUCKET_BITS 3
+#define LED_HISTOGRAM_SUB_BUCKETS (1U << LED_HISTOGRAM_SUB_BUCKET_BITS)
+#define LED_HISTOGRAM_MAX_BITS 34
+#define LED_HISTOGRAM_BUCKETS \
+    ((LED_HISTOGRAM_MAX_BITS - LED_HISTOGRAM_SUB_BUCKET_BITS + 1) * LED_HISTOGRAM_SUB_BUCKETS)
+
+struct led_histogram_st
+{
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[LED_HISTOGRAM_BUCKETS];
+};
+
+/* The number of calls to an operation, how many failed, and how long they took. */
+struct led_call_stats_st
+{
+    uint64_t calls;
+    uint64_t errors;
+    struct led_histogram_st latency;
+};
+
+/*
+ * Counters maintained by the daemon's control path. The daemon is single
+ * threaded, so these are updated without locking.
+ */
+struct led_daemon_stats_st
+{
+    /* When the statistics were last reset. */
+    uint64_t reset_ns;
+    struct led_call_stats_st set_led_state;
+    struct led_call_stats_st get_led_state;
+    uint64_t flash_timer_firings;
+    uint64_t pattern_timer_firings;
+    uint64_t pattern_steps;
+    /* Writes to the backend skipped because a higher priority controls the LED. */
+    uint64_t write_elisions;
+    /* How long after their scheduled time the flash and pattern timers fired. */
+    struct led_histogram_st flash_lateness;
+    struct led_histogram_st pattern_lateness;
+};
+
+enum led_timer_kind_t
+{
+    LED_TIMER_FLASH,
+    LED_TIMER_PATTERN
+};
+
+extern struct led_daemon_stats_st led_daemon_stats;
+
+uint64_t
+led_stats_now_ns(void);
+
+void
+led_histogram_record(struct led_histogram_st * histogram, uint64_t value_ns);
+
+/* The exclusive upper bound of the values counted in the given bucket. */
+uint64_t
+led_histogram_bucket_limit_ns(size_t bucket);
+
+/*
+ * The upper bound of the bucket containing the given fraction (0 to 1) of the
+ * values recorded.
+ */
+uint64_t
+led_histogram_percentile_ns(struct led_histogram_st const * histogram, double fraction);
+
+void
+led_call_stats_record(
+    struct led_call_stats_st * call_stats, uint64_t start_ns, bool success);
+
+void
+led_daemon_stats_reset(void);
+
+/*
+ * Record that a timer due at scheduled_ns has fired. name is the LED or
+ * pattern the timer belongs to, and must remain valid while the daemon runs.
+ * Returns how late the timer was.
+ */
+uint64_t
+led_timer_fired(enum led_timer_kind_t kind, char const * name, uint64_t scheduled_ns);
+
+/*
+ * Keep the most recent num_records timer firings in a trace ring, so that
+ * they can be written to dump_path for offline analysis. The ring is disabled
+ * by default. The file is chosen when the daemon starts, rather than by the
+ * client requesting the dump, as the daemon may be able to write files that
+ * its clients can't.
+ */
+bool
+led_timer_trace_init(size_t num_records, char const * dump_path);
+
+void
+led_timer_trace_free(void);
+
+/*
+ * Write the timer firings in the trace ring to the dump file, oldest first,
+ * as comma separated values. Returns false if the ring is disabled, there is
+ * no dump file, or the file can't be written.
+ */
+bool
+led_timer_trace_dump(size_t * num_records);
+
+#endif /* LED_STATS_H__ */
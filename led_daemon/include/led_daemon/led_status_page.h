@@ -0,0 +1,40 @@
+#ifndef LED_STATUS_PAGE_H__
+#define LED_STATUS_PAGE_H__
+
+#include "led_control.h"
+
+#include <libubox/avl.h>
+
+#include <stdint.h>
+
+/*
+ * A shared memory segment in which the status of every LED is published, so
+ * that readers can obtain it without a ubus request. See
+ * lib_led/led_status_page_layout.h for the layout.
+ *
+ * Updates are made between led_status_page_write_begin() and
+ * led_status_page_write_end(), and are only seen by readers once complete.
+ * All functions accept a NULL page, so the caller needn't check whether the
+ * page was created.
+ */
+typedef struct led_status_page_st led_status_page_st;
+
+/* Assigns each LED in all_leds its index in the page. */
+led_status_page_st *
+led_status_page_create(
+    char const * name, struct avl_tree * all_leds, uint32_t epoch);
+
+void
+led_status_page_free(led_status_page_st * page);
+
+void
+led_status_page_write_begin(led_status_page_st * page);
+
+void
+led_status_page_update(
+    led_status_page_st * page, struct led_ctx_st const * led_ctx);
+
+void
+led_status_page_write_end(led_status_page_st * page, uint32_t change_seq);
+
+#endif /* LED_STATUS_PAGE_H__ */
@@ -0,0 +1,45 @@
+#ifndef LED_TRACE_H__
+#define LED_TRACE_H__
+
+/*
+ * Statically defined (USDT) tracepoints for use with perf, bpftrace and
+ * similar tools. They are compiled in when the daemon is built with
+ * LED_DAEMON_USDT defined (see the ENABLE_USDT_PROBES CMake option), and
+ * otherwise compile to nothing, so the arguments aren't evaluated.
+ *
+ * All probes are in the "ledcmd" provider:
+ * method_entry(method)
+ * method_exit(method, ubus status, latency ns)
+ * set_state(LED name, state, priority, flash type)
+ * priority_activate(LED name, priority)
+ * priority_deactivate(LED name, priority)
+ * backend_set(LED name, state, success)
+ * pattern_start(pattern name)
+ * pattern_step(pattern name, step number)
+ * pattern_stop(pattern name)
+ * led_lock(LED name, lock ID, success)
+ * led_unlock(LED name, lock ID, success)
+ * States and priorities are the values of enum led_state_t and
+ * enum led_priority_t. set_state fires once the request's priority has been
+ * resolved, and reports the priority that the request updates.
+ */
+
+#ifdef LED_DAEMON_USDT
+
+#include <sys/sdt.h>
+
+#define LED_TRACE1(probe, a) DTRACE_PROBE1(ledcmd, probe, a)
+#define LED_TRACE2(probe, a, b) DTRACE_PROBE2(ledcmd, probe, a, b)
+#define LED_TRACE3(probe, a, b, c) DTRACE_PROBE3(ledcmd, probe, a, b, c)
+#define LED_TRACE4(probe, a, b, c, d) DTRACE_PROBE4(ledcmd, probe, a, b, c, d)
+
+#else
+
+#define LED_TRACE1(probe, a) do { } while (0)
+#define LED_TRACE2(probe, a, b) do { } while (0)
+#define LED_TRACE3(probe, a, b, c) do { } while (0)
+#define LED_TRACE4(probe, a, b, c, d) do { } while (0)
+
+#endif
+
+#endif /* LED_TRACE_H__ */
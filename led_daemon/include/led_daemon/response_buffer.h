@@ -0,0 +1,35 @@
+#ifndef RESPONSE_BUFFER_H__
+#define RESPONSE_BUFFER_H__
+
+#include <libubox/blob.h>
+
+#include <stddef.h>
+
+/*
+ * A blob_buf that is reset rather than freed between responses. The memory
+ * backing the buffer only grows when a response is larger than any previous
+ * response (the high-water mark), so in steady state building a response
+ * requires no heap allocations.
+ */
+struct response_buffer_st
+{
+    struct blob_buf buf;
+    /* The size of the largest response built in this buffer. */
+    size_t high_water;
+    /* The number of times the backing memory has been (re)allocated. */
+    size_t allocations;
+};
+
+void
+response_buffer_init(struct response_buffer_st * response_buffer, size_t initial_size);
+
+struct blob_buf *
+response_buffer_reset(struct response_buffer_st * response_buffer);
+
+void
+response_buffer_done(struct response_buffer_st * response_buffer);
+
+void
+response_buffer_free(struct response_buffer_st * response_buffer);
+
+#endif /* RESPONSE_BUFFER_H__ */
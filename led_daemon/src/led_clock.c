@@ -0,0 +1,209 @@
+#include "led_clock.h"
+
+#include <ubus_utils/ubus_utils.h>
+
+#include <time.h>
+
+struct led_clock_ops_st
+{
+    uint64_t (*now_ns)(void);
+    void (*timer_set)(struct led_timer_st * timer, uint32_t time_ms);
+};
+
+struct virtual_clock_st
+{
+    uint64_t now_ns;
+    uint64_t next_seq;
+    /* The pending timers, ordered by expiry time. */
+    struct avl_tree timers;
+    bool initialised;
+};
+
+static struct virtual_clock_st virtual_clock;
+
+static uint64_t
+real_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void
+real_timeout_cb(struct uloop_timeout * const timeout)
+{
+    struct led_timer_st * const timer = container_of(timeout, struct led_timer_st, timeout);
+
+    timer->cb(timer);
+}
+
+static void
+real_timer_set(struct led_timer_st * const timer, uint32_t const time_ms)
+{
+    timer->timeout.cb = real_timeout_cb;
+    uloop_timeout_set(&timer->timeout, time_ms);
+}
+
+static uint64_t
+virtual_now_ns(void)
+{
+    return virtual_clock.now_ns;
+}
+
+static int
+compare_timers(void const * const k1, void const * const k2, void * const ptr)
+{
+    struct led_timer_st const * const a = k1;
+    struct led_timer_st const * const b = k2;
+
+    UNUSED_ARG(ptr);
+
+    if (a->expires_ns != b->expires_ns)
+    {
+        return (a->expires_ns > b->expires_ns) - (a->expires_ns < b->expires_ns);
+    }
+
+    return (a->seq > b->seq) - (a->seq < b->seq);
+}
+
+static void
+virtual_timer_cancel(struct led_timer_st * const timer)
+{
+    if (timer->pending)
+    {
+        avl_delete(&virtual_clock.timers, &timer->node);
+        timer->pending = false;
+    }
+}
+
+static void
+virtual_timer_set(struct led_timer_st * const timer, uint32_t const time_ms)
+{
+    virtual_timer_cancel(timer);
+
+    timer->expires_ns = virtual_clock.now_ns + (uint64_t)time_ms * 1000000ULL;
+    timer->seq = virtual_clock.next_seq++;
+    timer->node.key = timer;
+    avl_insert(&virtual_clock.timers, &timer->node);
+    timer->pending = true;
+}
+
+static struct led_clock_ops_st const real_clock_ops =
+{
+    .now_ns = real_now_ns,
+    .timer_set = real_timer_set
+};
+
+static struct led_clock_ops_st const virtual_clock_ops =
+{
+    .now_ns = virtual_now_ns,
+    .timer_set = virtual_timer_set
+};
+
+static struct led_clock_ops_st const * clock_ops = &real_clock_ops;
+
+void
+led_timer_init(struct led_timer_st * const timer, led_timer_cb const cb)
+{
+    timer->cb = cb;
+}
+
+void
+led_timer_set(struct led_timer_st * const timer, uint32_t const time_ms)
+{
+    clock_ops->timer_set(timer, time_ms);
+}
+
+/* Timers are cancelled with either clock, in case the clock was switched after they were set. */
+void
+led_timer_cancel(struct led_timer_st * const timer)
+{
+    uloop_timeout_cancel(&timer->timeout);
+    virtual_timer_cancel(timer);
+}
+
+bool
+led_timer_pending(struct led_timer_st const * const timer)
+{
+    return timer->timeout.pending || timer->pending;
+}
+
+uint64_t
+led_clock_now_ns(void)
+{
+    return clock_ops->now_ns();
+}
+
+bool
+led_clock_use_virtual(bool const use_virtual)
+{
+    bool success;
+
+    if (!virtual_clock.initialised)
+    {
+        avl_init(&virtual_clock.timers, compare_timers, false, NULL);
+        virtual_clock.initialised = true;
+    }
+
+    if (use_virtual == led_clock_is_virtual())
+    {
+        success = true;
+        goto done;
+    }
+
+    /* Timers can't be moved from one clock to the other. */
+    if (!avl_is_empty(&virtual_clock.timers))
+    {
+        success = false;
+        goto done;
+    }
+
+    virtual_clock.now_ns = real_now_ns();
+    clock_ops = use_virtual ? &virtual_clock_ops : &real_clock_ops;
+    success = true;
+
+done:
+    return success;
+}
+
+bool
+led_clock_is_virtual(void)
+{
+    return clock_ops == &virtual_clock_ops;
+}
+
+size_t
+led_clock_advance(uint64_t const ns)
+{
+    size_t fired = 0;
+    uint64_t const target_ns = virtual_clock.now_ns + ns;
+
+    if (!led_clock_is_virtual())
+    {
+        goto done;
+    }
+
+    while (!avl_is_empty(&virtual_clock.timers))
+    {
+        struct led_timer_st * const timer =
+            avl_first_element(&virtual_clock.timers, timer, node);
+
+        if (timer->expires_ns > target_ns)
+        {
+            break;
+        }
+
+        avl_delete(&virtual_clock.timers, &timer->node);
+        timer->pending = false;
+        virtual_clock.now_ns = timer->expires_ns;
+        timer->cb(timer);
+        fired++;
+    }
+
+    virtual_clock.now_ns = target_ns;
+
+done:
+    return fired;
+}
@@ -0,0 +1,466 @@
+#include "led_command_ring.h"
+#include "flash_types.h"
+#include "led_states.h"
+
+#include <lib_log/log.h>
+#include <ubus_utils/ubus_utils.h>
+
+#include <libubox/uloop.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * The number of times the ring is drained in one wakeup before yielding to
+ * the other uloop users. If records remain, the daemon wakes itself.
+ */
+#define MAX_DRAIN_PASSES 4
+
+/* The most recent record for an LED in the records being drained. */
+struct coalesce_slot_st
+{
+    uint32_t stamp;
+    uint32_t led_id;
+    uint32_t state;
+    uint64_t timestamp_ns;
+};
+
+struct led_command_ring_st
+{
+    struct led_ops_st const * led_ops;
+    void * led_ops_context;
+    char priority[LED_FAST_PATH_PRIORITY_LEN];
+    char lock_id[LED_FAST_PATH_LOCK_ID_LEN];
+
+    int memfd;
+    struct uloop_fd event;
+    struct led_command_ring_header_st * header;
+    size_t size;
+    /*
+     * The producer can write to all of the shared memory, so the daemon
+     * keeps its own copies of the fields it relies on.
+     */
+    uint32_t mask;
+    uint32_t tail;
+    uint32_t generation;
+
+    /*
+     * A hash of LED IDs, twice the size of the ring, so that it never fills.
+     * Slots are only valid if their stamp matches the current one, which
+     * saves clearing them for each drain.
+     */
+    struct coalesce_slot_st * slots;
+    uint32_t slot_mask;
+    uint32_t stamp;
+    /* The slots used by the current drain, in the order they were filled. */
+    uint32_t * used_slots;
+    uint32_t num_used_slots;
+};
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t
+ring_size_for_request(uint32_t const requested)
+{
+    uint32_t num_records = LED_COMMAND_RING_MIN_RECORDS;
+
+    while (num_records < requested && num_records < LED_COMMAND_RING_MAX_RECORDS)
+    {
+        num_records <<= 1;
+    }
+
+    return num_records;
+}
+
+static void
+copy_request_string(char * const dest, size_t const dest_size, char const * const src)
+{
+    /* Don't trust the producer to have terminated the string. */
+    memcpy(dest, src, dest_size);
+    dest[dest_size - 1] = '\0';
+}
+
+static unsigned
+latency_bucket(uint64_t const latency_ns)
+{
+    unsigned const bucket =
+        (latency_ns == 0) ? 0 : 64 - (unsigned)__builtin_clzll(latency_ns);
+
+    return (bucket < LED_COMMAND_RING_LATENCY_BUCKETS)
+           ? bucket
+           : LED_COMMAND_RING_LATENCY_BUCKETS - 1;
+}
+
+/* The statistics have a single writer, so relaxed stores are sufficient. */
+#define stat_add(field, value) \
+    __atomic_store_n(&(field), (field) + (value), __ATOMIC_RELAXED)
+
+static void
+record_latency(struct led_command_ring_consumer_st * const consumer, uint64_t const latency_ns)
+{
+    stat_add(consumer->latency_count, 1);
+    stat_add(consumer->latency_total_ns, latency_ns);
+    stat_add(consumer->latency_buckets[latency_bucket(latency_ns)], 1);
+    if (latency_ns > consumer->latency_max_ns)
+    {
+        __atomic_store_n(&consumer->latency_max_ns, latency_ns, __ATOMIC_RELAXED);
+    }
+}
+
+static struct coalesce_slot_st *
+coalesce_slot_find(struct led_command_ring_st * const ring, uint32_t const led_id, bool * const found)
+{
+    /* Knuth's multiplicative hash spreads the sequential IDs. */
+    uint32_t index = (led_id * 2654435761u) & ring->slot_mask;
+
+    while (ring->slots[index].stamp == ring->stamp && ring->slots[index].led_id != led_id)
+    {
+        index = (index + 1) & ring->slot_mask;
+    }
+
+    struct coalesce_slot_st * const slot = &ring->slots[index];
+
+    *found = slot->stamp == ring->stamp;
+    if (!*found)
+    {
+        slot->stamp = ring->stamp;
+        slot->led_id = led_id;
+        ring->used_slots[ring->num_used_slots++] = index;
+    }
+
+    return slot;
+}
+
+static void
+coalesce_begin(struct led_command_ring_st * const ring)
+{
+    ring->stamp++;
+    if (ring->stamp == 0)
+    {
+        memset(ring->slots, 0, (ring->slot_mask + 1) * sizeof *ring->slots);
+        ring->stamp = 1;
+    }
+    ring->num_used_slots = 0;
+}
+
+static bool
+record_is_valid(struct led_command_record_st const * const record)
+{
+    return record->led_id != LED_ID_NONE
+           && record->state >= LED_FAST_PATH_STATE_OFF
+           && record->state <= LED_FAST_PATH_STATE_FAST_FLASH;
+}
+
+static void
+collect_records(struct led_command_ring_st * const ring, uint32_t const tail, uint32_t const head)
+{
+    struct led_command_ring_consumer_st * const consumer = &ring->header->consumer;
+
+    for (uint32_t pos = tail; pos != head; pos++)
+    {
+        struct led_command_record_st const record = ring->header->records[pos & ring->mask];
+
+        if (!record_is_valid(&record))
+        {
+            stat_add(consumer->records_invalid, 1);
+            continue;
+        }
+
+        bool found;
+        struct coalesce_slot_st * const slot = coalesce_slot_find(ring, record.led_id, &found);
+
+        if (found)
+        {
+            stat_add(consumer->records_coalesced, 1);
+        }
+        slot->state = record.state;
+        slot->timestamp_ns = record.timestamp_ns;
+    }
+}
+
+static void
+set_state_result_ignored(
+    char const * const led_name,
+    bool const success,
+    char const * const state,
+    char const * const error_msg,
+    void * const user_context)
+{
+    UNUSED_ARG(led_name);
+    UNUSED_ARG(success);
+    UNUSED_ARG(state);
+    UNUSED_ARG(error_msg);
+    UNUSED_ARG(user_context);
+}
+
+static void
+apply_records(struct led_command_ring_st * const ring)
+{
+    struct led_command_ring_consumer_st * const consumer = &ring->header->consumer;
+    struct led_ops_st const * const led_ops = ring->led_ops;
+    struct led_ops_handle_st * const led_ops_handle = led_ops->open(ring->led_ops_context);
+
+    if (led_ops_handle == NULL)
+    {
+        goto done;
+    }
+
+    struct set_state_req_st set_state_req =
+    {
+        .lock_id = (ring->lock_id[0] != '\0') ? ring->lock_id : NULL,
+        .led_priority = (ring->priority[0] != '\0') ? ring->priority : NULL,
+        .flash_type = LED_FLASH_TYPE_NONE
+    };
+
+    for (uint32_t i = 0; i < ring->num_used_slots; i++)
+    {
+        struct coalesce_slot_st const * const slot = &ring->slots[ring->used_slots[i]];
+
+        set_state_req.led_id = slot->led_id;
+        set_state_req.state = led_state_by_value(slot->state);
+        if (!led_ops->set_state(
+                led_ops_handle, &set_state_req, set_state_result_ignored, NULL))
+        {
+            stat_add(consumer->records_invalid, 1);
+            continue;
+        }
+
+        stat_add(consumer->records_applied, 1);
+        record_latency(consumer, monotonic_ns() - slot->timestamp_ns);
+    }
+
+done:
+    led_ops->close(led_ops_handle);
+}
+
+/* Returns true if the ring was empty once drained. */
+static bool
+drain_ring(struct led_command_ring_st * const ring)
+{
+    struct led_command_ring_header_st * const header = ring->header;
+    struct led_command_ring_consumer_st * const consumer = &header->consumer;
+    uint32_t const tail = ring->tail;
+    uint32_t const head = __atomic_load_n(&header->producer.head, __ATOMIC_ACQUIRE);
+    uint32_t const pending = head - tail;
+
+    if (pending > ring->mask + 1)
+    {
+        /*
+         * The producer has overwritten records that hadn't been read, or has
+         * moved head arbitrarily.
+         */
+        stat_add(consumer->overruns, 1);
+    }
+    else if (ring->generation != ring->led_ops->led_id_generation(ring->led_ops_context))
+    {
+        __atomic_store_n(&consumer->ids_stale, 1, __ATOMIC_RELAXED);
+        stat_add(consumer->records_invalid, pending);
+    }
+    else
+    {
+        coalesce_begin(ring);
+        collect_records(ring, tail, head);
+    }
+
+    /* Release the records before they are applied. */
+    ring->tail = head;
+    __atomic_store_n(&consumer->tail, head, __ATOMIC_RELEASE);
+    if (ring->num_used_slots > 0)
+    {
+        apply_records(ring);
+        ring->num_used_slots = 0;
+    }
+
+    /*
+     * Ask for a wakeup before checking for more records, so that a record
+     * queued after the check can't be missed.
+     */
+    __atomic_store_n(&header->wakeup_needed, 1, __ATOMIC_SEQ_CST);
+
+    return __atomic_load_n(&header->producer.head, __ATOMIC_SEQ_CST) == head;
+}
+
+static void
+event_cb(struct uloop_fd * const fd, unsigned int const events)
+{
+    UNUSED_ARG(events);
+
+    struct led_command_ring_st * const ring = container_of(fd, struct led_command_ring_st, event);
+    uint64_t count;
+
+    if (read(fd->fd, &count, sizeof count) < 0 && errno != EAGAIN)
+    {
+        log_error("Failed to read command ring eventfd: %m");
+    }
+
+    stat_add(ring->header->consumer.wakeups, 1);
+
+    for (size_t pass = 0; pass < MAX_DRAIN_PASSES; pass++)
+    {
+        if (drain_ring(ring))
+        {
+            goto done;
+        }
+    }
+
+    /* There are still records, so come back to them after servicing others. */
+    uint64_t const one = 1;
+
+    if (write(fd->fd, &one, sizeof one) < 0)
+    {
+        log_error("Failed to write command ring eventfd: %m");
+    }
+
+done:
+    return;
+}
+
+int
+led_command_ring_memfd(struct led_command_ring_st const * const ring)
+{
+    return ring->memfd;
+}
+
+int
+led_command_ring_eventfd(struct led_command_ring_st const * const ring)
+{
+    return ring->event.fd;
+}
+
+void
+led_command_ring_free(struct led_command_ring_st * const ring)
+{
+    if (ring == NULL)
+    {
+        goto done;
+    }
+
+    if (ring->event.fd >= 0)
+    {
+        uloop_fd_delete(&ring->event);
+        close(ring->event.fd);
+    }
+    if (ring->header != NULL)
+    {
+        munmap(ring->header, ring->size);
+    }
+    if (ring->memfd >= 0)
+    {
+        close(ring->memfd);
+    }
+    free(ring->slots);
+    free(ring->used_slots);
+    free(ring);
+
+done:
+    return;
+}
+
+led_command_ring_st *
+led_command_ring_create(
+    struct led_command_ring_request_st const * const request,
+    struct led_ops_st const * const led_ops,
+    void * const led_ops_context)
+{
+    bool success;
+    struct led_command_ring_st * ring = NULL;
+
+    if (request->magic != LED_COMMAND_RING_MAGIC
+        || request->version != LED_COMMAND_RING_VERSION)
+    {
+        success = false;
+        goto done;
+    }
+
+    ring = calloc(1, sizeof *ring);
+    if (ring == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    ring->memfd = -1;
+    ring->event.fd = -1;
+    ring->led_ops = led_ops;
+    ring->led_ops_context = led_ops_context;
+    copy_request_string(ring->priority, sizeof ring->priority, request->priority);
+    copy_request_string(ring->lock_id, sizeof ring->lock_id, request->lock_id);
+
+    uint32_t const num_records = ring_size_for_request(request->num_records);
+
+    ring->mask = num_records - 1;
+    ring->slot_mask = 2 * num_records - 1;
+    ring->slots = calloc(2 * num_records, sizeof *ring->slots);
+    ring->used_slots = calloc(num_records, sizeof *ring->used_slots);
+    ring->size =
+        sizeof *ring->header + num_records * sizeof ring->header->records[0];
+    ring->memfd = memfd_create("ledcmd_command_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+    /*
+     * The ring is sealed at its size before it is passed to the producer, so
+     * that the producer can't truncate it and fault the daemon's accesses.
+     */
+    if (ring->slots == NULL
+        || ring->used_slots == NULL
+        || ring->memfd < 0
+        || ftruncate(ring->memfd, ring->size) < 0
+        || fcntl(ring->memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+    {
+        log_error("Failed to create command ring: %m");
+        success = false;
+        goto done;
+    }
+
+    void * const base =
+        mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->memfd, 0);
+
+    if (base == MAP_FAILED)
+    {
+        log_error("Failed to map command ring: %m");
+        success = false;
+        goto done;
+    }
+
+    ring->header = base;
+    ring->header->magic = LED_COMMAND_RING_MAGIC;
+    ring->header->version = LED_COMMAND_RING_VERSION;
+    ring->header->num_records = num_records;
+    ring->generation = led_ops->led_id_generation(led_ops_context);
+    ring->header->generation = ring->generation;
+    ring->header->wakeup_needed = 1;
+
+    ring->event.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ring->event.fd < 0)
+    {
+        log_error("Failed to create command ring eventfd: %m");
+        success = false;
+        goto done;
+    }
+    ring->event.cb = event_cb;
+    uloop_fd_add(&ring->event, ULOOP_READ);
+
+    success = true;
+
+done:
+    if (!success)
+    {
+        led_command_ring_free(ring);
+        ring = NULL;
+    }
+
+    return ring;
+}
@@ -3,6 +3,11 @@
 #include "led_lock.h"
 #include "led_pattern_control.h"
 #include "led_aliases.h"
+#include "led_ids.h"
+#include "led_fast_path.h"
+#include "led_stats.h"
+#include "led_status_page.h"
+#include "led_trace.h"
 #include "platform_leds_plugin.h"
 
 #include <lib_led/string_constants.h>
@@ -11,6 +16,45 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * The number of led_ops handles that may be open at once. Handles are only
+ * held for the duration of a single request or pattern step, so nesting depth
+ * rather than request rate determines how many are needed.
+ */
+#define LED_OPS_HANDLE_POOL_SIZE 8
+
+/*
+ * The number of LED changes retained so that clients can catch up with the
+ * changes made since they last synchronised. Clients that fall further behind
+ * than this must fetch the status of all LEDs.
+ */
+#define LED_CHANGE_HISTORY_SIZE 256
+
+struct led_change_record_st
+{
+    uint32_t seq;
+    struct led_ctx_st * led_ctx;
+};
+
+struct led_change_history_st
+{
+    struct led_change_record_st records[LED_CHANGE_HISTORY_SIZE];
+    size_t next;
+    size_t count;
+    /* Changes up to and including this sequence number may have been lost. */
+    uint32_t lost_seq;
+};
+
+struct led_ops_handle_st
+{
+    struct led_ops_handle_st * next_free;
+    struct ledcmd_ctx_st * ledcmd_context;
+    led_handle_st * led_handle;
+};
 
 struct ledcmd_ctx_st
 {
@@ -22,6 +66,23 @@ struct ledcmd_ctx_st
     struct platform_led_methods_st const * methods;
     struct led_patterns_context_st * patterns_context;
     led_aliases_st const * led_aliases;
+    led_ids_st * led_ids;
+
+    /*
+     * LEDs that may have changed are collected while requests are handled,
+     * and checked from a timer that expires on the next uloop iteration, so a
+     * burst of requests results in a single notification.
+     */
+    struct list_head changed_leds;
+    struct uloop_timeout notify_timer;
+    uint32_t change_seq;
+    uint32_t epoch;
+    struct led_change_history_st change_history;
+    led_status_page_st * status_page;
+    led_fast_path_st * fast_path;
+
+    struct led_ops_handle_st * free_led_ops_handles;
+    struct led_ops_handle_st led_ops_handles[LED_OPS_HANDLE_POOL_SIZE];
 };
 
 static void
@@ -40,6 +101,139 @@ done:
     return;
 }
 
+static void
+led_ctx_get_status(
+    struct led_ctx_st const * const led_ctx, struct led_status_st * const status)
+{
+    enum led_priority_t const priority =
+        led_priority_highest_priority(led_ctx->priority_context);
+
+    status->state = led_ctx->priorities[priority].requested_state;
+    status->priority = priority;
+    status->locked = led_ctx->lock_id != NULL;
+}
+
+static bool
+led_status_equal(
+    struct led_status_st const * const a, struct led_status_st const * const b)
+{
+    return a->state == b->state && a->priority == b->priority && a->locked == b->locked;
+}
+
+static void
+led_ctx_mark_changed(
+    struct ledcmd_ctx_st * const context, struct led_ctx_st * const led_ctx)
+{
+    if (list_empty(&led_ctx->changed_node))
+    {
+        list_add_tail(&led_ctx->changed_node, &context->changed_leds);
+    }
+    if (!context->notify_timer.pending)
+    {
+        uloop_timeout_set(&context->notify_timer, 0);
+    }
+}
+
+static void
+led_change_history_add(
+    struct led_change_history_st * const history,
+    uint32_t const seq,
+    struct led_ctx_st * const led_ctx)
+{
+    struct led_change_record_st * const record = &history->records[history->next];
+
+    if (history->count == ARRAY_SIZE(history->records))
+    {
+        history->lost_seq = record->seq;
+    }
+    else
+    {
+        history->count++;
+    }
+
+    record->seq = seq;
+    record->led_ctx = led_ctx;
+    history->next = (history->next + 1) % ARRAY_SIZE(history->records);
+}
+
+static void
+iterate_changed_leds(
+    void * const iterate_context,
+    led_change_cb const result_cb,
+    void * const result_context)
+{
+    struct list_head * const changed = iterate_context;
+    struct led_ctx_st * led_ctx;
+
+    list_for_each_entry(led_ctx, changed, changed_node)
+    {
+        result_cb(led_ctx->node.key, &led_ctx->notified_status, result_context);
+    }
+}
+
+static void
+flush_led_changes(struct ledcmd_ctx_st * const context)
+{
+    LIST_HEAD(changed);
+    uint32_t const seq = context->change_seq + 1;
+    struct led_ctx_st * led_ctx;
+    struct led_ctx_st * tmp;
+
+    /*
+     * An LED may have been changed and then changed back within the burst, so
+     * only those whose status differs from the last one notified are
+     * included.
+     */
+    list_for_each_entry_safe(led_ctx, tmp, &context->changed_leds, changed_node)
+    {
+        struct led_status_st status;
+
+        led_ctx_get_status(led_ctx, &status);
+        list_del_init(&led_ctx->changed_node);
+        if (!led_status_equal(&status, &led_ctx->notified_status))
+        {
+            led_ctx->notified_status = status;
+            led_ctx->last_changed_seq = seq;
+            led_change_history_add(&context->change_history, seq, led_ctx);
+            list_add_tail(&led_ctx->changed_node, &changed);
+        }
+    }
+
+    if (list_empty(&changed))
+    {
+        goto done;
+    }
+
+    context->change_seq = seq;
+
+    led_status_page_write_begin(context->status_page);
+    list_for_each_entry(led_ctx, &changed, changed_node)
+    {
+        led_status_page_update(context->status_page, led_ctx);
+    }
+    led_status_page_write_end(context->status_page, seq);
+
+    ledcmd_ubus_notify_led_changes(
+        context->ubus_context, seq, iterate_changed_leds, &changed);
+
+    list_for_each_entry_safe(led_ctx, tmp, &changed, changed_node)
+    {
+        list_del_init(&led_ctx->changed_node);
+    }
+
+done:
+    return;
+}
+
+static void
+led_changes_timeout(struct uloop_timeout * const timeout)
+{
+    struct ledcmd_ctx_st * const context =
+        container_of(timeout, struct ledcmd_ctx_st, notify_timer);
+
+    flush_led_changes(context);
+}
+
 static void
 update_flash_timer(struct flash_context_st * const flash_ctx)
 {
@@ -47,14 +241,46 @@ update_flash_timer(struct flash_context_st * const flash_ctx)
 
     if (timer_required)
     {
-        uloop_timeout_set(&flash_ctx->timer, flash_ctx->current_time);
+        flash_ctx->scheduled_ns =
+            led_clock_now_ns() + (uint64_t)flash_ctx->current_time * 1000000ULL;
+        led_timer_set(&flash_ctx->timer, flash_ctx->current_time);
     }
     else
     {
-        uloop_timeout_cancel(&flash_ctx->timer);
+        led_timer_cancel(&flash_ctx->timer);
     }
 }
 
+static bool
+backend_set_led_state(
+    struct platform_led_methods_st const * const methods,
+    led_handle_st * const led_handle,
+    led_st * const led,
+    enum led_state_t const state)
+{
+    uint64_t const start_ns = led_stats_now_ns();
+    bool const success = methods->set_led_state(led_handle, led, state);
+
+    led_call_stats_record(&led_daemon_stats.set_led_state, start_ns, success);
+    LED_TRACE3(backend_set, methods->get_led_name(led), state, success);
+
+    return success;
+}
+
+static enum led_state_t
+backend_get_led_state(
+    struct platform_led_methods_st const * const methods,
+    led_handle_st * const led_handle,
+    led_st const * const led)
+{
+    uint64_t const start_ns = led_stats_now_ns();
+    enum led_state_t const state = methods->get_led_state(led_handle, led);
+
+    led_call_stats_record(&led_daemon_stats.get_led_state, start_ns, true);
+
+    return state;
+}
+
 static bool
 set_state(
     struct platform_led_methods_st const * const methods,
@@ -75,8 +301,12 @@ set_state(
         == PRIORITY_LESS;
     bool const state_set =
         priority_is_less
-        || methods->set_led_state(led_handle, led_ctx->led, state);
+        || backend_set_led_state(methods, led_handle, led_ctx->led, state);
 
+    if (priority_is_less)
+    {
+        led_daemon_stats.write_elisions++;
+    }
     if (state_set)
     {
         led_priority_ctx->state = state;
@@ -103,6 +333,9 @@ led_ctx_activate_priority(
     enum led_priority_t const priority)
 {
     bool priority_set;
+
+    LED_TRACE2(priority_activate, led_ctx->node.key, priority);
+
     enum led_priority_t const highest_priority =
         led_priority_priority_activate(led_ctx->priority_context, priority);
     struct led_state_context_st * const led_priority_ctx =
@@ -115,6 +348,7 @@ led_ctx_activate_priority(
     if (should_turn_led_off)
     {
         led_priority_ctx->state = LED_OFF;
+        led_priority_ctx->requested_state = LED_OFF;
         stop_flashing(&led_priority_ctx->flash);
     }
 
@@ -137,6 +371,8 @@ led_ctx_deactivate_priority(
     led_handle_st * const led_handle,
     enum led_priority_t const priority)
 {
+    LED_TRACE2(priority_deactivate, led_ctx->node.key, priority);
+
     enum led_priority_t const new_highest_priority =
         led_priority_priority_deactivate(led_ctx->priority_context, priority);
 
@@ -271,11 +507,20 @@ update_flashing(struct flash_context_st * const flash_ctx)
 }
 
 static void
-led_flash_timeout(struct uloop_timeout * const timeout)
+led_flash_timeout(struct led_timer_st * const timer)
 {
     struct flash_context_st * const flash_ctx =
-        container_of(timeout, struct flash_context_st, timer);
-
+        container_of(timer, struct flash_context_st, timer);
+    struct led_state_context_st const * const led_priority_ctx =
+        container_of(flash_ctx, struct led_state_context_st, flash);
+    struct led_ctx_st const * const led_ctx =
+        container_of(led_priority_ctx,
+                     struct led_ctx_st,
+                     priorities[led_priority_ctx->priority]);
+
+    led_daemon_stats.flash_timer_firings++;
+    led_timer_fired(
+        LED_TIMER_FLASH, flash_ctx->methods->get_led_name(led_ctx->led), flash_ctx->scheduled_ns);
     update_flash_time_remaining(flash_ctx);
     update_flashing(flash_ctx);
 }
@@ -290,7 +535,7 @@ initialise_flashing(
     enum led_state_t initial_state;
 
     flash_ctx->methods = methods;
-    flash_ctx->timer.cb = led_flash_timeout;
+    led_timer_init(&flash_ctx->timer, led_flash_timeout);
     flash_ctx->final_state =
         (request->state != LED_STATE_UNKNOWN) ? request->state : LED_ON;
 
@@ -346,6 +591,13 @@ led_ctx_set_state(
         goto done;
     }
 
+    LED_TRACE4(
+        set_state,
+        led_ctx->node.key,
+        request_in->state,
+        priority_to_update,
+        request_in->flash_type);
+
     /*
      * If the requested state isn't supported by the platform, map it to one of
      * the flash types supported by this daemon.
@@ -376,6 +628,9 @@ led_ctx_set_state(
         goto done;
     }
 
+    led_priority_ctx->requested_state = request_in->state;
+    led_ctx_mark_changed(context, led_ctx);
+
     success = true;
 
 done:
@@ -388,6 +643,56 @@ ledcmd_ctx_any_led_locked(struct ledcmd_ctx_st * const context)
     return led_ctx_any_led_locked(&context->all_leds);
 }
 
+static void
+led_ctx_activate(
+    struct ledcmd_ctx_st * const context,
+    struct led_ctx_st * const led_ctx,
+    led_handle_st * const led_handle,
+    char const * const led_name,
+    enum led_priority_t const priority,
+    char const * const lock_id,
+    activate_priority_result_cb const result_cb,
+    void * const result_context)
+{
+    char const * error_msg = NULL;
+    bool const locked =
+        (priority != LED_PRIORITY_LOCKED)
+        || led_ctx_lock_led(led_ctx, lock_id, &error_msg);
+
+    if (locked)
+    {
+        led_ctx_activate_priority(context->methods, led_ctx, led_handle, priority);
+        led_ctx_mark_changed(context, led_ctx);
+    }
+
+    result_cb(led_name, locked, led_ctx->lock_id, error_msg, result_context);
+}
+
+static void
+led_ctx_deactivate(
+    struct ledcmd_ctx_st * const context,
+    struct led_ctx_st * const led_ctx,
+    led_handle_st * const led_handle,
+    char const * const led_name,
+    enum led_priority_t const priority,
+    char const * const lock_id,
+    deactivate_priority_result_cb const result_cb,
+    void * const result_context)
+{
+    char const * error_msg = NULL;
+    bool const unlocked =
+        priority != LED_PRIORITY_LOCKED
+        || led_ctx_unlock_led(led_ctx, lock_id, &error_msg);
+
+    if (unlocked)
+    {
+        led_ctx_deactivate_priority(context->methods, led_ctx, led_handle, priority);
+        led_ctx_mark_changed(context, led_ctx);
+    }
+
+    result_cb(led_name, unlocked, led_ctx->lock_id, error_msg, result_context);
+}
+
 static void
 append_led_state(
     led_handle_st * const led_handle,
@@ -404,7 +709,7 @@ append_led_state(
     enum led_priority_t const current_priority =
         led_priority_highest_priority(led_ctx->priority_context);
     enum led_state_t const physical_led_state =
-        methods->get_led_state(led_handle, led);
+        backend_get_led_state(methods, led_handle, led);
     enum led_state_t const led_state =
         (physical_led_state == LED_STATE_UNKNOWN)
         ? led_ctx->priorities[current_priority].state
@@ -573,11 +878,10 @@ led_alias_deactivate_cb(char const * const led_name, void * user_ctx)
 {
     struct activate_alias_st const * const activate_alias = user_ctx;
     struct ledcmd_ctx_st * const context = activate_alias->context;
-    struct platform_led_methods_st const * const methods = context->methods;
     led_handle_st * const led_handle = activate_alias->led_handle;
     enum led_priority_t const priority = activate_alias->priority;
     char const * const lock_id = activate_alias->lock_id;
-    set_state_result_cb result_cb = activate_alias->result_cb;
+    activate_priority_result_cb const result_cb = activate_alias->result_cb;
     void * result_context = activate_alias->result_context;
     struct led_ctx_st * const led_ctx =
         avl_find_element(&context->all_leds, led_name, led_ctx, node);
@@ -591,17 +895,8 @@ led_alias_deactivate_cb(char const * const led_name, void * user_ctx)
         goto done;
     }
 
-    char const * error_msg = NULL;
-    bool const unlocked =
-        priority != LED_PRIORITY_LOCKED
-        || led_ctx_unlock_led(led_ctx, lock_id, &error_msg);
-
-    if (unlocked)
-    {
-        led_ctx_deactivate_priority(methods, led_ctx, led_handle, priority);
-    }
-
-    result_cb(led_name, unlocked, led_ctx->lock_id, error_msg, result_context);
+    led_ctx_deactivate(
+        context, led_ctx, led_handle, led_name, priority, lock_id, result_cb, result_context);
 
 done:;
     bool const continue_iteration = true;
@@ -645,11 +940,10 @@ led_alias_activate_cb(char const * const led_name, void * user_ctx)
 {
     struct activate_alias_st const * const activate_alias = user_ctx;
     struct ledcmd_ctx_st * const context = activate_alias->context;
-    struct platform_led_methods_st const * const methods = context->methods;
     led_handle_st * const led_handle = activate_alias->led_handle;
     enum led_priority_t const priority = activate_alias->priority;
     char const * const lock_id = activate_alias->lock_id;
-    set_state_result_cb result_cb = activate_alias->result_cb;
+    activate_priority_result_cb const result_cb = activate_alias->result_cb;
     void * result_context = activate_alias->result_context;
     struct led_ctx_st * const led_ctx =
         avl_find_element(&context->all_leds, led_name, led_ctx, node);
@@ -663,16 +957,8 @@ led_alias_activate_cb(char const * const led_name, void * user_ctx)
         goto done;
     }
 
-    char const * error_msg = NULL;
-    bool const locked =
-        (priority != LED_PRIORITY_LOCKED) || led_ctx_lock_led(led_ctx, lock_id, &error_msg);
-
-    if (locked)
-    {
-        led_ctx_activate_priority(methods, led_ctx, led_handle, priority);
-    }
-
-    result_cb(led_name, locked, led_ctx->lock_id, error_msg, result_context);
+    led_ctx_activate(
+        context, led_ctx, led_handle, led_name, priority, lock_id, result_cb, result_context);
 
 done:;
     bool const continue_iteration = true;
@@ -904,12 +1190,6 @@ done:
     return found_match;
 }
 
-struct led_ops_handle_st
-{
-    struct ledcmd_ctx_st * ledcmd_context;
-    led_handle_st * led_handle;
-};
-
 static bool
 led_ops_compare_leds(
     void * const led_ops_context,
@@ -986,6 +1266,96 @@ done:
     return leds_match;
 }
 
+/*
+ * The following functions handle requests that identify the LEDs by ID. The
+ * LEDs an ID refers to were looked up when the IDs were assigned, so there is
+ * no need to look them up by name again.
+ */
+static void
+set_target_states(
+    struct ledcmd_ctx_st * const context,
+    led_handle_st * const led_handle,
+    struct led_id_target_st const * const target,
+    struct set_state_req_st const * const request,
+    set_state_result_cb const result_cb,
+    void * const result_context)
+{
+    char const * const state_name = led_state_name(request->state);
+
+    for (size_t i = 0; i < target->num_leds; i++)
+    {
+        struct led_ctx_st * const led_ctx = target->leds[i];
+        char const * error_msg = NULL;
+        bool const success =
+            led_ctx_set_state(context, led_ctx, led_handle, request, &error_msg);
+
+        if (result_cb != NULL)
+        {
+            result_cb(led_ctx->node.key, success, state_name, error_msg, result_context);
+        }
+    }
+
+    if (target->is_alias && result_cb != NULL)
+    {
+        result_cb(target->name, true, state_name, NULL, result_context);
+    }
+}
+
+static void
+get_target_states(
+    struct ledcmd_ctx_st * const context,
+    led_handle_st * const led_handle,
+    struct led_id_target_st const * const target,
+    get_state_result_cb const result_cb,
+    void * const result_context)
+{
+    for (size_t i = 0; i < target->num_leds; i++)
+    {
+        append_led_state(
+            led_handle, context->methods, target->leds[i], result_cb, result_context);
+    }
+}
+
+static void
+activate_target_leds(
+    struct ledcmd_ctx_st * const context,
+    led_handle_st * const led_handle,
+    struct led_id_target_st const * const target,
+    enum led_priority_t const priority,
+    char const * const lock_id,
+    activate_priority_result_cb const result_cb,
+    void * const result_context)
+{
+    for (size_t i = 0; i < target->num_leds; i++)
+    {
+        struct led_ctx_st * const led_ctx = target->leds[i];
+
+        led_ctx_activate(
+            context, led_ctx, led_handle, led_ctx->node.key,
+            priority, lock_id, result_cb, result_context);
+    }
+}
+
+static void
+deactivate_target_leds(
+    struct ledcmd_ctx_st * const context,
+    led_handle_st * const led_handle,
+    struct led_id_target_st const * const target,
+    enum led_priority_t const priority,
+    char const * const lock_id,
+    deactivate_priority_result_cb const result_cb,
+    void * const result_context)
+{
+    for (size_t i = 0; i < target->num_leds; i++)
+    {
+        struct led_ctx_st * const led_ctx = target->leds[i];
+
+        led_ctx_deactivate(
+            context, led_ctx, led_handle, led_ctx->node.key,
+            priority, lock_id, result_cb, result_context);
+    }
+}
+
 static void
 led_ops_close(struct led_ops_handle_st * const led_ops_handle)
 {
@@ -994,19 +1364,20 @@ led_ops_close(struct led_ops_handle_st * const led_ops_handle)
         goto done;
     }
 
+    struct ledcmd_ctx_st * const ledcmd_context = led_ops_handle->ledcmd_context;
     led_handle_st * const led_handle = led_ops_handle->led_handle;
 
     if (led_handle != NULL)
     {
-        struct ledcmd_ctx_st * const ledcmd_context =
-            led_ops_handle->ledcmd_context;
         struct platform_led_methods_st const * const methods =
             ledcmd_context->methods;
 
         methods->close(led_handle);
     }
 
-    free(led_ops_handle);
+    led_ops_handle->led_handle = NULL;
+    led_ops_handle->next_free = ledcmd_context->free_led_ops_handles;
+    ledcmd_context->free_led_ops_handles = led_ops_handle;
 
 done:
     return;
@@ -1015,15 +1386,17 @@ done:
 static struct led_ops_handle_st *
 led_ops_open(void * const led_ops_context)
 {
-    struct led_ops_handle_st * led_ops_handle = calloc(1, sizeof *led_ops_handle);
+    struct ledcmd_ctx_st * const context = led_ops_context;
+    struct led_ops_handle_st * led_ops_handle = context->free_led_ops_handles;
 
     if (led_ops_handle == NULL)
     {
+        log_error("No free LED ops handles");
         goto done;
     }
 
-    struct ledcmd_ctx_st * const context = led_ops_context;
-    led_ops_handle->ledcmd_context = context;
+    context->free_led_ops_handles = led_ops_handle->next_free;
+    led_ops_handle->next_free = NULL;
 
     struct platform_led_methods_st const * const methods = context->methods;
 
@@ -1066,7 +1439,30 @@ led_ops_set_state(
 
     struct set_state_req_st const * const request = set_state_req_in;
 
-    if (request->led_name == NULL || request->state == LED_STATE_UNKNOWN)
+    if (request->state == LED_STATE_UNKNOWN)
+    {
+        success = false;
+        goto done;
+    }
+
+    if (request->led_id != LED_ID_NONE)
+    {
+        struct led_id_target_st const * const target =
+            led_ids_lookup(context->led_ids, request->led_id);
+
+        if (target == NULL)
+        {
+            success = false;
+            goto done;
+        }
+
+        set_target_states(
+            context, led_handle, target, request, result_cb, result_context);
+        success = true;
+        goto done;
+    }
+
+    if (request->led_name == NULL)
     {
         success = false;
         goto done;
@@ -1150,6 +1546,7 @@ static bool
 led_ops_get_state(
     led_ops_handle * const led_ops_handle,
     char const * const led_name,
+    uint32_t const led_id,
     get_state_result_cb result_cb,
     void * result_context)
 {
@@ -1171,6 +1568,22 @@ led_ops_get_state(
         goto done;
     }
 
+    if (led_id != LED_ID_NONE)
+    {
+        struct led_id_target_st const * const target =
+            led_ids_lookup(context->led_ids, led_id);
+
+        if (target == NULL)
+        {
+            success = false;
+            goto done;
+        }
+
+        get_target_states(context, led_handle, target, result_cb, result_context);
+        success = true;
+        goto done;
+    }
+
     bool const get_all_leds = strcasecmp(led_name, _led_all) == 0;
 
     if (get_all_leds)
@@ -1237,6 +1650,7 @@ static bool
 led_ops_deactivate_priority(
     led_ops_handle * const led_ops_handle,
     char const * const led_name,
+    uint32_t const led_id,
     char const * const led_priority,
     char const * const lock_id,
     activate_priority_result_cb const result_cb,
@@ -1250,13 +1664,24 @@ led_ops_deactivate_priority(
         goto done;
     }
 
+    struct ledcmd_ctx_st * const context = led_ops_handle->ledcmd_context;
+    struct led_id_target_st const * const target =
+        led_ids_lookup(context->led_ids, led_id);
+    char const * const target_name = (target != NULL) ? target->name : led_name;
+
+    if (target_name == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
     enum led_priority_t priority;
 
     if (!led_priority_by_name(led_priority, &priority))
     {
         char const * error_msg = "Unknown priority";
 
-        result_cb(led_name, false, NULL, error_msg, result_context);
+        result_cb(target_name, false, NULL, error_msg, result_context);
         success = true;
         goto done;
     }
@@ -1265,12 +1690,11 @@ led_ops_deactivate_priority(
     {
         char const * error_msg = "Lock ID missing";
 
-        result_cb(led_name, false, NULL, error_msg, result_context);
+        result_cb(target_name, false, NULL, error_msg, result_context);
         success = true;
         goto done;
     }
 
-    struct ledcmd_ctx_st * const context = led_ops_handle->ledcmd_context;
     struct platform_led_methods_st const * const methods = context->methods;
     led_handle_st * const led_handle = led_ops_handle->led_handle;
 
@@ -1280,6 +1704,14 @@ led_ops_deactivate_priority(
         goto done;
     }
 
+    if (target != NULL)
+    {
+        deactivate_target_leds(
+            context, led_handle, target, priority, lock_id, result_cb, result_context);
+        success = true;
+        goto done;
+    }
+
     bool const do_all = strcasecmp(led_name, _led_all) == 0;
 
     if (do_all)
@@ -1288,18 +1720,9 @@ led_ops_deactivate_priority(
 
         avl_for_each_element(&context->all_leds, led_ctx, node)
         {
-            char const * const led_name = methods->get_led_name(led_ctx->led);
-            char const * error_msg = NULL;
-            bool const unlocked =
-                priority != LED_PRIORITY_LOCKED
-                || led_ctx_unlock_led(led_ctx, lock_id, &error_msg);
-
-            if (unlocked)
-            {
-                led_ctx_deactivate_priority(methods, led_ctx, led_handle, priority);
-            }
-
-            result_cb(led_name, unlocked, led_ctx->lock_id, error_msg, result_context);
+            led_ctx_deactivate(
+                context, led_ctx, led_handle, methods->get_led_name(led_ctx->led),
+                priority, lock_id, result_cb, result_context);
         }
     }
     else
@@ -1325,18 +1748,10 @@ led_ops_deactivate_priority(
             success = true;
             goto done;
         }
-        char const * const led_name = methods->get_led_name(led_ctx->led);
-        char const * error_msg = NULL;
-        bool const unlocked =
-            priority != LED_PRIORITY_LOCKED
-            || led_ctx_unlock_led(led_ctx, lock_id, &error_msg);
-
-        if (unlocked)
-        {
-            led_ctx_deactivate_priority(methods, led_ctx, led_handle, priority);
-        }
 
-        result_cb(led_name, unlocked, led_ctx->lock_id, error_msg, result_context);
+        led_ctx_deactivate(
+            context, led_ctx, led_handle, methods->get_led_name(led_ctx->led),
+            priority, lock_id, result_cb, result_context);
     }
 
     success = true;
@@ -1349,6 +1764,7 @@ static bool
 led_ops_activate_priority(
     led_ops_handle * const led_ops_handle,
     char const * const led_name,
+    uint32_t const led_id,
     char const * const led_priority,
     char const * const lock_id,
     activate_priority_result_cb const result_cb,
@@ -1362,13 +1778,24 @@ led_ops_activate_priority(
         goto done;
     }
 
+    struct ledcmd_ctx_st * const context = led_ops_handle->ledcmd_context;
+    struct led_id_target_st const * const target =
+        led_ids_lookup(context->led_ids, led_id);
+    char const * const target_name = (target != NULL) ? target->name : led_name;
+
+    if (target_name == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
     enum led_priority_t priority;
 
     if (!led_priority_by_name(led_priority, &priority))
     {
         char const * error_msg = "Unknown priority";
 
-        result_cb(led_name, false, NULL, error_msg, result_context);
+        result_cb(target_name, false, NULL, error_msg, result_context);
         success = true;
         goto done;
     }
@@ -1377,12 +1804,11 @@ led_ops_activate_priority(
     {
         char const * error_msg = "Lock ID missing";
 
-        result_cb(led_name, false, NULL, error_msg, result_context);
+        result_cb(target_name, false, NULL, error_msg, result_context);
         success = true;
         goto done;
     }
 
-    struct ledcmd_ctx_st * const context = led_ops_handle->ledcmd_context;
     struct platform_led_methods_st const * const methods = context->methods;
     led_handle_st * const led_handle = led_ops_handle->led_handle;
 
@@ -1392,6 +1818,14 @@ led_ops_activate_priority(
         goto done;
     }
 
+    if (target != NULL)
+    {
+        activate_target_leds(
+            context, led_handle, target, priority, lock_id, result_cb, result_context);
+        success = true;
+        goto done;
+    }
+
     bool const do_all = strcasecmp(led_name, _led_all) == 0;
 
     if (do_all)
@@ -1413,19 +1847,9 @@ led_ops_activate_priority(
         {
             avl_for_each_element(&context->all_leds, led_ctx, node)
             {
-                char const * const led_name = methods->get_led_name(led_ctx->led);
-                char const * error_msg = NULL;
-
-                bool const locked =
-                    priority != LED_PRIORITY_LOCKED
-                    || led_ctx_lock_led(led_ctx, lock_id, &error_msg);
-
-                if (locked)
-                {
-                    led_ctx_activate_priority(
-                        methods, led_ctx, led_handle, priority);
-                }
-                result_cb(led_name, locked, led_ctx->lock_id, error_msg, result_context);
+                led_ctx_activate(
+                    context, led_ctx, led_handle, methods->get_led_name(led_ctx->led),
+                    priority, lock_id, result_cb, result_context);
             }
         }
     }
@@ -1453,18 +1877,9 @@ led_ops_activate_priority(
             goto done;
         }
 
-        char const * const led_name = methods->get_led_name(led_ctx->led);
-        char const * error_msg = NULL;
-        bool const locked =
-            (priority != LED_PRIORITY_LOCKED)
-            || led_ctx_lock_led(led_ctx, lock_id, &error_msg);
-
-        if (locked)
-        {
-            led_ctx_activate_priority(methods, led_ctx, led_handle, priority);
-        }
-
-        result_cb(led_name, locked, led_ctx->lock_id, error_msg, result_context);
+        led_ctx_activate(
+            context, led_ctx, led_handle, methods->get_led_name(led_ctx->led),
+            priority, lock_id, result_cb, result_context);
     }
 
     success = true;
@@ -1530,6 +1945,130 @@ led_ops_play_pattern(
     return true;
 }
 
+static uint32_t
+led_ops_resolve_leds(
+    void * const led_ops_context,
+    resolve_leds_cb const result_cb,
+    void * const result_context)
+{
+    struct ledcmd_ctx_st * const context = led_ops_context;
+
+    led_ids_iterate(context->led_ids, result_cb, result_context);
+
+    return led_ids_generation(context->led_ids);
+}
+
+static uint32_t
+led_ops_led_id_generation(void * const led_ops_context)
+{
+    struct ledcmd_ctx_st * const context = led_ops_context;
+
+    return led_ids_generation(context->led_ids);
+}
+
+static bool
+led_ops_led_id_is_valid(
+    led_ops_handle * const led_ops_handle, uint32_t const led_id)
+{
+    struct ledcmd_ctx_st * const context = led_ops_handle->ledcmd_context;
+
+    return led_ids_lookup(context->led_ids, led_id) != NULL;
+}
+
+static bool
+led_changes_need_resync(
+    struct ledcmd_ctx_st const * const context,
+    uint32_t const epoch,
+    uint32_t const since_seq)
+{
+    return epoch != context->epoch
+           || since_seq > context->change_seq
+           || since_seq < context->change_history.lost_seq;
+}
+
+static void
+led_ops_get_changes(
+    void * const led_ops_context,
+    uint32_t const epoch,
+    uint32_t const since_seq,
+    struct led_changes_info_st * const info,
+    led_change_cb const result_cb,
+    void * const result_context)
+{
+    struct ledcmd_ctx_st * const context = led_ops_context;
+
+    /* Include any changes made in this uloop iteration. */
+    uloop_timeout_cancel(&context->notify_timer);
+    flush_led_changes(context);
+
+    info->epoch = context->epoch;
+    info->seq = context->change_seq;
+    info->resync = led_changes_need_resync(context, epoch, since_seq);
+
+    if (info->resync)
+    {
+        struct led_ctx_st * led_ctx;
+
+        avl_for_each_element(&context->all_leds, led_ctx, node)
+        {
+            result_cb(led_ctx->node.key, &led_ctx->notified_status, result_context);
+        }
+        goto done;
+    }
+
+    struct led_change_history_st const * const history = &context->change_history;
+    size_t const size = ARRAY_SIZE(history->records);
+    size_t const oldest = (history->next + size - history->count) % size;
+
+    for (size_t i = 0; i < history->count; i++)
+    {
+        struct led_change_record_st const * const record =
+            &history->records[(oldest + i) % size];
+        struct led_ctx_st * const led_ctx = record->led_ctx;
+
+        /* Only report the most recent change to each LED. */
+        if (record->seq > since_seq && record->seq == led_ctx->last_changed_seq)
+        {
+            result_cb(led_ctx->node.key, &led_ctx->notified_status, result_context);
+        }
+    }
+
+done:
+    return;
+}
+
+static void
+led_ops_pattern_event(
+    void * const led_ops_context,
+    char const * const pattern_name,
+    enum led_pattern_event_t const event,
+    char const * const preempted_by)
+{
+    struct ledcmd_ctx_st * const context = led_ops_context;
+
+    ledcmd_ubus_send_pattern_event(
+        context->ubus_context, pattern_name, event, preempted_by);
+}
+
+static void
+led_ops_pattern_timing(
+    void * const led_ops_context,
+    pattern_timing_cb const result_cb,
+    void * const result_context)
+{
+    struct ledcmd_ctx_st * const context = led_ops_context;
+
+    led_pattern_list_timing(context->patterns_context, result_cb, result_context);
+}
+
+static void
+led_ops_pattern_timing_reset(void * const led_ops_context)
+{
+    struct ledcmd_ctx_st * const context = led_ops_context;
+
+    led_pattern_reset_timing(context->patterns_context);
+}
+
 static bool
 leds_init(led_st * const led, void * const user_ctx)
 {
@@ -1560,7 +2099,10 @@ leds_init(led_st * const led, void * const user_ctx)
 
         led_priority_ctx->priority = i;
         led_priority_ctx->state = LED_OFF;
+        led_priority_ctx->requested_state = LED_OFF;
     }
+    INIT_LIST_HEAD(&led_ctx->changed_node);
+    led_ctx_get_status(led_ctx, &led_ctx->notified_status);
     led_ctx->node.key = methods->get_led_name(led);
 
     avl_insert(tree, &led_ctx->node);
@@ -1632,14 +2174,35 @@ get_all_led_states(struct ledcmd_ctx_st * const context)
             enum led_priority_t const current_priority =
                 led_priority_highest_priority(led_ctx->priority_context);
 
-            led_ctx->priorities[current_priority].state =
-                methods->get_led_state(led_handle, led_ctx->led);
+            struct led_state_context_st * const led_priority_ctx =
+                &led_ctx->priorities[current_priority];
+
+            led_priority_ctx->state =
+                backend_get_led_state(methods, led_handle, led_ctx->led);
+            led_priority_ctx->requested_state = led_priority_ctx->state;
+            led_ctx_get_status(led_ctx, &led_ctx->notified_status);
         }
 
         methods->close(led_handle);
     }
 }
 
+static void
+led_ops_handles_init(struct ledcmd_ctx_st * const context)
+{
+    context->free_led_ops_handles = NULL;
+    for (size_t i = ARRAY_SIZE(context->led_ops_handles); i > 0; i--)
+    {
+        struct led_ops_handle_st * const led_ops_handle =
+            &context->led_ops_handles[i - 1];
+
+        led_ops_handle->ledcmd_context = context;
+        led_ops_handle->led_handle = NULL;
+        led_ops_handle->next_free = context->free_led_ops_handles;
+        context->free_led_ops_handles = led_ops_handle;
+    }
+}
+
 static void
 supported_states_cb(
     enum led_state_t const state, void * const user_ctx)
@@ -1665,7 +2228,11 @@ ledcmd_deinit(struct ledcmd_ctx_st * const context)
         goto done;
     }
 
+    uloop_timeout_cancel(&context->notify_timer);
+    led_fast_path_free(context->fast_path);
     ledcmd_ubus_deinit(context->ubus_context);
+    led_status_page_free(context->status_page);
+    led_ids_free(context->led_ids);
     free_led_ctxs(context);
 
     struct platform_led_methods_st const * const methods = context->methods;
@@ -1683,43 +2250,164 @@ done:
     return;
 }
 
-struct ledcmd_ctx_st *
-ledcmd_init(
-    char const * const ubus_path,
+static struct led_ops_st const ops =
+{
+    .open = led_ops_open,
+    .close = led_ops_close,
+    .set_state = led_ops_set_state,
+    .get_state = led_ops_get_state,
+    .activate_priority = led_ops_activate_priority,
+    .deactivate_priority = led_ops_deactivate_priority,
+    .list_leds = led_ops_list_leds,
+    .list_patterns = led_ops_list_patterns,
+    .list_playing_patterns = led_ops_list_playing_patterns,
+    .play_pattern = led_ops_play_pattern,
+    .stop_pattern = led_ops_stop_pattern,
+    .compare_leds = led_ops_compare_leds,
+    .resolve_leds = led_ops_resolve_leds,
+    .led_id_generation = led_ops_led_id_generation,
+    .led_id_is_valid = led_ops_led_id_is_valid,
+    .get_changes = led_ops_get_changes,
+    .pattern_event = led_ops_pattern_event,
+    .pattern_timing = led_ops_pattern_timing,
+    .pattern_timing_reset = led_ops_pattern_timing_reset
+};
+
+struct led_ops_st const *
+ledcmd_control_ops(void)
+{
+    return &ops;
+}
+
+/* Allocate a context that may be passed to ledcmd_deinit(). */
+/*
+ * The epoch lets clients tell that sequence numbers they hold refer to a
+ * previous instance of the daemon, so it must differ between instances even
+ * if they start in the same second. It is never 0, which clients use before
+ * their first sync.
+ */
+static uint32_t
+new_epoch(void)
+{
+    uint32_t epoch;
+
+    if (getrandom(&epoch, sizeof epoch, GRND_NONBLOCK) != sizeof epoch)
+    {
+        /* The entropy pool isn't ready yet early in boot. */
+        epoch = (uint32_t)time(NULL) ^ ((uint32_t)getpid() << 16);
+    }
+    if (epoch == 0)
+    {
+        epoch = 1;
+    }
+
+    return epoch;
+}
+
+static struct ledcmd_ctx_st *
+ledcmd_ctx_alloc(void)
+{
+    struct ledcmd_ctx_st * const context = calloc(1, sizeof *context);
+
+    if (context == NULL)
+    {
+        goto done;
+    }
+
+    led_ops_handles_init(context);
+    led_ctxs_init(context);
+    INIT_LIST_HEAD(&context->changed_leds);
+    context->notify_timer.cb = led_changes_timeout;
+    context->epoch = new_epoch();
+    led_daemon_stats_reset();
+
+done:
+    return context;
+}
+
+static bool
+control_init(
+    struct ledcmd_ctx_st * const context,
     char const * const patterns_directory,
     char const * const aliases_directory,
-    char const * const backend_path)
+    struct platform_led_methods_st const * const methods)
 {
     bool success;
-    struct ledcmd_ctx_st * context = calloc(1, sizeof *context);
 
-    if (context == NULL)
+    context->patterns_context = led_patterns_init(patterns_directory, &ops, context);
+    if (context->patterns_context == NULL)
     {
         success = false;
         goto done;
     }
 
-    static struct led_ops_st const ops =
-    {
-        .open = led_ops_open,
-        .close = led_ops_close,
-        .set_state = led_ops_set_state,
-        .get_state = led_ops_get_state,
-        .activate_priority = led_ops_activate_priority,
-        .deactivate_priority = led_ops_deactivate_priority,
-        .list_leds = led_ops_list_leds,
-        .list_patterns = led_ops_list_patterns,
-        .list_playing_patterns = led_ops_list_playing_patterns,
-        .play_pattern = led_ops_play_pattern,
-        .stop_pattern = led_ops_stop_pattern,
-        .compare_leds = led_ops_compare_leds
-    };
+    context->led_aliases = led_aliases_load(aliases_directory);
 
-    led_ctxs_init(context);
+    context->methods = methods;
+    context->platform_leds = methods->init();
 
-    context->patterns_context = led_patterns_init(patterns_directory, &ops, context);
+    if (!populate_led_ctxs(context))
+    {
+        success = false;
+        goto done;
+    }
 
-    context->led_aliases = led_aliases_load(aliases_directory);
+    context->led_ids = led_ids_create(&context->all_leds, context->led_aliases);
+    if (context->led_ids == NULL)
+    {
+        success = false;
+        goto done;
+    }
+    get_all_supported_states(context);
+    get_all_led_states(context);
+
+    success = true;
+
+done:
+    return success;
+}
+
+struct ledcmd_ctx_st *
+ledcmd_control_init(
+    char const * const patterns_directory,
+    char const * const aliases_directory,
+    struct platform_led_methods_st const * const methods)
+{
+    struct ledcmd_ctx_st * context = ledcmd_ctx_alloc();
+
+    if (context == NULL)
+    {
+        goto done;
+    }
+
+    if (!control_init(context, patterns_directory, aliases_directory, methods))
+    {
+        ledcmd_deinit(context);
+        context = NULL;
+        goto done;
+    }
+
+done:
+    return context;
+}
+
+struct ledcmd_ctx_st *
+ledcmd_init(
+    char const * const ubus_path,
+    char const * const patterns_directory,
+    char const * const aliases_directory,
+    char const * const backend_path,
+    char const * const status_page_name,
+    char const * const fast_path_socket)
+{
+    bool success;
+    struct ledcmd_ctx_st * context = ledcmd_ctx_alloc();
+
+    if (context == NULL)
+    {
+        success = false;
+        goto done;
+    }
 
     struct platform_led_methods_st const * methods;
 
@@ -1732,17 +2420,17 @@ ledcmd_init(
         goto done;
     }
 
-    context->methods = methods;
-    context->platform_leds = methods->init();
-
-    if (!populate_led_ctxs(context))
+    if (!control_init(context, patterns_directory, aliases_directory, methods))
     {
         success = false;
         goto done;
     }
-    get_all_supported_states(context);
-    get_all_led_states(context);
+
+    /* The daemon still runs without the status page; readers use ubus instead. */
+    context->status_page =
+        led_status_page_create(status_page_name, &context->all_leds, context->epoch);
     context->ubus_context = ledcmd_ubus_init(ubus_path, &ops, context);
+    context->fast_path = led_fast_path_create(fast_path_socket, &ops, context);
 
     success = true;
 
@@ -1,7 +1,12 @@
 #include "led_daemon_ubus.h"
 #include "led_control.h"
+#include "led_journal.h"
 #include "led_pattern_control.h"
+#include "led_priorities.h"
 #include "led_lock.h"
+#include "led_stats.h"
+#include "led_trace.h"
+#include "response_buffer.h"
 
 #include <lib_log/log.h>
 #include <lib_led/string_constants.h>
@@ -15,11 +20,120 @@
 struct ledcmd_ubus_context_st
 {
     struct ubus_connection_ctx_st ubus_connection;
+    /* False if the handlers are only called in-process. */
+    bool connected;
     struct led_ops_st const * led_ops;
     void * led_ops_context;
+    struct response_buffer_st response_buffer;
+    struct response_buffer_st notify_buffer;
+    /* Indexed in the same order as the methods of ledd_object. */
+    struct led_call_stats_st * method_stats;
+};
+
+enum response_verbosity_t
+{
+    RESPONSE_VERBOSITY_FULL,
+    RESPONSE_VERBOSITY_ERRORS,
+    RESPONSE_VERBOSITY_SUMMARY
+};
+
+/*
+ * The response to a request that operates on a number of LEDs. Depending on
+ * the verbosity requested, per-LED results may be omitted from the response,
+ * in which case the number of successful and failed operations is reported
+ * instead.
+ */
+struct led_response_st
+{
+    struct blob_buf * buf;
+    enum response_verbosity_t verbosity;
+    uint32_t num_succeeded;
+    uint32_t num_failed;
 };
 
 static uint32_t const default_flash_ms = 0;
+static size_t const initial_response_buffer_size = 1024;
+static size_t const initial_notify_buffer_size = 256;
+
+/* Returns false if the name isn't that of a verbosity. */
+static bool
+response_verbosity_by_name(
+    char const * const name, enum response_verbosity_t * const verbosity)
+{
+    bool valid = true;
+
+    if (name == NULL || strcmp(name, _led_verbosity_full) == 0)
+    {
+        *verbosity = RESPONSE_VERBOSITY_FULL;
+    }
+    else if (strcmp(name, _led_verbosity_errors) == 0)
+    {
+        *verbosity = RESPONSE_VERBOSITY_ERRORS;
+    }
+    else if (strcmp(name, _led_verbosity_summary) == 0)
+    {
+        *verbosity = RESPONSE_VERBOSITY_SUMMARY;
+    }
+    else
+    {
+        valid = false;
+    }
+
+    return valid;
+}
+
+/* Returns false if an unknown verbosity was requested. */
+static bool
+led_response_init(
+    struct led_response_st * const response,
+    struct blob_buf * const buf,
+    struct blob_attr * const verbosity)
+{
+    response->buf = buf;
+    response->num_succeeded = 0;
+    response->num_failed = 0;
+
+    return response_verbosity_by_name(blobmsg_get_string(verbosity), &response->verbosity);
+}
+
+static void
+append_led_response_summary(struct led_response_st const * const response)
+{
+    if (response->verbosity != RESPONSE_VERBOSITY_FULL)
+    {
+        blobmsg_add_u32(response->buf, _led_succeeded, response->num_succeeded);
+        blobmsg_add_u32(response->buf, _led_failed, response->num_failed);
+    }
+}
+
+/*
+ * Requests that identify LEDs by ID include the generation of the IDs. If the
+ * IDs have changed since the client resolved them, the request is rejected
+ * with UBUS_STATUS_NOT_FOUND so that the client knows to resolve them again.
+ */
+static bool
+led_id_generation_is_current(
+    struct ledcmd_ubus_context_st const * const ubus_context,
+    struct blob_attr * const generation)
+{
+    struct led_ops_st const * const led_ops = ubus_context->led_ops;
+
+    return generation == NULL
+        || blobmsg_get_u32(generation)
+           == led_ops->led_id_generation(ubus_context->led_ops_context);
+}
+
+static bool
+led_id_from_attr(
+    struct led_ops_st const * const led_ops,
+    struct led_ops_handle_st * const led_ops_handle,
+    struct blob_attr * const attr,
+    uint32_t * const led_id)
+{
+    *led_id = blobmsg_get_u32_or_default(attr, LED_ID_NONE);
+
+    return *led_id == LED_ID_NONE || led_ops->led_id_is_valid(led_ops_handle, *led_id);
+}
 
 static void
 append_led_data(
@@ -29,31 +143,53 @@ append_led_data(
     char const * const lock_id,
     char const * const led_priority,
     char const * const error_msg,
-    struct blob_buf * const response)
+    struct led_response_st * const response)
 {
-    void * const cookie = blobmsg_open_table(response, NULL);
+    if (success)
+    {
+        response->num_succeeded++;
+    }
+    else
+    {
+        response->num_failed++;
+    }
 
-    blobmsg_add_string(response, _led_name, led_name);
-    blobmsg_add_u8(response, _led_success, success);
+    bool const include_result =
+        response->verbosity == RESPONSE_VERBOSITY_FULL
+        || (response->verbosity == RESPONSE_VERBOSITY_ERRORS && !success);
+
+    if (!include_result)
+    {
+        goto done;
+    }
+
+    struct blob_buf * const buf = response->buf;
+    void * const cookie = blobmsg_open_table(buf, NULL);
+
+    blobmsg_add_string(buf, _led_name, led_name);
+    blobmsg_add_u8(buf, _led_success, success);
 
     if (state != NULL)
     {
-        blobmsg_add_string(response, _led_state, state);
+        blobmsg_add_string(buf, _led_state, state);
     }
     if (lock_id != NULL)
     {
-        blobmsg_add_string(response, _led_lock_id, lock_id);
+        blobmsg_add_string(buf, _led_lock_id, lock_id);
     }
     if (led_priority != NULL)
     {
-        blobmsg_add_string(response, _led_priority, led_priority);
+        blobmsg_add_string(buf, _led_priority, led_priority);
     }
     if (error_msg != NULL)
     {
-        blobmsg_add_string(response, _led_error, error_msg);
+        blobmsg_add_string(buf, _led_error, error_msg);
     }
 
-    blobmsg_close_table(response, cookie);
+    blobmsg_close_table(buf, cookie);
+
+done:
+    return;
 }
 
 #define append_activate_response(name, result, lock_id, msg, response) \
@@ -103,7 +239,7 @@ get_state_cb(
     char const * const error_msg,
     void * const result_context)
 {
-    struct blob_buf * const response = result_context;
+    struct led_response_st * const response = result_context;
 
     append_get_response(
         led_name, success, led_state, lock_id, led_priority, error_msg, response);
@@ -114,17 +250,18 @@ process_get_request(
     struct led_ops_st const * const led_ops,
     struct led_ops_handle_st * const led_ops_handle,
     char const * const led_name,
-    struct blob_buf * const response)
+    uint32_t const led_id,
+    struct led_response_st * const response)
 {
     bool success;
 
-    if (led_name == NULL)
+    if (led_name == NULL && led_id == LED_ID_NONE)
     {
         success = false;
         goto done;
     }
 
-    led_ops->get_state(led_ops_handle, led_name, get_state_cb, response);
+    led_ops->get_state(led_ops_handle, led_name, led_id, get_state_cb, response);
 
     success = true;
 
@@ -137,45 +274,64 @@ process_get_state_attr(
     struct led_ops_st const * const led_ops,
     struct led_ops_handle_st * const led_ops_handle,
     struct blob_attr const * const attr,
-    struct blob_buf * const response)
+    struct led_response_st * const response)
 {
     enum
     {
         LED_NAME,
+        LED_ID,
         LED_MAX__
     };
     struct blobmsg_policy const get_led_policy[LED_MAX__] =
     {
-        [LED_NAME] = { .name = _led_name, .type = BLOBMSG_TYPE_STRING }
+        [LED_NAME] = { .name = _led_name, .type = BLOBMSG_TYPE_STRING },
+        [LED_ID] = { .name = _led_id, .type = BLOBMSG_TYPE_INT32 }
     };
     struct blob_attr * fields[LED_MAX__];
+    bool success;
 
     blobmsg_parse(get_led_policy, ARRAY_SIZE(get_led_policy), fields,
                   blobmsg_data(attr), blobmsg_data_len(attr));
 
-    return process_get_request(
+    uint32_t led_id;
+
+    if (!led_id_from_attr(led_ops, led_ops_handle, fields[LED_ID], &led_id))
+    {
+        success = false;
+        goto done;
+    }
+
+    success = process_get_request(
         led_ops,
         led_ops_handle,
         blobmsg_get_string(fields[LED_NAME]),
+        led_id,
         response);
+
+done:
+    return success;
 }
 
 enum
 {
     GET_LEDS,
+    GET_VERBOSITY,
+    GET_GENERATION,
     GET_MAX__
 };
 
 static struct blobmsg_policy const get_state_policy[GET_MAX__] =
 {
-    [GET_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY }
+    [GET_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY },
+    [GET_VERBOSITY] = { .name = _led_verbosity, .type = BLOBMSG_TYPE_STRING },
+    [GET_GENERATION] = { .name = _led_generation, .type = BLOBMSG_TYPE_INT32 }
 };
 
 static int
 process_get_msg(
     struct ledcmd_ubus_context_st * const ubus_context,
     struct blob_attr const * const msg,
-    struct blob_buf * const response)
+    struct blob_buf * const buf)
 {
     int result;
     struct led_ops_st const * const led_ops = ubus_context->led_ops;
@@ -202,20 +358,35 @@ process_get_msg(
         goto done;
     }
 
-    void * const cookie = blobmsg_open_array(response, _led_leds);
+    if (!led_id_generation_is_current(ubus_context, fields[GET_GENERATION]))
+    {
+        result = UBUS_STATUS_NOT_FOUND;
+        goto done;
+    }
+
+    struct led_response_st response;
+
+    if (!led_response_init(&response, buf, fields[GET_VERBOSITY]))
+    {
+        result = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    void * const cookie = blobmsg_open_array(buf, _led_leds);
     struct blob_attr * cur;
     int rem;
 
     blobmsg_for_each_attr(cur, array_blob, rem)
     {
-        if (!process_get_state_attr(led_ops, led_ops_handle, cur, response))
+        if (!process_get_state_attr(led_ops, led_ops_handle, cur, &response))
         {
             result = UBUS_STATUS_INVALID_ARGUMENT;
             goto done;
         }
     }
 
-    blobmsg_close_array(response, cookie);
+    blobmsg_close_array(buf, cookie);
+    append_led_response_summary(&response);
 
     result = UBUS_STATUS_OK;
 
@@ -238,17 +409,16 @@ get_state_handler(
 
     struct ledcmd_ubus_context_st * const ubus_context =
         container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
-    struct blob_buf response;
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
 
-    blob_buf_full_init(&response, 0);
-
-    int const result = process_get_msg(ubus_context, msg, &response);
+    int const result = process_get_msg(ubus_context, msg, response);
 
     if (result == UBUS_STATUS_OK)
     {
-        ubus_send_reply(ctx, req, response.head);
+        ubus_send_reply(ctx, req, response->head);
     }
-    blob_buf_free(&response);
+    response_buffer_done(&ubus_context->response_buffer);
 
     return result;
 }
@@ -261,6 +431,7 @@ populate_led_set_state_request(
     enum
     {
         LED_NAME,
+        LED_ID,
         LED_STATE,
         LOCK_ID,
         LED_PRIORITY,
@@ -272,6 +443,8 @@ populate_led_set_state_request(
     {
         [LED_NAME] =
         { .name = _led_name, .type = BLOBMSG_TYPE_STRING },
+        [LED_ID] =
+        { .name = _led_id, .type = BLOBMSG_TYPE_INT32 },
         [LED_STATE] =
         { .name = _led_state, .type = BLOBMSG_TYPE_STRING },
         [LOCK_ID] =
@@ -290,6 +463,7 @@ populate_led_set_state_request(
 
     memset(set_state_req, 0, sizeof *set_state_req);
     set_state_req->led_name = blobmsg_get_string(fields[LED_NAME]);
+    set_state_req->led_id = blobmsg_get_u32_or_default(fields[LED_ID], LED_ID_NONE);
     set_state_req->lock_id = blobmsg_get_string(fields[LOCK_ID]);
     set_state_req->led_priority = blobmsg_get_string(fields[LED_PRIORITY]);
     set_state_req->state =
@@ -308,7 +482,7 @@ set_state_cb(
     char const * const error_msg,
     void * user_context)
 {
-    struct blob_buf * const response = user_context;
+    struct led_response_st * const response = user_context;
 
     append_set_response(led_name, success, state, error_msg, response);
 }
@@ -318,14 +492,22 @@ process_set_state_attr(
     struct led_ops_st const * const led_ops,
     struct led_ops_handle_st * const led_ops_handle,
     struct blob_attr const * const request,
-    struct blob_buf * const response)
+    struct led_response_st * const response)
 {
     bool success;
     struct set_state_req_st set_state_req;
 
     populate_led_set_state_request(request, &set_state_req);
 
-    if (set_state_req.led_name == NULL || set_state_req.state == LED_STATE_UNKNOWN)
+    if ((set_state_req.led_name == NULL && set_state_req.led_id == LED_ID_NONE)
+        || set_state_req.state == LED_STATE_UNKNOWN)
+    {
+        success = false;
+        goto done;
+    }
+
+    if (set_state_req.led_id != LED_ID_NONE
+        && !led_ops->led_id_is_valid(led_ops_handle, set_state_req.led_id))
     {
         success = false;
         goto done;
@@ -342,19 +524,23 @@ done:
 enum
 {
     SET_LEDS,
+    SET_VERBOSITY,
+    SET_GENERATION,
     SET_MAX__
 };
 
 static struct blobmsg_policy const set_state_policy[SET_MAX__] =
 {
-    [SET_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY }
+    [SET_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY },
+    [SET_VERBOSITY] = { .name = _led_verbosity, .type = BLOBMSG_TYPE_STRING },
+    [SET_GENERATION] = { .name = _led_generation, .type = BLOBMSG_TYPE_INT32 }
 };
 
 static bool
 process_set_msg(
     struct ledcmd_ubus_context_st * const ubus_context,
     struct blob_attr const * const msg,
-    struct blob_buf * const response)
+    struct blob_buf * const buf)
 {
     struct led_ops_st const * const led_ops = ubus_context->led_ops;
     int result;
@@ -380,20 +566,35 @@ process_set_msg(
         goto done;
     }
 
-    void * const cookie = blobmsg_open_array(response, _led_leds);
+    if (!led_id_generation_is_current(ubus_context, fields[SET_GENERATION]))
+    {
+        result = UBUS_STATUS_NOT_FOUND;
+        goto done;
+    }
+
+    struct led_response_st response;
+
+    if (!led_response_init(&response, buf, fields[SET_VERBOSITY]))
+    {
+        result = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    void * const cookie = blobmsg_open_array(buf, _led_leds);
     struct blob_attr * cur;
     int rem;
 
     blobmsg_for_each_attr(cur, array_blob, rem)
     {
-        if (!process_set_state_attr(led_ops, led_ops_handle, cur, response))
+        if (!process_set_state_attr(led_ops, led_ops_handle, cur, &response))
         {
             result = UBUS_STATUS_INVALID_ARGUMENT;
             goto done;
         }
     }
 
-    blobmsg_close_array(response, cookie);
+    blobmsg_close_array(buf, cookie);
+    append_led_response_summary(&response);
 
     result = UBUS_STATUS_OK;
 
@@ -416,17 +617,221 @@ set_state_handler(
 
     struct ledcmd_ubus_context_st * const ubus_context =
         container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
-    struct blob_buf response;
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
+
+    int const result = process_set_msg(ubus_context, msg, response);
+
+    if (result == UBUS_STATUS_OK)
+    {
+        ubus_send_reply(ctx, req, response->head);
+    }
+    response_buffer_done(&ubus_context->response_buffer);
+
+    return result;
+}
+
+/*
+ * A set_many request applies the same lock, priority and flash settings to a
+ * number of LEDs, so those settings are parsed once per request rather than
+ * once per LED. States may be specified either by name or by their numeric
+ * value, and a single state may be supplied to be applied to all of the LEDs.
+ * The LEDs may be identified by their IDs rather than by their names.
+ */
+enum
+{
+    SET_MANY_NAMES,
+    SET_MANY_IDS,
+    SET_MANY_GENERATION,
+    SET_MANY_STATES,
+    SET_MANY_LOCK_ID,
+    SET_MANY_PRIORITY,
+    SET_MANY_FLASH_TYPE,
+    SET_MANY_FLASH_TIME_MS,
+    SET_MANY_VERBOSITY,
+    SET_MANY_MAX__
+};
+
+static struct blobmsg_policy const set_many_policy[SET_MANY_MAX__] =
+{
+    [SET_MANY_NAMES] = { .name = _led_names, .type = BLOBMSG_TYPE_ARRAY },
+    [SET_MANY_IDS] = { .name = _led_ids, .type = BLOBMSG_TYPE_ARRAY },
+    [SET_MANY_GENERATION] = { .name = _led_generation, .type = BLOBMSG_TYPE_INT32 },
+    [SET_MANY_STATES] = { .name = _led_states, .type = BLOBMSG_TYPE_ARRAY },
+    [SET_MANY_LOCK_ID] = { .name = _led_lock_id, .type = BLOBMSG_TYPE_STRING },
+    [SET_MANY_PRIORITY] = { .name = _led_priority, .type = BLOBMSG_TYPE_STRING },
+    [SET_MANY_FLASH_TYPE] = { .name = _led_flash_type, .type = BLOBMSG_TYPE_STRING },
+    [SET_MANY_FLASH_TIME_MS] = { .name = _led_flash_time_ms, .type = BLOBMSG_TYPE_INT32 },
+    [SET_MANY_VERBOSITY] = { .name = _led_verbosity, .type = BLOBMSG_TYPE_STRING }
+};
+
+static enum led_state_t
+led_state_from_attr(struct blob_attr * const attr)
+{
+    enum led_state_t state;
 
-    blob_buf_full_init(&response, 0);
+    switch (blobmsg_type(attr))
+    {
+    case BLOBMSG_TYPE_STRING:
+        state = led_state_by_query_name(blobmsg_get_string(attr));
+        break;
+
+    case BLOBMSG_TYPE_INT32:
+        state = led_state_by_value(blobmsg_get_u32(attr));
+        break;
+
+    default:
+        state = LED_STATE_UNKNOWN;
+        break;
+    }
+
+    return state;
+}
+
+static int
+process_set_many_msg(
+    struct ledcmd_ubus_context_st * const ubus_context,
+    struct blob_attr const * const msg,
+    struct blob_buf * const buf)
+{
+    struct led_ops_st const * const led_ops = ubus_context->led_ops;
+    int result;
+    struct blob_attr * fields[SET_MANY_MAX__];
+    struct led_ops_handle_st * const led_ops_handle =
+        led_ops->open(ubus_context->led_ops_context);
+
+    if (led_ops_handle == NULL)
+    {
+        result = UBUS_STATUS_UNKNOWN_ERROR;
+        goto done;
+    }
+
+    blobmsg_parse(set_many_policy, ARRAY_SIZE(set_many_policy), fields,
+                  blobmsg_data(msg), blobmsg_len(msg));
+
+    bool const use_ids = fields[SET_MANY_IDS] != NULL;
+    struct blob_attr * const leds = use_ids ? fields[SET_MANY_IDS] : fields[SET_MANY_NAMES];
+    int const led_type = use_ids ? BLOBMSG_TYPE_INT32 : BLOBMSG_TYPE_STRING;
+    struct blob_attr * const states = fields[SET_MANY_STATES];
+
+    if (!blobmsg_array_is_type(leds, led_type) || states == NULL)
+    {
+        result = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    int const num_leds = blobmsg_check_array(leds, led_type);
+    int const num_states = blobmsg_check_array(states, BLOBMSG_TYPE_UNSPEC);
+    bool const single_state = num_states == 1;
+
+    if (num_leds < 0 || (!single_state && num_states != num_leds))
+    {
+        result = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    if (!led_id_generation_is_current(ubus_context, fields[SET_MANY_GENERATION]))
+    {
+        result = UBUS_STATUS_NOT_FOUND;
+        goto done;
+    }
+
+    struct set_state_req_st set_state_req =
+    {
+        .lock_id = blobmsg_get_string(fields[SET_MANY_LOCK_ID]),
+        .led_priority = blobmsg_get_string(fields[SET_MANY_PRIORITY]),
+        .flash_type =
+            led_flash_type_lookup(blobmsg_get_string(fields[SET_MANY_FLASH_TYPE])),
+        .flash_time_ms =
+            blobmsg_get_u32_or_default(fields[SET_MANY_FLASH_TIME_MS], default_flash_ms)
+    };
+    struct led_response_st response;
+
+    if (!led_response_init(&response, buf, fields[SET_MANY_VERBOSITY]))
+    {
+        result = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    struct blob_attr * state_attr = blobmsg_data(states);
+    struct blob_attr * cur;
+    int rem;
+
+    /* Check every LED and state first, so that a bad request changes no LEDs. */
+    blobmsg_for_each_attr(cur, leds, rem)
+    {
+        if ((use_ids
+             && (!led_id_from_attr(led_ops, led_ops_handle, cur, &set_state_req.led_id)
+                 || set_state_req.led_id == LED_ID_NONE))
+            || led_state_from_attr(state_attr) == LED_STATE_UNKNOWN)
+        {
+            result = UBUS_STATUS_INVALID_ARGUMENT;
+            goto done;
+        }
+
+        if (!single_state)
+        {
+            state_attr = blob_next(state_attr);
+        }
+    }
+
+    void * const cookie = blobmsg_open_array(buf, _led_leds);
+
+    state_attr = blobmsg_data(states);
+    blobmsg_for_each_attr(cur, leds, rem)
+    {
+        if (use_ids)
+        {
+            set_state_req.led_id = blobmsg_get_u32(cur);
+        }
+        else
+        {
+            set_state_req.led_name = blobmsg_get_string(cur);
+        }
+        set_state_req.state = led_state_from_attr(state_attr);
+
+        led_ops->set_state(led_ops_handle, &set_state_req, set_state_cb, &response);
+
+        if (!single_state)
+        {
+            state_attr = blob_next(state_attr);
+        }
+    }
+
+    blobmsg_close_array(buf, cookie);
+    append_led_response_summary(&response);
+
+    result = UBUS_STATUS_OK;
+
+done:
+    led_ops->close(led_ops_handle);
+
+    return result;
+}
+
+static int
+set_many_handler(
+    struct ubus_context * const ctx,
+    struct ubus_object * const obj,
+    struct ubus_request_data * const req,
+    char const * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED_ARG(obj);
+    UNUSED_ARG(method);
+
+    struct ledcmd_ubus_context_st * const ubus_context =
+        container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
 
-    int const result = process_set_msg(ubus_context, msg, &response);
+    int const result = process_set_many_msg(ubus_context, msg, response);
 
     if (result == UBUS_STATUS_OK)
     {
-        ubus_send_reply(ctx, req, response.head);
+        ubus_send_reply(ctx, req, response->head);
     }
-    blob_buf_free(&response);
+    response_buffer_done(&ubus_context->response_buffer);
 
     return result;
 }
@@ -439,7 +844,7 @@ activate_led_cb(
     char const * const error_msg,
     void * const result_context)
 {
-    struct blob_buf * const response = result_context;
+    struct led_response_st * const response = result_context;
 
     append_activate_response(led_name, success, lock_id, error_msg, response);
 }
@@ -449,13 +854,14 @@ process_activate_request(
     struct led_ops_st const * const led_ops,
     struct led_ops_handle_st * const led_ops_handle,
     char const * const led_name,
+    uint32_t const led_id,
     char const * const led_priority,
     char const * const lock_id,
-    struct blob_buf * const response)
+    struct led_response_st * const response)
 {
     bool success;
 
-    if (led_name == NULL)
+    if (led_name == NULL && led_id == LED_ID_NONE)
     {
         success = false;
         goto done;
@@ -464,6 +870,7 @@ process_activate_request(
         led_ops->activate_priority(
         led_ops_handle,
         led_name,
+        led_id,
         led_priority,
         lock_id,
         activate_led_cb,
@@ -478,11 +885,12 @@ process_activate_attr(
     struct led_ops_st const * const led_ops,
     struct led_ops_handle_st * const led_ops_handle,
     struct blob_attr const * const attr,
-    struct blob_buf * const response)
+    struct led_response_st * const response)
 {
     enum
     {
         LED_NAME,
+        LED_ID,
         LED_PRIORITY,
         LOCK_ID,
         LED_MAX__
@@ -490,39 +898,57 @@ process_activate_attr(
     struct blobmsg_policy const activate_led_policy[LED_MAX__] =
     {
         [LED_NAME] = { .name = _led_name, .type = BLOBMSG_TYPE_STRING },
+        [LED_ID] = { .name = _led_id, .type = BLOBMSG_TYPE_INT32 },
         [LED_PRIORITY] = { .name = _led_priority, .type = BLOBMSG_TYPE_STRING },
         [LOCK_ID] = { .name = _led_lock_id, .type = BLOBMSG_TYPE_STRING }
     };
     struct blob_attr * fields[LED_MAX__];
+    bool success;
 
     blobmsg_parse(activate_led_policy, ARRAY_SIZE(activate_led_policy), fields,
                   blobmsg_data(attr), blobmsg_data_len(attr));
 
-    return process_activate_request(
+    uint32_t led_id;
+
+    if (!led_id_from_attr(led_ops, led_ops_handle, fields[LED_ID], &led_id))
+    {
+        success = false;
+        goto done;
+    }
+
+    success = process_activate_request(
         led_ops,
         led_ops_handle,
         blobmsg_get_string(fields[LED_NAME]),
+        led_id,
         blobmsg_get_string(fields[LED_PRIORITY]),
         blobmsg_get_string(fields[LOCK_ID]),
         response);
+
+done:
+    return success;
 }
 
 enum
 {
     ACTIVATE_LEDS,
+    ACTIVATE_VERBOSITY,
+    ACTIVATE_GENERATION,
     ACTIVATE_MAX__
 };
 
 static struct blobmsg_policy const activate_policy[ACTIVATE_MAX__] =
 {
-    [ACTIVATE_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY }
+    [ACTIVATE_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY },
+    [ACTIVATE_VERBOSITY] = { .name = _led_verbosity, .type = BLOBMSG_TYPE_STRING },
+    [ACTIVATE_GENERATION] = { .name = _led_generation, .type = BLOBMSG_TYPE_INT32 }
 };
 
 static int
 process_activate_msg(
     struct ledcmd_ubus_context_st * const ubus_context,
     struct blob_attr const * const msg,
-    struct blob_buf * const response)
+    struct blob_buf * const buf)
 {
     int result;
     struct blob_attr * fields[ACTIVATE_MAX__];
@@ -548,20 +974,35 @@ process_activate_msg(
         goto done;
     }
 
-    void * const cookie = blobmsg_open_array(response, _led_leds);
+    if (!led_id_generation_is_current(ubus_context, fields[ACTIVATE_GENERATION]))
+    {
+        result = UBUS_STATUS_NOT_FOUND;
+        goto done;
+    }
+
+    struct led_response_st response;
+
+    if (!led_response_init(&response, buf, fields[ACTIVATE_VERBOSITY]))
+    {
+        result = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    void * const cookie = blobmsg_open_array(buf, _led_leds);
     struct blob_attr * cur;
     int rem;
 
     blobmsg_for_each_attr(cur, array_blob, rem)
     {
-        if (!process_activate_attr(led_ops, led_ops_handle, cur, response))
+        if (!process_activate_attr(led_ops, led_ops_handle, cur, &response))
         {
             result = UBUS_STATUS_INVALID_ARGUMENT;
             goto done;
         }
     }
 
-    blobmsg_close_array(response, cookie);
+    blobmsg_close_array(buf, cookie);
+    append_led_response_summary(&response);
 
     result = UBUS_STATUS_OK;
 
@@ -584,17 +1025,16 @@ activate_handler(
 
     struct ledcmd_ubus_context_st * const ubus_context =
         container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
-    struct blob_buf response;
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
 
-    blob_buf_full_init(&response, 0);
-
-    int const result = process_activate_msg(ubus_context, msg, &response);
+    int const result = process_activate_msg(ubus_context, msg, response);
 
     if (result == UBUS_STATUS_OK)
     {
-        ubus_send_reply(ctx, req, response.head);
+        ubus_send_reply(ctx, req, response->head);
     }
-    blob_buf_free(&response);
+    response_buffer_done(&ubus_context->response_buffer);
 
     return result;
 }
@@ -607,7 +1047,7 @@ deactivate_led_cb(
     char const * const error_msg,
     void * const result_context)
 {
-    struct blob_buf * const response = result_context;
+    struct led_response_st * const response = result_context;
 
     append_activate_response(led_name, success, lock_id, error_msg, response);
 }
@@ -617,13 +1057,14 @@ process_deactivate_request(
     struct led_ops_st const * const led_ops,
     struct led_ops_handle_st * const led_ops_handle,
     char const * const led_name,
+    uint32_t const led_id,
     char const * const led_priority,
     char const * const lock_id,
-    struct blob_buf * const response)
+    struct led_response_st * const response)
 {
     bool success;
 
-    if (led_name == NULL)
+    if (led_name == NULL && led_id == LED_ID_NONE)
     {
         success = false;
         goto done;
@@ -633,6 +1074,7 @@ process_deactivate_request(
         led_ops->deactivate_priority(
         led_ops_handle,
         led_name,
+        led_id,
         led_priority,
         lock_id,
         deactivate_led_cb,
@@ -646,12 +1088,13 @@ static bool
 process_deactivate_attr(
     struct led_ops_st const * const led_ops,
     struct led_ops_handle_st * const led_ops_handle,
-    struct blob_attr * const attr,
-    struct blob_buf * const response)
+    struct blob_attr const * const attr,
+    struct led_response_st * const response)
 {
     enum
     {
         LED_NAME,
+        LED_ID,
         LED_PRIORITY,
         LOCK_ID,
         LOCK_MAX__
@@ -660,41 +1103,60 @@ process_deactivate_attr(
     {
         [LED_NAME] =
         { .name = _led_name, .type = BLOBMSG_TYPE_STRING },
+        [LED_ID] =
+        { .name = _led_id, .type = BLOBMSG_TYPE_INT32 },
         [LED_PRIORITY] =
         { .name = _led_priority, .type = BLOBMSG_TYPE_STRING },
         [LOCK_ID] =
         { .name = _led_lock_id, .type = BLOBMSG_TYPE_STRING }
     };
     struct blob_attr * fields[LOCK_MAX__];
+    bool success;
 
     blobmsg_parse(deactivate_led_policy, ARRAY_SIZE(deactivate_led_policy), fields,
                   blobmsg_data(attr), blobmsg_data_len(attr));
 
-    return process_deactivate_request(
-        led_ops,
+    uint32_t led_id;
+
+    if (!led_id_from_attr(led_ops, led_ops_handle, fields[LED_ID], &led_id))
+    {
+        success = false;
+        goto done;
+    }
+
+    success = process_deactivate_request(
+        led_ops,
         led_ops_handle,
         blobmsg_get_string(fields[LED_NAME]),
+        led_id,
         blobmsg_get_string(fields[LED_PRIORITY]),
         blobmsg_get_string(fields[LOCK_ID]),
         response);
+
+done:
+    return success;
 }
 
 enum
 {
     DEACTIVATE_LEDS,
+    DEACTIVATE_VERBOSITY,
+    DEACTIVATE_GENERATION,
     DEACTIVATE_MAX__
 };
 
 static struct blobmsg_policy const deactivate_policy[DEACTIVATE_MAX__] =
 {
-    [DEACTIVATE_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY }
+    [DEACTIVATE_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY },
+    [DEACTIVATE_VERBOSITY] = { .name = _led_verbosity, .type = BLOBMSG_TYPE_STRING },
+    [DEACTIVATE_GENERATION] = { .name = _led_generation, .type = BLOBMSG_TYPE_INT32 }
 };
 
 static int
 process_deactivate_msg(
     struct ledcmd_ubus_context_st * const ubus_context,
     struct blob_attr const * const msg,
-    struct blob_buf * const response)
+    struct blob_buf * const buf)
 {
     int result;
     struct blob_attr * fields[DEACTIVATE_MAX__];
@@ -720,20 +1182,35 @@ process_deactivate_msg(
         goto done;
     }
 
-    void * const cookie = blobmsg_open_array(response, _led_leds);
+    if (!led_id_generation_is_current(ubus_context, fields[DEACTIVATE_GENERATION]))
+    {
+        result = UBUS_STATUS_NOT_FOUND;
+        goto done;
+    }
+
+    struct led_response_st response;
+
+    if (!led_response_init(&response, buf, fields[DEACTIVATE_VERBOSITY]))
+    {
+        result = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    void * const cookie = blobmsg_open_array(buf, _led_leds);
     struct blob_attr * cur;
     int rem;
 
     blobmsg_for_each_attr(cur, array_blob, rem)
     {
-        if (!process_deactivate_attr(led_ops, led_ops_handle, cur, response))
+        if (!process_deactivate_attr(led_ops, led_ops_handle, cur, &response))
         {
             result = UBUS_STATUS_INVALID_ARGUMENT;
             goto done;
         }
     }
 
-    blobmsg_close_array(response, cookie);
+    blobmsg_close_array(buf, cookie);
+    append_led_response_summary(&response);
 
     result = UBUS_STATUS_OK;
 
@@ -756,17 +1233,242 @@ deactivate_handler(
 
     struct ledcmd_ubus_context_st * const ubus_context =
         container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
-    struct blob_buf response;
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
+
+    int const result = process_deactivate_msg(ubus_context, msg, response);
+
+    if (result == UBUS_STATUS_OK)
+    {
+        ubus_send_reply(ctx, req, response->head);
+    }
+    response_buffer_done(&ubus_context->response_buffer);
+
+    return result;
+}
+
+/*
+ * A batch request contains a list of get, set, activate and deactivate
+ * operations, each of which is specified in the same way as an entry in the
+ * 'leds' array of the equivalent request, plus the name of the operation.
+ * The operations are performed in order, and the results of each are
+ * reported in a separate entry in the response, so that clients can match
+ * results to operations even if an operation affects a number of LEDs. The
+ * batch's verbosity applies to the per-LED results of each operation. If
+ * stop_on_error is set, the operations following one that fails are skipped.
+ */
+typedef bool (*process_led_attr_fn)(
+    struct led_ops_st const * led_ops,
+    struct led_ops_handle_st * led_ops_handle,
+    struct blob_attr const * attr,
+    struct led_response_st * response);
+
+static process_led_attr_fn
+batch_op_lookup(char const * const op)
+{
+    static struct
+    {
+        char const * name;
+        process_led_attr_fn process;
+    } const batch_ops[] =
+    {
+        { .name = _led_get, .process = process_get_state_attr },
+        { .name = _led_set, .process = process_set_state_attr },
+        { .name = _led_activate, .process = process_activate_attr },
+        { .name = _led_deactivate, .process = process_deactivate_attr }
+    };
+    process_led_attr_fn process = NULL;
+
+    if (op == NULL)
+    {
+        goto done;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(batch_ops); i++)
+    {
+        if (strcmp(op, batch_ops[i].name) == 0)
+        {
+            process = batch_ops[i].process;
+            break;
+        }
+    }
+
+done:
+    return process;
+}
+
+/*
+ * Returns true if the remaining operations in the batch should be skipped.
+ * An operation may override the batch's stop_on_error setting.
+ */
+static bool
+process_batch_op(
+    struct led_ops_st const * const led_ops,
+    struct led_ops_handle_st * const led_ops_handle,
+    struct blob_attr const * const attr,
+    bool const batch_stop_on_error,
+    enum response_verbosity_t const verbosity,
+    struct blob_buf * const buf)
+{
+    enum
+    {
+        BATCH_OP,
+        BATCH_OP_STOP_ON_ERROR,
+        BATCH_OP_MAX__
+    };
+    struct blobmsg_policy const batch_op_policy[BATCH_OP_MAX__] =
+    {
+        [BATCH_OP] = { .name = _led_op, .type = BLOBMSG_TYPE_STRING },
+        [BATCH_OP_STOP_ON_ERROR] =
+            { .name = _led_stop_on_error, .type = BLOBMSG_TYPE_BOOL }
+    };
+    struct blob_attr * fields[BATCH_OP_MAX__];
+
+    blobmsg_parse(batch_op_policy, ARRAY_SIZE(batch_op_policy), fields,
+                  blobmsg_data(attr), blobmsg_data_len(attr));
+
+    process_led_attr_fn const process = batch_op_lookup(blobmsg_get_string(fields[BATCH_OP]));
+    struct led_response_st response =
+    {
+        .buf = buf,
+        .verbosity = verbosity,
+        .num_succeeded = 0,
+        .num_failed = 0
+    };
+    void * const cookie = blobmsg_open_array(buf, _led_leds);
+    bool const valid_op =
+        process != NULL && process(led_ops, led_ops_handle, attr, &response);
+
+    blobmsg_close_array(buf, cookie);
+    append_led_response_summary(&response);
+
+    bool const success = valid_op && response.num_failed == 0;
+
+    blobmsg_add_u8(buf, _led_success, success);
+    if (!valid_op)
+    {
+        blobmsg_add_string(buf, _led_error, "Invalid operation");
+    }
+
+    bool const stop_on_error =
+        blobmsg_get_bool_or_default(fields[BATCH_OP_STOP_ON_ERROR], batch_stop_on_error);
+
+    return !success && stop_on_error;
+}
+
+enum
+{
+    BATCH_OPS,
+    BATCH_STOP_ON_ERROR,
+    BATCH_GENERATION,
+    BATCH_VERBOSITY,
+    BATCH_MAX__
+};
+
+static struct blobmsg_policy const batch_policy[BATCH_MAX__] =
+{
+    [BATCH_OPS] = { .name = _led_ops, .type = BLOBMSG_TYPE_ARRAY },
+    [BATCH_STOP_ON_ERROR] = { .name = _led_stop_on_error, .type = BLOBMSG_TYPE_BOOL },
+    [BATCH_GENERATION] = { .name = _led_generation, .type = BLOBMSG_TYPE_INT32 },
+    [BATCH_VERBOSITY] = { .name = _led_verbosity, .type = BLOBMSG_TYPE_STRING }
+};
+
+static int
+process_batch_msg(
+    struct ledcmd_ubus_context_st * const ubus_context,
+    struct blob_attr const * const msg,
+    struct blob_buf * const buf)
+{
+    int result;
+    struct blob_attr * fields[BATCH_MAX__];
+    struct led_ops_st const * const led_ops = ubus_context->led_ops;
+    struct led_ops_handle_st * const led_ops_handle =
+        led_ops->open(ubus_context->led_ops_context);
+
+    if (led_ops_handle == NULL)
+    {
+        result = UBUS_STATUS_UNKNOWN_ERROR;
+        goto done;
+    }
+
+    blobmsg_parse(batch_policy, ARRAY_SIZE(batch_policy), fields,
+                  blobmsg_data(msg), blobmsg_len(msg));
+
+    struct blob_attr const * const array_blob = fields[BATCH_OPS];
+    enum response_verbosity_t verbosity;
+
+    if (!blobmsg_array_is_type(array_blob, BLOBMSG_TYPE_TABLE)
+        || !response_verbosity_by_name(blobmsg_get_string(fields[BATCH_VERBOSITY]), &verbosity))
+    {
+        result = UBUS_STATUS_INVALID_ARGUMENT;
+        goto done;
+    }
+
+    if (!led_id_generation_is_current(ubus_context, fields[BATCH_GENERATION]))
+    {
+        result = UBUS_STATUS_NOT_FOUND;
+        goto done;
+    }
+
+    bool const stop_on_error =
+        blobmsg_get_bool_or_default(fields[BATCH_STOP_ON_ERROR], false);
+    bool skip_remaining = false;
+    void * const cookie = blobmsg_open_array(buf, _led_results);
+    struct blob_attr * cur;
+    int rem;
+
+    blobmsg_for_each_attr(cur, array_blob, rem)
+    {
+        void * const op_cookie = blobmsg_open_table(buf, NULL);
+
+        if (skip_remaining)
+        {
+            blobmsg_add_u8(buf, _led_success, false);
+            blobmsg_add_u8(buf, _led_skipped, true);
+        }
+        else
+        {
+            skip_remaining =
+                process_batch_op(
+                    led_ops, led_ops_handle, cur, stop_on_error, verbosity, buf);
+        }
+
+        blobmsg_close_table(buf, op_cookie);
+    }
+
+    blobmsg_close_array(buf, cookie);
 
-    blob_buf_full_init(&response, 0);
+    result = UBUS_STATUS_OK;
 
-    int const result = process_deactivate_msg(ubus_context, msg, &response);
+done:
+    led_ops->close(led_ops_handle);
+
+    return result;
+}
+
+static int
+batch_handler(
+    struct ubus_context * const ctx,
+    struct ubus_object * const obj,
+    struct ubus_request_data * const req,
+    char const * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED_ARG(obj);
+    UNUSED_ARG(method);
+
+    struct ledcmd_ubus_context_st * const ubus_context =
+        container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
+
+    int const result = process_batch_msg(ubus_context, msg, response);
 
     if (result == UBUS_STATUS_OK)
     {
-        ubus_send_reply(ctx, req, response.head);
+        ubus_send_reply(ctx, req, response->head);
     }
-    blob_buf_free(&response);
+    response_buffer_done(&ubus_context->response_buffer);
 
     return result;
 }
@@ -811,12 +1513,12 @@ list_led_names_handler(
 
     struct ledcmd_ubus_context_st * const ubus_context =
         container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
-    struct blob_buf response;
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
 
-    blob_buf_full_init(&response, 0);
-    process_list_names_msg(ubus_context, msg, &response);
-    ubus_send_reply(ctx, req, response.head);
-    blob_buf_free(&response);
+    process_list_names_msg(ubus_context, msg, response);
+    ubus_send_reply(ctx, req, response->head);
+    response_buffer_done(&ubus_context->response_buffer);
 
     return UBUS_STATUS_OK;
 }
@@ -858,12 +1560,14 @@ list_supported_states_handler(
     UNUSED_ARG(obj);
     UNUSED_ARG(method);
 
-    struct blob_buf response;
+    struct ledcmd_ubus_context_st * const ubus_context =
+        container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
 
-    blob_buf_full_init(&response, 0);
-    process_list_supported_states_msg(msg, &response);
-    ubus_send_reply(ctx, req, response.head);
-    blob_buf_free(&response);
+    process_list_supported_states_msg(msg, response);
+    ubus_send_reply(ctx, req, response->head);
+    response_buffer_done(&ubus_context->response_buffer);
 
     return UBUS_STATUS_OK;
 }
@@ -933,17 +1637,16 @@ pattern_play_handler(
 
     struct ledcmd_ubus_context_st * const ubus_context =
         container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
-    struct blob_buf response;
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
 
-    blob_buf_full_init(&response, 0);
-
-    int const result = process_pattern_play_msg(ubus_context, msg, &response);
+    int const result = process_pattern_play_msg(ubus_context, msg, response);
 
     if (result == UBUS_STATUS_OK)
     {
-        ubus_send_reply(ctx, req, response.head);
+        ubus_send_reply(ctx, req, response->head);
     }
-    blob_buf_free(&response);
+    response_buffer_done(&ubus_context->response_buffer);
 
     return result;
 }
@@ -996,17 +1699,16 @@ pattern_stop_handler(
 
     struct ledcmd_ubus_context_st * const ubus_context =
         container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
-    struct blob_buf response;
-
-    blob_buf_full_init(&response, 0);
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
 
-    int const result = process_pattern_stop_msg(ubus_context, msg, &response);
+    int const result = process_pattern_stop_msg(ubus_context, msg, response);
 
     if (result == UBUS_STATUS_OK)
     {
-        ubus_send_reply(ctx, req, response.head);
+        ubus_send_reply(ctx, req, response->head);
     }
-    blob_buf_free(&response);
+    response_buffer_done(&ubus_context->response_buffer);
 
     return result;
 }
@@ -1135,12 +1837,12 @@ pattern_list_handler(
 
     struct ledcmd_ubus_context_st * const ubus_context =
         container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
-    struct blob_buf response;
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
 
-    blob_buf_full_init(&response, 0);
-    process_pattern_list_msg(ubus_context, msg, &response);
-    ubus_send_reply(ctx, req, response.head);
-    blob_buf_free(&response);
+    process_pattern_list_msg(ubus_context, msg, response);
+    ubus_send_reply(ctx, req, response->head);
+    response_buffer_done(&ubus_context->response_buffer);
 
     return UBUS_STATUS_OK;
 }
@@ -1175,12 +1877,371 @@ pattern_list_playing_handler(
 
     struct ledcmd_ubus_context_st * const ubus_context =
         container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
-    struct blob_buf response;
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
 
-    blob_buf_full_init(&response, 0);
-    process_pattern_list_playing_msg(ubus_context, msg, &response);
-    ubus_send_reply(ctx, req, response.head);
-    blob_buf_free(&response);
+    process_pattern_list_playing_msg(ubus_context, msg, response);
+    ubus_send_reply(ctx, req, response->head);
+    response_buffer_done(&ubus_context->response_buffer);
+
+    return UBUS_STATUS_OK;
+}
+
+static void
+resolve_led_cb(
+    char const * const led_name,
+    uint32_t const led_id,
+    void * const result_context)
+{
+    struct blob_buf * const response = result_context;
+    void * const cookie = blobmsg_open_table(response, NULL);
+
+    blobmsg_add_string(response, _led_name, led_name);
+    blobmsg_add_u32(response, _led_id, led_id);
+
+    blobmsg_close_table(response, cookie);
+}
+
+static void
+process_resolve_msg(
+    struct ledcmd_ubus_context_st * const ubus_context,
+    struct blob_buf * const response)
+{
+    struct led_ops_st const * const led_ops = ubus_context->led_ops;
+    void * const cookie = blobmsg_open_array(response, _led_leds);
+    uint32_t const generation =
+        led_ops->resolve_leds(ubus_context->led_ops_context, resolve_led_cb, response);
+
+    blobmsg_close_array(response, cookie);
+    blobmsg_add_u32(response, _led_generation, generation);
+}
+
+static int
+resolve_handler(
+    struct ubus_context * const ctx,
+    struct ubus_object * const obj,
+    struct ubus_request_data * const req,
+    char const * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED_ARG(obj);
+    UNUSED_ARG(method);
+    UNUSED_ARG(msg);
+
+    struct ledcmd_ubus_context_st * const ubus_context =
+        container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
+
+    process_resolve_msg(ubus_context, response);
+
+    ubus_send_reply(ctx, req, response->head);
+    response_buffer_done(&ubus_context->response_buffer);
+
+    return UBUS_STATUS_OK;
+}
+
+static void
+append_led_change_cb(
+    char const * const led_name,
+    struct led_status_st const * const status,
+    void * const result_context)
+{
+    struct blob_buf * const buf = result_context;
+    void * const cookie = blobmsg_open_table(buf, NULL);
+
+    blobmsg_add_string(buf, _led_name, led_name);
+    blobmsg_add_string(buf, _led_state, led_state_query_name(status->state));
+    blobmsg_add_string(buf, _led_priority, led_priority_to_name(status->priority));
+    blobmsg_add_u8(buf, _led_locked, status->locked);
+
+    blobmsg_close_table(buf, cookie);
+}
+
+enum
+{
+    GET_CHANGES_EPOCH,
+    GET_CHANGES_SINCE,
+    GET_CHANGES_MAX__
+};
+
+static struct blobmsg_policy const get_changes_policy[GET_CHANGES_MAX__] =
+{
+    [GET_CHANGES_EPOCH] = { .name = _led_epoch, .type = BLOBMSG_TYPE_INT32 },
+    [GET_CHANGES_SINCE] = { .name = _led_since, .type = BLOBMSG_TYPE_INT32 }
+};
+
+static void
+process_get_changes_msg(
+    struct ledcmd_ubus_context_st * const ubus_context,
+    struct blob_attr const * const msg,
+    struct blob_buf * const response)
+{
+    struct blob_attr * fields[GET_CHANGES_MAX__];
+
+    blobmsg_parse(get_changes_policy, ARRAY_SIZE(get_changes_policy), fields,
+                  blobmsg_data(msg), blobmsg_len(msg));
+
+    /*
+     * A client without a previous epoch (e.g. on its first call) gets the
+     * status of all LEDs.
+     */
+    uint32_t const epoch =
+        blobmsg_get_u32_or_default(fields[GET_CHANGES_EPOCH], 0);
+    uint32_t const since_seq =
+        blobmsg_get_u32_or_default(fields[GET_CHANGES_SINCE], 0);
+    struct led_ops_st const * const led_ops = ubus_context->led_ops;
+    struct led_changes_info_st info;
+    void * const cookie = blobmsg_open_array(response, _led_leds);
+
+    led_ops->get_changes(
+        ubus_context->led_ops_context,
+        epoch,
+        since_seq,
+        &info,
+        append_led_change_cb,
+        response);
+
+    blobmsg_close_array(response, cookie);
+    blobmsg_add_u32(response, _led_epoch, info.epoch);
+    blobmsg_add_u32(response, _led_seq, info.seq);
+    blobmsg_add_u8(response, _led_resync, info.resync);
+}
+
+static int
+get_changes_handler(
+    struct ubus_context * const ctx,
+    struct ubus_object * const obj,
+    struct ubus_request_data * const req,
+    char const * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED_ARG(obj);
+    UNUSED_ARG(method);
+
+    struct ledcmd_ubus_context_st * const ubus_context =
+        container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
+
+    process_get_changes_msg(ubus_context, msg, response);
+
+    ubus_send_reply(ctx, req, response->head);
+    response_buffer_done(&ubus_context->response_buffer);
+
+    return UBUS_STATUS_OK;
+}
+
+static struct ubus_object ledd_object;
+
+static void
+append_histogram(
+    struct blob_buf * const response,
+    char const * const name,
+    struct led_histogram_st const * const histogram)
+{
+    void * const cookie = blobmsg_open_table(response, name);
+
+    blobmsg_add_u64(response, _led_count, histogram->count);
+    blobmsg_add_u64(
+        response,
+        _led_mean_ns,
+        (histogram->count > 0) ? histogram->total_ns / histogram->count : 0);
+    blobmsg_add_u64(response, _led_p50_ns, led_histogram_percentile_ns(histogram, 0.5));
+    blobmsg_add_u64(response, _led_p90_ns, led_histogram_percentile_ns(histogram, 0.9));
+    blobmsg_add_u64(response, _led_p99_ns, led_histogram_percentile_ns(histogram, 0.99));
+    blobmsg_add_u64(response, _led_max_ns, histogram->max_ns);
+
+    /* Only the non-empty buckets are reported, each as [limit_ns, count]. */
+    void * const array_cookie = blobmsg_open_array(response, _led_histogram);
+
+    for (size_t i = 0; i < LED_HISTOGRAM_BUCKETS; i++)
+    {
+        if (histogram->buckets[i] > 0)
+        {
+            void * const bucket_cookie = blobmsg_open_array(response, NULL);
+
+            blobmsg_add_u64(response, NULL, led_histogram_bucket_limit_ns(i));
+            blobmsg_add_u64(response, NULL, histogram->buckets[i]);
+            blobmsg_close_array(response, bucket_cookie);
+        }
+    }
+
+    blobmsg_close_array(response, array_cookie);
+    blobmsg_close_table(response, cookie);
+}
+
+static void
+append_call_stats(
+    struct blob_buf * const response,
+    char const * const name,
+    struct led_call_stats_st const * const call_stats)
+{
+    void * const cookie = blobmsg_open_table(response, name);
+
+    blobmsg_add_u64(response, _led_calls, call_stats->calls);
+    blobmsg_add_u64(response, _led_errors, call_stats->errors);
+    append_histogram(response, _led_latency, &call_stats->latency);
+
+    blobmsg_close_table(response, cookie);
+}
+
+static void
+append_pattern_timing_cb(
+    char const * const pattern_name,
+    struct led_histogram_st const * const lateness,
+    void * const result_context)
+{
+    struct blob_buf * const response = result_context;
+
+    append_histogram(response, pattern_name, lateness);
+}
+
+static void
+process_stats_msg(
+    struct ledcmd_ubus_context_st const * const ubus_context,
+    struct blob_buf * const response)
+{
+    struct led_daemon_stats_st const * const stats = &led_daemon_stats;
+
+    blobmsg_add_u64(
+        response, _led_elapsed_ms, (led_stats_now_ns() - stats->reset_ns) / 1000000);
+
+    void * const methods_cookie = blobmsg_open_table(response, _led_methods);
+
+    for (int i = 0; i < ledd_object.n_methods; i++)
+    {
+        append_call_stats(
+            response, ledd_object.methods[i].name, &ubus_context->method_stats[i]);
+    }
+    blobmsg_close_table(response, methods_cookie);
+
+    void * const backend_cookie = blobmsg_open_table(response, _led_backend);
+
+    append_call_stats(response, _led_set_led_state, &stats->set_led_state);
+    append_call_stats(response, _led_get_led_state, &stats->get_led_state);
+    blobmsg_close_table(response, backend_cookie);
+
+    blobmsg_add_u64(response, _led_flash_timer_firings, stats->flash_timer_firings);
+    blobmsg_add_u64(response, _led_pattern_timer_firings, stats->pattern_timer_firings);
+    blobmsg_add_u64(response, _led_pattern_steps, stats->pattern_steps);
+    blobmsg_add_u64(response, _led_write_elisions, stats->write_elisions);
+
+    struct response_buffer_st const * const response_buffer = &ubus_context->response_buffer;
+    void * const buffer_cookie = blobmsg_open_table(response, _led_response_buffer);
+
+    blobmsg_add_u64(response, _led_high_water, response_buffer->high_water);
+    blobmsg_add_u64(response, _led_allocations, response_buffer->allocations);
+    blobmsg_close_table(response, buffer_cookie);
+
+    void * const lateness_cookie = blobmsg_open_table(response, _led_timer_lateness);
+
+    append_histogram(response, _led_flash, &stats->flash_lateness);
+    append_histogram(response, _led_pattern_pattern, &stats->pattern_lateness);
+
+    void * const patterns_cookie = blobmsg_open_table(response, _led_patterns);
+    struct led_ops_st const * const led_ops = ubus_context->led_ops;
+
+    led_ops->pattern_timing(ubus_context->led_ops_context, append_pattern_timing_cb, response);
+    blobmsg_close_table(response, patterns_cookie);
+    blobmsg_close_table(response, lateness_cookie);
+}
+
+static int
+stats_handler(
+    struct ubus_context * const ctx,
+    struct ubus_object * const obj,
+    struct ubus_request_data * const req,
+    char const * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED_ARG(obj);
+    UNUSED_ARG(method);
+    UNUSED_ARG(msg);
+
+    struct ledcmd_ubus_context_st * const ubus_context =
+        container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
+
+    process_stats_msg(ubus_context, response);
+
+    ubus_send_reply(ctx, req, response->head);
+    response_buffer_done(&ubus_context->response_buffer);
+
+    return UBUS_STATUS_OK;
+}
+
+static int
+stats_reset_handler(
+    struct ubus_context * const ctx,
+    struct ubus_object * const obj,
+    struct ubus_request_data * const req,
+    char const * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED_ARG(obj);
+    UNUSED_ARG(req);
+    UNUSED_ARG(method);
+    UNUSED_ARG(msg);
+
+    struct ledcmd_ubus_context_st * const ubus_context =
+        container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
+
+    memset(
+        ubus_context->method_stats,
+        0,
+        ledd_object.n_methods * sizeof *ubus_context->method_stats);
+    led_daemon_stats_reset();
+
+    struct led_ops_st const * const led_ops = ubus_context->led_ops;
+
+    led_ops->pattern_timing_reset(ubus_context->led_ops_context);
+
+    return UBUS_STATUS_OK;
+}
+
+static void
+process_timer_trace_dump_msg(struct blob_buf * const response)
+{
+    size_t num_records;
+    bool const success = led_timer_trace_dump(&num_records);
+
+    blobmsg_add_u8(response, _led_success, success);
+    if (success)
+    {
+        blobmsg_add_u32(response, _led_records, num_records);
+    }
+    else
+    {
+        blobmsg_add_string(
+            response,
+            _led_error,
+            "The timer trace is disabled, has no file, or the file can't be written");
+    }
+}
+
+static int
+timer_trace_dump_handler(
+    struct ubus_context * const ctx,
+    struct ubus_object * const obj,
+    struct ubus_request_data * const req,
+    char const * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED_ARG(obj);
+    UNUSED_ARG(method);
+    UNUSED_ARG(msg);
+
+    struct ledcmd_ubus_context_st * const ubus_context =
+        container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
+    struct blob_buf * const response =
+        response_buffer_reset(&ubus_context->response_buffer);
+
+    process_timer_trace_dump_msg(response);
+
+    ubus_send_reply(ctx, req, response->head);
+    response_buffer_done(&ubus_context->response_buffer);
 
     return UBUS_STATUS_OK;
 }
@@ -1189,16 +2250,50 @@ static struct ubus_method const ledd_methods[] =
 {
     UBUS_METHOD(_led_get, get_state_handler, get_state_policy),
     UBUS_METHOD(_led_set, set_state_handler, set_state_policy),
+    UBUS_METHOD(_led_set_many, set_many_handler, set_many_policy),
     UBUS_METHOD_NOARG(_led_list, list_led_names_handler),
     UBUS_METHOD_NOARG(_led_list_supported_states, list_supported_states_handler),
     UBUS_METHOD(_led_activate, activate_handler, activate_policy),
     UBUS_METHOD(_led_deactivate, deactivate_handler, deactivate_policy),
+    UBUS_METHOD(_led_batch, batch_handler, batch_policy),
     UBUS_METHOD(_led_pattern_play, pattern_play_handler, pattern_play_policy),
     UBUS_METHOD(_led_pattern_stop, pattern_stop_handler, pattern_stop_policy),
     UBUS_METHOD_NOARG(_led_pattern_list, pattern_list_handler),
-    UBUS_METHOD_NOARG(_led_pattern_list_playing, pattern_list_playing_handler)
+    UBUS_METHOD_NOARG(_led_pattern_list_playing, pattern_list_playing_handler),
+    UBUS_METHOD_NOARG(_led_resolve, resolve_handler),
+    UBUS_METHOD(_led_get_changes, get_changes_handler, get_changes_policy),
+    UBUS_METHOD_NOARG(_led_stats, stats_handler),
+    UBUS_METHOD_NOARG(_led_stats_reset, stats_reset_handler),
+    UBUS_METHOD_NOARG(_led_timer_trace_dump, timer_trace_dump_handler)
 };
 
+/*
+ * The methods registered with ubus. Each is a copy of the entry in
+ * ledd_methods, but with a handler that times the call to the handler in
+ * ledd_methods.
+ */
+static struct ubus_method ledd_timed_methods[ARRAY_SIZE(ledd_methods)];
+
+/*
+ * Methods that don't change LED state aren't journalled, so that replaying a
+ * journal doesn't issue diagnostic requests such as stats_reset.
+ */
+static char const * const unjournalled_methods[] =
+{
+    _led_get,
+    _led_list,
+    _led_list_supported_states,
+    _led_pattern_list,
+    _led_pattern_list_playing,
+    _led_resolve,
+    _led_get_changes,
+    _led_stats,
+    _led_stats_reset,
+    _led_timer_trace_dump
+};
+
+static bool ledd_method_is_journalled[ARRAY_SIZE(ledd_methods)];
+
 static struct ubus_object_type ledd_object_type =
     UBUS_OBJECT_TYPE(_led_ledcmd, ledd_methods);
 
@@ -1206,10 +2301,118 @@ static struct ubus_object ledd_object =
 {
     .name = _led_ledcmd,
     .type = &ledd_object_type,
-    .methods = ledd_methods,
-    .n_methods = ARRAY_SIZE(ledd_methods),
+    .methods = ledd_timed_methods,
+    .n_methods = ARRAY_SIZE(ledd_timed_methods),
+};
+
+static int
+timed_method_handler(
+    size_t const index,
+    struct ubus_context * const ctx,
+    struct ubus_object * const obj,
+    struct ubus_request_data * const req,
+    char const * const method,
+    struct blob_attr * const msg)
+{
+    struct ledcmd_ubus_context_st * const ubus_context =
+        container_of(ctx, struct ledcmd_ubus_context_st, ubus_connection.context);
+
+    LED_TRACE1(method_entry, method);
+    if (ledd_method_is_journalled[index])
+    {
+        led_journal_record(method, msg);
+    }
+
+    uint64_t const start_ns = led_stats_now_ns();
+    int const result = ledd_methods[index].handler(ctx, obj, req, method, msg);
+
+    led_call_stats_record(
+        &ubus_context->method_stats[index], start_ns, result == UBUS_STATUS_OK);
+    LED_TRACE3(method_exit, method, result, led_stats_now_ns() - start_ns);
+
+    return result;
+}
+
+/*
+ * ubus passes a handler the method name from the request, not the entry
+ * in the method table, so each method has its own wrapper that knows
+ * which entry it is timing.
+ */
+#define TIMED_METHOD(index) \
+    static int \
+    timed_method_##index( \
+        struct ubus_context * const ctx, \
+        struct ubus_object * const obj, \
+        struct ubus_request_data * const req, \
+        char const * const method, \
+        struct blob_attr * const msg) \
+    { \
+        return timed_method_handler(index, ctx, obj, req, method, msg); \
+    }
+
+TIMED_METHOD(0)
+TIMED_METHOD(1)
+TIMED_METHOD(2)
+TIMED_METHOD(3)
+TIMED_METHOD(4)
+TIMED_METHOD(5)
+TIMED_METHOD(6)
+TIMED_METHOD(7)
+TIMED_METHOD(8)
+TIMED_METHOD(9)
+TIMED_METHOD(10)
+TIMED_METHOD(11)
+TIMED_METHOD(12)
+TIMED_METHOD(13)
+TIMED_METHOD(14)
+TIMED_METHOD(15)
+TIMED_METHOD(16)
+
+static ubus_handler_t const timed_method_handlers[] =
+{
+    timed_method_0,
+    timed_method_1,
+    timed_method_2,
+    timed_method_3,
+    timed_method_4,
+    timed_method_5,
+    timed_method_6,
+    timed_method_7,
+    timed_method_8,
+    timed_method_9,
+    timed_method_10,
+    timed_method_11,
+    timed_method_12,
+    timed_method_13,
+    timed_method_14,
+    timed_method_15,
+    timed_method_16
 };
 
+_Static_assert(
+    ARRAY_SIZE(timed_method_handlers) == ARRAY_SIZE(ledd_methods),
+    "Each method needs a timed wrapper");
+
+static void
+timed_methods_init(void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(ledd_methods); i++)
+    {
+        ledd_timed_methods[i] = ledd_methods[i];
+        ledd_timed_methods[i].handler = timed_method_handlers[i];
+
+        ledd_method_is_journalled[i] = true;
+        for (size_t j = 0; j < ARRAY_SIZE(unjournalled_methods); j++)
+        {
+            if (strcmp(ledd_methods[i].name, unjournalled_methods[j]) == 0)
+            {
+                ledd_method_is_journalled[i] = false;
+                break;
+            }
+        }
+    }
+}
+
 static void
 ubus_reconnected(struct ubus_connection_ctx_st * const connection_context)
 {
@@ -1237,6 +2440,90 @@ ubus_disconnected(struct ubus_connection_ctx_st * const connection_context)
     log_info("Disconnected from ubus");
 }
 
+void
+ledcmd_ubus_notify_led_changes(
+    struct ledcmd_ubus_context_st * const ledcmd_ubus_context,
+    uint32_t const seq,
+    led_changes_iterate_fn const iterate,
+    void * const iterate_context)
+{
+    /* Don't bother building the message if no-one will receive it. */
+    if (ledcmd_ubus_context == NULL || !ledd_object.has_subscribers)
+    {
+        goto done;
+    }
+
+    struct blob_buf * const buf =
+        response_buffer_reset(&ledcmd_ubus_context->notify_buffer);
+
+    blobmsg_add_u32(buf, _led_seq, seq);
+
+    void * const cookie = blobmsg_open_array(buf, _led_leds);
+
+    iterate(iterate_context, append_led_change_cb, buf);
+    blobmsg_close_array(buf, cookie);
+
+    int const no_reply_timeout = -1;
+
+    ubus_notify(
+        &ledcmd_ubus_context->ubus_connection.context,
+        &ledd_object,
+        _led_leds_changed,
+        buf->head,
+        no_reply_timeout);
+    response_buffer_done(&ledcmd_ubus_context->notify_buffer);
+
+done:
+    return;
+}
+
+static char const *
+pattern_event_name(enum led_pattern_event_t const event)
+{
+    static char const * const event_names[] =
+    {
+        [LED_PATTERN_EVENT_STARTED] = _led_pattern_started,
+        [LED_PATTERN_EVENT_STEP_WRAPPED] = _led_pattern_step_wrapped,
+        [LED_PATTERN_EVENT_FINISHED] = _led_pattern_finished,
+        [LED_PATTERN_EVENT_STOPPED] = _led_pattern_stopped,
+        [LED_PATTERN_EVENT_PREEMPTED] = _led_pattern_preempted
+    };
+
+    return (size_t)event < ARRAY_SIZE(event_names) ? event_names[event] : NULL;
+}
+
+void
+ledcmd_ubus_send_pattern_event(
+    struct ledcmd_ubus_context_st * const ledcmd_ubus_context,
+    char const * const pattern_name,
+    enum led_pattern_event_t const event,
+    char const * const preempted_by)
+{
+    char const * const event_name = pattern_event_name(event);
+
+    if (ledcmd_ubus_context == NULL || event_name == NULL)
+    {
+        goto done;
+    }
+
+    struct blob_buf * const buf =
+        response_buffer_reset(&ledcmd_ubus_context->notify_buffer);
+
+    blobmsg_add_string(buf, _led_pattern_name, pattern_name);
+    blobmsg_add_string(buf, _led_event, event_name);
+    if (preempted_by != NULL)
+    {
+        blobmsg_add_string(buf, _led_pattern_preempted_by, preempted_by);
+    }
+
+    ubus_send_event(
+        &ledcmd_ubus_context->ubus_connection.context, _led_pattern_event, buf->head);
+    response_buffer_done(&ledcmd_ubus_context->notify_buffer);
+
+done:
+    return;
+}
+
 void
 ledcmd_ubus_deinit(
     struct ledcmd_ubus_context_st * const ledcmd_ubus_context)
@@ -1246,7 +2533,13 @@ ledcmd_ubus_deinit(
         goto done;
     }
 
-    ubus_connection_shutdown(&ledcmd_ubus_context->ubus_connection);
+    if (ledcmd_ubus_context->connected)
+    {
+        ubus_connection_shutdown(&ledcmd_ubus_context->ubus_connection);
+    }
+    response_buffer_free(&ledcmd_ubus_context->response_buffer);
+    response_buffer_free(&ledcmd_ubus_context->notify_buffer);
+    free(ledcmd_ubus_context->method_stats);
     free(ledcmd_ubus_context);
 
 done:
@@ -1254,12 +2547,11 @@ done:
 }
 
 struct ledcmd_ubus_context_st *
-ledcmd_ubus_init(
-    char const * const ubus_path,
+ledcmd_ubus_init_unconnected(
     struct led_ops_st const * const led_ops,
     void * const led_ops_context)
 {
-    struct ledcmd_ubus_context_st * const ledcmd_ubus_context =
+    struct ledcmd_ubus_context_st * ledcmd_ubus_context =
         calloc(1, sizeof *ledcmd_ubus_context);
 
     if (ledcmd_ubus_context == NULL)
@@ -1267,9 +2559,42 @@ ledcmd_ubus_init(
         goto done;
     }
 
+    ledcmd_ubus_context->method_stats =
+        calloc(ARRAY_SIZE(ledd_methods), sizeof *ledcmd_ubus_context->method_stats);
+    if (ledcmd_ubus_context->method_stats == NULL)
+    {
+        free(ledcmd_ubus_context);
+        ledcmd_ubus_context = NULL;
+        goto done;
+    }
+
+    timed_methods_init();
     ledcmd_ubus_context->led_ops = led_ops;
     ledcmd_ubus_context->led_ops_context = led_ops_context;
+    response_buffer_init(
+        &ledcmd_ubus_context->response_buffer, initial_response_buffer_size);
+    response_buffer_init(
+        &ledcmd_ubus_context->notify_buffer, initial_notify_buffer_size);
 
+done:
+    return ledcmd_ubus_context;
+}
+
+struct ledcmd_ubus_context_st *
+ledcmd_ubus_init(
+    char const * const ubus_path,
+    struct led_ops_st const * const led_ops,
+    void * const led_ops_context)
+{
+    struct ledcmd_ubus_context_st * const ledcmd_ubus_context =
+        ledcmd_ubus_init_unconnected(led_ops, led_ops_context);
+
+    if (ledcmd_ubus_context == NULL)
+    {
+        goto done;
+    }
+
+    ledcmd_ubus_context->connected = true;
     ubus_connection_init(
         &ledcmd_ubus_context->ubus_connection,
         ubus_path,
@@ -1281,3 +2606,26 @@ done:
     return ledcmd_ubus_context;
 }
 
+int
+ledcmd_ubus_call(
+    struct ledcmd_ubus_context_st * const ledcmd_ubus_context,
+    char const * const method,
+    struct blob_attr * const msg)
+{
+    int result = UBUS_STATUS_METHOD_NOT_FOUND;
+    struct ubus_request_data req;
+
+    memset(&req, 0, sizeof req);
+
+    for (int i = 0; i < ledd_object.n_methods; i++)
+    {
+        if (strcmp(ledd_object.methods[i].name, method) == 0)
+        {
+            result = ledd_object.methods[i].handler(
+                &ledcmd_ubus_context->ubus_connection.context, &ledd_object, &req, method, msg);
+            break;
+        }
+    }
+
+    return result;
+}
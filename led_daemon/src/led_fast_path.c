@@ -0,0 +1,475 @@
+#include "led_fast_path.h"
+#include "flash_types.h"
+#include "led_command_ring.h"
+#include "led_states.h"
+
+#include <lib_led/led_fast_path_layout.h>
+#include <lib_log/log.h>
+#include <ubus_utils/ubus_utils.h>
+
+#include <libubox/list.h>
+#include <libubox/uloop.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* Only the daemon's owner and group may connect. */
+#define FAST_PATH_SOCKET_MODE 0660
+#define FAST_PATH_LISTEN_BACKLOG 8
+/* Limits the time spent on one client before others are serviced. */
+#define FAST_PATH_MAX_FRAMES_PER_READ 16
+
+struct led_fast_path_st
+{
+    char * socket_path;
+    struct uloop_fd listen_fd;
+    struct list_head clients;
+    struct led_ops_st const * led_ops;
+    void * led_ops_context;
+    /* Large enough for any valid frame, plus one byte to detect oversized ones. */
+    union
+    {
+        struct led_fast_path_header_st header;
+        uint8_t bytes[LED_FAST_PATH_MAX_FRAME_SIZE + 1];
+    } frame;
+};
+
+struct fast_path_client_st
+{
+    struct list_head node;
+    struct uloop_fd fd;
+    struct led_fast_path_st * fast_path;
+    /* The client's command ring, if it has registered one. */
+    led_command_ring_st * ring;
+};
+
+struct fast_path_result_st
+{
+    uint32_t num_failed;
+};
+
+static void
+client_free(struct fast_path_client_st * const client)
+{
+    uloop_fd_delete(&client->fd);
+    close(client->fd.fd);
+    list_del(&client->node);
+    led_command_ring_free(client->ring);
+    free(client);
+}
+
+static void
+send_ack(
+    struct fast_path_client_st const * const client,
+    uint32_t const seq,
+    enum led_fast_path_status_t const status,
+    uint32_t const num_failed)
+{
+    struct led_fast_path_ack_st const ack =
+    {
+        .magic = LED_FAST_PATH_MAGIC,
+        .seq = seq,
+        .status = status,
+        .num_failed = num_failed
+    };
+
+    /* A client that doesn't read its acknowledgements loses them. */
+    if (send(client->fd.fd, &ack, sizeof ack, MSG_DONTWAIT | MSG_NOSIGNAL) < 0
+        && errno != EAGAIN)
+    {
+        log_error("Failed to send fast path acknowledgement: %m");
+    }
+}
+
+static void
+count_failures_cb(
+    char const * const led_name,
+    bool const success,
+    char const * const state,
+    char const * const error_msg,
+    void * const user_context)
+{
+    UNUSED_ARG(led_name);
+    UNUSED_ARG(state);
+    UNUSED_ARG(error_msg);
+
+    struct fast_path_result_st * const result = user_context;
+
+    if (!success)
+    {
+        result->num_failed++;
+    }
+}
+
+static enum led_fast_path_status_t
+apply_frame(
+    struct led_fast_path_st const * const fast_path,
+    struct led_fast_path_header_st * const header,
+    size_t const frame_len,
+    uint32_t * const num_failed)
+{
+    enum led_fast_path_status_t status;
+    struct led_ops_st const * const led_ops = fast_path->led_ops;
+    struct led_ops_handle_st * led_ops_handle = NULL;
+
+    if (frame_len < sizeof *header
+        || header->magic != LED_FAST_PATH_MAGIC
+        || header->version != LED_FAST_PATH_VERSION
+        || header->num_entries > LED_FAST_PATH_MAX_ENTRIES
+        || frame_len
+           != sizeof *header + header->num_entries * sizeof(struct led_fast_path_entry_st))
+    {
+        status = LED_FAST_PATH_STATUS_INVALID_FRAME;
+        goto done;
+    }
+
+    if (header->generation != led_ops->led_id_generation(fast_path->led_ops_context))
+    {
+        status = LED_FAST_PATH_STATUS_STALE_IDS;
+        goto done;
+    }
+
+    led_ops_handle = led_ops->open(fast_path->led_ops_context);
+    if (led_ops_handle == NULL)
+    {
+        status = LED_FAST_PATH_STATUS_FAILED;
+        *num_failed = header->num_entries;
+        goto done;
+    }
+
+    /* Don't trust the client to have terminated the strings. */
+    header->priority[sizeof header->priority - 1] = '\0';
+    header->lock_id[sizeof header->lock_id - 1] = '\0';
+
+    struct led_fast_path_entry_st const * const entries =
+        (struct led_fast_path_entry_st const *)(header + 1);
+    struct set_state_req_st set_state_req =
+    {
+        .lock_id = (header->lock_id[0] != '\0') ? header->lock_id : NULL,
+        .led_priority = (header->priority[0] != '\0') ? header->priority : NULL,
+        .flash_type = LED_FLASH_TYPE_NONE
+    };
+    struct fast_path_result_st result =
+    {
+        .num_failed = 0
+    };
+
+    for (uint32_t i = 0; i < header->num_entries; i++)
+    {
+        set_state_req.led_id = entries[i].led_id;
+        set_state_req.state = led_state_by_value(entries[i].state);
+
+        if (set_state_req.led_id == LED_ID_NONE
+            || set_state_req.state == LED_STATE_UNKNOWN
+            || !led_ops->set_state(
+                led_ops_handle, &set_state_req, count_failures_cb, &result))
+        {
+            result.num_failed++;
+        }
+    }
+
+    *num_failed = result.num_failed;
+    status = (result.num_failed == 0) ? LED_FAST_PATH_STATUS_OK : LED_FAST_PATH_STATUS_FAILED;
+
+done:
+    led_ops->close(led_ops_handle);
+
+    return status;
+}
+
+/*
+ * The reply to a ring registration carries the ring's descriptors, or none
+ * if the ring couldn't be created.
+ */
+static void
+send_ring_reply(
+    struct fast_path_client_st const * const client,
+    led_command_ring_st const * const ring)
+{
+    struct led_fast_path_ack_st ack =
+    {
+        .magic = LED_COMMAND_RING_MAGIC,
+        .status = (ring != NULL) ? LED_FAST_PATH_STATUS_OK : LED_FAST_PATH_STATUS_FAILED
+    };
+    int fds[2];
+    union
+    {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof fds)];
+    } control;
+    struct iovec iov =
+    {
+        .iov_base = &ack,
+        .iov_len = sizeof ack
+    };
+    struct msghdr msg =
+    {
+        .msg_iov = &iov,
+        .msg_iovlen = 1
+    };
+
+    if (ring != NULL)
+    {
+        fds[0] = led_command_ring_memfd(ring);
+        fds[1] = led_command_ring_eventfd(ring);
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof control.buf;
+
+        struct cmsghdr * const cmsg = CMSG_FIRSTHDR(&msg);
+
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof fds);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof fds);
+    }
+
+    if (sendmsg(client->fd.fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+    {
+        log_error("Failed to send command ring reply: %m");
+    }
+}
+
+static void
+register_command_ring(struct fast_path_client_st * const client)
+{
+    struct led_fast_path_st * const fast_path = client->fast_path;
+    struct led_command_ring_request_st const * const request =
+        (struct led_command_ring_request_st const *)fast_path->frame.bytes;
+    led_command_ring_st * const ring =
+        led_command_ring_create(request, fast_path->led_ops, fast_path->led_ops_context);
+
+    if (ring != NULL)
+    {
+        /* A client has at most one ring, so a new one replaces the old. */
+        led_command_ring_free(client->ring);
+        client->ring = ring;
+    }
+    send_ring_reply(client, ring);
+}
+
+static bool
+is_ring_request(struct led_fast_path_st const * const fast_path, size_t const frame_len)
+{
+    struct led_command_ring_request_st const * const request =
+        (struct led_command_ring_request_st const *)fast_path->frame.bytes;
+
+    return frame_len == sizeof *request && request->magic == LED_COMMAND_RING_MAGIC;
+}
+
+static void
+process_frame(
+    struct fast_path_client_st * const client, size_t const frame_len)
+{
+    struct led_fast_path_st * const fast_path = client->fast_path;
+
+    if (is_ring_request(fast_path, frame_len))
+    {
+        register_command_ring(client);
+        goto done;
+    }
+
+    struct led_fast_path_header_st * const header = &fast_path->frame.header;
+    uint32_t num_failed = 0;
+    enum led_fast_path_status_t const status =
+        apply_frame(fast_path, header, frame_len, &num_failed);
+    bool const header_valid = frame_len >= sizeof *header;
+    bool const ack_requested = header_valid && (header->flags & LED_FAST_PATH_FLAG_ACK) != 0;
+
+    if (ack_requested || status != LED_FAST_PATH_STATUS_OK)
+    {
+        send_ack(client, header_valid ? header->seq : 0, status, num_failed);
+    }
+
+done:
+    return;
+}
+
+static void
+client_fd_cb(struct uloop_fd * const fd, unsigned int const events)
+{
+    UNUSED_ARG(events);
+
+    struct fast_path_client_st * const client =
+        container_of(fd, struct fast_path_client_st, fd);
+    struct led_fast_path_st * const fast_path = client->fast_path;
+
+    for (size_t i = 0; i < FAST_PATH_MAX_FRAMES_PER_READ; i++)
+    {
+        ssize_t const frame_len =
+            recv(fd->fd, fast_path->frame.bytes, sizeof fast_path->frame.bytes, MSG_DONTWAIT);
+
+        if (frame_len < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            break;
+        }
+        if (frame_len <= 0)
+        {
+            client_free(client);
+            break;
+        }
+
+        process_frame(client, frame_len);
+    }
+}
+
+static void
+listen_fd_cb(struct uloop_fd * const fd, unsigned int const events)
+{
+    UNUSED_ARG(events);
+
+    struct led_fast_path_st * const fast_path =
+        container_of(fd, struct led_fast_path_st, listen_fd);
+    int const client_fd = accept4(fd->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (client_fd < 0)
+    {
+        if (errno != EAGAIN && errno != EINTR)
+        {
+            log_error("Failed to accept fast path connection: %m");
+        }
+        goto done;
+    }
+
+    struct fast_path_client_st * const client = calloc(1, sizeof *client);
+
+    if (client == NULL)
+    {
+        close(client_fd);
+        goto done;
+    }
+
+    client->fast_path = fast_path;
+    client->fd.fd = client_fd;
+    client->fd.cb = client_fd_cb;
+    list_add_tail(&client->node, &fast_path->clients);
+    uloop_fd_add(&client->fd, ULOOP_READ);
+
+done:
+    return;
+}
+
+static int
+open_listen_socket(char const * const socket_path)
+{
+    int fd = -1;
+    struct sockaddr_un addr =
+    {
+        .sun_family = AF_UNIX
+    };
+
+    if (strlen(socket_path) >= sizeof addr.sun_path)
+    {
+        log_error("Fast path socket path too long: %s", socket_path);
+        goto done;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        log_error("Failed to create fast path socket: %m");
+        goto done;
+    }
+
+    /* Remove any socket left behind by a previous instance. */
+    unlink(socket_path);
+
+    /*
+     * bind() creates the socket with the permissions allowed by the umask,
+     * so restrict them to no more than the final mode, which the chmod()
+     * then sets regardless of the caller's umask.
+     */
+    mode_t const old_umask = umask(~FAST_PATH_SOCKET_MODE & 0777);
+    bool const bound = bind(fd, (struct sockaddr const *)&addr, sizeof addr) == 0;
+
+    umask(old_umask);
+
+    if (!bound
+        || chmod(socket_path, FAST_PATH_SOCKET_MODE) < 0
+        || listen(fd, FAST_PATH_LISTEN_BACKLOG) < 0)
+    {
+        log_error("Failed to listen on fast path socket %s: %m", socket_path);
+        close(fd);
+        fd = -1;
+        goto done;
+    }
+
+done:
+    return fd;
+}
+
+void
+led_fast_path_free(led_fast_path_st * const fast_path)
+{
+    if (fast_path == NULL)
+    {
+        goto done;
+    }
+
+    struct fast_path_client_st * client;
+    struct fast_path_client_st * tmp;
+
+    list_for_each_entry_safe(client, tmp, &fast_path->clients, node)
+    {
+        client_free(client);
+    }
+
+    if (fast_path->listen_fd.fd >= 0)
+    {
+        uloop_fd_delete(&fast_path->listen_fd);
+        close(fast_path->listen_fd.fd);
+    }
+    if (fast_path->socket_path != NULL)
+    {
+        unlink(fast_path->socket_path);
+    }
+    free(fast_path->socket_path);
+    free(fast_path);
+
+done:
+    return;
+}
+
+led_fast_path_st *
+led_fast_path_create(
+    char const * const socket_path,
+    struct led_ops_st const * const led_ops,
+    void * const led_ops_context)
+{
+    struct led_fast_path_st * fast_path = NULL;
+
+    if (socket_path == NULL || socket_path[0] == '\0')
+    {
+        goto done;
+    }
+
+    fast_path = calloc(1, sizeof *fast_path);
+    if (fast_path == NULL)
+    {
+        goto done;
+    }
+
+    INIT_LIST_HEAD(&fast_path->clients);
+    fast_path->led_ops = led_ops;
+    fast_path->led_ops_context = led_ops_context;
+    fast_path->listen_fd.cb = listen_fd_cb;
+    fast_path->listen_fd.fd = open_listen_socket(socket_path);
+    fast_path->socket_path = strdup(socket_path);
+
+    if (fast_path->listen_fd.fd < 0 || fast_path->socket_path == NULL)
+    {
+        led_fast_path_free(fast_path);
+        fast_path = NULL;
+        goto done;
+    }
+
+    uloop_fd_add(&fast_path->listen_fd, ULOOP_READ);
+
+done:
+    return fast_path;
+}
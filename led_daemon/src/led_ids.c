@@ -0,0 +1,254 @@
+#include "led_ids.h"
+
+#include <stdlib.h>
+
+struct led_ids_st
+{
+    uint32_t generation;
+    size_t num_targets;
+    struct led_id_target_st * targets;
+    struct led_ctx_st * * leds;
+};
+
+/*
+ * The targets are populated in two passes. The first counts the number of
+ * targets and LEDs so that the tables can be allocated, and the second fills
+ * them in.
+ */
+struct led_ids_builder_st
+{
+    struct avl_tree * all_leds;
+    led_aliases_st const * led_aliases;
+    struct led_ids_st * led_ids;
+    bool counting;
+    size_t num_targets;
+    size_t num_leds;
+};
+
+static uint32_t const fnv_offset_basis = 2166136261u;
+static uint32_t const fnv_prime = 16777619u;
+
+static uint32_t
+hash_name(uint32_t hash, char const * const name)
+{
+    /* Include the terminator so that {"ab", "c"} and {"a", "bc"} differ. */
+    for (char const * p = name; ; p++)
+    {
+        hash ^= (unsigned char)*p;
+        hash *= fnv_prime;
+        if (*p == '\0')
+        {
+            break;
+        }
+    }
+
+    return hash;
+}
+
+static void
+target_begin(
+    struct led_ids_builder_st * const builder,
+    char const * const name,
+    bool const is_alias)
+{
+    if (!builder->counting)
+    {
+        struct led_ids_st * const led_ids = builder->led_ids;
+        struct led_id_target_st * const target =
+            &led_ids->targets[builder->num_targets];
+
+        target->name = name;
+        target->is_alias = is_alias;
+        target->num_leds = 0;
+        target->leds = &led_ids->leds[builder->num_leds];
+        led_ids->generation = hash_name(led_ids->generation, name);
+    }
+
+    builder->num_targets++;
+}
+
+static void
+target_add_led(
+    struct led_ids_builder_st * const builder,
+    struct led_ctx_st * const led_ctx)
+{
+    if (!builder->counting)
+    {
+        struct led_ids_st * const led_ids = builder->led_ids;
+        struct led_id_target_st * const target =
+            &led_ids->targets[builder->num_targets - 1];
+
+        led_ids->leds[builder->num_leds] = led_ctx;
+        target->num_leds++;
+    }
+
+    builder->num_leds++;
+}
+
+static bool
+add_aliased_led_cb(char const * const led_name, void * const user_ctx)
+{
+    struct led_ids_builder_st * const builder = user_ctx;
+    struct led_ctx_st * const led_ctx =
+        avl_find_element(builder->all_leds, led_name, led_ctx, node);
+
+    /* Aliased LEDs that don't exist on this platform are ignored. */
+    if (led_ctx != NULL)
+    {
+        target_add_led(builder, led_ctx);
+    }
+
+    bool const continue_iteration = true;
+
+    return continue_iteration;
+}
+
+static bool
+add_alias_target_cb(led_alias_st const * const led_alias, void * const user_ctx)
+{
+    struct led_ids_builder_st * const builder = user_ctx;
+    char const * const alias_name = led_alias_name(led_alias);
+
+    /* An alias named after an LED shares the LED's target. */
+    if (avl_find(builder->all_leds, alias_name) == NULL)
+    {
+        target_begin(builder, alias_name, true);
+        led_alias_iterate(led_alias, add_aliased_led_cb, builder);
+    }
+
+    bool const continue_iteration = true;
+
+    return continue_iteration;
+}
+
+static void
+populate_targets(struct led_ids_builder_st * const builder)
+{
+    struct led_ctx_st * led_ctx;
+
+    builder->num_targets = 0;
+    builder->num_leds = 0;
+
+    avl_for_each_element(builder->all_leds, led_ctx, node)
+    {
+        char const * const led_name = led_ctx->node.key;
+        led_alias_st const * const led_alias =
+            led_alias_lookup(builder->led_aliases, led_name);
+
+        /*
+         * A request by name for a name that is both an LED and an alias
+         * applies to the aliased LEDs and then the LED, so the target for the
+         * name does the same. The result for the LED is the result for the
+         * name, so the target isn't treated as an alias.
+         */
+        target_begin(builder, led_name, false);
+        if (led_alias != NULL)
+        {
+            led_alias_iterate(led_alias, add_aliased_led_cb, builder);
+        }
+        target_add_led(builder, led_ctx);
+    }
+
+    led_aliases_iterate(builder->led_aliases, add_alias_target_cb, builder);
+}
+
+void
+led_ids_free(struct led_ids_st * const led_ids)
+{
+    if (led_ids == NULL)
+    {
+        goto done;
+    }
+
+    free(led_ids->targets);
+    free(led_ids->leds);
+    free(led_ids);
+
+done:
+    return;
+}
+
+struct led_ids_st *
+led_ids_create(
+    struct avl_tree * const all_leds, led_aliases_st const * const led_aliases)
+{
+    bool success;
+    struct led_ids_st * led_ids = calloc(1, sizeof *led_ids);
+
+    if (led_ids == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    struct led_ids_builder_st builder =
+    {
+        .all_leds = all_leds,
+        .led_aliases = led_aliases,
+        .led_ids = led_ids,
+        .counting = true
+    };
+
+    populate_targets(&builder);
+
+    led_ids->targets = calloc(builder.num_targets, sizeof *led_ids->targets);
+    led_ids->leds = calloc(builder.num_leds, sizeof *led_ids->leds);
+    if ((builder.num_targets > 0 && led_ids->targets == NULL)
+        || (builder.num_leds > 0 && led_ids->leds == NULL))
+    {
+        success = false;
+        goto done;
+    }
+
+    led_ids->num_targets = builder.num_targets;
+    led_ids->generation = fnv_offset_basis;
+    builder.counting = false;
+    populate_targets(&builder);
+
+    success = true;
+
+done:
+    if (!success)
+    {
+        led_ids_free(led_ids);
+        led_ids = NULL;
+    }
+
+    return led_ids;
+}
+
+uint32_t
+led_ids_generation(struct led_ids_st const * const led_ids)
+{
+    return led_ids->generation;
+}
+
+struct led_id_target_st const *
+led_ids_lookup(struct led_ids_st const * const led_ids, uint32_t const led_id)
+{
+    struct led_id_target_st const * target;
+
+    /* IDs start at 1 so that LED_ID_NONE is never a valid ID. */
+    if (led_ids == NULL || led_id == LED_ID_NONE || led_id > led_ids->num_targets)
+    {
+        target = NULL;
+        goto done;
+    }
+
+    target = &led_ids->targets[led_id - 1];
+
+done:
+    return target;
+}
+
+void
+led_ids_iterate(
+    struct led_ids_st const * const led_ids,
+    void (* const cb)(char const * name, uint32_t led_id, void * user_ctx),
+    void * const user_ctx)
+{
+    for (size_t i = 0; i < led_ids->num_targets; i++)
+    {
+        cb(led_ids->targets[i].name, i + 1, user_ctx);
+    }
+}
@@ -0,0 +1,280 @@
+#include "led_journal.h"
+#include "led_journal_format.h"
+#include "led_stats.h"
+
+#include <lib_log/log.h>
+#include <ubus_utils/ubus_utils.h>
+
+#include <libubox/uloop.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Buffered requests are written after this time even if fewer than N arrive. */
+#define JOURNAL_FLUSH_INTERVAL_MS 1000
+/* The buffer holds at least this much, and room for N records of this size. */
+#define JOURNAL_MIN_BUFFER_SIZE (64 * 1024)
+#define JOURNAL_TYPICAL_RECORD_SIZE 256
+
+struct led_journal_st
+{
+    int fd;
+    uint8_t * buffer;
+    size_t buffer_size;
+    size_t buffer_used;
+    size_t records_buffered;
+    size_t records_per_write;
+    struct uloop_timeout flush_timer;
+    /* Requests that couldn't be written. Only the first failure is logged. */
+    uint64_t records_dropped;
+};
+
+static struct led_journal_st journal =
+{
+    .fd = -1
+};
+
+static bool
+write_all(int const fd, void const * const data, size_t const len)
+{
+    bool success = true;
+    uint8_t const * cursor = data;
+    size_t remaining = len;
+
+    while (remaining > 0 && success)
+    {
+        ssize_t const written = write(fd, cursor, remaining);
+
+        if (written >= 0)
+        {
+            cursor += written;
+            remaining -= written;
+        }
+        else
+        {
+            success = errno == EINTR;
+        }
+    }
+
+    return success;
+}
+
+static void
+journal_flush(void)
+{
+    uloop_timeout_cancel(&journal.flush_timer);
+
+    if (journal.buffer_used == 0)
+    {
+        goto done;
+    }
+
+    if (!write_all(journal.fd, journal.buffer, journal.buffer_used))
+    {
+        if (journal.records_dropped == 0)
+        {
+            log_error("Unable to write to the request journal: %m");
+        }
+        journal.records_dropped += journal.records_buffered;
+    }
+
+    journal.buffer_used = 0;
+    journal.records_buffered = 0;
+
+done:
+    return;
+}
+
+static void
+flush_timer_cb(struct uloop_timeout * const timeout)
+{
+    UNUSED_ARG(timeout);
+
+    journal_flush();
+}
+
+void
+led_journal_record(char const * const method, struct blob_attr const * const msg)
+{
+    if (journal.fd < 0)
+    {
+        goto done;
+    }
+
+    struct led_journal_record_st const record =
+    {
+        .timestamp_ns = led_stats_now_ns(),
+        .method_len = strlen(method),
+        .args_len = (msg != NULL) ? blob_raw_len(msg) : 0
+    };
+    size_t const len = sizeof record + record.method_len + record.args_len;
+
+    if (journal.buffer_used + len > journal.buffer_size)
+    {
+        journal_flush();
+    }
+
+    if (len > journal.buffer_size)
+    {
+        /* Too large to buffer, so write it directly. */
+        if (!write_all(journal.fd, &record, sizeof record)
+            || !write_all(journal.fd, method, record.method_len)
+            || !write_all(journal.fd, msg, record.args_len))
+        {
+            journal.records_dropped++;
+        }
+        goto done;
+    }
+
+    uint8_t * const cursor = journal.buffer + journal.buffer_used;
+
+    memcpy(cursor, &record, sizeof record);
+    memcpy(cursor + sizeof record, method, record.method_len);
+    if (record.args_len > 0)
+    {
+        memcpy(cursor + sizeof record + record.method_len, msg, record.args_len);
+    }
+    journal.buffer_used += len;
+    journal.records_buffered++;
+
+    if (journal.records_buffered >= journal.records_per_write)
+    {
+        journal_flush();
+    }
+    else if (!journal.flush_timer.pending)
+    {
+        uloop_timeout_set(&journal.flush_timer, JOURNAL_FLUSH_INTERVAL_MS);
+    }
+
+done:
+    return;
+}
+
+void
+led_journal_close(void)
+{
+    if (journal.fd < 0)
+    {
+        goto done;
+    }
+
+    journal_flush();
+    if (journal.records_dropped > 0)
+    {
+        log_error("%llu requests weren't written to the journal",
+                  (unsigned long long)journal.records_dropped);
+    }
+    close(journal.fd);
+    free(journal.buffer);
+    memset(&journal, 0, sizeof journal);
+    journal.fd = -1;
+
+done:
+    return;
+}
+
+/*
+ * Start a new journal with a header, or check that an existing one is a
+ * journal in this format and mark where this session's requests begin.
+ */
+static bool
+journal_start_session(int const fd, char const * const path, uint64_t const now_ns)
+{
+    bool success;
+    struct stat st;
+    struct led_journal_header_st header =
+    {
+        .magic = LED_JOURNAL_MAGIC,
+        .version = LED_JOURNAL_VERSION,
+        .start_ns = now_ns
+    };
+    struct led_journal_record_st const session_marker =
+    {
+        .timestamp_ns = now_ns
+    };
+
+    if (fstat(fd, &st) != 0)
+    {
+        success = false;
+        goto done;
+    }
+
+    if (st.st_size == 0)
+    {
+        success = write_all(fd, &header, sizeof header);
+        goto done;
+    }
+
+    if (pread(fd, &header, sizeof header, 0) != (ssize_t)sizeof header
+        || header.magic != LED_JOURNAL_MAGIC
+        || header.version != LED_JOURNAL_VERSION)
+    {
+        log_error("%s isn't a version %u request journal", path, LED_JOURNAL_VERSION);
+        success = false;
+        goto done;
+    }
+
+    success = write_all(fd, &session_marker, sizeof session_marker);
+
+done:
+    return success;
+}
+
+bool
+led_journal_open(char const * const path, size_t const records_per_write)
+{
+    bool success;
+
+    led_journal_close();
+
+    if (records_per_write == 0 || records_per_write > LED_JOURNAL_MAX_RECORDS_PER_WRITE)
+    {
+        success = false;
+        goto done;
+    }
+
+    size_t const buffer_size = records_per_write * JOURNAL_TYPICAL_RECORD_SIZE;
+
+    journal.buffer_size =
+        (buffer_size > JOURNAL_MIN_BUFFER_SIZE) ? buffer_size : JOURNAL_MIN_BUFFER_SIZE;
+    journal.buffer = malloc(journal.buffer_size);
+    if (journal.buffer == NULL)
+    {
+        success = false;
+        goto done;
+    }
+    /* Touch the buffer now so that recording doesn't incur page faults. */
+    memset(journal.buffer, 0xff, journal.buffer_size);
+
+    /* Opened for reading too, so that an existing journal's header can be checked. */
+    journal.fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+    if (journal.fd < 0 || !journal_start_session(journal.fd, path, led_stats_now_ns()))
+    {
+        success = false;
+        goto done;
+    }
+
+    journal.records_per_write = records_per_write;
+    journal.flush_timer.cb = flush_timer_cb;
+
+    success = true;
+
+done:
+    if (!success)
+    {
+        if (journal.fd >= 0)
+        {
+            close(journal.fd);
+        }
+        free(journal.buffer);
+        memset(&journal, 0, sizeof journal);
+        journal.fd = -1;
+    }
+
+    return success;
+}
@@ -1,4 +1,5 @@
 #include "led_lock.h"
+#include "led_trace.h"
 
 #include <ubus_utils/ubus_utils.h>
 
@@ -113,7 +114,11 @@ led_ctx_lock_led(
     char const * const lock_id,
     char const ** const error_msg)
 {
-    return assign_lock_id(led_ctx, lock_id, error_msg);
+    bool const locked = assign_lock_id(led_ctx, lock_id, error_msg);
+
+    LED_TRACE3(led_lock, led_ctx->node.key, lock_id, locked);
+
+    return locked;
 }
 
 bool
@@ -126,6 +131,7 @@ led_ctx_unlock_led(
     {
         destroy_led_lock_id(led_ctx);
     }
+    LED_TRACE3(led_unlock, led_ctx->node.key, lock_id, id_is_correct);
 
     return id_is_correct;
 }
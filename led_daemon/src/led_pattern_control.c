@@ -1,6 +1,9 @@
 #include "led_pattern_control.h"
+#include "led_clock.h"
 #include "led_patterns.h"
 #include "led_priorities.h"
+#include "led_stats.h"
+#include "led_trace.h"
 
 #include <ubus_utils/ubus_utils.h>
 #include <lib_led/string_constants.h>
@@ -18,7 +21,9 @@ struct led_pattern_context_st
     TAILQ_ENTRY(led_pattern_context_st) entry;
     size_t times_played;
     size_t next_step_number;
-    struct uloop_timeout timer;
+    struct led_timer_st timer;
+    /* When the timer is due to fire, used to measure its lateness. */
+    uint64_t scheduled_ns;
     struct led_pattern_st const * led_pattern;
     struct led_patterns_context_st * patterns_context;
 };
@@ -34,9 +39,33 @@ struct led_patterns_context_st
     led_patterns_st const * led_patterns;
 
     struct playing_pattern_st playing_patterns;
+
+    /*
+     * A pattern can't be playing more than once at a time, so one context per
+     * loaded pattern is sufficient. Contexts that aren't playing are kept on
+     * the free list.
+     */
+    struct led_pattern_context_st * pattern_context_pool;
+    struct playing_pattern_st free_pattern_contexts;
+
+    /* The lateness of each pattern's timers, indexed by the pattern's index. */
+    struct led_histogram_st * pattern_lateness;
 };
 
-static void pattern_timeout(struct uloop_timeout * t);
+static void pattern_timeout(struct led_timer_st * t);
+
+static void
+send_pattern_event(
+    struct led_patterns_context_st * const patterns_context,
+    struct led_pattern_st const * const led_pattern,
+    enum led_pattern_event_t const event,
+    char const * const preempted_by)
+{
+    struct led_ops_st const * const led_ops = patterns_context->led_ops;
+
+    led_ops->pattern_event(
+        patterns_context->led_ops_context, led_pattern->name, event, preempted_by);
+}
 
 static void
 led_pattern_set_state_setup(
@@ -98,6 +127,7 @@ set_led_states_from_step(
             led_ops->activate_priority(
                 led_ops_handle,
                 led_step->led_name,
+                LED_ID_NONE,
                 led_step->priority,
                 NULL,
                 led_activate_cb,
@@ -116,6 +146,7 @@ set_led_states_from_step(
             led_ops->deactivate_priority(
                 led_ops_handle,
                 led_step->led_name,
+                LED_ID_NONE,
                 led_step->priority,
                 NULL,
                 led_activate_cb,
@@ -132,7 +163,8 @@ done:
 static void
 led_pattern_stop(struct led_pattern_context_st * const pattern_context)
 {
-    log_info("Stop pattern: %s", pattern_context->led_pattern->name);
+    log_debug("Stop pattern: %s", pattern_context->led_pattern->name);
+    LED_TRACE1(pattern_stop, pattern_context->led_pattern->name);
 
     struct pattern_step_st const * const end_step =
         &pattern_context->led_pattern->end_step;
@@ -145,14 +177,39 @@ led_pattern_stop(struct led_pattern_context_st * const pattern_context)
         set_led_states_from_step(pattern_context, end_step, starting, stopping);
     }
     pattern_context->led_pattern = NULL;
-    uloop_timeout_cancel(&pattern_context->timer);
+    led_timer_cancel(&pattern_context->timer);
 
     struct led_patterns_context_st * const patterns_context =
         pattern_context->patterns_context;
 
     TAILQ_REMOVE(&patterns_context->playing_patterns, pattern_context, entry);
+    TAILQ_INSERT_TAIL(&patterns_context->free_pattern_contexts, pattern_context, entry);
+}
 
-    free(pattern_context);
+/*
+ * Stop the pattern and report why it stopped. The event is sent once the end
+ * step has been played so that listeners see the final LED states.
+ */
+static void
+led_pattern_stop_with_event(
+    struct led_pattern_context_st * const pattern_context,
+    enum led_pattern_event_t const event,
+    char const * const preempted_by)
+{
+    struct led_patterns_context_st * const patterns_context =
+        pattern_context->patterns_context;
+    struct led_pattern_st const * const led_pattern = pattern_context->led_pattern;
+
+    led_pattern_stop(pattern_context);
+    send_pattern_event(patterns_context, led_pattern, event, preempted_by);
+}
+
+static void
+set_pattern_timer(
+    struct led_pattern_context_st * const pattern_context, unsigned const time_ms)
+{
+    pattern_context->scheduled_ns = led_clock_now_ns() + (uint64_t)time_ms * 1000000ULL;
+    led_timer_set(&pattern_context->timer, time_ms);
 }
 
 static void
@@ -163,7 +220,9 @@ led_pattern_play_step(struct led_pattern_context_st * const pattern_context)
     struct pattern_step_st const * const pattern_step =
         &led_pattern->steps[pattern_context->next_step_number];
 
+    LED_TRACE2(pattern_step, led_pattern->name, pattern_context->next_step_number);
     pattern_context->next_step_number++;
+    led_daemon_stats.pattern_steps++;
 
     bool const starting = false;
     bool const stopping = false;
@@ -172,11 +231,11 @@ led_pattern_play_step(struct led_pattern_context_st * const pattern_context)
 
     if (pattern_step->time_ms > 0)
     {
-        uloop_timeout_set(&pattern_context->timer, pattern_step->time_ms);
+        set_pattern_timer(pattern_context, pattern_step->time_ms);
     }
     else
     {
-        led_pattern_stop(pattern_context);
+        led_pattern_stop_with_event(pattern_context, LED_PATTERN_EVENT_FINISHED, NULL);
     }
 }
 
@@ -195,7 +254,7 @@ led_pattern_play_start_step(struct led_pattern_context_st * const pattern_contex
 
     if (pattern_step->time_ms > 0)
     {
-        uloop_timeout_set(&pattern_context->timer, pattern_step->time_ms);
+        set_pattern_timer(pattern_context, pattern_step->time_ms);
         start_step_completed = false;
     }
     else
@@ -214,7 +273,7 @@ pattern_context_initialise(
 {
     pattern_context->patterns_context = patterns_context;
     pattern_context->led_pattern = led_pattern;
-    pattern_context->timer.cb = pattern_timeout;
+    led_timer_init(&pattern_context->timer, pattern_timeout);
     pattern_context->next_step_number = 0;
     /*
      * Start the play count at 1. If the pattern gets retriggered the play
@@ -233,7 +292,10 @@ led_pattern_start(struct led_pattern_context_st * const pattern_context)
     struct led_pattern_st const * const led_pattern =
         pattern_context->led_pattern;
 
-    log_info("Start pattern: %s", led_pattern->name);
+    log_debug("Start pattern: %s", led_pattern->name);
+    LED_TRACE1(pattern_start, led_pattern->name);
+    send_pattern_event(
+        pattern_context->patterns_context, led_pattern, LED_PATTERN_EVENT_STARTED, NULL);
 
     bool const start_step_required = led_pattern->start_step.num_leds > 0;
     bool const start_step_completed =
@@ -246,7 +308,7 @@ led_pattern_start(struct led_pattern_context_st * const pattern_context)
 }
 
 static void
-pattern_timeout(struct uloop_timeout * t)
+pattern_timeout(struct led_timer_st * t)
 {
     struct led_pattern_context_st * const pattern_context =
         container_of(t, struct led_pattern_context_st, timer);
@@ -255,6 +317,17 @@ pattern_timeout(struct uloop_timeout * t)
     bool const all_steps_completed =
         pattern_context->next_step_number == led_pattern->num_steps;
 
+    struct led_patterns_context_st * const patterns_context =
+        pattern_context->patterns_context;
+    uint64_t const lateness_ns =
+        led_timer_fired(LED_TIMER_PATTERN, led_pattern->name, pattern_context->scheduled_ns);
+
+    led_daemon_stats.pattern_timer_firings++;
+    if (patterns_context->pattern_lateness != NULL)
+    {
+        led_histogram_record(
+            &patterns_context->pattern_lateness[led_pattern->index], lateness_ns);
+    }
     if (all_steps_completed)
     {
         pattern_context->next_step_number = 0;
@@ -265,11 +338,19 @@ pattern_timeout(struct uloop_timeout * t)
         || led_pattern->play_count == 0
         || pattern_context->times_played <= led_pattern->play_count)
     {
+        if (all_steps_completed)
+        {
+            send_pattern_event(
+                pattern_context->patterns_context,
+                led_pattern,
+                LED_PATTERN_EVENT_STEP_WRAPPED,
+                NULL);
+        }
         led_pattern_play_step(pattern_context);
     }
     else
     {
-        led_pattern_stop(pattern_context);
+        led_pattern_stop_with_event(pattern_context, LED_PATTERN_EVENT_FINISHED, NULL);
     }
 }
 
@@ -445,7 +526,8 @@ stop_other_patterns_using_this_patterns_leds(
         if (patterns_share_leds(
                 patterns_context, pattern_context->led_pattern, led_pattern))
         {
-            led_pattern_stop(pattern_context);
+            led_pattern_stop_with_event(
+                pattern_context, LED_PATTERN_EVENT_PREEMPTED, led_pattern->name);
         }
     }
 }
@@ -495,7 +577,7 @@ led_pattern_stop_pattern(
         goto done;
     }
 
-    led_pattern_stop(pattern_context);
+    led_pattern_stop_with_event(pattern_context, LED_PATTERN_EVENT_STOPPED, NULL);
 
     success = true;
 
@@ -557,14 +639,6 @@ led_pattern_play_pattern(
         goto done;
     }
 
-    pattern_context = calloc(1, sizeof *pattern_context);
-    if (pattern_context == NULL)
-    {
-        *error_msg = "Out of memory";
-        success = false;
-        goto done;
-    }
-
     /*
      * It isn't desirable for multiple patterns to control the same LEDS,
      * so stop any other patterns that use the same LEDs that this pattern uses.
@@ -572,6 +646,16 @@ led_pattern_play_pattern(
      */
 
     stop_other_patterns_using_this_patterns_leds(patterns_context, led_pattern);
+
+    pattern_context = TAILQ_FIRST(&patterns_context->free_pattern_contexts);
+    if (pattern_context == NULL)
+    {
+        *error_msg = "Too many patterns playing";
+        success = false;
+        goto done;
+    }
+    TAILQ_REMOVE(&patterns_context->free_pattern_contexts, pattern_context, entry);
+
     pattern_context_initialise(patterns_context, pattern_context, led_pattern);
     led_pattern_start(pattern_context);
 
@@ -604,6 +688,69 @@ led_pattern_list_patterns(
     led_pattern_list(patterns_context->led_patterns, cb, user_ctx);
 }
 
+struct list_timing_st
+{
+    struct led_histogram_st const * pattern_lateness;
+    pattern_timing_cb cb;
+    void * user_ctx;
+};
+
+static void
+list_pattern_timing_cb(struct led_pattern_st const * const led_pattern, void * const user_ctx)
+{
+    struct list_timing_st const * const list_timing = user_ctx;
+    struct led_histogram_st const * const lateness =
+        &list_timing->pattern_lateness[led_pattern->index];
+
+    /* Patterns whose timers haven't fired are omitted. */
+    if (lateness->count > 0)
+    {
+        list_timing->cb(led_pattern->name, lateness, list_timing->user_ctx);
+    }
+}
+
+void
+led_pattern_list_timing(
+    struct led_patterns_context_st * const patterns_context,
+    pattern_timing_cb const cb,
+    void * const user_ctx)
+{
+    if (patterns_context == NULL || patterns_context->pattern_lateness == NULL)
+    {
+        goto done;
+    }
+
+    struct list_timing_st list_timing =
+    {
+        .pattern_lateness = patterns_context->pattern_lateness,
+        .cb = cb,
+        .user_ctx = user_ctx
+    };
+
+    led_pattern_list(patterns_context->led_patterns, list_pattern_timing_cb, &list_timing);
+
+done:
+    return;
+}
+
+void
+led_pattern_reset_timing(struct led_patterns_context_st * const patterns_context)
+{
+    if (patterns_context == NULL || patterns_context->pattern_lateness == NULL)
+    {
+        goto done;
+    }
+
+    memset(
+        patterns_context->pattern_lateness,
+        0,
+        led_patterns_count(patterns_context->led_patterns)
+        * sizeof *patterns_context->pattern_lateness);
+
+done:
+    return;
+}
+
 void
 led_patterns_deinit(struct led_patterns_context_st * const patterns_context)
 {
@@ -621,18 +768,59 @@ led_patterns_deinit(struct led_patterns_context_st * const patterns_context)
     }
 
     free_patterns(patterns_context->led_patterns);
+    free(patterns_context->pattern_context_pool);
+    free(patterns_context->pattern_lateness);
 
 done:
     return;
 }
 
+static bool
+pattern_context_pool_init(struct led_patterns_context_st * const patterns_context)
+{
+    bool success;
+    size_t const pool_size = led_patterns_count(patterns_context->led_patterns);
+
+    TAILQ_INIT(&patterns_context->free_pattern_contexts);
+
+    if (pool_size == 0)
+    {
+        success = true;
+        goto done;
+    }
+
+    patterns_context->pattern_context_pool =
+        calloc(pool_size, sizeof *patterns_context->pattern_context_pool);
+    patterns_context->pattern_lateness =
+        calloc(pool_size, sizeof *patterns_context->pattern_lateness);
+    if (patterns_context->pattern_context_pool == NULL
+        || patterns_context->pattern_lateness == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    for (size_t i = 0; i < pool_size; i++)
+    {
+        TAILQ_INSERT_TAIL(
+            &patterns_context->free_pattern_contexts,
+            &patterns_context->pattern_context_pool[i],
+            entry);
+    }
+
+    success = true;
+
+done:
+    return success;
+}
+
 struct led_patterns_context_st *
 led_patterns_init(
     char const * const patterns_directory,
     struct led_ops_st const * const led_ops,
     void * const led_ops_context)
 {
-    struct led_patterns_context_st * const patterns_context =
+    struct led_patterns_context_st * patterns_context =
         calloc(1, sizeof * patterns_context);
 
     if (patterns_context == NULL)
@@ -646,6 +834,18 @@ led_patterns_init(
     patterns_context->led_ops_context = led_ops_context;
     patterns_context->led_patterns = load_patterns(patterns_directory);
 
+    /*
+     * Playing a pattern takes a context from the pool rather than allocating
+     * one, so there is no way to play patterns without it.
+     */
+    if (!pattern_context_pool_init(patterns_context))
+    {
+        log_error("Failed to allocate pattern contexts");
+        led_patterns_deinit(patterns_context);
+        patterns_context = NULL;
+        goto done;
+    }
+
 done:
     return patterns_context;
 }
@@ -562,6 +562,7 @@ new_pattern_cb(
     }
 
     led_daemon_led_pattern->led_pattern = led_pattern;
+    led_pattern->index = tree->count - 1;
     success = true;
 
 done:
@@ -631,6 +632,15 @@ led_pattern_list(
     }
 }
 
+size_t
+led_patterns_count(led_patterns_st const * const led_patterns)
+{
+    size_t const count =
+        (led_patterns != NULL) ? led_patterns->all_patterns.count : 0;
+
+    return count;
+}
+
 void
 free_patterns(struct led_patterns_st const * const led_patterns)
 {
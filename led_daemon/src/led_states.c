@@ -107,3 +107,12 @@ led_state_by_query_name(char const * const name)
     return state;
 }
 
+enum led_state_t
+led_state_by_value(int const value)
+{
+    enum led_state_t const state =
+        is_valid_state(value) ? (enum led_state_t)value : LED_STATE_UNKNOWN;
+
+    return state;
+}
+
@@ -0,0 +1,277 @@
+#include "led_stats.h"
+#include "led_clock.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct led_timer_trace_record_st
+{
+    uint64_t scheduled_ns;
+    uint64_t fired_ns;
+    char const * name;
+    enum led_timer_kind_t kind;
+};
+
+struct led_timer_trace_st
+{
+    struct led_timer_trace_record_st * records;
+    size_t num_records;
+    /* The file the trace is dumped to, or NULL if it can't be dumped. */
+    char * dump_path;
+    size_t next;
+    /* The number of firings recorded, including any since overwritten. */
+    uint64_t count;
+};
+
+struct led_daemon_stats_st led_daemon_stats;
+
+static struct led_timer_trace_st timer_trace;
+
+static char const * const timer_kind_names[] =
+{
+    [LED_TIMER_FLASH] = "flash",
+    [LED_TIMER_PATTERN] = "pattern"
+};
+
+uint64_t
+led_stats_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t
+histogram_bucket(uint64_t const value_ns)
+{
+    size_t bucket;
+
+    if (value_ns < LED_HISTOGRAM_SUB_BUCKETS)
+    {
+        bucket = value_ns;
+        goto done;
+    }
+
+    /*
+     * The most significant bit selects the power of two range, and the bits
+     * below it select the sub-bucket within that range.
+     */
+    unsigned const msb = 63 - __builtin_clzll(value_ns);
+    unsigned const shift = msb - LED_HISTOGRAM_SUB_BUCKET_BITS;
+    size_t const sub_bucket = (value_ns >> shift) & (LED_HISTOGRAM_SUB_BUCKETS - 1);
+
+    bucket = (shift + 1) * LED_HISTOGRAM_SUB_BUCKETS + sub_bucket;
+    if (bucket >= LED_HISTOGRAM_BUCKETS)
+    {
+        bucket = LED_HISTOGRAM_BUCKETS - 1;
+    }
+
+done:
+    return bucket;
+}
+
+uint64_t
+led_histogram_bucket_limit_ns(size_t const bucket)
+{
+    uint64_t limit_ns;
+
+    if (bucket < LED_HISTOGRAM_SUB_BUCKETS)
+    {
+        limit_ns = bucket + 1;
+    }
+    else
+    {
+        unsigned const shift = bucket / LED_HISTOGRAM_SUB_BUCKETS - 1;
+        uint64_t const sub_bucket = bucket % LED_HISTOGRAM_SUB_BUCKETS;
+
+        limit_ns = (LED_HISTOGRAM_SUB_BUCKETS + sub_bucket + 1) << shift;
+    }
+
+    return limit_ns;
+}
+
+void
+led_histogram_record(struct led_histogram_st * const histogram, uint64_t const value_ns)
+{
+    histogram->count++;
+    histogram->total_ns += value_ns;
+    if (value_ns > histogram->max_ns)
+    {
+        histogram->max_ns = value_ns;
+    }
+    histogram->buckets[histogram_bucket(value_ns)]++;
+}
+
+uint64_t
+led_histogram_percentile_ns(
+    struct led_histogram_st const * const histogram, double const fraction)
+{
+    uint64_t const target = (uint64_t)((double)histogram->count * fraction);
+    uint64_t seen = 0;
+    size_t bucket;
+
+    for (bucket = 0; bucket < LED_HISTOGRAM_BUCKETS - 1; bucket++)
+    {
+        seen += histogram->buckets[bucket];
+        if (seen > target)
+        {
+            break;
+        }
+    }
+
+    return (histogram->count > 0) ? led_histogram_bucket_limit_ns(bucket) : 0;
+}
+
+void
+led_call_stats_record(
+    struct led_call_stats_st * const call_stats, uint64_t const start_ns, bool const success)
+{
+    call_stats->calls++;
+    if (!success)
+    {
+        call_stats->errors++;
+    }
+    led_histogram_record(&call_stats->latency, led_stats_now_ns() - start_ns);
+}
+
+void
+led_daemon_stats_reset(void)
+{
+    memset(&led_daemon_stats, 0, sizeof led_daemon_stats);
+    led_daemon_stats.reset_ns = led_stats_now_ns();
+    timer_trace.next = 0;
+    timer_trace.count = 0;
+}
+
+uint64_t
+led_timer_fired(
+    enum led_timer_kind_t const kind, char const * const name, uint64_t const scheduled_ns)
+{
+    uint64_t const fired_ns = led_clock_now_ns();
+    /* uloop timers have millisecond resolution, so may fire a little early. */
+    uint64_t const lateness_ns = (fired_ns > scheduled_ns) ? fired_ns - scheduled_ns : 0;
+
+    led_histogram_record(
+        (kind == LED_TIMER_FLASH)
+        ? &led_daemon_stats.flash_lateness
+        : &led_daemon_stats.pattern_lateness,
+        lateness_ns);
+
+    if (timer_trace.records != NULL)
+    {
+        struct led_timer_trace_record_st * const record =
+            &timer_trace.records[timer_trace.next];
+
+        record->scheduled_ns = scheduled_ns;
+        record->fired_ns = fired_ns;
+        record->name = name;
+        record->kind = kind;
+        timer_trace.next = (timer_trace.next + 1) % timer_trace.num_records;
+        timer_trace.count++;
+    }
+
+    return lateness_ns;
+}
+
+bool
+led_timer_trace_init(size_t const num_records, char const * const dump_path)
+{
+    bool success;
+
+    led_timer_trace_free();
+
+    if (num_records == 0)
+    {
+        success = true;
+        goto done;
+    }
+
+    if (dump_path != NULL)
+    {
+        timer_trace.dump_path = strdup(dump_path);
+        if (timer_trace.dump_path == NULL)
+        {
+            success = false;
+            goto done;
+        }
+    }
+
+    timer_trace.records = calloc(num_records, sizeof *timer_trace.records);
+    if (timer_trace.records == NULL)
+    {
+        led_timer_trace_free();
+        success = false;
+        goto done;
+    }
+    timer_trace.num_records = num_records;
+
+    success = true;
+
+done:
+    return success;
+}
+
+void
+led_timer_trace_free(void)
+{
+    free(timer_trace.records);
+    free(timer_trace.dump_path);
+    memset(&timer_trace, 0, sizeof timer_trace);
+}
+
+bool
+led_timer_trace_dump(size_t * const num_records)
+{
+    bool success;
+    FILE * fp = NULL;
+
+    *num_records = 0;
+
+    if (timer_trace.records == NULL || timer_trace.dump_path == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    fp = fopen(timer_trace.dump_path, "w");
+    if (fp == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    bool const wrapped = timer_trace.count >= timer_trace.num_records;
+    size_t const count = wrapped ? timer_trace.num_records : timer_trace.next;
+    size_t const first = wrapped ? timer_trace.next : 0;
+
+    fprintf(fp, "timer,name,scheduled_ns,fired_ns,lateness_ns\n");
+    for (size_t i = 0; i < count; i++)
+    {
+        struct led_timer_trace_record_st const * const record =
+            &timer_trace.records[(first + i) % timer_trace.num_records];
+
+        fprintf(fp,
+                "%s,%s,%" PRIu64 ",%" PRIu64 ",%" PRId64 "\n",
+                timer_kind_names[record->kind],
+                record->name,
+                record->scheduled_ns,
+                record->fired_ns,
+                (int64_t)(record->fired_ns - record->scheduled_ns));
+    }
+    *num_records = count;
+
+    success = !ferror(fp);
+
+done:
+    if (fp != NULL && fclose(fp) != 0)
+    {
+        success = false;
+    }
+
+    return success;
+}
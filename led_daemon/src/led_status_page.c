@@ -0,0 +1,302 @@
+#include "led_status_page.h"
+#include "led_priorities.h"
+
+#include <lib_led/led_status_page_layout.h>
+#include <lib_log/log.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct led_status_page_st
+{
+    char * name;
+    void * base;
+    size_t size;
+    struct led_status_page_header_st * header;
+    struct led_status_page_entry_st * entries;
+    uint32_t state_offsets[LED_STATE_MAX];
+    uint32_t priority_offsets[LED_PRIORITY_COUNT];
+};
+
+static char const *
+state_name(enum led_state_t const state)
+{
+    char const * const name = led_state_query_name(state);
+
+    return (name != NULL) ? name : "";
+}
+
+static char const *
+priority_name(enum led_priority_t const priority)
+{
+    char const * const name = led_priority_to_name(priority);
+
+    return (name != NULL) ? name : "";
+}
+
+static size_t
+page_size(struct avl_tree const * const all_leds)
+{
+    size_t size = sizeof(struct led_status_page_header_st);
+    struct led_ctx_st const * led_ctx;
+
+    avl_for_each_element(all_leds, led_ctx, node)
+    {
+        size += sizeof(struct led_status_page_entry_st);
+        size += strlen(led_ctx->node.key) + 1;
+    }
+    for (enum led_state_t state = 0; state < LED_STATE_MAX; state++)
+    {
+        size += strlen(state_name(state)) + 1;
+    }
+    for (enum led_priority_t priority = 0; priority < LED_PRIORITY_COUNT; priority++)
+    {
+        size += strlen(priority_name(priority)) + 1;
+    }
+
+    return size;
+}
+
+static uint32_t
+append_string(
+    struct led_status_page_st * const page,
+    size_t * const offset,
+    char const * const str)
+{
+    size_t const len = strlen(str) + 1;
+    uint32_t const string_offset = *offset;
+
+    memcpy((char *)page->base + string_offset, str, len);
+    *offset += len;
+
+    return string_offset;
+}
+
+static void
+write_entry(
+    struct led_status_page_st * const page,
+    struct led_status_page_entry_st * const entry,
+    struct led_status_st const * const status,
+    uint32_t const last_changed_seq)
+{
+    __atomic_store_n(
+        &entry->state_offset, page->state_offsets[status->state], __ATOMIC_RELAXED);
+    __atomic_store_n(
+        &entry->priority_offset, page->priority_offsets[status->priority], __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->locked, status->locked, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->last_changed_seq, last_changed_seq, __ATOMIC_RELAXED);
+}
+
+static void
+populate_page(
+    struct led_status_page_st * const page,
+    struct avl_tree * const all_leds,
+    uint32_t const epoch)
+{
+    struct led_status_page_header_st * const header = page->header;
+    size_t offset = sizeof *header;
+    uint32_t num_leds = 0;
+    struct led_ctx_st * led_ctx;
+
+    avl_for_each_element(all_leds, led_ctx, node)
+    {
+        num_leds++;
+    }
+
+    page->entries = (struct led_status_page_entry_st *)((char *)page->base + offset);
+    header->entries_offset = offset;
+    header->num_leds = num_leds;
+    offset += num_leds * sizeof *page->entries;
+
+    for (enum led_state_t state = 0; state < LED_STATE_MAX; state++)
+    {
+        page->state_offsets[state] = append_string(page, &offset, state_name(state));
+    }
+    for (enum led_priority_t priority = 0; priority < LED_PRIORITY_COUNT; priority++)
+    {
+        page->priority_offsets[priority] =
+            append_string(page, &offset, priority_name(priority));
+    }
+
+    uint32_t index = 0;
+
+    /* The AVL tree is ordered by name, so readers may binary search the entries. */
+    avl_for_each_element(all_leds, led_ctx, node)
+    {
+        struct led_status_page_entry_st * const entry = &page->entries[index];
+
+        entry->name_offset = append_string(page, &offset, led_ctx->node.key);
+        write_entry(page, entry, &led_ctx->notified_status, led_ctx->last_changed_seq);
+        led_ctx->status_page_index = index;
+        index++;
+    }
+
+    header->version = LED_STATUS_PAGE_VERSION;
+    header->epoch = epoch;
+    header->size = page->size;
+    /* Readers ignore the page until the magic number appears. */
+    __atomic_store_n(&header->magic, LED_STATUS_PAGE_MAGIC, __ATOMIC_RELEASE);
+}
+
+void
+led_status_page_write_begin(struct led_status_page_st * const page)
+{
+    if (page == NULL)
+    {
+        goto done;
+    }
+
+    struct led_status_page_header_st * const header = page->header;
+
+    __atomic_store_n(&header->seqlock, header->seqlock + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+done:
+    return;
+}
+
+void
+led_status_page_update(
+    struct led_status_page_st * const page, struct led_ctx_st const * const led_ctx)
+{
+    if (page == NULL)
+    {
+        goto done;
+    }
+
+    write_entry(
+        page,
+        &page->entries[led_ctx->status_page_index],
+        &led_ctx->notified_status,
+        led_ctx->last_changed_seq);
+
+done:
+    return;
+}
+
+void
+led_status_page_write_end(
+    struct led_status_page_st * const page, uint32_t const change_seq)
+{
+    if (page == NULL)
+    {
+        goto done;
+    }
+
+    struct led_status_page_header_st * const header = page->header;
+
+    __atomic_store_n(&header->change_seq, change_seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->seqlock, header->seqlock + 1, __ATOMIC_RELEASE);
+
+done:
+    return;
+}
+
+void
+led_status_page_free(struct led_status_page_st * const page)
+{
+    if (page == NULL)
+    {
+        goto done;
+    }
+
+    if (page->base != NULL)
+    {
+        /* Tell readers still mapping the page that they should map it again. */
+        __atomic_store_n(&page->header->closed, 1, __ATOMIC_RELEASE);
+        munmap(page->base, page->size);
+        shm_unlink(page->name);
+    }
+    free(page->name);
+    free(page);
+
+done:
+    return;
+}
+
+led_status_page_st *
+led_status_page_create(
+    char const * const name,
+    struct avl_tree * const all_leds,
+    uint32_t const epoch)
+{
+    bool success;
+    struct led_status_page_st * page = NULL;
+    int fd = -1;
+
+    if (name == NULL || name[0] == '\0')
+    {
+        success = false;
+        goto done;
+    }
+
+    page = calloc(1, sizeof *page);
+    if (page == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    page->name = strdup(name);
+    if (page->name == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    page->size = page_size(all_leds);
+
+    /*
+     * Any page left by a previous instance is unlinked rather than reused so
+     * that readers still mapping it aren't affected by it being resized.
+     * Like the fast path socket, only the daemon's owner and group may use it.
+     */
+    shm_unlink(name);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0640);
+    if (fd < 0)
+    {
+        log_error("Unable to create LED status page %s: %m", name);
+        success = false;
+        goto done;
+    }
+
+    if (ftruncate(fd, page->size) < 0)
+    {
+        log_error("Unable to size LED status page %s: %m", name);
+        shm_unlink(name);
+        success = false;
+        goto done;
+    }
+
+    void * const base = mmap(NULL, page->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (base == MAP_FAILED)
+    {
+        log_error("Unable to map LED status page %s: %m", name);
+        shm_unlink(name);
+        success = false;
+        goto done;
+    }
+
+    page->base = base;
+    page->header = base;
+    populate_page(page, all_leds, epoch);
+
+    success = true;
+
+done:
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    if (!success)
+    {
+        led_status_page_free(page);
+        page = NULL;
+    }
+
+    return page;
+}
@@ -1,6 +1,9 @@
 #include "led_control.h"
+#include "led_journal.h"
+#include "led_stats.h"
 
 #include <lib_log/log.h>
+#include <lib_led/led_status_page_layout.h>
 #include <lib_led/string_constants.h>
 
 #include <libubox/uloop.h>
@@ -12,6 +15,7 @@
 
 static char const default_patterns_directory[] = "/usr/local/share/led_daemon/patterns";
 static char const default_aliases_directory[] = "/usr/local/share/led_daemon/aliases";
+static size_t const default_journal_records_per_write = 64;
 
 static bool
 is_only_instance(void)
@@ -56,7 +60,9 @@ run(
     char const * const ubus_path,
     char const * const patterns_directory,
     char const * const aliases_directory,
-    char const * const backend_path)
+    char const * const backend_path,
+    char const * const status_page_name,
+    char const * const fast_path_socket)
 {
     bool success;
 
@@ -65,7 +71,13 @@ run(
     uloop_init();
 
     ledcmd_ctx_st * const context =
-        ledcmd_init(ubus_path, patterns_directory, aliases_directory, backend_path);
+        ledcmd_init(
+            ubus_path,
+            patterns_directory,
+            aliases_directory,
+            backend_path,
+            status_page_name,
+            fast_path_socket);
 
     if (context != NULL)
     {
@@ -88,17 +100,35 @@ usage(FILE * const fp, char const * const program_name)
 {
     fprintf(fp,
             "usage: %s [-u ubus_path] [-p pattern_path] [-a LED aliases path] "
-            "[-l logging plugin path] [-b LED backend plugin path]\n"
+            "[-l logging plugin path] [-L log level] [-b LED backend plugin path] "
+            "[-s status page name] [-f fast path socket] [-t timer trace records] "
+            "[-T timer trace file] [-j journal path] [-J journal records per write]\n"
             "LED control daemon\n\n"
             "\t-h\thelp      - this help\n"
             "\t-u\tubus path - UBUS socket path\n"
             "\t-p\tpatterns  - LED patterns directory (default: %s)\n"
             "\t-a\taliases   - LED aliases directory (default: %s)\n"
             "\t-l\tlogging   - Path to logging plugin (default: None)\n"
-            "\t-b\tbackend   - Path to backend LED plugin\n",
+            "\t-L\tlog level - error, warn, info or debug (default: info)\n"
+            "\t-b\tbackend   - Path to backend LED plugin\n"
+            "\t-s\tstatus    - Publish the LED status page under this shared memory "
+            "name, readable by the daemon's group; lib_led readers default to %s "
+            "(default: None)\n"
+            "\t-f\tfast path - Binary LED state socket path (default: None)\n"
+            "\t-t\ttrace     - Number of timer firings to keep for timer_trace_dump "
+            "(default: 0, disabled)\n"
+            "\t-T\ttrace     - File timer_trace_dump writes the timer firings to "
+            "(default: None)\n"
+            "\t-j\tjournal   - Append the requests that change LED state to this file "
+            "(default: None)\n"
+            "\t-J\tjournal   - Requests to buffer per journal write, 1 to %d "
+            "(default: %zu)\n",
             program_name,
             default_patterns_directory,
-            default_aliases_directory);
+            default_aliases_directory,
+            LED_STATUS_PAGE_DEFAULT_NAME,
+            LED_JOURNAL_MAX_RECORDS_PER_WRITE,
+            default_journal_records_per_write);
 }
 
 int
@@ -110,10 +140,17 @@ main(int argc, char ** argv)
     char const * aliases_directory = default_aliases_directory;
     char const * backend_plugin_path = NULL;
     char const * logging_plugin_path = NULL;
+    enum log_level_t log_level = LOG_LEVEL_INFO;
+    char const * status_page_name = NULL;
+    char const * fast_path_socket = NULL;
+    size_t timer_trace_records = 0;
+    char const * timer_trace_path = NULL;
+    char const * journal_path = NULL;
+    size_t journal_records_per_write = default_journal_records_per_write;
 
     int opt;
 
-    while ((opt = getopt(argc, argv, "?ha:p:u:b:l:")) != -1)
+    while ((opt = getopt(argc, argv, "?ha:p:u:b:l:L:s:f:t:T:j:J:")) != -1)
     {
         switch (opt)
         {
@@ -142,6 +179,52 @@ main(int argc, char ** argv)
             logging_plugin_path = optarg;
             break;
 
+        case 'L':
+            log_level = log_level_by_name(optarg);
+            if (log_level == LOG_LEVEL_NONE)
+            {
+                usage(stderr, argv[0]);
+                exit_code = EXIT_FAILURE;
+                goto done;
+            }
+            break;
+
+        case 's':
+            status_page_name = optarg;
+            break;
+
+        case 'f':
+            fast_path_socket = optarg;
+            break;
+
+        case 't':
+            timer_trace_records = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'T':
+            timer_trace_path = optarg;
+            break;
+
+        case 'j':
+            journal_path = optarg;
+            break;
+
+        case 'J':
+        {
+            char * end;
+            unsigned long const records_per_write = strtoul(optarg, &end, 10);
+
+            if (end == optarg || *end != '\0' || records_per_write == 0
+                || records_per_write > LED_JOURNAL_MAX_RECORDS_PER_WRITE)
+            {
+                usage(stderr, argv[0]);
+                exit_code = EXIT_FAILURE;
+                goto done;
+            }
+            journal_records_per_write = records_per_write;
+            break;
+        }
+
         case '?':
             usage(stdout, argv[0]);
             exit_code = EXIT_SUCCESS;
@@ -154,6 +237,7 @@ main(int argc, char ** argv)
         }
     }
 
+    log_set_level(log_level);
     logging_plugin_load(logging_plugin_path, _led_ledcmd, false, false);
 
     if (!is_only_instance())
@@ -165,8 +249,28 @@ main(int argc, char ** argv)
 
     log_info("Daemon starting");
 
+    if (!led_timer_trace_init(timer_trace_records, timer_trace_path))
+    {
+        log_error("Unable to allocate the timer trace");
+    }
+    else if (timer_trace_records > 0 && timer_trace_path == NULL)
+    {
+        log_warn("No timer trace file (-T), so the timer trace can't be dumped");
+    }
+
+    if (journal_path != NULL
+        && !led_journal_open(journal_path, journal_records_per_write))
+    {
+        log_error("Unable to open the request journal %s", journal_path);
+    }
+
     if (run(
-            ubus_path, patterns_directory, aliases_directory, backend_plugin_path))
+            ubus_path,
+            patterns_directory,
+            aliases_directory,
+            backend_plugin_path,
+            status_page_name,
+            fast_path_socket))
     {
         exit_code = EXIT_SUCCESS;
     }
@@ -176,6 +280,9 @@ main(int argc, char ** argv)
     }
 
 
+    led_journal_close();
+    led_timer_trace_free();
+
     log_info("Daemon stopping");
 
     logging_plugin_unload();
@@ -0,0 +1,88 @@
+#include "response_buffer.h"
+
+#include <libubox/utils.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static size_t const minimum_buffer_size = 256;
+
+static bool
+response_buffer_grow(struct blob_buf * const buf, int const minlen)
+{
+    bool success;
+    struct response_buffer_st * const response_buffer =
+        container_of(buf, struct response_buffer_st, buf);
+    size_t const current_size = buf->buflen;
+    size_t const required_size = current_size + minlen;
+    size_t new_size = (current_size > 0) ? current_size : minimum_buffer_size;
+
+    /*
+     * Grow geometrically so that even the first large response only needs a
+     * few reallocations.
+     */
+    while (new_size < required_size)
+    {
+        new_size *= 2;
+    }
+
+    void * const new_buf = realloc(buf->buf, new_size);
+
+    if (new_buf == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    memset((char *)new_buf + current_size, 0, new_size - current_size);
+    buf->buf = new_buf;
+    buf->buflen = new_size;
+    response_buffer->allocations++;
+
+    success = true;
+
+done:
+    return success;
+}
+
+struct blob_buf *
+response_buffer_reset(struct response_buffer_st * const response_buffer)
+{
+    struct blob_buf * const buf = &response_buffer->buf;
+
+    blob_buf_init(buf, 0);
+
+    return buf;
+}
+
+void
+response_buffer_done(struct response_buffer_st * const response_buffer)
+{
+    struct blob_buf const * const buf = &response_buffer->buf;
+    size_t const response_size = blob_raw_len(buf->head);
+
+    if (response_size > response_buffer->high_water)
+    {
+        response_buffer->high_water = response_size;
+    }
+}
+
+void
+response_buffer_free(struct response_buffer_st * const response_buffer)
+{
+    blob_buf_free(&response_buffer->buf);
+    response_buffer->high_water = 0;
+}
+
+void
+response_buffer_init(
+    struct response_buffer_st * const response_buffer, size_t const initial_size)
+{
+    memset(response_buffer, 0, sizeof *response_buffer);
+    response_buffer->buf.grow = response_buffer_grow;
+
+    if (initial_size > 0)
+    {
+        response_buffer_grow(&response_buffer->buf, initial_size);
+    }
+}
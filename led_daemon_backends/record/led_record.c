@@ -0,0 +1,443 @@
+#include "led_record_format.h"
+
+#include <led_daemon/platform_specific.h>
+
+#include <ubus_utils/ubus_utils.h>
+
+#include <libubox/uloop.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * A headless backend that records each LED write in a preallocated ring,
+ * and writes the ring to a timeline file when the backend is deinitialised
+ * or when the daemon receives SIGUSR1. Only the on and off states are
+ * supported, so the daemon does the flashing itself and each step of a flash
+ * or pattern is recorded.
+ *
+ * Configured from the environment:
+ * LED_RECORD_LEDS    - the number of LEDs, named "1" to "N" (default 19).
+ * LED_RECORD_RECORDS - the number of records kept in the ring (default 65536).
+ * LED_RECORD_FILE    - the timeline file (default /tmp/led_record.bin).
+ */
+
+#define DEFAULT_NUM_LEDS 19
+#define MAX_NUM_LEDS 100000
+#define DEFAULT_NUM_RECORDS 65536
+#define DEFAULT_RECORD_FILE "/tmp/led_record.bin"
+
+struct led
+{
+    char name[8];
+    uint32_t index;
+    enum led_state_t state;
+};
+
+struct platform_leds_st
+{
+    struct led * leds;
+    size_t num_leds;
+
+    struct led_record_st * records;
+    size_t num_records;
+    /* The total number of writes. The next record is written at total % num_records. */
+    uint64_t total_writes;
+    uint64_t start_ns;
+    char const * path;
+    /*
+     * Set once initialisation has succeeded, so a failed initialisation
+     * doesn't overwrite an existing timeline with an empty one.
+     */
+    bool recording;
+
+    /* SIGUSR1 is passed from the signal handler to the event loop through this pipe. */
+    int signal_pipe[2];
+    struct uloop_fd signal_fd;
+    struct sigaction old_sigusr1;
+};
+
+static struct platform_leds_st recorder =
+{
+    .signal_pipe = { -1, -1 }
+};
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t
+env_size(char const * const name, size_t const default_value, size_t const max_value)
+{
+    char const * const value = getenv(name);
+    size_t size = default_value;
+
+    if (value != NULL)
+    {
+        char * end;
+        unsigned long const parsed = strtoul(value, &end, 10);
+
+        if (end != value && *end == '\0' && parsed > 0 && parsed <= max_value)
+        {
+            size = parsed;
+        }
+    }
+
+    return size;
+}
+
+static bool
+write_all(FILE * const fp, void const * const buf, size_t const len)
+{
+    return len == 0 || fwrite(buf, len, 1, fp) == 1;
+}
+
+/*
+ * Write the records to a temporary file which is then renamed, so that a
+ * reader never sees a partially written timeline.
+ */
+static bool
+dump_timeline(struct platform_leds_st const * const platform_leds)
+{
+    bool success;
+    char * tmp_path = NULL;
+    FILE * fp = NULL;
+    size_t const num_records =
+        (platform_leds->total_writes < platform_leds->num_records)
+        ? platform_leds->total_writes
+        : platform_leds->num_records;
+    size_t const first = (platform_leds->total_writes - num_records) % platform_leds->num_records;
+    struct led_record_header_st const header =
+    {
+        .magic = LED_RECORD_MAGIC,
+        .version = LED_RECORD_VERSION,
+        .num_leds = platform_leds->num_leds,
+        .num_records = num_records,
+        .total_writes = platform_leds->total_writes,
+        .start_ns = platform_leds->start_ns
+    };
+
+    if (asprintf(&tmp_path, "%s.tmp", platform_leds->path) < 0)
+    {
+        tmp_path = NULL;
+        success = false;
+        goto done;
+    }
+
+    fp = fopen(tmp_path, "w");
+    if (fp == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    success = write_all(fp, &header, sizeof header);
+
+    for (size_t i = 0; i < platform_leds->num_leds && success; i++)
+    {
+        uint16_t const len = strlen(platform_leds->leds[i].name);
+
+        success =
+            write_all(fp, &len, sizeof len)
+            && write_all(fp, platform_leds->leds[i].name, len);
+    }
+
+    /* The ring may wrap, in which case the records are written in two parts. */
+    size_t const first_part =
+        (first + num_records > platform_leds->num_records)
+        ? platform_leds->num_records - first
+        : num_records;
+
+    success =
+        success
+        && write_all(fp, &platform_leds->records[first], first_part * sizeof *platform_leds->records)
+        && write_all(
+            fp, platform_leds->records, (num_records - first_part) * sizeof *platform_leds->records);
+
+    if (fclose(fp) != 0)
+    {
+        success = false;
+    }
+    fp = NULL;
+
+    if (success && rename(tmp_path, platform_leds->path) != 0)
+    {
+        success = false;
+    }
+
+done:
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+    if (tmp_path != NULL)
+    {
+        if (!success)
+        {
+            unlink(tmp_path);
+        }
+        free(tmp_path);
+    }
+
+    return success;
+}
+
+static void
+sigusr1_handler(int const signo)
+{
+    int const saved_errno = errno;
+    char const c = 0;
+
+    UNUSED_ARG(signo);
+
+    if (write(recorder.signal_pipe[1], &c, sizeof c) < 0)
+    {
+        /* The pipe is full, so a dump is already pending. */
+    }
+    errno = saved_errno;
+}
+
+static void
+signal_fd_cb(struct uloop_fd * const fd, unsigned int const events)
+{
+    struct platform_leds_st * const platform_leds =
+        container_of(fd, struct platform_leds_st, signal_fd);
+    char buf[16];
+
+    UNUSED_ARG(events);
+
+    while (read(fd->fd, buf, sizeof buf) > 0)
+    {
+        /* Drain the pipe. Any number of signals results in a single dump. */
+    }
+
+    if (!dump_timeline(platform_leds))
+    {
+        fprintf(stderr, "Unable to write LED timeline to %s\n", platform_leds->path);
+    }
+}
+
+static enum led_state_t
+get_led_state(
+    led_handle_st * const led_handle, led_st const * const led)
+{
+    enum led_state_t const state = (led != NULL) ? led->state : LED_STATE_UNKNOWN;
+
+    UNUSED_ARG(led_handle);
+
+    return state;
+}
+
+static bool
+set_led_state(
+    led_handle_st * const led_handle,
+    led_st * const led,
+    enum led_state_t const state)
+{
+    struct led_record_st * const record =
+        &recorder.records[recorder.total_writes % recorder.num_records];
+
+    UNUSED_ARG(led_handle);
+
+    record->timestamp_ns = monotonic_ns();
+    record->led_index = led->index;
+    record->state = state;
+    recorder.total_writes++;
+    led->state = state;
+
+    return true;
+}
+
+static led_handle_st *
+led_open(void)
+{
+    static int const dummy = 0;
+    /* Nothing to do. Don't return NULL though, as that indicates error. */
+
+    return (led_handle_st *)&dummy;
+}
+
+static void
+led_close(led_handle_st * const led_handle)
+{
+    UNUSED_ARG(led_handle);
+    /* Nothing to do. */
+}
+
+static led_st *
+iterate_leds(
+    platform_leds_st * const platform_leds,
+    bool (*cb)(led_st * led, void * user_ctx),
+    void * user_ctx)
+{
+    led_st * led;
+
+    for (size_t i = 0; i < platform_leds->num_leds; i++)
+    {
+        if (!cb(&platform_leds->leds[i], user_ctx))
+        {
+            led = &platform_leds->leds[i];
+            goto done;
+        }
+    }
+
+    led = NULL;
+
+done:
+    return led;
+}
+
+static void
+iterate_supported_states(
+    void (*cb)(enum led_state_t state, void * user_ctx), void * user_ctx)
+{
+    cb(LED_OFF, user_ctx);
+    cb(LED_ON, user_ctx);
+}
+
+static char const *
+get_led_name(led_st const * const led)
+{
+    return led->name;
+}
+
+static enum led_colour_t
+get_led_colour(led_st const * const led)
+{
+    enum led_colour_t const colour =
+        (led != NULL) ? LED_COLOUR_GREEN : (enum led_colour_t)-1;
+
+    return colour;
+}
+
+static void
+leds_deinit(platform_leds_st * const platform_leds)
+{
+    if (platform_leds == NULL)
+    {
+        goto done;
+    }
+
+    if (platform_leds->signal_fd.registered)
+    {
+        uloop_fd_delete(&platform_leds->signal_fd);
+        sigaction(SIGUSR1, &platform_leds->old_sigusr1, NULL);
+    }
+    if (platform_leds->recording && !dump_timeline(platform_leds))
+    {
+        fprintf(stderr, "Unable to write LED timeline to %s\n", platform_leds->path);
+    }
+    platform_leds->recording = false;
+
+    for (size_t i = 0; i < ARRAY_SIZE(platform_leds->signal_pipe); i++)
+    {
+        if (platform_leds->signal_pipe[i] >= 0)
+        {
+            close(platform_leds->signal_pipe[i]);
+            platform_leds->signal_pipe[i] = -1;
+        }
+    }
+
+    free(platform_leds->records);
+    platform_leds->records = NULL;
+    free(platform_leds->leds);
+    platform_leds->leds = NULL;
+
+done:
+    return;
+}
+
+static platform_leds_st *
+leds_init(void)
+{
+    struct platform_leds_st * platform_leds = &recorder;
+    char const * const path = getenv("LED_RECORD_FILE");
+    struct sigaction const sa =
+    {
+        .sa_handler = sigusr1_handler,
+        .sa_flags = SA_RESTART
+    };
+
+    platform_leds->num_leds = env_size("LED_RECORD_LEDS", DEFAULT_NUM_LEDS, MAX_NUM_LEDS);
+    platform_leds->num_records = env_size("LED_RECORD_RECORDS", DEFAULT_NUM_RECORDS, UINT32_MAX);
+    platform_leds->path = (path != NULL) ? path : DEFAULT_RECORD_FILE;
+    platform_leds->total_writes = 0;
+    platform_leds->start_ns = monotonic_ns();
+
+    platform_leds->leds = calloc(platform_leds->num_leds, sizeof *platform_leds->leds);
+    platform_leds->records = malloc(platform_leds->num_records * sizeof *platform_leds->records);
+    if (platform_leds->leds == NULL || platform_leds->records == NULL)
+    {
+        leds_deinit(platform_leds);
+        platform_leds = NULL;
+        goto done;
+    }
+
+    /* Touch every record now so that recording doesn't incur page faults. */
+    for (size_t i = 0; i < platform_leds->num_records; i++)
+    {
+        platform_leds->records[i].led_index = UINT32_MAX;
+    }
+
+    for (size_t i = 0; i < platform_leds->num_leds; i++)
+    {
+        struct led * const led = &platform_leds->leds[i];
+
+        snprintf(led->name, sizeof led->name, "%zu", i + 1);
+        led->index = i;
+        led->state = LED_OFF;
+    }
+
+    if (pipe2(platform_leds->signal_pipe, O_CLOEXEC | O_NONBLOCK) != 0)
+    {
+        leds_deinit(platform_leds);
+        platform_leds = NULL;
+        goto done;
+    }
+
+    platform_leds->signal_fd.fd = platform_leds->signal_pipe[0];
+    platform_leds->signal_fd.cb = signal_fd_cb;
+    uloop_fd_add(&platform_leds->signal_fd, ULOOP_READ);
+    sigaction(SIGUSR1, &sa, &platform_leds->old_sigusr1);
+    platform_leds->recording = true;
+
+done:
+    return platform_leds;
+}
+
+struct platform_led_methods_st const *
+platform_leds_methods(int const plugin_version)
+{
+    static struct platform_led_methods_st const methods =
+    {
+        .get_led_state = get_led_state,
+        .set_led_state = set_led_state,
+        .get_led_name = get_led_name,
+        .get_led_colour = get_led_colour,
+        .open = led_open,
+        .close = led_close,
+        .iterate_leds = iterate_leds,
+        .iterate_supported_states = iterate_supported_states,
+        .init = leds_init,
+        .deinit = leds_deinit
+    };
+    bool const version_ok = plugin_version == LED_DAEMON_PLUGIN_VERSION;
+    struct platform_led_methods_st const * const platform_methods =
+        version_ok ? &methods : NULL;
+
+    return platform_methods;
+}
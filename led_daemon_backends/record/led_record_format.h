@@ -0,0 +1,37 @@
+#ifndef LED_RECORD_FORMAT_H__
+#define LED_RECORD_FORMAT_H__
+
+#include <stdint.h>
+
+/*
+ * The layout of the timeline files written by the recording backend. All
+ * values are in host byte order. The file starts with a header, followed by
+ * the LED names, each as a uint16_t length and that many bytes (not NUL
+ * terminated), in LED index order, and then the records, oldest first.
+ */
+
+#define LED_RECORD_MAGIC 0x5244454cU /* "LEDR" */
+#define LED_RECORD_VERSION 1
+
+struct led_record_header_st
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_leds;
+    uint32_t num_records;
+    /* The number of writes recorded, including any overwritten in the ring. */
+    uint64_t total_writes;
+    /* CLOCK_MONOTONIC time at which the backend was initialised. */
+    uint64_t start_ns;
+};
+
+struct led_record_st
+{
+    /* CLOCK_MONOTONIC time of the write. */
+    uint64_t timestamp_ns;
+    uint32_t led_index;
+    /* An enum led_state_t value. */
+    uint32_t state;
+};
+
+#endif /* LED_RECORD_FORMAT_H__ */
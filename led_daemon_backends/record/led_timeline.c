@@ -0,0 +1,632 @@
+#include "led_record_format.h"
+
+#include <led_daemon/led_states.h>
+
+#include <lib_led/lib_led.h>
+#include <lib_led/lib_led_control.h>
+#include <lib_led/string_constants.h>
+#include <ubus_utils/ubus_utils.h>
+
+#include <libubus.h>
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Prints, compares and replays the timeline files written by the recording
+ * LED backend.
+ */
+
+#define DEFAULT_TOLERANCE_MS 5
+
+struct timeline_st
+{
+    struct led_record_header_st header;
+    char * * names;
+    struct led_record_st * records;
+};
+
+struct led_writes_st
+{
+    struct led_record_st const * * records;
+    size_t num_records;
+};
+
+struct replay_context_st
+{
+    bool success;
+};
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static char const *
+state_name(uint32_t const state)
+{
+    static char const * const names[LED_STATE_MAX] =
+    {
+        [LED_OFF] = _led_off,
+        [LED_ON] = _led_on,
+        [LED_SLOW_FLASH] = _led_flash,
+        [LED_FAST_FLASH] = _led_fast_flash
+    };
+
+    return (state < ARRAY_SIZE(names)) ? names[state] : NULL;
+}
+
+static void
+free_timeline(struct timeline_st * const timeline)
+{
+    if (timeline->names != NULL)
+    {
+        for (size_t i = 0; i < timeline->header.num_leds; i++)
+        {
+            free(timeline->names[i]);
+        }
+        free(timeline->names);
+        timeline->names = NULL;
+    }
+    free(timeline->records);
+    timeline->records = NULL;
+}
+
+static bool
+load_timeline(char const * const path, struct timeline_st * const timeline)
+{
+    bool success;
+    FILE * const fp = fopen(path, "r");
+
+    memset(timeline, 0, sizeof *timeline);
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Unable to open %s\n", path);
+        success = false;
+        goto done;
+    }
+
+    if (fread(&timeline->header, sizeof timeline->header, 1, fp) != 1
+        || timeline->header.magic != LED_RECORD_MAGIC
+        || timeline->header.version != LED_RECORD_VERSION)
+    {
+        fprintf(stderr, "%s isn't an LED timeline\n", path);
+        memset(&timeline->header, 0, sizeof timeline->header);
+        success = false;
+        goto done;
+    }
+
+    timeline->names = calloc(timeline->header.num_leds, sizeof *timeline->names);
+    timeline->records = calloc(timeline->header.num_records, sizeof *timeline->records);
+    if ((timeline->names == NULL && timeline->header.num_leds > 0)
+        || (timeline->records == NULL && timeline->header.num_records > 0))
+    {
+        success = false;
+        goto done;
+    }
+
+    for (size_t i = 0; i < timeline->header.num_leds; i++)
+    {
+        uint16_t len;
+
+        if (fread(&len, sizeof len, 1, fp) != 1)
+        {
+            success = false;
+            goto done;
+        }
+        timeline->names[i] = calloc(1, len + 1);
+        if (timeline->names[i] == NULL
+            || (len > 0 && fread(timeline->names[i], len, 1, fp) != 1))
+        {
+            success = false;
+            goto done;
+        }
+    }
+
+    if (timeline->header.num_records > 0
+        && fread(
+            timeline->records, sizeof *timeline->records, timeline->header.num_records, fp)
+           != timeline->header.num_records)
+    {
+        success = false;
+        goto done;
+    }
+
+    success = true;
+
+    for (size_t i = 0; i < timeline->header.num_records && success; i++)
+    {
+        success = timeline->records[i].led_index < timeline->header.num_leds;
+    }
+
+done:
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+    if (!success)
+    {
+        if (timeline->header.magic == LED_RECORD_MAGIC)
+        {
+            fprintf(stderr, "%s is truncated or corrupt\n", path);
+        }
+        free_timeline(timeline);
+    }
+
+    return success;
+}
+
+static uint64_t
+first_timestamp_ns(struct timeline_st const * const timeline)
+{
+    return (timeline->header.num_records > 0) ? timeline->records[0].timestamp_ns : 0;
+}
+
+static void
+warn_if_overwritten(char const * const path, struct timeline_st const * const timeline)
+{
+    if (timeline->header.total_writes > timeline->header.num_records)
+    {
+        fprintf(stderr,
+                "%s: the oldest %" PRIu64 " writes were overwritten\n",
+                path,
+                timeline->header.total_writes - timeline->header.num_records);
+    }
+}
+
+static bool
+print_timeline(char const * const path)
+{
+    bool success;
+    struct timeline_st timeline;
+
+    if (!load_timeline(path, &timeline))
+    {
+        success = false;
+        goto done;
+    }
+
+    fprintf(stdout,
+            "# leds %" PRIu32 ", records %" PRIu32 ", writes %" PRIu64 "\n"
+            "# time_ms led state\n",
+            timeline.header.num_leds,
+            timeline.header.num_records,
+            timeline.header.total_writes);
+
+    for (size_t i = 0; i < timeline.header.num_records; i++)
+    {
+        struct led_record_st const * const record = &timeline.records[i];
+        char const * const state = state_name(record->state);
+
+        fprintf(stdout,
+                "%.3f %s %s\n",
+                (double)(record->timestamp_ns - timeline.header.start_ns) / 1e6,
+                timeline.names[record->led_index],
+                (state != NULL) ? state : "unknown");
+    }
+
+    free_timeline(&timeline);
+    success = true;
+
+done:
+    return success;
+}
+
+/* Group the records of a timeline by LED, keeping them in time order. */
+static struct led_writes_st *
+group_writes(struct timeline_st const * const timeline)
+{
+    struct led_writes_st * writes = calloc(timeline->header.num_leds, sizeof *writes);
+    struct led_record_st const * * const records =
+        calloc(timeline->header.num_records, sizeof *records);
+    size_t offset = 0;
+
+    if (writes == NULL || (records == NULL && timeline->header.num_records > 0))
+    {
+        free(writes);
+        free(records);
+        writes = NULL;
+        goto done;
+    }
+
+    for (size_t i = 0; i < timeline->header.num_records; i++)
+    {
+        writes[timeline->records[i].led_index].num_records++;
+    }
+
+    /* Each LED's writes are a slice of the single records array. */
+    for (size_t i = 0; i < timeline->header.num_leds; i++)
+    {
+        writes[i].records = records + offset;
+        offset += writes[i].num_records;
+        writes[i].num_records = 0;
+    }
+
+    for (size_t i = 0; i < timeline->header.num_records; i++)
+    {
+        struct led_writes_st * const led_writes = &writes[timeline->records[i].led_index];
+
+        led_writes->records[led_writes->num_records++] = &timeline->records[i];
+    }
+
+done:
+    return writes;
+}
+
+static void
+free_writes(struct led_writes_st * const writes, size_t const num_leds)
+{
+    if (writes != NULL)
+    {
+        /* The first LED's slice starts at the beginning of the allocation. */
+        if (num_leds > 0)
+        {
+            free(writes[0].records);
+        }
+        free(writes);
+    }
+}
+
+static ssize_t
+find_led(struct timeline_st const * const timeline, char const * const name)
+{
+    ssize_t index = -1;
+
+    for (size_t i = 0; i < timeline->header.num_leds && index < 0; i++)
+    {
+        if (strcmp(timeline->names[i], name) == 0)
+        {
+            index = i;
+        }
+    }
+
+    return index;
+}
+
+/*
+ * Compare the writes to one LED. Times are relative to the first record of
+ * each timeline. Returns false and reports the first difference if the
+ * states differ, or if the times differ by more than the tolerance.
+ */
+static bool
+compare_led_writes(
+    char const * const led_name,
+    struct led_writes_st const * const a,
+    uint64_t const a_base_ns,
+    struct led_writes_st const * const b,
+    uint64_t const b_base_ns,
+    uint64_t const tolerance_ns)
+{
+    bool match = true;
+    size_t const count = (a->num_records < b->num_records) ? a->num_records : b->num_records;
+
+    for (size_t i = 0; i < count && match; i++)
+    {
+        struct led_record_st const * const ra = a->records[i];
+        struct led_record_st const * const rb = b->records[i];
+        int64_t const a_ns = ra->timestamp_ns - a_base_ns;
+        int64_t const b_ns = rb->timestamp_ns - b_base_ns;
+        uint64_t const delta_ns = (a_ns > b_ns) ? a_ns - b_ns : b_ns - a_ns;
+
+        if (ra->state != rb->state || delta_ns > tolerance_ns)
+        {
+            char const * const a_state = state_name(ra->state);
+            char const * const b_state = state_name(rb->state);
+
+            fprintf(stdout,
+                    "LED %s: write %zu: %s at %.3f ms vs %s at %.3f ms\n",
+                    led_name,
+                    i + 1,
+                    (a_state != NULL) ? a_state : "unknown",
+                    (double)a_ns / 1e6,
+                    (b_state != NULL) ? b_state : "unknown",
+                    (double)b_ns / 1e6);
+            match = false;
+        }
+    }
+
+    if (match && a->num_records != b->num_records)
+    {
+        fprintf(stdout,
+                "LED %s: %zu writes vs %zu writes\n",
+                led_name,
+                a->num_records,
+                b->num_records);
+        match = false;
+    }
+
+    return match;
+}
+
+static bool
+diff_timelines(
+    char const * const path_a, char const * const path_b, uint64_t const tolerance_ns, bool * const match)
+{
+    bool success;
+    struct timeline_st a = { .names = NULL, .records = NULL };
+    struct timeline_st b = { .names = NULL, .records = NULL };
+    struct led_writes_st * a_writes = NULL;
+    struct led_writes_st * b_writes = NULL;
+    size_t leds_differing = 0;
+
+    if (!load_timeline(path_a, &a) || !load_timeline(path_b, &b))
+    {
+        success = false;
+        goto done;
+    }
+
+    warn_if_overwritten(path_a, &a);
+    warn_if_overwritten(path_b, &b);
+
+    a_writes = group_writes(&a);
+    b_writes = group_writes(&b);
+    if (a_writes == NULL || b_writes == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    static struct led_writes_st const no_writes = { .records = NULL, .num_records = 0 };
+
+    for (size_t i = 0; i < a.header.num_leds; i++)
+    {
+        ssize_t const b_index = find_led(&b, a.names[i]);
+        struct led_writes_st const * const b_led_writes =
+            (b_index >= 0) ? &b_writes[b_index] : &no_writes;
+
+        if (!compare_led_writes(
+                a.names[i],
+                &a_writes[i],
+                first_timestamp_ns(&a),
+                b_led_writes,
+                first_timestamp_ns(&b),
+                tolerance_ns))
+        {
+            leds_differing++;
+        }
+    }
+
+    for (size_t i = 0; i < b.header.num_leds; i++)
+    {
+        if (b_writes[i].num_records > 0 && find_led(&a, b.names[i]) < 0)
+        {
+            fprintf(stdout,
+                    "LED %s: %zu writes only in %s\n",
+                    b.names[i],
+                    b_writes[i].num_records,
+                    path_b);
+            leds_differing++;
+        }
+    }
+
+    *match = leds_differing == 0;
+    if (*match)
+    {
+        fprintf(stdout, "timelines match: %" PRIu32 " writes\n", a.header.num_records);
+    }
+    else
+    {
+        fprintf(stdout, "timelines differ: %zu LEDs\n", leds_differing);
+    }
+    success = true;
+
+done:
+    free_writes(a_writes, a.header.num_leds);
+    free_writes(b_writes, b.header.num_leds);
+    free_timeline(&a);
+    free_timeline(&b);
+
+    return success;
+}
+
+static void
+replay_result_cb(struct led_get_set_result_st const * const result, void * const user_context)
+{
+    struct replay_context_st * const context = user_context;
+
+    context->success = context->success && result->success;
+}
+
+/*
+ * Re-issue the writes in a timeline as set requests to a running daemon,
+ * keeping their original spacing (scaled by the speed).
+ */
+static bool
+replay_timeline(char const * const path, char const * const ubus_path, double const speed)
+{
+    bool success;
+    struct timeline_st timeline = { .names = NULL, .records = NULL };
+    struct ubus_context * ubus_ctx = NULL;
+    ledcmd_ctx_st * ledcmd_ctx = NULL;
+    size_t failures = 0;
+    uint64_t max_lag_ns = 0;
+
+    if (!load_timeline(path, &timeline))
+    {
+        success = false;
+        goto done;
+    }
+
+    ubus_ctx = ubus_connect(ubus_path);
+    if (ubus_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to connect to UBUS\n");
+        success = false;
+        goto done;
+    }
+
+    ledcmd_ctx = led_init(ubus_ctx);
+    if (ledcmd_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to connect to LED daemon\n");
+        success = false;
+        goto done;
+    }
+
+    uint64_t const base_ns = first_timestamp_ns(&timeline);
+    uint64_t const start_ns = monotonic_ns();
+
+    for (size_t i = 0; i < timeline.header.num_records; i++)
+    {
+        struct led_record_st const * const record = &timeline.records[i];
+        char const * const state = state_name(record->state);
+        uint64_t const due_ns =
+            start_ns + (uint64_t)((double)(record->timestamp_ns - base_ns) / speed);
+        struct timespec const due =
+        {
+            .tv_sec = due_ns / 1000000000ULL,
+            .tv_nsec = due_ns % 1000000000ULL
+        };
+        struct replay_context_st context = { .success = true };
+
+        if (state == NULL)
+        {
+            continue;
+        }
+
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+
+        uint64_t const lag_ns = monotonic_ns() - due_ns;
+
+        if (lag_ns > max_lag_ns)
+        {
+            max_lag_ns = lag_ns;
+        }
+
+        if (!led_get_set_request(
+                ledcmd_ctx, _led_set, state, timeline.names[record->led_index],
+                NULL, NULL, NULL, 0, replay_result_cb, &context)
+            || !context.success)
+        {
+            failures++;
+        }
+    }
+
+    fprintf(stdout,
+            "replayed %" PRIu32 " writes, %zu failed, max lag %.3f ms\n",
+            timeline.header.num_records,
+            failures,
+            (double)max_lag_ns / 1e6);
+    success = failures == 0;
+
+done:
+    led_deinit(ledcmd_ctx);
+    if (ubus_ctx != NULL)
+    {
+        ubus_free(ubus_ctx);
+    }
+    free_timeline(&timeline);
+
+    return success;
+}
+
+static void
+usage(FILE * const fp)
+{
+    fprintf(fp,
+            "usage:\n"
+            "\tled_timeline print <file>\n"
+            "\tled_timeline diff [-t <ms>] <file a> <file b>\n"
+            "\tled_timeline replay [-u <path>] [-s <speed>] <file>\n"
+            "\t-h?           - help    - what you see below\n"
+            "\t-t <ms>       - allowed difference in write times (default %u)\n"
+            "\t-u <path>     - ubus socket path\n"
+            "\t-s <speed>    - replay speed multiplier (default 1.0)\n"
+            "\n"
+            "diff compares the sequence of writes to each LED, with times relative\n"
+            "to the first write in each file, and exits with failure if they differ.\n"
+            "\n",
+            DEFAULT_TOLERANCE_MS);
+}
+
+int
+main(int argc, char * argv[])
+{
+    int c;
+    int result;
+    char const * ubus_path = NULL;
+    unsigned long tolerance_ms = DEFAULT_TOLERANCE_MS;
+    double speed = 1.0;
+    char const * command;
+
+    if (argc < 2)
+    {
+        usage(stderr);
+        result = EXIT_FAILURE;
+        goto done;
+    }
+
+    command = argv[1];
+
+    /* The options follow the command. */
+    while ((c = getopt(argc - 1, argv + 1, "?ht:u:s:")) != -1)
+    {
+        switch (c)
+        {
+        case '?':
+        case 'h':
+            usage(stdout);
+            result = EXIT_SUCCESS;
+            goto done;
+
+        case 't':
+            tolerance_ms = strtoul(optarg, NULL, 10);
+            break;
+
+        case 'u':
+            ubus_path = optarg;
+            break;
+
+        case 's':
+            speed = strtod(optarg, NULL);
+            break;
+
+        default:
+            usage(stderr);
+            result = EXIT_FAILURE;
+            goto done;
+
+        }
+    }
+
+    char * const * const args = argv + 1 + optind;
+    int const num_args = argc - 1 - optind;
+
+    if (strcmp(command, "print") == 0 && num_args == 1)
+    {
+        result = print_timeline(args[0]) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    else if (strcmp(command, "diff") == 0 && num_args == 2)
+    {
+        bool match = false;
+
+        result =
+            (diff_timelines(args[0], args[1], tolerance_ms * 1000000ULL, &match) && match)
+            ? EXIT_SUCCESS
+            : EXIT_FAILURE;
+    }
+    else if (strcmp(command, "replay") == 0 && num_args == 1 && speed > 0)
+    {
+        result = replay_timeline(args[0], ubus_path, speed) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    else
+    {
+        usage(stderr);
+        result = EXIT_FAILURE;
+    }
+
+done:
+    return result;
+}
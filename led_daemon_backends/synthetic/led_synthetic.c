@@ -0,0 +1,706 @@
+#include <led_daemon/platform_specific.h>
+
+#include <ubus_utils/ubus_utils.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * A synthetic backend for benchmarking the daemon at scale without hardware.
+ * The LEDs exist only in memory, and reads and writes may be delayed or fail
+ * as configured.
+ *
+ * The configuration is read from the file named by LED_SYNTHETIC_CONFIG, if
+ * set, one setting per line ('#' starts a comment):
+ *
+ * leds <count> [<prefix> [<colour>]]
+ *     Add <count> LEDs named <prefix>1 to <prefix><count> (default prefix "").
+ * led <name> [<colour>]
+ *     Add a single LED.
+ * write_latency fixed <us>
+ * write_latency random <min us> <max us>
+ * write_latency stall <us> <stall us> <stalls per million>
+ *     Delay each write by a fixed time, a uniformly distributed time, or a
+ *     fixed time with occasional longer stalls.
+ * read_latency ...
+ *     As write_latency, for reads.
+ * write_failures <per million>
+ * read_failures <per million>
+ *     The proportion of writes and reads that fail.
+ * hardware_flash <0|1>
+ *     Whether the backend supports the flash states itself (default 1). If not,
+ *     the daemon flashes the LEDs with its own timers.
+ * seed <n>
+ *     Seed for the random delays and failures, so runs are repeatable.
+ *
+ * Each setting apart from 'led' may also be given in an environment variable
+ * named LED_SYNTHETIC_ and the setting in upper case, e.g.
+ * LED_SYNTHETIC_WRITE_LATENCY="random 50 500". These are applied after the
+ * file, so override its settings, apart from LED_SYNTHETIC_LEDS, which adds to
+ * its LEDs. If no LEDs are configured there are 19, named "1" to "19".
+ */
+
+#define DEFAULT_NUM_LEDS 19
+#define MAX_NUM_LEDS 100000
+#define MAX_LINE_LEN 256
+
+struct led
+{
+    char * name;
+    enum led_colour_t colour;
+    enum led_state_t state;
+};
+
+struct latency_st
+{
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t stall_us;
+    uint32_t stalls_per_million;
+};
+
+struct platform_leds_st
+{
+    struct led * leds;
+    size_t num_leds;
+    size_t max_leds;
+
+    struct latency_st write_latency;
+    struct latency_st read_latency;
+    uint32_t write_failures_per_million;
+    uint32_t read_failures_per_million;
+    bool hardware_flash;
+    uint64_t random_state;
+};
+
+typedef bool (*setting_parse_fn)(struct platform_leds_st * platform_leds, char * * args);
+
+struct setting_st
+{
+    char const * name;
+    char const * env;
+    setting_parse_fn parse;
+};
+
+static struct platform_leds_st synthetic;
+
+static uint64_t
+next_random(struct platform_leds_st * const platform_leds)
+{
+    /* xorshift64*, which is fast and good enough for injecting faults. */
+    uint64_t x = platform_leds->random_state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    platform_leds->random_state = x;
+
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+static bool
+one_in_a_million(struct platform_leds_st * const platform_leds, uint32_t const per_million)
+{
+    return per_million > 0 && (next_random(platform_leds) % 1000000) < per_million;
+}
+
+static void
+inject_latency(struct platform_leds_st * const platform_leds, struct latency_st const * const latency)
+{
+    uint32_t delay_us = latency->min_us;
+
+    if (latency->max_us > latency->min_us)
+    {
+        delay_us += next_random(platform_leds) % (latency->max_us - latency->min_us + 1);
+    }
+    if (one_in_a_million(platform_leds, latency->stalls_per_million))
+    {
+        delay_us = latency->stall_us;
+    }
+
+    if (delay_us > 0)
+    {
+        struct timespec ts =
+        {
+            .tv_sec = delay_us / 1000000,
+            .tv_nsec = (delay_us % 1000000) * 1000L
+        };
+
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        {
+            /* Sleep for the remainder. */
+        }
+    }
+}
+
+static bool
+parse_u32(char const * const arg, uint32_t * const value)
+{
+    bool success;
+    char * end;
+    unsigned long parsed;
+
+    if (arg == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    parsed = strtoul(arg, &end, 10);
+    success = end != arg && *end == '\0' && parsed <= UINT32_MAX;
+    if (success)
+    {
+        *value = parsed;
+    }
+
+done:
+    return success;
+}
+
+static bool
+parse_colour(char const * const arg, enum led_colour_t * const colour)
+{
+    static char const * const colours[LED_COLOUR_MAX] =
+    {
+        [LED_COLOUR_UNKNOWN] = "unknown",
+        [LED_COLOUR_RED] = "red",
+        [LED_COLOUR_GREEN] = "green",
+        [LED_COLOUR_BLUE] = "blue",
+        [LED_COLOUR_YELLOW] = "yellow"
+    };
+    bool success = false;
+
+    if (arg == NULL)
+    {
+        *colour = LED_COLOUR_GREEN;
+        success = true;
+        goto done;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(colours) && !success; i++)
+    {
+        if (strcmp(arg, colours[i]) == 0)
+        {
+            *colour = i;
+            success = true;
+        }
+    }
+
+done:
+    return success;
+}
+
+static bool
+add_led(
+    struct platform_leds_st * const platform_leds,
+    char const * const prefix,
+    char const * const name,
+    enum led_colour_t const colour)
+{
+    bool success;
+    struct led * led;
+
+    if (platform_leds->num_leds >= MAX_NUM_LEDS)
+    {
+        success = false;
+        goto done;
+    }
+
+    if (platform_leds->num_leds == platform_leds->max_leds)
+    {
+        size_t const max_leds =
+            (platform_leds->max_leds == 0) ? DEFAULT_NUM_LEDS : platform_leds->max_leds * 2;
+        struct led * const leds = realloc(platform_leds->leds, max_leds * sizeof *leds);
+
+        if (leds == NULL)
+        {
+            success = false;
+            goto done;
+        }
+        platform_leds->leds = leds;
+        platform_leds->max_leds = max_leds;
+    }
+
+    led = &platform_leds->leds[platform_leds->num_leds];
+    if (asprintf(&led->name, "%s%s", prefix, name) < 0)
+    {
+        success = false;
+        goto done;
+    }
+    led->colour = colour;
+    led->state = LED_OFF;
+    platform_leds->num_leds++;
+
+    success = true;
+
+done:
+    return success;
+}
+
+static bool
+parse_leds(struct platform_leds_st * const platform_leds, char * * const args)
+{
+    bool success;
+    uint32_t count;
+    char const * const prefix = (args[1] != NULL) ? args[1] : "";
+    enum led_colour_t colour;
+
+    if (!parse_u32(args[0], &count)
+        || count > MAX_NUM_LEDS
+        || !parse_colour((args[1] != NULL) ? args[2] : NULL, &colour))
+    {
+        success = false;
+        goto done;
+    }
+
+    success = true;
+    for (uint32_t i = 0; i < count && success; i++)
+    {
+        char name[16];
+
+        snprintf(name, sizeof name, "%" PRIu32, i + 1);
+        success = add_led(platform_leds, prefix, name, colour);
+    }
+
+done:
+    return success;
+}
+
+static bool
+parse_led(struct platform_leds_st * const platform_leds, char * * const args)
+{
+    bool success;
+    enum led_colour_t colour;
+
+    if (args[0] == NULL || !parse_colour(args[1], &colour))
+    {
+        success = false;
+        goto done;
+    }
+
+    success = add_led(platform_leds, "", args[0], colour);
+
+done:
+    return success;
+}
+
+static bool
+parse_latency(char * * const args, struct latency_st * const latency)
+{
+    bool success;
+    struct latency_st parsed = { .min_us = 0 };
+
+    if (args[0] == NULL)
+    {
+        success = false;
+    }
+    else if (strcmp(args[0], "fixed") == 0)
+    {
+        success = parse_u32(args[1], &parsed.min_us);
+        parsed.max_us = parsed.min_us;
+    }
+    else if (strcmp(args[0], "random") == 0)
+    {
+        success =
+            parse_u32(args[1], &parsed.min_us)
+            && parse_u32(args[2], &parsed.max_us)
+            && parsed.max_us >= parsed.min_us;
+    }
+    else if (strcmp(args[0], "stall") == 0)
+    {
+        success =
+            parse_u32(args[1], &parsed.min_us)
+            && parse_u32(args[2], &parsed.stall_us)
+            && parse_u32(args[3], &parsed.stalls_per_million);
+        parsed.max_us = parsed.min_us;
+    }
+    else
+    {
+        success = false;
+    }
+
+    if (success)
+    {
+        *latency = parsed;
+    }
+
+    return success;
+}
+
+static bool
+parse_write_latency(struct platform_leds_st * const platform_leds, char * * const args)
+{
+    return parse_latency(args, &platform_leds->write_latency);
+}
+
+static bool
+parse_read_latency(struct platform_leds_st * const platform_leds, char * * const args)
+{
+    return parse_latency(args, &platform_leds->read_latency);
+}
+
+static bool
+parse_write_failures(struct platform_leds_st * const platform_leds, char * * const args)
+{
+    return parse_u32(args[0], &platform_leds->write_failures_per_million);
+}
+
+static bool
+parse_read_failures(struct platform_leds_st * const platform_leds, char * * const args)
+{
+    return parse_u32(args[0], &platform_leds->read_failures_per_million);
+}
+
+static bool
+parse_hardware_flash(struct platform_leds_st * const platform_leds, char * * const args)
+{
+    bool success;
+    uint32_t value;
+
+    success = parse_u32(args[0], &value) && value <= 1;
+    if (success)
+    {
+        platform_leds->hardware_flash = value != 0;
+    }
+
+    return success;
+}
+
+static bool
+parse_seed(struct platform_leds_st * const platform_leds, char * * const args)
+{
+    bool success;
+    uint32_t seed;
+
+    success = parse_u32(args[0], &seed);
+    if (success)
+    {
+        /* The xorshift state mustn't be zero. */
+        platform_leds->random_state = (uint64_t)seed + 1;
+    }
+
+    return success;
+}
+
+static struct setting_st const settings[] =
+{
+    { .name = "leds", .env = "LED_SYNTHETIC_LEDS", .parse = parse_leds },
+    { .name = "led", .env = NULL, .parse = parse_led },
+    { .name = "write_latency", .env = "LED_SYNTHETIC_WRITE_LATENCY", .parse = parse_write_latency },
+    { .name = "read_latency", .env = "LED_SYNTHETIC_READ_LATENCY", .parse = parse_read_latency },
+    { .name = "write_failures", .env = "LED_SYNTHETIC_WRITE_FAILURES", .parse = parse_write_failures },
+    { .name = "read_failures", .env = "LED_SYNTHETIC_READ_FAILURES", .parse = parse_read_failures },
+    { .name = "hardware_flash", .env = "LED_SYNTHETIC_HARDWARE_FLASH", .parse = parse_hardware_flash },
+    { .name = "seed", .env = "LED_SYNTHETIC_SEED", .parse = parse_seed }
+};
+
+/* Split the line into words and apply the setting they describe. */
+static bool
+apply_setting(
+    struct platform_leds_st * const platform_leds,
+    struct setting_st const * setting,
+    char * const line)
+{
+    bool success;
+    char * args[6] = { NULL };
+    size_t num_args = 0;
+    char * saveptr;
+
+    for (char * word = strtok_r(line, " \t\r\n", &saveptr);
+         word != NULL && num_args < ARRAY_SIZE(args) - 1;
+         word = strtok_r(NULL, " \t\r\n", &saveptr))
+    {
+        args[num_args++] = word;
+    }
+
+    if (num_args == 0)
+    {
+        /* A blank line. */
+        success = true;
+        goto done;
+    }
+
+    if (setting == NULL)
+    {
+        for (size_t i = 0; i < ARRAY_SIZE(settings) && setting == NULL; i++)
+        {
+            if (strcmp(args[0], settings[i].name) == 0)
+            {
+                setting = &settings[i];
+            }
+        }
+        if (setting == NULL)
+        {
+            success = false;
+            goto done;
+        }
+        success = setting->parse(platform_leds, &args[1]);
+    }
+    else
+    {
+        success = setting->parse(platform_leds, args);
+    }
+
+done:
+    return success;
+}
+
+static bool
+read_config_file(struct platform_leds_st * const platform_leds, char const * const path)
+{
+    bool success = true;
+    FILE * const fp = fopen(path, "r");
+    char line[MAX_LINE_LEN];
+    unsigned line_number = 0;
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Unable to open synthetic LED config %s\n", path);
+        success = false;
+        goto done;
+    }
+
+    while (success && fgets(line, sizeof line, fp) != NULL)
+    {
+        char * const comment = strchr(line, '#');
+
+        line_number++;
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+        success = apply_setting(platform_leds, NULL, line);
+        if (!success)
+        {
+            fprintf(stderr, "Invalid setting at %s:%u\n", path, line_number);
+        }
+    }
+
+done:
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+
+    return success;
+}
+
+static bool
+read_config_env(struct platform_leds_st * const platform_leds)
+{
+    bool success = true;
+
+    for (size_t i = 0; i < ARRAY_SIZE(settings) && success; i++)
+    {
+        char const * const value = (settings[i].env != NULL) ? getenv(settings[i].env) : NULL;
+
+        if (value != NULL)
+        {
+            char * const line = strdup(value);
+
+            success = line != NULL && apply_setting(platform_leds, &settings[i], line);
+            if (!success)
+            {
+                fprintf(stderr, "Invalid setting %s=\"%s\"\n", settings[i].env, value);
+            }
+            free(line);
+        }
+    }
+
+    return success;
+}
+
+static enum led_state_t
+get_led_state(
+    led_handle_st * const led_handle, led_st const * const led)
+{
+    enum led_state_t state;
+
+    UNUSED_ARG(led_handle);
+
+    if (led == NULL)
+    {
+        state = LED_STATE_UNKNOWN;
+        goto done;
+    }
+
+    inject_latency(&synthetic, &synthetic.read_latency);
+    state =
+        one_in_a_million(&synthetic, synthetic.read_failures_per_million)
+        ? LED_STATE_UNKNOWN
+        : led->state;
+
+done:
+    return state;
+}
+
+static bool
+set_led_state(
+    led_handle_st * const led_handle,
+    led_st * const led,
+    enum led_state_t const state)
+{
+    bool success;
+
+    UNUSED_ARG(led_handle);
+
+    inject_latency(&synthetic, &synthetic.write_latency);
+    success = !one_in_a_million(&synthetic, synthetic.write_failures_per_million);
+    if (success)
+    {
+        led->state = state;
+    }
+
+    return success;
+}
+
+static led_handle_st *
+led_open(void)
+{
+    static int const dummy = 0;
+    /* Nothing to do. Don't return NULL though, as that indicates error. */
+
+    return (led_handle_st *)&dummy;
+}
+
+static void
+led_close(led_handle_st * const led_handle)
+{
+    UNUSED_ARG(led_handle);
+    /* Nothing to do. */
+}
+
+static led_st *
+iterate_leds(
+    platform_leds_st * const platform_leds,
+    bool (*cb)(led_st * led, void * user_ctx),
+    void * user_ctx)
+{
+    led_st * led;
+
+    for (size_t i = 0; i < platform_leds->num_leds; i++)
+    {
+        if (!cb(&platform_leds->leds[i], user_ctx))
+        {
+            led = &platform_leds->leds[i];
+            goto done;
+        }
+    }
+
+    led = NULL;
+
+done:
+    return led;
+}
+
+static void
+iterate_supported_states(
+    void (*cb)(enum led_state_t state, void * user_ctx), void * user_ctx)
+{
+    cb(LED_OFF, user_ctx);
+    cb(LED_ON, user_ctx);
+    if (synthetic.hardware_flash)
+    {
+        cb(LED_SLOW_FLASH, user_ctx);
+        cb(LED_FAST_FLASH, user_ctx);
+    }
+}
+
+static char const *
+get_led_name(led_st const * const led)
+{
+    return led->name;
+}
+
+static enum led_colour_t
+get_led_colour(led_st const * const led)
+{
+    enum led_colour_t const colour =
+        (led != NULL) ? led->colour : (enum led_colour_t)-1;
+
+    return colour;
+}
+
+static void
+leds_deinit(platform_leds_st * const platform_leds)
+{
+    if (platform_leds == NULL)
+    {
+        goto done;
+    }
+
+    for (size_t i = 0; i < platform_leds->num_leds; i++)
+    {
+        free(platform_leds->leds[i].name);
+    }
+    free(platform_leds->leds);
+    memset(platform_leds, 0, sizeof *platform_leds);
+
+done:
+    return;
+}
+
+static platform_leds_st *
+leds_init(void)
+{
+    struct platform_leds_st * platform_leds = &synthetic;
+    char const * const config_path = getenv("LED_SYNTHETIC_CONFIG");
+
+    memset(platform_leds, 0, sizeof *platform_leds);
+    platform_leds->hardware_flash = true;
+    platform_leds->random_state = 1;
+
+    if ((config_path != NULL && !read_config_file(platform_leds, config_path))
+        || !read_config_env(platform_leds))
+    {
+        leds_deinit(platform_leds);
+        platform_leds = NULL;
+        goto done;
+    }
+
+    if (platform_leds->num_leds == 0)
+    {
+        char count[16];
+        char * args[] = { count, NULL };
+
+        snprintf(count, sizeof count, "%d", DEFAULT_NUM_LEDS);
+        if (!parse_leds(platform_leds, args))
+        {
+            leds_deinit(platform_leds);
+            platform_leds = NULL;
+            goto done;
+        }
+    }
+
+done:
+    return platform_leds;
+}
+
+struct platform_led_methods_st const *
+platform_leds_methods(int const plugin_version)
+{
+    static struct platform_led_methods_st const methods =
+    {
+        .get_led_state = get_led_state,
+        .set_led_state = set_led_state,
+        .get_led_name = get_led_name,
+        .get_led_colour = get_led_colour,
+        .open = led_open,
+        .close = led_close,
+        .iterate_leds = iterate_leds,
+        .iterate_supported_states = iterate_supported_states,
+        .init = leds_init,
+        .deinit = leds_deinit
+    };
+    bool const version_ok = plugin_version == LED_DAEMON_PLUGIN_VERSION;
+    struct platform_led_methods_st const * const platform_methods =
+        version_ok ? &methods : NULL;
+
+    return platform_methods;
+}
@@ -3,10 +3,13 @@
 #include <lib_led/string_constants.h>
 #include <ubus_utils/ubus_utils.h>
 
+#include <libubox/uloop.h>
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <limits.h>
 #include <string.h>
 #include <stdint.h>
 
@@ -64,6 +67,132 @@ play_pattern(
     return context.success;
 }
 
+struct wait_pattern_context_st
+{
+    char const * pattern_name;
+    bool ended;
+    bool finished;
+    struct uloop_timeout timeout;
+};
+
+static void
+wait_pattern_event(
+    struct led_pattern_event_st const * const event, void * const user_ctx)
+{
+    struct wait_pattern_context_st * const context = user_ctx;
+
+    if (!event->pattern_ended
+        || strcasecmp(event->pattern_name, context->pattern_name) != 0)
+    {
+        goto done;
+    }
+
+    if (event->preempted_by != NULL)
+    {
+        fprintf(stdout, "%s: %s by %s\n",
+                event->pattern_name, event->event, event->preempted_by);
+    }
+    else
+    {
+        fprintf(stdout, "%s: %s\n", event->pattern_name, event->event);
+    }
+
+    context->ended = true;
+    context->finished = strcmp(event->event, _led_pattern_finished) == 0;
+    uloop_end();
+
+done:
+    return;
+}
+
+static void
+wait_pattern_timeout(struct uloop_timeout * const timeout)
+{
+    struct wait_pattern_context_st const * const context =
+        container_of(timeout, struct wait_pattern_context_st, timeout);
+
+    fprintf(stdout, "%s: timed out\n", context->pattern_name);
+    uloop_end();
+}
+
+/*
+ * Play the pattern and block until it stops, or until timeout_secs have
+ * passed if it isn't 0. Succeeds only if the pattern finished by itself,
+ * rather than being stopped or pre-empted. A pattern that plays until it is
+ * stopped is only waited for with a timeout.
+ */
+static bool
+play_pattern_and_wait(
+    struct ubus_context * const ubus_ctx,
+    struct ledcmd_ctx_st const * const ctx,
+    char const * const pattern_name,
+    bool const retrigger,
+    unsigned long const timeout_secs)
+{
+    bool success;
+    struct wait_pattern_context_st context =
+    {
+        .pattern_name = pattern_name,
+        .ended = false,
+        .finished = false,
+        .timeout = { .cb = wait_pattern_timeout }
+    };
+    bool plays_forever;
+    led_pattern_watch_st * watch = NULL;
+
+    uloop_init();
+    ubus_add_uloop(ubus_ctx);
+
+    if (!led_pattern_plays_forever(ctx, pattern_name, &plays_forever))
+    {
+        fprintf(stderr, "Unknown pattern: %s\n", pattern_name);
+        success = false;
+        goto done;
+    }
+    if (plays_forever && timeout_secs == 0)
+    {
+        fprintf(stderr,
+                "%s plays until it is stopped, so --wait needs a --timeout\n",
+                pattern_name);
+        success = false;
+        goto done;
+    }
+
+    watch = led_watch_pattern_events(ctx, wait_pattern_event, &context);
+
+    if (watch == NULL)
+    {
+        fprintf(stderr, "Unable to watch for pattern events\n");
+        success = false;
+        goto done;
+    }
+
+    if (!play_pattern(ctx, pattern_name, retrigger))
+    {
+        success = false;
+        goto done;
+    }
+
+    /* The pattern may already have ended if all of its steps are untimed. */
+    if (!context.ended)
+    {
+        if (timeout_secs > 0)
+        {
+            uloop_timeout_set(&context.timeout, (int)(timeout_secs * 1000));
+        }
+        uloop_run();
+    }
+
+    success = context.finished;
+
+done:
+    uloop_timeout_cancel(&context.timeout);
+    led_unwatch_pattern_events(watch);
+    uloop_done();
+
+    return success;
+}
+
 static int
 stop_pattern(
     struct ledcmd_ctx_st const * const ctx, char const * const pattern_name)
@@ -86,6 +215,10 @@ usage(FILE * const fp)
             "\tled_pattern [options] <pattern>\n"
             "\t-h?         - help    - what you see below\n"
             "\t-r          - replay pattern if already playing\n"
+            "\t-w, --wait  - wait for a played pattern to stop\n"
+            "\t-t, --timeout <seconds>\n"
+            "\t            - stop waiting after this long, which is required\n"
+            "\t              for patterns that play until they are stopped\n"
             "\t-u <socket> - UBUS socket path (otherwise uses default)\n"
             "\tled_pattern list               - List patterns\n"
             "\tled_pattern list_playing       - List playing patterns\n"
@@ -100,11 +233,20 @@ main(int argc, char * argv[])
     int c;
     int result;
     bool retrigger = false;
+    bool wait = false;
+    unsigned long timeout_secs = 0;
     char const * ubus_path = NULL;
     struct ubus_context * ubus_ctx = NULL;
     struct ledcmd_ctx_st * ctx = NULL;
 
-    while ((c = getopt(argc, argv, "?hru:")) != -1)
+    static struct option const long_options[] =
+    {
+        { "wait", no_argument, NULL, 'w' },
+        { "timeout", required_argument, NULL, 't' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    while ((c = getopt_long(argc, argv, "?hrt:u:w", long_options, NULL)) != -1)
     {
         switch (c)
         {
@@ -118,10 +260,24 @@ main(int argc, char * argv[])
             retrigger = true;
             break;
 
+        case 't':
+            timeout_secs = strtoul(optarg, NULL, 10);
+            if (timeout_secs > INT_MAX / 1000)
+            {
+                usage(stderr);
+                result = EXIT_FAILURE;
+                goto done;
+            }
+            break;
+
         case 'u':
             ubus_path = optarg;
             break;
 
+        case 'w':
+            wait = true;
+            break;
+
         default:
             usage(stderr);
             result = EXIT_FAILURE;
@@ -177,8 +333,12 @@ main(int argc, char * argv[])
     }
     if (strcmp(argv[optind], "play") == 0)
     {
-        result = play_pattern(
-            ctx, argv[optind + 1], retrigger) ? EXIT_SUCCESS : EXIT_FAILURE;
+        bool const success =
+            wait
+            ? play_pattern_and_wait(ubus_ctx, ctx, argv[optind + 1], retrigger, timeout_secs)
+            : play_pattern(ctx, argv[optind + 1], retrigger);
+
+        result = success ? EXIT_SUCCESS : EXIT_FAILURE;
         goto done;
     }
     if (strcmp(argv[optind], "stop") == 0)
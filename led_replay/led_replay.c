@@ -0,0 +1,449 @@
+#include <led_daemon/led_journal_format.h>
+
+#include <lib_led/string_constants.h>
+#include <ubus_utils/ubus_utils.h>
+
+#include <libubus.h>
+#include <libubox/blob.h>
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Re-issues the requests recorded in a daemon's request journal to a running
+ * daemon, either with their original spacing or as fast as possible, and
+ * reports the latency of the replayed requests.
+ */
+
+#define DEFAULT_TIMEOUT_MS 5000
+#define MAX_METHOD_LEN 64
+
+struct replay_config_st
+{
+    char const * journal_path;
+    char const * ubus_path;
+    bool as_fast_as_possible;
+    double speed;
+    int timeout_ms;
+};
+
+struct journal_st
+{
+    uint8_t * data;
+    size_t len;
+    size_t num_records;
+};
+
+struct replay_result_st
+{
+    size_t requests;
+    size_t failed;
+    uint64_t elapsed_ns;
+    uint64_t max_lag_ns;
+    uint64_t * latencies_ns;
+};
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int
+compare_u64(void const * const a, void const * const b)
+{
+    uint64_t const * const ua = a;
+    uint64_t const * const ub = b;
+
+    return (*ua > *ub) - (*ua < *ub);
+}
+
+/*
+ * Copy the record at the given offset in the journal, and set next to the
+ * offset of the record following it. Returns false if the journal ends or is
+ * truncated. Records aren't aligned in the journal, so are always copied.
+ */
+static bool
+journal_record_at(
+    struct journal_st const * const journal,
+    size_t const offset,
+    struct led_journal_record_st * const record,
+    size_t * const next)
+{
+    bool found;
+
+    if (offset + sizeof *record > journal->len)
+    {
+        found = false;
+        goto done;
+    }
+
+    memcpy(record, journal->data + offset, sizeof *record);
+    *next = offset + sizeof *record + record->method_len + record->args_len;
+    found = *next <= journal->len && record->method_len < MAX_METHOD_LEN;
+
+done:
+    return found;
+}
+
+static bool
+load_journal(char const * const path, struct journal_st * const journal)
+{
+    bool success;
+    FILE * const fp = fopen(path, "r");
+    struct led_journal_header_st header;
+    long size;
+
+    memset(journal, 0, sizeof *journal);
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Unable to open %s\n", path);
+        success = false;
+        goto done;
+    }
+
+    if (fread(&header, sizeof header, 1, fp) != 1
+        || header.magic != LED_JOURNAL_MAGIC
+        || header.version != LED_JOURNAL_VERSION)
+    {
+        fprintf(stderr, "%s isn't a request journal\n", path);
+        success = false;
+        goto done;
+    }
+
+    if (fseek(fp, 0, SEEK_END) != 0
+        || (size = ftell(fp)) < 0
+        || fseek(fp, sizeof header, SEEK_SET) != 0)
+    {
+        success = false;
+        goto done;
+    }
+
+    journal->len = size - sizeof header;
+    journal->data = malloc(journal->len + 1);
+    if (journal->data == NULL
+        || (journal->len > 0 && fread(journal->data, journal->len, 1, fp) != 1))
+    {
+        success = false;
+        goto done;
+    }
+
+    size_t offset = 0;
+    size_t next;
+    struct led_journal_record_st record;
+
+    while (journal_record_at(journal, offset, &record, &next))
+    {
+        journal->num_records++;
+        offset = next;
+    }
+    if (offset != journal->len)
+    {
+        /* The daemon may have stopped part way through a write. */
+        fprintf(stderr, "%s is truncated after %zu requests\n", path, journal->num_records);
+    }
+
+    success = true;
+
+done:
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+    if (!success)
+    {
+        free(journal->data);
+        journal->data = NULL;
+    }
+
+    return success;
+}
+
+static bool
+replay_journal(
+    struct replay_config_st const * const config,
+    struct journal_st const * const journal,
+    struct ubus_context * const ubus_ctx,
+    uint32_t const ledcmd_id,
+    struct replay_result_st * const result)
+{
+    bool success;
+    struct blob_attr * args = NULL;
+    size_t args_size = 0;
+    size_t offset = 0;
+    size_t next;
+    struct led_journal_record_st record;
+    /*
+     * Requests are paced relative to the first request of each of the
+     * daemon's sessions, as timestamps from different sessions can't be
+     * compared.
+     */
+    bool new_session = true;
+    uint64_t base_ns = 0;
+    uint64_t session_start_ns = 0;
+    uint64_t const start_ns = monotonic_ns();
+
+    while (journal_record_at(journal, offset, &record, &next))
+    {
+        char method[MAX_METHOD_LEN];
+        uint8_t const * const data = journal->data + offset + sizeof record;
+
+        if (record.method_len == 0)
+        {
+            /* The daemon reopened the journal here. */
+            new_session = true;
+            offset = next;
+            continue;
+        }
+
+        memcpy(method, data, record.method_len);
+        method[record.method_len] = '\0';
+
+        /* Copy the arguments so that they are aligned as libubox expects. */
+        if (record.args_len > args_size)
+        {
+            struct blob_attr * const new_args = realloc(args, record.args_len);
+
+            if (new_args == NULL)
+            {
+                success = false;
+                goto done;
+            }
+            args = new_args;
+            args_size = record.args_len;
+        }
+        if (record.args_len > 0)
+        {
+            memcpy(args, data + record.method_len, record.args_len);
+        }
+
+        if (new_session)
+        {
+            base_ns = record.timestamp_ns;
+            session_start_ns = monotonic_ns();
+            new_session = false;
+        }
+
+        if (!config->as_fast_as_possible)
+        {
+            uint64_t const due_ns =
+                session_start_ns
+                + (uint64_t)((double)(record.timestamp_ns - base_ns) / config->speed);
+            struct timespec const due =
+            {
+                .tv_sec = due_ns / 1000000000ULL,
+                .tv_nsec = due_ns % 1000000000ULL
+            };
+
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+
+            uint64_t const lag_ns = monotonic_ns() - due_ns;
+
+            if (lag_ns > result->max_lag_ns)
+            {
+                result->max_lag_ns = lag_ns;
+            }
+        }
+
+        uint64_t const request_start_ns = monotonic_ns();
+        int const status =
+            ubus_invoke(
+                ubus_ctx,
+                ledcmd_id,
+                method,
+                (record.args_len > 0) ? args : NULL,
+                NULL,
+                NULL,
+                config->timeout_ms);
+
+        result->latencies_ns[result->requests] = monotonic_ns() - request_start_ns;
+        result->requests++;
+        if (status != UBUS_STATUS_OK)
+        {
+            result->failed++;
+        }
+
+        offset = next;
+    }
+
+    result->elapsed_ns = monotonic_ns() - start_ns;
+    success = true;
+
+done:
+    free(args);
+
+    return success;
+}
+
+static void
+print_result(struct replay_config_st const * const config, struct replay_result_st const * const result)
+{
+    uint64_t total_ns = 0;
+
+    for (size_t i = 0; i < result->requests; i++)
+    {
+        total_ns += result->latencies_ns[i];
+    }
+    qsort(result->latencies_ns, result->requests, sizeof *result->latencies_ns, compare_u64);
+
+    fprintf(stdout,
+            "{\"replay\": \"%s\", \"mode\": \"%s\", \"requests\": %zu, \"failed\": %zu, "
+            "\"elapsed_ms\": %.3f, \"requests_per_sec\": %.0f, \"max_lag_ms\": %.3f, "
+            "\"mean_ns\": %" PRIu64 ", \"p50_ns\": %" PRIu64 ", \"p99_ns\": %" PRIu64 "}\n",
+            config->journal_path,
+            config->as_fast_as_possible ? "fast" : "paced",
+            result->requests,
+            result->failed,
+            (double)result->elapsed_ns / 1e6,
+            (result->elapsed_ns > 0) ? (double)result->requests * 1e9 / (double)result->elapsed_ns : 0.0,
+            (double)result->max_lag_ns / 1e6,
+            (result->requests > 0) ? total_ns / result->requests : 0,
+            (result->requests > 0) ? result->latencies_ns[(result->requests * 50) / 100] : 0,
+            (result->requests > 0) ? result->latencies_ns[(result->requests * 99) / 100] : 0);
+}
+
+static bool
+run_replay(struct replay_config_st const * const config)
+{
+    bool success;
+    struct journal_st journal = { .data = NULL };
+    struct ubus_context * ubus_ctx = NULL;
+    uint32_t ledcmd_id;
+    struct replay_result_st result = { .latencies_ns = NULL };
+
+    if (!load_journal(config->journal_path, &journal))
+    {
+        success = false;
+        goto done;
+    }
+
+    result.latencies_ns = calloc(journal.num_records + 1, sizeof *result.latencies_ns);
+    if (result.latencies_ns == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    ubus_ctx = ubus_connect(config->ubus_path);
+    if (ubus_ctx == NULL)
+    {
+        fprintf(stderr, "Unable to connect to UBUS\n");
+        success = false;
+        goto done;
+    }
+
+    if (ubus_lookup_id(ubus_ctx, _led_ledcmd, &ledcmd_id) != UBUS_STATUS_OK)
+    {
+        fprintf(stderr, "Unable to find the LED daemon\n");
+        success = false;
+        goto done;
+    }
+
+    success = replay_journal(config, &journal, ubus_ctx, ledcmd_id, &result);
+    if (success)
+    {
+        print_result(config, &result);
+    }
+
+done:
+    if (ubus_ctx != NULL)
+    {
+        ubus_free(ubus_ctx);
+    }
+    free(result.latencies_ns);
+    free(journal.data);
+
+    return success;
+}
+
+static void
+usage(FILE * const fp)
+{
+    fprintf(fp,
+            "usage:\n"
+            "\tled_replay [options] <journal>\n"
+            "\t-h?           - help    - what you see below\n"
+            "\t-u <path>     - ubus socket path\n"
+            "\t-f            - send the requests as fast as possible\n"
+            "\t-s <speed>    - speed multiplier for the original pacing (default 1.0)\n"
+            "\t-t <ms>       - request timeout (default %d)\n"
+            "\n"
+            "Each request is sent when the previous one has completed. The result\n"
+            "is written to stdout as a JSON object.\n"
+            "\n",
+            DEFAULT_TIMEOUT_MS);
+}
+
+int
+main(int argc, char * argv[])
+{
+    int c;
+    int result;
+    struct replay_config_st config =
+    {
+        .journal_path = NULL,
+        .ubus_path = NULL,
+        .as_fast_as_possible = false,
+        .speed = 1.0,
+        .timeout_ms = DEFAULT_TIMEOUT_MS
+    };
+
+    while ((c = getopt(argc, argv, "?hu:fs:t:")) != -1)
+    {
+        switch (c)
+        {
+        case '?':
+        case 'h':
+            usage(stdout);
+            result = EXIT_SUCCESS;
+            goto done;
+
+        case 'u':
+            config.ubus_path = optarg;
+            break;
+
+        case 'f':
+            config.as_fast_as_possible = true;
+            break;
+
+        case 's':
+            config.speed = strtod(optarg, NULL);
+            break;
+
+        case 't':
+            config.timeout_ms = atoi(optarg);
+            break;
+
+        default:
+            usage(stderr);
+            result = EXIT_FAILURE;
+            goto done;
+
+        }
+    }
+
+    if (optind != argc - 1 || config.speed <= 0 || config.timeout_ms <= 0)
+    {
+        usage(stderr);
+        result = EXIT_FAILURE;
+        goto done;
+    }
+
+    config.journal_path = argv[optind];
+
+    result = run_replay(&config) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+done:
+    return result;
+}
@@ -0,0 +1,98 @@
+#ifndef LED_COMMAND_RING_LAYOUT_H__
+#define LED_COMMAND_RING_LAYOUT_H__
+
+#include "led_fast_path_layout.h"
+
+#include <stdint.h>
+
+/*
+ * A single producer, single consumer ring of LED state updates in shared
+ * memory, for producers that update many LEDs many times a second. A
+ * producer registers a ring by sending a led_command_ring_request_st over
+ * the fast path socket. The daemon replies with a led_fast_path_ack_st
+ * carrying two file descriptors: the shared memory, which holds a
+ * led_command_ring_header_st followed by num_records records, and an
+ * eventfd used to wake the daemon. The ring lasts as long as the
+ * connection.
+ *
+ * The producer writes records at head and then advances head. The daemon
+ * reads records at tail and advances tail. Both are free running counters,
+ * so the record at position n is records[n & (num_records - 1)]. Before
+ * waiting for more records the daemon sets wakeup_needed, and a producer
+ * that finds it set after advancing head clears it and writes to the
+ * eventfd. Otherwise no system call is needed to queue records.
+ *
+ * The daemon applies only the most recent of the records it drains for each
+ * LED, using the priority and lock ID given at registration. If the LED IDs
+ * change the daemon sets ids_stale and discards all records, and the
+ * producer must resolve the IDs and register a new ring.
+ */
+#define LED_COMMAND_RING_MAGIC 0x4c454452u /* "LEDR" */
+#define LED_COMMAND_RING_VERSION 1
+#define LED_COMMAND_RING_MIN_RECORDS 64
+#define LED_COMMAND_RING_MAX_RECORDS 65536
+#define LED_COMMAND_RING_DEFAULT_RECORDS 1024
+/* Bucket n counts latencies of at least 2^(n-1) and less than 2^n ns. */
+#define LED_COMMAND_RING_LATENCY_BUCKETS 40
+
+struct led_command_ring_request_st
+{
+    uint32_t magic;
+    uint32_t version;
+    /* Rounded up to a power of two within the limits above. */
+    uint32_t num_records;
+    char priority[LED_FAST_PATH_PRIORITY_LEN];
+    char lock_id[LED_FAST_PATH_LOCK_ID_LEN];
+};
+
+struct led_command_record_st
+{
+    uint32_t led_id;
+    /* One of enum led_fast_path_state_t. */
+    uint32_t state;
+    /* CLOCK_MONOTONIC when the record was queued, used for latency statistics. */
+    uint64_t timestamp_ns;
+};
+
+/* The fields written by the producer. */
+struct led_command_ring_producer_st
+{
+    uint32_t head;
+    /* Records that weren't queued because the ring was full. */
+    uint64_t backpressure_count;
+} __attribute__((aligned(64)));
+
+/* The fields written by the daemon. */
+struct led_command_ring_consumer_st
+{
+    uint32_t tail;
+    uint32_t ids_stale;
+    uint64_t wakeups;
+    uint64_t records_applied;
+    /* Records superseded by a later record for the same LED. */
+    uint64_t records_coalesced;
+    uint64_t records_invalid;
+    /* Times head was found to be more than num_records ahead of tail. */
+    uint64_t overruns;
+    /* The time from queueing a record to the backend applying it. */
+    uint64_t latency_count;
+    uint64_t latency_total_ns;
+    uint64_t latency_max_ns;
+    uint64_t latency_buckets[LED_COMMAND_RING_LATENCY_BUCKETS];
+} __attribute__((aligned(64)));
+
+struct led_command_ring_header_st
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_records;
+    /* The generation of the LED IDs the ring accepts. */
+    uint32_t generation;
+    /* Set by the daemon, and cleared by the producer. */
+    uint32_t wakeup_needed;
+    struct led_command_ring_producer_st producer;
+    struct led_command_ring_consumer_st consumer;
+    struct led_command_record_st records[] __attribute__((aligned(64)));
+};
+
+#endif /* LED_COMMAND_RING_LAYOUT_H__ */
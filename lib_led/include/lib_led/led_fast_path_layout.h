@@ -0,0 +1,79 @@
+#ifndef LED_FAST_PATH_LAYOUT_H__
+#define LED_FAST_PATH_LAYOUT_H__
+
+#include <stdint.h>
+
+/*
+ * The frames exchanged over the daemon's optional fast path socket, a UNIX
+ * SOCK_SEQPACKET socket for producers that set LED states at a high rate.
+ * Each frame is a header followed by num_entries entries, and sets the state
+ * of each LED identified by ID (see resolve_leds) using the priority and
+ * lock ID in the header. Fields are in host byte order.
+ *
+ * The daemon replies with an acknowledgement if the frame requested one, and
+ * always if the frame was rejected, so a client that doesn't wait for
+ * acknowledgements should still check for replies. A client with stale LED
+ * IDs receives LED_FAST_PATH_STATUS_STALE_IDS and should resolve them again.
+ */
+#define LED_FAST_PATH_MAGIC 0x4c454446u /* "LEDF" */
+#define LED_FAST_PATH_VERSION 1
+#define LED_FAST_PATH_MAX_ENTRIES 256
+#define LED_FAST_PATH_PRIORITY_LEN 16
+#define LED_FAST_PATH_LOCK_ID_LEN 32
+
+/* Request an acknowledgement. */
+#define LED_FAST_PATH_FLAG_ACK (1u << 0)
+
+/* The states have the same values as the numeric states of set_many. */
+enum led_fast_path_state_t
+{
+    LED_FAST_PATH_STATE_OFF = 1,
+    LED_FAST_PATH_STATE_ON,
+    LED_FAST_PATH_STATE_FLASH,
+    LED_FAST_PATH_STATE_FAST_FLASH
+};
+
+enum led_fast_path_status_t
+{
+    LED_FAST_PATH_STATUS_OK,
+    /* The state of one or more LEDs couldn't be set. */
+    LED_FAST_PATH_STATUS_FAILED,
+    LED_FAST_PATH_STATUS_INVALID_FRAME,
+    LED_FAST_PATH_STATUS_STALE_IDS
+};
+
+struct led_fast_path_header_st
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    /* Returned in the acknowledgement. */
+    uint32_t seq;
+    /* The generation of the LED IDs. */
+    uint32_t generation;
+    uint32_t num_entries;
+    /* NUL-terminated. Empty for the normal priority. */
+    char priority[LED_FAST_PATH_PRIORITY_LEN];
+    /* NUL-terminated. Empty if not locked. */
+    char lock_id[LED_FAST_PATH_LOCK_ID_LEN];
+};
+
+struct led_fast_path_entry_st
+{
+    uint32_t led_id;
+    uint32_t state;
+};
+
+struct led_fast_path_ack_st
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t status;
+    uint32_t num_failed;
+};
+
+#define LED_FAST_PATH_MAX_FRAME_SIZE \
+    (sizeof(struct led_fast_path_header_st) \
+     + LED_FAST_PATH_MAX_ENTRIES * sizeof(struct led_fast_path_entry_st))
+
+#endif /* LED_FAST_PATH_LAYOUT_H__ */
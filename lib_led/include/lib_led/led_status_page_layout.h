@@ -0,0 +1,48 @@
+#ifndef LED_STATUS_PAGE_LAYOUT_H__
+#define LED_STATUS_PAGE_LAYOUT_H__
+
+#include <stdint.h>
+
+/*
+ * The layout of the shared memory segment in which the daemon publishes the
+ * status of every LED. The segment is written only by the daemon and may be
+ * mapped read-only by any number of readers.
+ *
+ * The header is followed by an array of num_leds entries, sorted by LED name
+ * (ignoring case), and then by a block of NUL-terminated strings. All offsets
+ * are in bytes from the start of the segment. The strings never change once
+ * the segment has been created, but the entries and the change sequence
+ * number may only be read consistently using the seqlock protocol: read
+ * seqlock, and retry if it is odd; read the data; and retry if seqlock has
+ * since changed. A reader should give up if seqlock stays odd, as the daemon
+ * may have stopped part way through an update.
+ */
+#define LED_STATUS_PAGE_DEFAULT_NAME "/ledcmd_status"
+#define LED_STATUS_PAGE_MAGIC 0x4c454453u /* "LEDS" */
+#define LED_STATUS_PAGE_VERSION 1
+
+struct led_status_page_header_st
+{
+    uint32_t magic;
+    uint32_t version;
+    /* Odd while the daemon is updating the entries. */
+    uint32_t seqlock;
+    /* Set when the daemon has stopped and the page will no longer be updated. */
+    uint32_t closed;
+    uint32_t epoch;
+    uint32_t change_seq;
+    uint32_t num_leds;
+    uint32_t entries_offset;
+    uint32_t size;
+};
+
+struct led_status_page_entry_st
+{
+    uint32_t name_offset;
+    uint32_t state_offset;
+    uint32_t priority_offset;
+    uint32_t locked;
+    uint32_t last_changed_seq;
+};
+
+#endif /* LED_STATUS_PAGE_LAYOUT_H__ */
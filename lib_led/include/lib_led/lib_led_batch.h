@@ -0,0 +1,120 @@
+#ifndef LIB_LED_BATCH_H__
+#define LIB_LED_BATCH_H__
+
+#include "lib_led_control.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A batch collects a number of get, set, activate or deactivate operations
+ * and sends them to the daemon in a single request, rather than making a
+ * round trip for each LED. The results for each LED are reported to the
+ * callback in the order the LEDs were added.
+ *
+ * A batch begun without a command is a mixed batch, which may contain any
+ * combination of operations, each added with led_batch_add_op(). The
+ * operations are performed in the order they were added, and the results
+ * of each are reported to the callback supplied with the operation, or to
+ * the callback passed on submission if the operation has none. The results
+ * of operations skipped because of an earlier failure (see
+ * led_batch_set_stop_on_error()) are reported as failures.
+ */
+typedef struct led_batch_st led_batch_st;
+
+/*
+ * Called once an asynchronous request has completed. success is false if
+ * the daemon couldn't be reached or didn't respond in time.
+ */
+typedef void (*led_async_complete_cb)(bool success, void * user_context);
+
+/*
+ * cmd is one of "get", "set", "activate" or "deactivate", or NULL to begin a
+ * mixed batch.
+ */
+led_batch_st *
+led_batch_begin(ledcmd_ctx_st const * ledcmd_ctx, char const * cmd);
+
+/* The strings are copied, so needn't remain valid after the call. */
+bool
+led_batch_add(
+    led_batch_st * batch,
+    char const * led_name,
+    char const * state,
+    char const * lock_id,
+    char const * led_priority,
+    char const * flash_type,
+    uint32_t flash_time_ms);
+
+/* Add an operation to a mixed batch. cb may be NULL. */
+bool
+led_batch_add_op(
+    led_batch_st * batch,
+    char const * cmd,
+    char const * led_name,
+    char const * state,
+    char const * lock_id,
+    char const * led_priority,
+    char const * flash_type,
+    uint32_t flash_time_ms,
+    led_get_set_cb cb,
+    void * cb_context);
+
+/*
+ * Skip the operations in a mixed batch that follow one that fails. By
+ * default all operations are attempted.
+ */
+bool
+led_batch_set_stop_on_error(led_batch_st * batch, bool stop_on_error);
+
+/*
+ * Override the batch's stop_on_error setting for the operation most recently
+ * added to a mixed batch.
+ */
+bool
+led_batch_set_op_stop_on_error(led_batch_st * batch, bool stop_on_error);
+
+/* Returns 0 if batch is NULL. */
+size_t
+led_batch_count(led_batch_st const * batch);
+
+/* Discard a batch without sending it. */
+void
+led_batch_free(led_batch_st * batch);
+
+/* Send the batch and wait for the response. The batch is freed. */
+bool
+led_batch_submit(led_batch_st * batch, led_get_set_cb cb, void * cb_context);
+
+/*
+ * Send the batch without waiting for the response, which is processed from
+ * uloop, so the caller's ubus context must have been added to uloop. Any
+ * number of requests may be in flight at once. The results are reported to
+ * cb, and then complete_cb is called, after which the batch is freed. If
+ * false is returned the request wasn't sent and no callbacks will be made.
+ * All requests must have completed before led_deinit() is called.
+ */
+bool
+led_batch_submit_async(
+    led_batch_st * batch,
+    led_get_set_cb cb,
+    led_async_complete_cb complete_cb,
+    void * cb_context);
+
+/* The asynchronous equivalent of led_get_set_request(). */
+bool
+led_get_set_request_async(
+    ledcmd_ctx_st const * ledcmd_ctx,
+    char const * cmd,
+    char const * state,
+    char const * led_name,
+    char const * lock_id,
+    char const * led_priority,
+    char const * flash_type,
+    uint32_t flash_time_ms,
+    led_get_set_cb cb,
+    led_async_complete_cb complete_cb,
+    void * cb_context);
+
+#endif /* LIB_LED_BATCH_H__ */
@@ -0,0 +1,76 @@
+#ifndef LIB_LED_CHANGES_H__
+#define LIB_LED_CHANGES_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct ledcmd_ctx_st ledcmd_ctx_st;
+typedef struct led_subscription_st led_subscription_st;
+
+struct led_change_st
+{
+    char const * led_name;
+    char const * led_state;
+    char const * led_priority;
+    bool locked;
+};
+
+/*
+ * Called for each LED included in a change notification. All of the LEDs
+ * that changed in the same burst of requests are reported with the same
+ * sequence number.
+ */
+typedef void (*led_change_cb)(
+    uint32_t seq,
+    struct led_change_st const * change,
+    void * user_context);
+
+/*
+ * Subscribe to the notifications sent by the daemon when the state, priority
+ * or lock status of an LED changes. Notifications are delivered from uloop,
+ * so the caller's ubus context must have been added to uloop.
+ */
+led_subscription_st *
+led_subscribe_changes(
+    ledcmd_ctx_st const * ledcmd_ctx,
+    led_change_cb cb,
+    void * cb_context);
+
+void
+led_unsubscribe_changes(led_subscription_st * subscription);
+
+/*
+ * The point up to which a client has synchronised with the daemon's LED
+ * status. Zero-initialise it before the first call to led_sync_changes().
+ */
+struct led_sync_state_st
+{
+    uint32_t epoch;
+    uint32_t seq;
+};
+
+/*
+ * Called for each LED reported by led_sync_changes(). If full_resync is set,
+ * the daemon couldn't supply only the changes since the last sync and every
+ * LED is reported, so the caller should discard any state it holds for LEDs
+ * that aren't reported.
+ */
+typedef void (*led_sync_cb)(
+    struct led_change_st const * change,
+    bool full_resync,
+    void * user_context);
+
+/*
+ * Fetch the LEDs that changed since sync_state was last updated, and update
+ * sync_state on success. The sequence numbers match those in the change
+ * notifications, so a subscriber can use this call to recover from missed
+ * notifications.
+ */
+bool
+led_sync_changes(
+    ledcmd_ctx_st const * ledcmd_ctx,
+    struct led_sync_state_st * sync_state,
+    led_sync_cb cb,
+    void * cb_context);
+
+#endif /* LIB_LED_CHANGES_H__ */
@@ -0,0 +1,80 @@
+#ifndef LIB_LED_COMMAND_RING_H__
+#define LIB_LED_COMMAND_RING_H__
+
+#include "led_command_ring_layout.h"
+#include "lib_led_fast_path.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A shared memory ring of LED updates registered over a fast path
+ * connection (see led_command_ring_layout.h). Updates are queued with
+ * led_command_ring_push() and made visible to the daemon with
+ * led_command_ring_commit(), which only makes a system call if the daemon
+ * is waiting for more updates. The daemon applies only the most recent
+ * update for each LED it finds in the ring. The ring must only be used by
+ * one thread at a time, and is closed before its fast path connection.
+ */
+typedef struct led_command_ring_client_st led_command_ring_client_st;
+
+struct led_command_ring_stats_st
+{
+    uint32_t num_records;
+    /* Records committed but not yet read by the daemon. */
+    uint32_t pending;
+    bool ids_stale;
+    uint64_t backpressure_count;
+    uint64_t wakeups;
+    uint64_t records_applied;
+    uint64_t records_coalesced;
+    uint64_t records_invalid;
+    uint64_t overruns;
+    uint64_t latency_count;
+    uint64_t latency_total_ns;
+    uint64_t latency_max_ns;
+    uint64_t latency_buckets[LED_COMMAND_RING_LATENCY_BUCKETS];
+};
+
+/*
+ * Register a ring of at least num_records records. led_priority and lock_id
+ * may be NULL, and apply to every update queued on the ring.
+ */
+led_command_ring_client_st *
+led_command_ring_open(
+    led_fast_path_st * fast_path,
+    uint32_t num_records,
+    char const * led_priority,
+    char const * lock_id);
+
+void
+led_command_ring_close(led_command_ring_client_st * ring);
+
+/* Returns 0 if the LED isn't known. */
+uint32_t
+led_command_ring_led_id(led_command_ring_client_st const * ring, char const * led_name);
+
+/*
+ * Queue an update. Fails if the LED or state isn't known, the ring is full
+ * (counted in backpressure_count) or the daemon has reported that the LED
+ * IDs have changed, in which case the ring must be reopened.
+ */
+bool
+led_command_ring_push(
+    led_command_ring_client_st * ring, char const * led_name, char const * state);
+
+/* As led_command_ring_push(), for an ID and an enum led_fast_path_state_t. */
+bool
+led_command_ring_push_id(
+    led_command_ring_client_st * ring, uint32_t led_id, uint32_t state);
+
+/* Make the queued updates visible to the daemon, waking it if need be. */
+bool
+led_command_ring_commit(led_command_ring_client_st * ring);
+
+void
+led_command_ring_get_stats(
+    led_command_ring_client_st const * ring, struct led_command_ring_stats_st * stats);
+
+#endif /* LIB_LED_COMMAND_RING_H__ */
@@ -2,6 +2,7 @@
 #define LIB_LED_CONTROL_H__
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct ledcmd_ctx_st ledcmd_ctx_st;
@@ -39,6 +40,39 @@ typedef void (*led_get_set_cb)(
     struct led_get_set_result_st const * result,
     void * user_context);
 
+/*
+ * Controls how much detail the daemon includes in the responses to requests
+ * that operate on a number of LEDs (get/set/activate/deactivate).
+ * FULL: A result is reported for every LED.
+ * ERRORS_ONLY: Only failed results are reported.
+ * SUMMARY: No per-LED results are reported.
+ * With ERRORS_ONLY and SUMMARY the number of successful and failed operations
+ * is reported to the summary callback.
+ */
+enum led_response_verbosity_t
+{
+    LED_RESPONSE_VERBOSITY_FULL,
+    LED_RESPONSE_VERBOSITY_ERRORS_ONLY,
+    LED_RESPONSE_VERBOSITY_SUMMARY
+};
+
+struct led_response_summary_st
+{
+    uint32_t succeeded;
+    uint32_t failed;
+};
+
+typedef void (*led_response_summary_cb)(
+    struct led_response_summary_st const * summary,
+    void * user_context);
+
+void
+led_set_response_verbosity(
+    ledcmd_ctx_st * ledcmd_ctx,
+    enum led_response_verbosity_t verbosity,
+    led_response_summary_cb summary_cb,
+    void * summary_cb_context);
+
 bool
 led_activate_or_deactivate(
     ledcmd_ctx_st const * ledcmd_ctx,
@@ -74,5 +108,54 @@ led_get_set_request(
     led_get_set_cb cb,
     void * cb_context);
 
+/*
+ * Ask the daemon for the numeric IDs of its LEDs and aliases, and cache them
+ * in the context. Subsequent requests identify those LEDs by ID, which saves
+ * the daemon from looking them up by name. If the daemon reports that the IDs
+ * have changed, they are resolved again and the request is retried; for
+ * asynchronous requests the IDs are resolved asynchronously too.
+ */
+bool
+led_resolve_ids(ledcmd_ctx_st const * ledcmd_ctx);
+
+/*
+ * Set the state of a number of LEDs in a single request. The lock ID,
+ * priority and flash settings apply to all of the LEDs. Either one state
+ * must be supplied for each LED, or a single state that is applied to all
+ * of them.
+ */
+bool
+led_set_many_request(
+    ledcmd_ctx_st const * ledcmd_ctx,
+    char const * const * led_names,
+    size_t num_leds,
+    char const * const * states,
+    size_t num_states,
+    char const * lock_id,
+    char const * led_priority,
+    char const * flash_type,
+    uint32_t flash_time_ms,
+    led_get_set_cb cb,
+    void * cb_context);
+
+/*
+ * As led_set_many_request(), but with the states given by value, as one of
+ * enum led_fast_path_state_t (see led_fast_path_layout.h), rather than by
+ * name.
+ */
+bool
+led_set_many_values_request(
+    ledcmd_ctx_st const * ledcmd_ctx,
+    char const * const * led_names,
+    size_t num_leds,
+    uint32_t const * states,
+    size_t num_states,
+    char const * lock_id,
+    char const * led_priority,
+    char const * flash_type,
+    uint32_t flash_time_ms,
+    led_get_set_cb cb,
+    void * cb_context);
+
 #endif /* LIB_LED_CONTROL_H__ */
 
@@ -0,0 +1,63 @@
+#ifndef LIB_LED_FAST_PATH_H__
+#define LIB_LED_FAST_PATH_H__
+
+#include "lib_led.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A connection to the daemon's fast path socket (see the daemon's -f
+ * option), over which LED states are set with small binary frames rather
+ * than ubus requests. This suits producers that update LEDs many times a
+ * second. LEDs are identified by the IDs resolved with led_resolve_ids(), so
+ * the ubus context is still required, and the IDs are resolved again if the
+ * daemon reports that they have changed.
+ */
+typedef struct led_fast_path_st led_fast_path_st;
+
+struct led_fast_path_update_st
+{
+    char const * led_name;
+    /* One of the states accepted by "set" requests, e.g. "on". */
+    char const * state;
+};
+
+led_fast_path_st *
+led_fast_path_connect(ledcmd_ctx_st * ledcmd_ctx, char const * socket_path);
+
+void
+led_fast_path_close(led_fast_path_st * fast_path);
+
+/*
+ * Set the states of the LEDs without waiting for the daemon to apply them.
+ * led_priority and lock_id may be NULL. Fails if a LED or state isn't known,
+ * or there are more than LED_FAST_PATH_MAX_ENTRIES updates.
+ *
+ * Also fails, without sending the frame, if the daemon has rejected an
+ * earlier frame sent by this function because the LED IDs had changed. The
+ * states in that frame weren't set. The IDs have been resolved again, so the
+ * caller should resend the states it needs, including these.
+ */
+bool
+led_fast_path_set(
+    led_fast_path_st * fast_path,
+    struct led_fast_path_update_st const * updates,
+    size_t num_updates,
+    char const * led_priority,
+    char const * lock_id);
+
+/*
+ * As led_fast_path_set(), but waits for the daemon to apply the states, and
+ * succeeds only if all were set.
+ */
+bool
+led_fast_path_set_and_wait(
+    led_fast_path_st * fast_path,
+    struct led_fast_path_update_st const * updates,
+    size_t num_updates,
+    char const * led_priority,
+    char const * lock_id);
+
+#endif /* LIB_LED_FAST_PATH_H__ */
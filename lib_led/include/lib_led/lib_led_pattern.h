@@ -1,9 +1,12 @@
 #ifndef LIB_LED_PATTERN_H__
 #define LIB_LED_PATTERN_H__
 
+#include "lib_led_batch.h"
+
 #include <stdbool.h>
 
 typedef struct ledcmd_ctx_st ledcmd_ctx_st;
+typedef struct led_pattern_watch_st led_pattern_watch_st;
 
 typedef void (*led_list_patterns_cb)(
     char const * pattern_name, void * user_context);
@@ -17,6 +20,16 @@ led_list_patterns(
     led_list_patterns_cb cb,
     void * cb_context);
 
+/*
+ * Look up whether the named pattern plays until it is stopped, because it
+ * repeats or has a play count of 0. Fails if there is no such pattern.
+ */
+bool
+led_pattern_plays_forever(
+    struct ledcmd_ctx_st const * ledcmd_ctx,
+    char const * pattern_name,
+    bool * plays_forever);
+
 bool
 led_list_playing_patterns(
     struct ledcmd_ctx_st const * ledcmd_ctx,
@@ -38,5 +51,57 @@ led_stop_pattern(
     led_play_pattern_cb cb,
     void * cb_context);
 
+/*
+ * The asynchronous equivalents of led_play_pattern() and led_stop_pattern(),
+ * which complete as described for led_batch_submit_async().
+ */
+bool
+led_play_pattern_async(
+    struct ledcmd_ctx_st const * ledcmd_ctx,
+    char const * pattern_name,
+    bool retrigger,
+    led_play_pattern_cb cb,
+    led_async_complete_cb complete_cb,
+    void * cb_context);
+
+bool
+led_stop_pattern_async(
+    struct ledcmd_ctx_st const * ledcmd_ctx,
+    char const * pattern_name,
+    led_play_pattern_cb cb,
+    led_async_complete_cb complete_cb,
+    void * cb_context);
+
+/*
+ * event is one of "started", "step_wrapped", "finished", "stopped" or
+ * "preempted". pattern_ended is set for the events sent when a pattern stops
+ * playing. preempted_by is only set for "preempted" events.
+ */
+struct led_pattern_event_st
+{
+    char const * pattern_name;
+    char const * event;
+    char const * preempted_by;
+    bool pattern_ended;
+};
+
+typedef void (*led_pattern_event_cb)(
+    struct led_pattern_event_st const * event, void * user_ctx);
+
+/*
+ * Receive the events the daemon sends as patterns start, repeat and stop.
+ * Events are delivered from uloop, so the caller's ubus context must have
+ * been added to uloop. To avoid missing the events for a pattern, start
+ * watching before asking for the pattern to be played.
+ */
+led_pattern_watch_st *
+led_watch_pattern_events(
+    struct ledcmd_ctx_st const * ledcmd_ctx,
+    led_pattern_event_cb cb,
+    void * cb_context);
+
+void
+led_unwatch_pattern_events(led_pattern_watch_st * watch);
+
 #endif /* LIB_LED_PATTERN_H__ */
 
@@ -0,0 +1,56 @@
+#ifndef LIB_LED_STATUS_PAGE_H__
+#define LIB_LED_STATUS_PAGE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Read-only access to the LED status page published by the daemon. Reads
+ * don't involve ubus or the daemon at all, so they suit readers that poll the
+ * LED status at a high rate. The state and priority strings are the same as
+ * those reported by the daemon's "get" method.
+ */
+typedef struct led_status_page_map_st led_status_page_map_st;
+
+struct led_page_status_st
+{
+    char const * led_name;
+    char const * led_state;
+    char const * led_priority;
+    bool locked;
+    uint32_t last_changed_seq;
+};
+
+/* Map the status page. If name is NULL the daemon's default name is used. */
+led_status_page_map_st *
+led_status_page_map(char const * name);
+
+void
+led_status_page_unmap(led_status_page_map_st * map);
+
+size_t
+led_status_page_num_leds(led_status_page_map_st const * map);
+
+/*
+ * Look up the index of the named LED. Indexes remain valid for as long as
+ * the page is mapped.
+ */
+bool
+led_status_page_find(
+    led_status_page_map_st const * map, char const * led_name, size_t * index);
+
+/*
+ * Read a consistent snapshot of the status of the LED at the index, and of
+ * the change sequence number at the time. Fails if the daemon has stopped
+ * updating the page, or stopped part way through an update, in which case the
+ * caller should unmap it and map it again once the daemon has restarted.
+ */
+bool
+led_status_page_read(
+    led_status_page_map_st const * map,
+    size_t index,
+    struct led_page_status_st * status,
+    uint32_t * change_seq);
+
+#endif /* LIB_LED_STATUS_PAGE_H__ */
@@ -66,5 +66,78 @@ extern char const _led_alias_aliases[];
 extern char const _led_pattern_step_time_ms[];
 extern char const _led_pattern_step_leds[];
 
+extern char const _led_verbosity[];
+extern char const _led_verbosity_full[];
+extern char const _led_verbosity_errors[];
+extern char const _led_verbosity_summary[];
+extern char const _led_succeeded[];
+extern char const _led_failed[];
+
+extern char const _led_set_many[];
+extern char const _led_names[];
+extern char const _led_states[];
+
+extern char const _led_resolve[];
+extern char const _led_id[];
+extern char const _led_ids[];
+extern char const _led_generation[];
+
+extern char const _led_leds_changed[];
+extern char const _led_seq[];
+extern char const _led_locked[];
+
+extern char const _led_get_changes[];
+extern char const _led_since[];
+extern char const _led_resync[];
+extern char const _led_epoch[];
+
+extern char const _led_pattern_event[];
+extern char const _led_event[];
+extern char const _led_pattern_started[];
+extern char const _led_pattern_step_wrapped[];
+extern char const _led_pattern_finished[];
+extern char const _led_pattern_stopped[];
+extern char const _led_pattern_preempted[];
+extern char const _led_pattern_preempted_by[];
+
+extern char const _led_batch[];
+extern char const _led_ops[];
+extern char const _led_op[];
+extern char const _led_results[];
+extern char const _led_skipped[];
+extern char const _led_stop_on_error[];
+
+extern char const _led_line[];
+extern char const _led_command[];
+
+extern char const _led_stats[];
+extern char const _led_stats_reset[];
+extern char const _led_methods[];
+extern char const _led_backend[];
+extern char const _led_calls[];
+extern char const _led_errors[];
+extern char const _led_latency[];
+extern char const _led_count[];
+extern char const _led_mean_ns[];
+extern char const _led_p50_ns[];
+extern char const _led_p90_ns[];
+extern char const _led_p99_ns[];
+extern char const _led_max_ns[];
+extern char const _led_histogram[];
+extern char const _led_set_led_state[];
+extern char const _led_get_led_state[];
+extern char const _led_flash_timer_firings[];
+extern char const _led_pattern_timer_firings[];
+extern char const _led_pattern_steps[];
+extern char const _led_write_elisions[];
+extern char const _led_response_buffer[];
+extern char const _led_high_water[];
+extern char const _led_allocations[];
+extern char const _led_elapsed_ms[];
+extern char const _led_timer_lateness[];
+extern char const _led_timer_trace_dump[];
+extern char const _led_path[];
+extern char const _led_records[];
+
 #endif /* STRING_CONSTANTS_H__ */
 
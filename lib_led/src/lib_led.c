@@ -8,22 +8,14 @@
 #include <stdlib.h>
 #include <string.h>
 
-struct ledcmd_ctx_st
-{
-    struct ubus_context * ubus_ctx;
-    uint32_t ledcmd_ubus_id;
-};
-
-bool
-ledcmd_ubus_invoke(
+int
+ledcmd_ubus_invoke_status(
     char const * const cmd,
     struct blob_buf * const msg,
     ubus_cb const cb,
     void * const cb_context,
     struct ledcmd_ctx_st const * const ledcmd_ctx)
 {
-    int const ubus_req_timeout_ms = 1000;
-
     return ubus_invoke(
         ledcmd_ctx->ubus_ctx,
         ledcmd_ctx->ledcmd_ubus_id,
@@ -31,13 +23,34 @@ ledcmd_ubus_invoke(
         msg->head,
         cb,
         cb_context,
-        ubus_req_timeout_ms) == UBUS_STATUS_OK;
+        LEDCMD_UBUS_REQUEST_TIMEOUT_MS);
+}
+
+bool
+ledcmd_ubus_invoke(
+    char const * const cmd,
+    struct blob_buf * const msg,
+    ubus_cb const cb,
+    void * const cb_context,
+    struct ledcmd_ctx_st const * const ledcmd_ctx)
+{
+    return ledcmd_ubus_invoke_status(cmd, msg, cb, cb_context, ledcmd_ctx)
+        == UBUS_STATUS_OK;
 }
 
 void
 led_deinit(struct ledcmd_ctx_st * const ctx)
 {
+    if (ctx == NULL)
+    {
+        goto done;
+    }
+
+    led_ids_free(ctx);
     free(ctx);
+
+done:
+    return;
 }
 
 struct ledcmd_ctx_st *
@@ -53,8 +66,10 @@ led_init(struct ubus_context * const ubus_ctx)
     }
 
     ctx->ubus_ctx = ubus_ctx;
+    ctx->verbosity = LED_RESPONSE_VERBOSITY_FULL;
 
-    success = ubus_lookup_id(ctx->ubus_ctx, _led_ledcmd, &ctx->ledcmd_ubus_id)
+    success = led_ids_init(ctx)
+        && ubus_lookup_id(ctx->ubus_ctx, _led_ledcmd, &ctx->ledcmd_ubus_id)
         == UBUS_STATUS_OK;
 
 done:
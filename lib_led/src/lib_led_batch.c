@@ -0,0 +1,719 @@
+#include "lib_led_batch.h"
+#include "lib_led_private.h"
+#include "string_constants.h"
+
+#include <ubus_utils/ubus_utils.h>
+#include <libubox/uloop.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+struct led_batch_entry_st
+{
+    struct led_request_st request;
+    /* Holds copies of the strings the request points to. */
+    char * strings;
+    /* The operation, and its own callback, for entries in mixed batches. */
+    char const * op;
+    led_get_set_cb cb;
+    void * cb_context;
+    /* Overrides the batch's stop_on_error setting if set. */
+    bool stop_on_error_set;
+    bool stop_on_error;
+};
+
+struct batch_response_ctx_st
+{
+    /* Must be first, as this is all that led_response_handler() uses. */
+    struct ledcmd_led_ctx_st led_ctx;
+    struct led_batch_st const * batch;
+};
+
+struct led_batch_st
+{
+    struct ledcmd_ctx_st const * ledcmd_ctx;
+    char const * cmd;
+    bool mixed;
+    bool stop_on_error;
+    struct led_batch_entry_st * entries;
+    size_t num_entries;
+    size_t max_entries;
+
+    /* Only used by asynchronous requests. */
+    struct ubus_request req;
+    struct uloop_timeout timeout;
+    struct blob_buf msg;
+    struct batch_response_ctx_st response_ctx;
+    led_async_complete_cb complete_cb;
+    bool retried;
+};
+
+static char const *
+batch_command(char const * const cmd)
+{
+    static char const * const batch_commands[] =
+    {
+        _led_get,
+        _led_set,
+        _led_activate,
+        _led_deactivate
+    };
+    char const * batch_cmd = NULL;
+
+    for (size_t i = 0; i < ARRAY_SIZE(batch_commands); i++)
+    {
+        if (strcmp(cmd, batch_commands[i]) == 0)
+        {
+            batch_cmd = batch_commands[i];
+            break;
+        }
+    }
+
+    return batch_cmd;
+}
+
+void
+led_batch_free(struct led_batch_st * const batch)
+{
+    if (batch == NULL)
+    {
+        goto done;
+    }
+
+    for (size_t i = 0; i < batch->num_entries; i++)
+    {
+        free(batch->entries[i].strings);
+    }
+    free(batch->entries);
+    blob_buf_free(&batch->msg);
+    free(batch);
+
+done:
+    return;
+}
+
+struct led_batch_st *
+led_batch_begin(struct ledcmd_ctx_st const * const ledcmd_ctx, char const * const cmd)
+{
+    struct led_batch_st * batch = NULL;
+    bool const mixed = cmd == NULL;
+    char const * const batch_cmd = mixed ? _led_batch : batch_command(cmd);
+
+    if (ledcmd_ctx == NULL || batch_cmd == NULL)
+    {
+        goto done;
+    }
+
+    batch = calloc(1, sizeof *batch);
+    if (batch == NULL)
+    {
+        goto done;
+    }
+
+    batch->ledcmd_ctx = ledcmd_ctx;
+    batch->cmd = batch_cmd;
+    batch->mixed = mixed;
+
+done:
+    return batch;
+}
+
+static size_t
+optional_string_size(char const * const str)
+{
+    return (str != NULL) ? strlen(str) + 1 : 0;
+}
+
+static char const *
+copy_optional_string(char ** const cursor, char const * const str)
+{
+    char const * copy;
+
+    if (str == NULL)
+    {
+        copy = NULL;
+        goto done;
+    }
+
+    size_t const size = strlen(str) + 1;
+
+    memcpy(*cursor, str, size);
+    copy = *cursor;
+    *cursor += size;
+
+done:
+    return copy;
+}
+
+static bool
+batch_reserve_entry(struct led_batch_st * const batch)
+{
+    bool success;
+
+    if (batch->num_entries < batch->max_entries)
+    {
+        success = true;
+        goto done;
+    }
+
+    size_t const max_entries = (batch->max_entries > 0) ? batch->max_entries * 2 : 8;
+    struct led_batch_entry_st * const entries =
+        realloc(batch->entries, max_entries * sizeof *entries);
+
+    if (entries == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    batch->entries = entries;
+    batch->max_entries = max_entries;
+    success = true;
+
+done:
+    return success;
+}
+
+static struct led_batch_entry_st *
+batch_add_entry(
+    struct led_batch_st * const batch,
+    char const * const led_name,
+    char const * const state,
+    char const * const lock_id,
+    char const * const led_priority,
+    char const * const flash_type,
+    uint32_t const flash_time_ms)
+{
+    struct led_batch_entry_st * entry = NULL;
+
+    if (led_name == NULL || !batch_reserve_entry(batch))
+    {
+        goto done;
+    }
+
+    size_t const strings_size =
+        optional_string_size(led_name)
+        + optional_string_size(state)
+        + optional_string_size(lock_id)
+        + optional_string_size(led_priority)
+        + optional_string_size(flash_type);
+    char * const strings = malloc(strings_size);
+
+    if (strings == NULL)
+    {
+        goto done;
+    }
+
+    char * cursor = strings;
+
+    entry = &batch->entries[batch->num_entries];
+    memset(entry, 0, sizeof *entry);
+
+    entry->strings = strings;
+    entry->request.led_name = copy_optional_string(&cursor, led_name);
+    entry->request.state = copy_optional_string(&cursor, state);
+    entry->request.lock_id = copy_optional_string(&cursor, lock_id);
+    entry->request.led_priority = copy_optional_string(&cursor, led_priority);
+    entry->request.flash_type = copy_optional_string(&cursor, flash_type);
+    entry->request.flash_time_ms = flash_time_ms;
+    batch->num_entries++;
+
+done:
+    return entry;
+}
+
+bool
+led_batch_add(
+    struct led_batch_st * const batch,
+    char const * const led_name,
+    char const * const state,
+    char const * const lock_id,
+    char const * const led_priority,
+    char const * const flash_type,
+    uint32_t const flash_time_ms)
+{
+    return batch != NULL
+           && !batch->mixed
+           && batch_add_entry(
+               batch, led_name, state, lock_id, led_priority, flash_type, flash_time_ms)
+              != NULL;
+}
+
+bool
+led_batch_add_op(
+    struct led_batch_st * const batch,
+    char const * const cmd,
+    char const * const led_name,
+    char const * const state,
+    char const * const lock_id,
+    char const * const led_priority,
+    char const * const flash_type,
+    uint32_t const flash_time_ms,
+    led_get_set_cb const cb,
+    void * const cb_context)
+{
+    bool success;
+    char const * const op = (cmd != NULL) ? batch_command(cmd) : NULL;
+
+    if (batch == NULL || !batch->mixed || op == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    struct led_batch_entry_st * const entry =
+        batch_add_entry(
+            batch, led_name, state, lock_id, led_priority, flash_type, flash_time_ms);
+
+    if (entry == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    entry->op = op;
+    entry->cb = cb;
+    entry->cb_context = cb_context;
+
+    success = true;
+
+done:
+    return success;
+}
+
+bool
+led_batch_set_stop_on_error(struct led_batch_st * const batch, bool const stop_on_error)
+{
+    bool success;
+
+    if (batch == NULL || !batch->mixed)
+    {
+        success = false;
+        goto done;
+    }
+
+    batch->stop_on_error = stop_on_error;
+    success = true;
+
+done:
+    return success;
+}
+
+bool
+led_batch_set_op_stop_on_error(struct led_batch_st * const batch, bool const stop_on_error)
+{
+    bool success;
+
+    if (batch == NULL || !batch->mixed || batch->num_entries == 0)
+    {
+        success = false;
+        goto done;
+    }
+
+    struct led_batch_entry_st * const entry = &batch->entries[batch->num_entries - 1];
+
+    entry->stop_on_error_set = true;
+    entry->stop_on_error = stop_on_error;
+    success = true;
+
+done:
+    return success;
+}
+
+size_t
+led_batch_count(struct led_batch_st const * const batch)
+{
+    return (batch != NULL) ? batch->num_entries : 0;
+}
+
+static void
+build_batch_request(
+    struct ledcmd_ctx_st const * const ctx,
+    void const * const request_in,
+    struct blob_buf * const msg)
+{
+    struct led_batch_st const * const batch = request_in;
+    void * const cookie = blobmsg_open_array(msg, batch->mixed ? _led_ops : _led_leds);
+    bool used_id = false;
+
+    for (size_t i = 0; i < batch->num_entries; i++)
+    {
+        struct led_batch_entry_st const * const entry = &batch->entries[i];
+        struct led_request_st const * const request = &entry->request;
+
+        void * const entry_cookie = blobmsg_open_table(msg, NULL);
+
+        if (entry->op != NULL)
+        {
+            blobmsg_add_string(msg, _led_op, entry->op);
+        }
+        used_id |= append_led_request_fields(
+            ctx,
+            request->led_name,
+            request->state,
+            request->lock_id,
+            request->led_priority,
+            request->flash_type,
+            request->flash_time_ms,
+            msg);
+        if (entry->stop_on_error_set)
+        {
+            blobmsg_add_u8(msg, _led_stop_on_error, entry->stop_on_error);
+        }
+
+        blobmsg_close_table(msg, entry_cookie);
+    }
+
+    blobmsg_close_array(msg, cookie);
+    if (used_id)
+    {
+        blobmsg_add_u32(msg, _led_generation, ctx->led_id_cache->generation);
+    }
+    if (batch->mixed)
+    {
+        blobmsg_add_u8(msg, _led_stop_on_error, batch->stop_on_error);
+    }
+    append_response_verbosity(ctx, msg);
+}
+
+/*
+ * Operations that weren't performed, or were rejected by the daemon, have no
+ * per-LED results, so a failed result is reported for the LED the operation
+ * was for.
+ */
+static void
+report_failed_op(
+    struct led_batch_entry_st const * const entry,
+    char const * const error_msg,
+    led_get_set_cb const cb,
+    void * const cb_context)
+{
+    struct led_get_set_result_st const result =
+    {
+        .success = false,
+        .led_name = entry->request.led_name,
+        .error_msg = error_msg
+    };
+
+    cb(&result, cb_context);
+}
+
+static void
+process_op_result(
+    struct led_batch_entry_st const * const entry,
+    struct blob_attr * const attr,
+    struct ledcmd_led_ctx_st const * const ctx)
+{
+    enum
+    {
+        OP_LEDS,
+        OP_SUCCESS,
+        OP_SKIPPED,
+        OP_ERROR,
+        OP_MAX__
+    };
+    struct blob_attr * fields[OP_MAX__];
+    struct blobmsg_policy const op_result_policy[] =
+    {
+        [OP_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY },
+        [OP_SUCCESS] = { .name = _led_success, .type = BLOBMSG_TYPE_BOOL },
+        [OP_SKIPPED] = { .name = _led_skipped, .type = BLOBMSG_TYPE_BOOL },
+        [OP_ERROR] = { .name = _led_error, .type = BLOBMSG_TYPE_STRING }
+    };
+    led_get_set_cb const cb = (entry->cb != NULL) ? entry->cb : ctx->cb;
+    void * const cb_context = (entry->cb != NULL) ? entry->cb_context : ctx->cb_context;
+
+    if (cb == NULL)
+    {
+        goto done;
+    }
+
+    blobmsg_parse(
+        op_result_policy, ARRAY_SIZE(fields), fields,
+        blobmsg_data(attr), blobmsg_len(attr));
+
+    if (blobmsg_get_bool_or_default(fields[OP_SKIPPED], false))
+    {
+        report_failed_op(entry, "Skipped after an earlier failure", cb, cb_context);
+        goto done;
+    }
+
+    struct blob_attr const * const leds = fields[OP_LEDS];
+
+    if (!blobmsg_array_is_type(leds, BLOBMSG_TYPE_TABLE) || blobmsg_len(leds) == 0)
+    {
+        if (!blobmsg_get_bool_or_default(fields[OP_SUCCESS], false))
+        {
+            report_failed_op(entry, blobmsg_get_string(fields[OP_ERROR]), cb, cb_context);
+        }
+        goto done;
+    }
+
+    struct blob_attr * cur;
+    int rem;
+
+    blobmsg_for_each_attr(cur, leds, rem)
+    {
+        struct led_get_set_result_st result;
+
+        populate_get_set_result(&result, cur);
+        cb(&result, cb_context);
+    }
+
+done:
+    return;
+}
+
+static void
+batch_response_handler(
+    struct ubus_request * const req, int const type, struct blob_attr * const response)
+{
+    UNUSED_ARG(type);
+
+    struct batch_response_ctx_st * const ctx = req->priv;
+    struct led_batch_st const * const batch = ctx->batch;
+    enum
+    {
+        BATCH_RESULTS,
+        BATCH_MAX__
+    };
+    struct blob_attr * fields[BATCH_MAX__];
+    struct blobmsg_policy const batch_reply_policy[] =
+    {
+        [BATCH_RESULTS] = { .name = _led_results, .type = BLOBMSG_TYPE_ARRAY }
+    };
+
+    blobmsg_parse(
+        batch_reply_policy, ARRAY_SIZE(fields), fields,
+        blobmsg_data(response), blobmsg_len(response));
+
+    if (!blobmsg_array_is_type(fields[BATCH_RESULTS], BLOBMSG_TYPE_TABLE))
+    {
+        goto done;
+    }
+
+    ctx->led_ctx.success = true;
+
+    /* The daemon reports one result per operation, in order. */
+    size_t index = 0;
+    struct blob_attr * cur;
+    int rem;
+
+    blobmsg_for_each_attr(cur, fields[BATCH_RESULTS], rem)
+    {
+        if (index >= batch->num_entries)
+        {
+            break;
+        }
+        process_op_result(&batch->entries[index], cur, &ctx->led_ctx);
+        index++;
+    }
+
+done:
+    return;
+}
+
+static void
+batch_response_ctx_init(
+    struct batch_response_ctx_st * const response_ctx,
+    struct led_batch_st const * const batch,
+    led_get_set_cb const cb,
+    void * const cb_context)
+{
+    response_ctx->led_ctx.ledcmd_ctx = batch->ledcmd_ctx;
+    response_ctx->led_ctx.success = false;
+    response_ctx->led_ctx.cb = cb;
+    response_ctx->led_ctx.cb_context = cb_context;
+    response_ctx->batch = batch;
+}
+
+static ubus_cb
+batch_response_cb(struct led_batch_st const * const batch)
+{
+    return batch->mixed ? batch_response_handler : led_response_handler;
+}
+
+bool
+led_batch_submit(
+    struct led_batch_st * const batch,
+    led_get_set_cb const cb,
+    void * const cb_context)
+{
+    bool success;
+
+    if (batch == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    struct batch_response_ctx_st ctx;
+
+    batch_response_ctx_init(&ctx, batch, cb, cb_context);
+    invoke_led_request(
+        batch->ledcmd_ctx, batch->cmd, build_batch_request, batch,
+        batch_response_cb(batch), &ctx);
+    success = ctx.led_ctx.success;
+
+done:
+    led_batch_free(batch);
+
+    return success;
+}
+
+static bool
+send_batch_async(struct led_batch_st * const batch);
+
+static void
+batch_async_finish(struct led_batch_st * const batch, bool const success)
+{
+    uloop_timeout_cancel(&batch->timeout);
+    if (batch->complete_cb != NULL)
+    {
+        batch->complete_cb(success, batch->response_ctx.led_ctx.cb_context);
+    }
+    led_batch_free(batch);
+}
+
+/* Resends the batch once the IDs have been resolved again, successfully or not. */
+static void
+batch_resolve_complete(struct ubus_request * const req, int const ret)
+{
+    UNUSED_ARG(ret);
+
+    struct led_batch_st * const batch = container_of(req, struct led_batch_st, req);
+
+    if (!send_batch_async(batch))
+    {
+        batch_async_finish(batch, false);
+    }
+}
+
+static void
+batch_async_complete(struct ubus_request * const req, int const ret)
+{
+    struct led_batch_st * const batch = container_of(req, struct led_batch_st, req);
+    struct ledcmd_ctx_st const * const ledcmd_ctx = batch->ledcmd_ctx;
+
+    if (ret == UBUS_STATUS_NOT_FOUND && led_ids_are_cached(ledcmd_ctx) && !batch->retried)
+    {
+        /*
+         * As for synchronous requests, resolve the changed IDs and retry, but
+         * without blocking the caller's event loop while they're resolved.
+         */
+        batch->retried = true;
+        if (led_resolve_ids_async(ledcmd_ctx, &batch->msg, &batch->req, batch_resolve_complete))
+        {
+            uloop_timeout_set(&batch->timeout, LEDCMD_UBUS_REQUEST_TIMEOUT_MS);
+            goto done;
+        }
+    }
+
+    batch_async_finish(
+        batch, ret == UBUS_STATUS_OK && batch->response_ctx.led_ctx.success);
+
+done:
+    return;
+}
+
+static void
+batch_async_timeout(struct uloop_timeout * const timeout)
+{
+    struct led_batch_st * const batch =
+        container_of(timeout, struct led_batch_st, timeout);
+
+    ubus_abort_request(batch->ledcmd_ctx->ubus_ctx, &batch->req);
+    batch_async_finish(batch, false);
+}
+
+static bool
+send_batch_async(struct led_batch_st * const batch)
+{
+    bool success;
+    struct ledcmd_ctx_st const * const ledcmd_ctx = batch->ledcmd_ctx;
+
+    blob_buf_init(&batch->msg, 0);
+    build_batch_request(ledcmd_ctx, batch, &batch->msg);
+
+    if (ubus_invoke_async(
+            ledcmd_ctx->ubus_ctx,
+            ledcmd_ctx->ledcmd_ubus_id,
+            batch->cmd,
+            batch->msg.head,
+            &batch->req) != UBUS_STATUS_OK)
+    {
+        success = false;
+        goto done;
+    }
+
+    batch->req.data_cb = batch_response_cb(batch);
+    batch->req.complete_cb = batch_async_complete;
+    batch->req.priv = &batch->response_ctx;
+    ubus_complete_request_async(ledcmd_ctx->ubus_ctx, &batch->req);
+    uloop_timeout_set(&batch->timeout, LEDCMD_UBUS_REQUEST_TIMEOUT_MS);
+
+    success = true;
+
+done:
+    return success;
+}
+
+bool
+led_batch_submit_async(
+    struct led_batch_st * const batch,
+    led_get_set_cb const cb,
+    led_async_complete_cb const complete_cb,
+    void * const cb_context)
+{
+    bool success;
+
+    if (batch == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    batch_response_ctx_init(&batch->response_ctx, batch, cb, cb_context);
+    batch->complete_cb = complete_cb;
+    batch->timeout.cb = batch_async_timeout;
+
+    success = send_batch_async(batch);
+    if (!success)
+    {
+        led_batch_free(batch);
+    }
+
+done:
+    return success;
+}
+
+bool
+led_get_set_request_async(
+    struct ledcmd_ctx_st const * const ledcmd_ctx,
+    char const * const cmd,
+    char const * const state,
+    char const * const led_name,
+    char const * const lock_id,
+    char const * const led_priority,
+    char const * const flash_type,
+    uint32_t const flash_time_ms,
+    led_get_set_cb const cb,
+    led_async_complete_cb const complete_cb,
+    void * const cb_context)
+{
+    bool success;
+    struct led_batch_st * const batch = led_batch_begin(ledcmd_ctx, cmd);
+
+    if (!led_batch_add(
+            batch, led_name, state, lock_id, led_priority, flash_type, flash_time_ms))
+    {
+        led_batch_free(batch);
+        success = false;
+        goto done;
+    }
+
+    success = led_batch_submit_async(batch, cb, complete_cb, cb_context);
+
+done:
+    return success;
+}
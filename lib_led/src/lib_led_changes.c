@@ -0,0 +1,272 @@
+#include "lib_led_changes.h"
+#include "lib_led_private.h"
+#include "string_constants.h"
+
+#include <ubus_utils/ubus_utils.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+struct sync_ctx_st
+{
+    struct led_sync_state_st * sync_state;
+    led_sync_cb cb;
+    void * cb_context;
+    bool success;
+};
+
+struct led_subscription_st
+{
+    struct ubus_subscriber subscriber;
+    struct ledcmd_ctx_st const * ledcmd_ctx;
+    led_change_cb cb;
+    void * cb_context;
+};
+
+static void
+populate_led_change(
+    struct led_change_st * const change, struct blob_attr * const attr)
+{
+    enum
+    {
+        LED_NAME,
+        LED_STATE,
+        LED_PRIORITY,
+        LED_LOCKED,
+        LED_MAX__
+    };
+    struct blob_attr * fields[LED_MAX__];
+    struct blobmsg_policy const led_change_policy[] =
+    {
+        [LED_NAME] = { .name = _led_name, .type = BLOBMSG_TYPE_STRING },
+        [LED_STATE] = { .name = _led_state, .type = BLOBMSG_TYPE_STRING },
+        [LED_PRIORITY] = { .name = _led_priority, .type = BLOBMSG_TYPE_STRING },
+        [LED_LOCKED] = { .name = _led_locked, .type = BLOBMSG_TYPE_BOOL }
+    };
+
+    blobmsg_parse(
+        led_change_policy, ARRAY_SIZE(fields), fields,
+        blobmsg_data(attr), blobmsg_len(attr));
+
+    change->led_name = blobmsg_get_string(fields[LED_NAME]);
+    change->led_state = blobmsg_get_string(fields[LED_STATE]);
+    change->led_priority = blobmsg_get_string(fields[LED_PRIORITY]);
+    change->locked = blobmsg_get_bool_or_default(fields[LED_LOCKED], false);
+}
+
+static int
+led_changes_notify_handler(
+    struct ubus_context * const ctx,
+    struct ubus_object * const obj,
+    struct ubus_request_data * const req,
+    char const * const method,
+    struct blob_attr * const msg)
+{
+    UNUSED_ARG(ctx);
+    UNUSED_ARG(req);
+
+    struct ubus_subscriber * const subscriber =
+        container_of(obj, struct ubus_subscriber, obj);
+    struct led_subscription_st * const subscription =
+        container_of(subscriber, struct led_subscription_st, subscriber);
+    enum
+    {
+        CHANGES_SEQ,
+        CHANGES_LEDS,
+        CHANGES_MAX__
+    };
+    struct blob_attr * fields[CHANGES_MAX__];
+    struct blobmsg_policy const changes_policy[] =
+    {
+        [CHANGES_SEQ] = { .name = _led_seq, .type = BLOBMSG_TYPE_INT32 },
+        [CHANGES_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY }
+    };
+
+    if (strcmp(method, _led_leds_changed) != 0)
+    {
+        goto done;
+    }
+
+    blobmsg_parse(
+        changes_policy, ARRAY_SIZE(fields), fields,
+        blobmsg_data(msg), blobmsg_len(msg));
+
+    if (!blobmsg_array_is_type(fields[CHANGES_LEDS], BLOBMSG_TYPE_TABLE))
+    {
+        goto done;
+    }
+
+    uint32_t const seq = blobmsg_get_u32_or_default(fields[CHANGES_SEQ], 0);
+    struct blob_attr * cur;
+    int rem;
+
+    blobmsg_for_each_attr(cur, fields[CHANGES_LEDS], rem)
+    {
+        struct led_change_st change;
+
+        populate_led_change(&change, cur);
+        subscription->cb(seq, &change, subscription->cb_context);
+    }
+
+done:
+    return UBUS_STATUS_OK;
+}
+
+void
+led_unsubscribe_changes(struct led_subscription_st * const subscription)
+{
+    if (subscription == NULL)
+    {
+        goto done;
+    }
+
+    struct ledcmd_ctx_st const * const ledcmd_ctx = subscription->ledcmd_ctx;
+
+    ubus_unsubscribe(
+        ledcmd_ctx->ubus_ctx, &subscription->subscriber, ledcmd_ctx->ledcmd_ubus_id);
+    ubus_unregister_subscriber(ledcmd_ctx->ubus_ctx, &subscription->subscriber);
+    free(subscription);
+
+done:
+    return;
+}
+
+struct led_subscription_st *
+led_subscribe_changes(
+    struct ledcmd_ctx_st const * const ledcmd_ctx,
+    led_change_cb const cb,
+    void * const cb_context)
+{
+    bool success;
+    struct led_subscription_st * subscription = NULL;
+
+    if (cb == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    subscription = calloc(1, sizeof *subscription);
+    if (subscription == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    subscription->ledcmd_ctx = ledcmd_ctx;
+    subscription->cb = cb;
+    subscription->cb_context = cb_context;
+    subscription->subscriber.cb = led_changes_notify_handler;
+
+    if (ubus_register_subscriber(ledcmd_ctx->ubus_ctx, &subscription->subscriber)
+        != UBUS_STATUS_OK)
+    {
+        free(subscription);
+        subscription = NULL;
+        success = false;
+        goto done;
+    }
+
+    success =
+        ubus_subscribe(
+            ledcmd_ctx->ubus_ctx, &subscription->subscriber, ledcmd_ctx->ledcmd_ubus_id)
+        == UBUS_STATUS_OK;
+
+done:
+    if (!success)
+    {
+        led_unsubscribe_changes(subscription);
+        subscription = NULL;
+    }
+
+    return subscription;
+}
+
+static void
+get_changes_response_handler(
+    struct ubus_request * const req, int const type, struct blob_attr * const response)
+{
+    UNUSED_ARG(type);
+
+    struct sync_ctx_st * const ctx = req->priv;
+    enum
+    {
+        CHANGES_LEDS,
+        CHANGES_EPOCH,
+        CHANGES_SEQ,
+        CHANGES_RESYNC,
+        CHANGES_MAX__
+    };
+    struct blob_attr * fields[CHANGES_MAX__];
+    struct blobmsg_policy const get_changes_policy[] =
+    {
+        [CHANGES_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY },
+        [CHANGES_EPOCH] = { .name = _led_epoch, .type = BLOBMSG_TYPE_INT32 },
+        [CHANGES_SEQ] = { .name = _led_seq, .type = BLOBMSG_TYPE_INT32 },
+        [CHANGES_RESYNC] = { .name = _led_resync, .type = BLOBMSG_TYPE_BOOL }
+    };
+
+    blobmsg_parse(
+        get_changes_policy, ARRAY_SIZE(fields), fields,
+        blobmsg_data(response), blobmsg_len(response));
+
+    if (!blobmsg_array_is_type(fields[CHANGES_LEDS], BLOBMSG_TYPE_TABLE)
+        || fields[CHANGES_EPOCH] == NULL
+        || fields[CHANGES_SEQ] == NULL)
+    {
+        goto done;
+    }
+
+    bool const full_resync =
+        blobmsg_get_bool_or_default(fields[CHANGES_RESYNC], false);
+    struct blob_attr * cur;
+    int rem;
+
+    blobmsg_for_each_attr(cur, fields[CHANGES_LEDS], rem)
+    {
+        struct led_change_st change;
+
+        populate_led_change(&change, cur);
+        ctx->cb(&change, full_resync, ctx->cb_context);
+    }
+
+    ctx->sync_state->epoch = blobmsg_get_u32(fields[CHANGES_EPOCH]);
+    ctx->sync_state->seq = blobmsg_get_u32(fields[CHANGES_SEQ]);
+    ctx->success = true;
+
+done:
+    return;
+}
+
+bool
+led_sync_changes(
+    struct ledcmd_ctx_st const * const ledcmd_ctx,
+    struct led_sync_state_st * const sync_state,
+    led_sync_cb const cb,
+    void * const cb_context)
+{
+    struct sync_ctx_st ctx =
+    {
+        .sync_state = sync_state,
+        .cb = cb,
+        .cb_context = cb_context,
+        .success = false
+    };
+
+    if (cb == NULL)
+    {
+        goto done;
+    }
+
+    struct blob_buf msg;
+
+    blob_buf_full_init(&msg, 0);
+    blobmsg_add_u32(&msg, _led_epoch, sync_state->epoch);
+    blobmsg_add_u32(&msg, _led_since, sync_state->seq);
+
+    ledcmd_ubus_invoke(_led_get_changes, &msg, get_changes_response_handler, &ctx, ledcmd_ctx);
+    blob_buf_free(&msg);
+
+done:
+    return ctx.success;
+}
@@ -0,0 +1,382 @@
+#include "lib_led_command_ring.h"
+#include "lib_led_private.h"
+
+#include <ubus_utils/ubus_utils.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+struct led_command_ring_client_st
+{
+    struct ledcmd_ctx_st * ledcmd_ctx;
+    int memfd;
+    int eventfd;
+    struct led_command_ring_header_st * header;
+    size_t size;
+    uint32_t mask;
+    /* Records are queued here and published by led_command_ring_commit(). */
+    uint32_t head;
+};
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static bool
+copy_request_string(char * const field, size_t const field_size, char const * const value)
+{
+    bool success;
+
+    if (value == NULL)
+    {
+        success = true;
+        goto done;
+    }
+
+    size_t const len = strlen(value);
+
+    if (len >= field_size)
+    {
+        success = false;
+        goto done;
+    }
+
+    memcpy(field, value, len + 1);
+    success = true;
+
+done:
+    return success;
+}
+
+static bool
+send_request(
+    int const fd,
+    uint32_t const num_records,
+    char const * const led_priority,
+    char const * const lock_id)
+{
+    bool success;
+    struct led_command_ring_request_st request =
+    {
+        .magic = LED_COMMAND_RING_MAGIC,
+        .version = LED_COMMAND_RING_VERSION,
+        .num_records = num_records
+    };
+
+    if (!copy_request_string(request.priority, sizeof request.priority, led_priority)
+        || !copy_request_string(request.lock_id, sizeof request.lock_id, lock_id))
+    {
+        success = false;
+        goto done;
+    }
+
+    success = send(fd, &request, sizeof request, MSG_NOSIGNAL) == (ssize_t)sizeof request;
+
+done:
+    return success;
+}
+
+/*
+ * Wait for the reply to the registration, skipping the replies to any
+ * earlier fast path frames. Returns true if the ring's descriptors were
+ * received.
+ */
+static bool
+receive_descriptors(int const fd, int * const memfd, int * const eventfd)
+{
+    bool received = false;
+    struct pollfd pfd =
+    {
+        .fd = fd,
+        .events = POLLIN
+    };
+
+    while (!received && poll(&pfd, 1, LEDCMD_UBUS_REQUEST_TIMEOUT_MS) > 0)
+    {
+        struct led_fast_path_ack_st ack;
+        int fds[2];
+        union
+        {
+            struct cmsghdr header;
+            char buf[CMSG_SPACE(sizeof fds)];
+        } control;
+        struct iovec iov =
+        {
+            .iov_base = &ack,
+            .iov_len = sizeof ack
+        };
+        struct msghdr msg =
+        {
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = control.buf,
+            .msg_controllen = sizeof control.buf
+        };
+        ssize_t const len = recvmsg(fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+
+        if (len < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            continue;
+        }
+        if (len != sizeof ack)
+        {
+            break;
+        }
+        if (ack.magic != LED_COMMAND_RING_MAGIC)
+        {
+            continue;
+        }
+
+        struct cmsghdr const * const cmsg = CMSG_FIRSTHDR(&msg);
+
+        if (ack.status != LED_FAST_PATH_STATUS_OK
+            || cmsg == NULL
+            || cmsg->cmsg_level != SOL_SOCKET
+            || cmsg->cmsg_type != SCM_RIGHTS
+            || cmsg->cmsg_len != CMSG_LEN(sizeof fds))
+        {
+            break;
+        }
+
+        memcpy(fds, CMSG_DATA(cmsg), sizeof fds);
+        *memfd = fds[0];
+        *eventfd = fds[1];
+        received = true;
+    }
+
+    return received;
+}
+
+static bool
+map_ring(struct led_command_ring_client_st * const ring)
+{
+    bool success;
+    struct stat st;
+
+    if (fstat(ring->memfd, &st) < 0 || (size_t)st.st_size < sizeof *ring->header)
+    {
+        success = false;
+        goto done;
+    }
+
+    void * const base =
+        mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->memfd, 0);
+
+    if (base == MAP_FAILED)
+    {
+        success = false;
+        goto done;
+    }
+
+    ring->header = base;
+    ring->size = st.st_size;
+
+    uint32_t const num_records = ring->header->num_records;
+
+    success =
+        ring->header->magic == LED_COMMAND_RING_MAGIC
+        && ring->header->version == LED_COMMAND_RING_VERSION
+        && num_records != 0
+        && (num_records & (num_records - 1)) == 0
+        && ring->size >= sizeof *ring->header + num_records * sizeof ring->header->records[0];
+    ring->mask = num_records - 1;
+    ring->head = ring->header->producer.head;
+
+done:
+    return success;
+}
+
+void
+led_command_ring_close(struct led_command_ring_client_st * const ring)
+{
+    if (ring == NULL)
+    {
+        goto done;
+    }
+
+    if (ring->header != NULL)
+    {
+        munmap(ring->header, ring->size);
+    }
+    if (ring->memfd >= 0)
+    {
+        close(ring->memfd);
+    }
+    if (ring->eventfd >= 0)
+    {
+        close(ring->eventfd);
+    }
+    free(ring);
+
+done:
+    return;
+}
+
+struct led_command_ring_client_st *
+led_command_ring_open(
+    struct led_fast_path_st * const fast_path,
+    uint32_t const num_records,
+    char const * const led_priority,
+    char const * const lock_id)
+{
+    struct led_command_ring_client_st * ring = NULL;
+
+    if (fast_path == NULL)
+    {
+        goto done;
+    }
+
+    ring = calloc(1, sizeof *ring);
+    if (ring == NULL)
+    {
+        goto done;
+    }
+
+    ring->ledcmd_ctx = led_fast_path_ledcmd_ctx(fast_path);
+    ring->memfd = -1;
+    ring->eventfd = -1;
+
+    int const fd = led_fast_path_fd(fast_path);
+
+    if (!send_request(fd, num_records, led_priority, lock_id)
+        || !receive_descriptors(fd, &ring->memfd, &ring->eventfd)
+        || !map_ring(ring))
+    {
+        led_command_ring_close(ring);
+        ring = NULL;
+        goto done;
+    }
+
+done:
+    return ring;
+}
+
+uint32_t
+led_command_ring_led_id(
+    struct led_command_ring_client_st const * const ring, char const * const led_name)
+{
+    return led_id_lookup(ring->ledcmd_ctx, led_name);
+}
+
+bool
+led_command_ring_push_id(
+    struct led_command_ring_client_st * const ring, uint32_t const led_id, uint32_t const state)
+{
+    bool success;
+    struct led_command_ring_header_st * const header = ring->header;
+
+    if (__atomic_load_n(&header->consumer.ids_stale, __ATOMIC_RELAXED) != 0)
+    {
+        success = false;
+        goto done;
+    }
+
+    uint32_t const tail = __atomic_load_n(&header->consumer.tail, __ATOMIC_ACQUIRE);
+
+    if (ring->head - tail >= header->num_records)
+    {
+        __atomic_store_n(
+            &header->producer.backpressure_count,
+            header->producer.backpressure_count + 1,
+            __ATOMIC_RELAXED);
+        success = false;
+        goto done;
+    }
+
+    struct led_command_record_st * const record = &header->records[ring->head & ring->mask];
+
+    record->led_id = led_id;
+    record->state = state;
+    record->timestamp_ns = monotonic_ns();
+    ring->head++;
+    success = true;
+
+done:
+    return success;
+}
+
+bool
+led_command_ring_push(
+    struct led_command_ring_client_st * const ring,
+    char const * const led_name,
+    char const * const state)
+{
+    bool success;
+    uint32_t const led_id = led_id_lookup(ring->ledcmd_ctx, led_name);
+    uint32_t state_value;
+
+    if (led_id == LED_ID_NONE || !led_fast_path_state_value(state, &state_value))
+    {
+        success = false;
+        goto done;
+    }
+
+    success = led_command_ring_push_id(ring, led_id, state_value);
+
+done:
+    return success;
+}
+
+bool
+led_command_ring_commit(struct led_command_ring_client_st * const ring)
+{
+    bool success = true;
+    struct led_command_ring_header_st * const header = ring->header;
+
+    /*
+     * Sequentially consistent, so that either the daemon sees the new head
+     * after asking for a wakeup, or the wakeup request is seen here.
+     */
+    __atomic_store_n(&header->producer.head, ring->head, __ATOMIC_SEQ_CST);
+
+    if (__atomic_exchange_n(&header->wakeup_needed, 0, __ATOMIC_SEQ_CST) != 0)
+    {
+        uint64_t const one = 1;
+
+        success = write(ring->eventfd, &one, sizeof one) == (ssize_t)sizeof one;
+    }
+
+    return success;
+}
+
+void
+led_command_ring_get_stats(
+    struct led_command_ring_client_st const * const ring,
+    struct led_command_ring_stats_st * const stats)
+{
+    struct led_command_ring_header_st const * const header = ring->header;
+    struct led_command_ring_consumer_st const * const consumer = &header->consumer;
+
+    stats->num_records = header->num_records;
+    stats->pending =
+        __atomic_load_n(&header->producer.head, __ATOMIC_RELAXED)
+        - __atomic_load_n(&consumer->tail, __ATOMIC_ACQUIRE);
+    stats->ids_stale = __atomic_load_n(&consumer->ids_stale, __ATOMIC_RELAXED) != 0;
+    stats->backpressure_count = header->producer.backpressure_count;
+    stats->wakeups = __atomic_load_n(&consumer->wakeups, __ATOMIC_RELAXED);
+    stats->records_applied = __atomic_load_n(&consumer->records_applied, __ATOMIC_RELAXED);
+    stats->records_coalesced = __atomic_load_n(&consumer->records_coalesced, __ATOMIC_RELAXED);
+    stats->records_invalid = __atomic_load_n(&consumer->records_invalid, __ATOMIC_RELAXED);
+    stats->overruns = __atomic_load_n(&consumer->overruns, __ATOMIC_RELAXED);
+    stats->latency_count = __atomic_load_n(&consumer->latency_count, __ATOMIC_RELAXED);
+    stats->latency_total_ns = __atomic_load_n(&consumer->latency_total_ns, __ATOMIC_RELAXED);
+    stats->latency_max_ns = __atomic_load_n(&consumer->latency_max_ns, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < ARRAY_SIZE(stats->latency_buckets); i++)
+    {
+        stats->latency_buckets[i] =
+            __atomic_load_n(&consumer->latency_buckets[i], __ATOMIC_RELAXED);
+    }
+}
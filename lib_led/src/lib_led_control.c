@@ -4,8 +4,9 @@
 
 #include <ubus_utils/ubus_utils.h>
 
-static void
-append_led_request_data(
+bool
+append_led_request_fields(
+    struct ledcmd_ctx_st const * const ctx,
     char const * const led_name,
     char const * const state,
     char const * const lock_id,
@@ -14,9 +15,16 @@ append_led_request_data(
     uint32_t const flash_time_ms,
     struct blob_buf * const msg)
 {
-    void * const cookie = blobmsg_open_table(msg, NULL);
+    uint32_t const led_id = led_id_lookup(ctx, led_name);
 
-    blobmsg_add_string(msg, _led_name, led_name);
+    if (led_id != LED_ID_NONE)
+    {
+        blobmsg_add_u32(msg, _led_id, led_id);
+    }
+    else
+    {
+        blobmsg_add_string(msg, _led_name, led_name);
+    }
     if (flash_type != NULL)
     {
         blobmsg_add_string(msg, _led_flash_type, flash_type);
@@ -38,41 +46,176 @@ append_led_request_data(
         blobmsg_add_string(msg, _led_priority, led_priority);
     }
 
-    blobmsg_close_table(msg, cookie);
+    return led_id != LED_ID_NONE;
 }
 
 static bool
-send_ubus_led_request(
+append_led_request_data(
     struct ledcmd_ctx_st const * const ctx,
-    char const * const cmd,
-    char const * const state,
     char const * const led_name,
+    char const * const state,
     char const * const lock_id,
     char const * const led_priority,
     char const * const flash_type,
     uint32_t const flash_time_ms,
+    struct blob_buf * const msg)
+{
+    void * const cookie = blobmsg_open_table(msg, NULL);
+    bool const used_id = append_led_request_fields(
+        ctx, led_name, state, lock_id, led_priority, flash_type, flash_time_ms, msg);
+
+    blobmsg_close_table(msg, cookie);
+
+    return used_id;
+}
+
+static char const *
+response_verbosity_name(enum led_response_verbosity_t const verbosity)
+{
+    char const * name;
+
+    switch (verbosity)
+    {
+    case LED_RESPONSE_VERBOSITY_ERRORS_ONLY:
+        name = _led_verbosity_errors;
+        break;
+
+    case LED_RESPONSE_VERBOSITY_SUMMARY:
+        name = _led_verbosity_summary;
+        break;
+
+    case LED_RESPONSE_VERBOSITY_FULL:
+    default:
+        name = _led_verbosity_full;
+        break;
+    }
+
+    return name;
+}
+
+void
+append_response_verbosity(
+    struct ledcmd_ctx_st const * const ctx, struct blob_buf * const msg)
+{
+    /* Full responses are the default, so there's no need to ask for them. */
+    if (ctx->verbosity != LED_RESPONSE_VERBOSITY_FULL)
+    {
+        blobmsg_add_string(msg, _led_verbosity, response_verbosity_name(ctx->verbosity));
+    }
+}
+
+static void
+process_response_summary(
+    struct ledcmd_ctx_st const * const ctx,
+    struct blob_attr * const succeeded,
+    struct blob_attr * const failed)
+{
+    if (ctx->summary_cb == NULL || (succeeded == NULL && failed == NULL))
+    {
+        goto done;
+    }
+
+    struct led_response_summary_st const summary =
+    {
+        .succeeded = blobmsg_get_u32_or_default(succeeded, 0),
+        .failed = blobmsg_get_u32_or_default(failed, 0)
+    };
+
+    ctx->summary_cb(&summary, ctx->summary_cb_context);
+
+done:
+    return;
+}
+
+bool
+invoke_led_request(
+    struct ledcmd_ctx_st const * const ctx,
+    char const * const cmd,
+    build_request_fn const build_request,
+    void const * const request,
     ubus_cb const cb,
     void * const cb_context)
 {
     struct blob_buf msg;
 
     blob_buf_full_init(&msg, 0);
+    build_request(ctx, request, &msg);
 
-    void * const cookie = blobmsg_open_array(&msg, _led_leds);
-
-    append_led_request_data(
-        led_name, state, lock_id, led_priority, flash_type, flash_time_ms, &msg);
-    blobmsg_close_array(&msg, cookie);
+    int status = ledcmd_ubus_invoke_status(cmd, &msg, cb, cb_context, ctx);
 
-    bool const success = ledcmd_ubus_invoke(cmd, &msg, cb, cb_context, ctx);
+    if (status == UBUS_STATUS_NOT_FOUND && led_ids_are_cached(ctx))
+    {
+        /*
+         * The daemon's LED IDs have changed since they were resolved. Resolve
+         * them again and retry. If they can't be resolved the cache is left
+         * empty and the request is sent using LED names.
+         */
+        led_resolve_ids(ctx);
+        blob_buf_init(&msg, 0);
+        build_request(ctx, request, &msg);
+        status = ledcmd_ubus_invoke_status(cmd, &msg, cb, cb_context, ctx);
+    }
 
     blob_buf_free(&msg);
 
-    return success;
+    return status == UBUS_STATUS_OK;
+}
+
+static void
+build_led_request(
+    struct ledcmd_ctx_st const * const ctx,
+    void const * const request_in,
+    struct blob_buf * const msg)
+{
+    struct led_request_st const * const request = request_in;
+    void * const cookie = blobmsg_open_array(msg, _led_leds);
+    bool const used_id = append_led_request_data(
+        ctx,
+        request->led_name,
+        request->state,
+        request->lock_id,
+        request->led_priority,
+        request->flash_type,
+        request->flash_time_ms,
+        msg);
+
+    blobmsg_close_array(msg, cookie);
+    if (used_id)
+    {
+        blobmsg_add_u32(msg, _led_generation, ctx->led_id_cache->generation);
+    }
+    append_response_verbosity(ctx, msg);
+}
+
+static bool
+send_ubus_led_request(
+    struct ledcmd_ctx_st const * const ctx,
+    char const * const cmd,
+    char const * const state,
+    char const * const led_name,
+    char const * const lock_id,
+    char const * const led_priority,
+    char const * const flash_type,
+    uint32_t const flash_time_ms,
+    ubus_cb const cb,
+    void * const cb_context)
+{
+    struct led_request_st const request =
+    {
+        .led_name = led_name,
+        .state = state,
+        .lock_id = lock_id,
+        .led_priority = led_priority,
+        .flash_type = flash_type,
+        .flash_time_ms = flash_time_ms
+    };
+
+    return invoke_led_request(ctx, cmd, build_led_request, &request, cb, cb_context);
 }
 
 struct ledcmd_lock_ctx_st
 {
+    struct ledcmd_ctx_st const * ledcmd_ctx;
     bool success;
     led_lock_result_cb const cb;
     void * const cb_context;
@@ -152,12 +295,16 @@ lock_led_response_handler(
     enum
     {
         LOCK_RESPONSE,
+        LOCK_SUCCEEDED,
+        LOCK_FAILED,
         LOCK_MAX__
     };
     struct blob_attr * fields[LOCK_MAX__];
     struct blobmsg_policy const lock_policy[] =
     {
-        [LOCK_RESPONSE] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY }
+        [LOCK_RESPONSE] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY },
+        [LOCK_SUCCEEDED] = { .name = _led_succeeded, .type = BLOBMSG_TYPE_INT32 },
+        [LOCK_FAILED] = { .name = _led_failed, .type = BLOBMSG_TYPE_INT32 }
     };
 
     blobmsg_parse(
@@ -165,6 +312,8 @@ lock_led_response_handler(
         blobmsg_data(response), blobmsg_len(response));
 
     process_lock_led_response(fields[LOCK_RESPONSE], ctx);
+    process_response_summary(
+        ctx->ledcmd_ctx, fields[LOCK_SUCCEEDED], fields[LOCK_FAILED]);
 }
 
 bool
@@ -180,6 +329,7 @@ led_activate_or_deactivate(
     char const * const ubus_cmd = activate_it ? _led_activate : _led_deactivate;
     struct ledcmd_lock_ctx_st ctx =
     {
+        .ledcmd_ctx = ledcmd_ctx,
         /* Assume failure unless the message gets a response.*/
         .success = false,
         .cb = cb,
@@ -382,14 +532,7 @@ led_get_states(
     return ctx.success;
 }
 
-struct ledcmd_led_ctx_st
-{
-    bool success;
-    led_get_set_cb const cb;
-    void * const cb_context;
-};
-
-static void
+void
 populate_get_set_result(
     struct led_get_set_result_st * const result,
     struct blob_attr * const response)
@@ -466,7 +609,7 @@ done:
     return;
 }
 
-static void
+void
 led_response_handler(
     struct ubus_request * req, int type, struct blob_attr * response)
 {
@@ -476,12 +619,16 @@ led_response_handler(
     enum
     {
         SET_RESPONSE,
+        SET_SUCCEEDED,
+        SET_FAILED,
         SET_MAX__
     };
     struct blob_attr * fields[SET_MAX__];
     struct blobmsg_policy const set_reply_policy[] =
     {
-        [SET_RESPONSE] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY }
+        [SET_RESPONSE] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY },
+        [SET_SUCCEEDED] = { .name = _led_succeeded, .type = BLOBMSG_TYPE_INT32 },
+        [SET_FAILED] = { .name = _led_failed, .type = BLOBMSG_TYPE_INT32 }
     };
 
     blobmsg_parse(
@@ -489,6 +636,8 @@ led_response_handler(
         blobmsg_data(response), blobmsg_len(response));
 
     process_led_response(fields[SET_RESPONSE], ctx);
+    process_response_summary(
+        ctx->ledcmd_ctx, fields[SET_SUCCEEDED], fields[SET_FAILED]);
 }
 
 bool
@@ -506,6 +655,7 @@ led_get_set_request(
 {
     struct ledcmd_led_ctx_st ctx =
     {
+        .ledcmd_ctx = ledcmd_ctx,
         .success = false,
         .cb = cb,
         .cb_context = cb_context
@@ -526,3 +676,227 @@ led_get_set_request(
     return ctx.success;
 }
 
+struct set_many_request_st
+{
+    char const * const * led_names;
+    size_t num_leds;
+    /* Either the names of the states or their values. */
+    char const * const * states;
+    uint32_t const * state_values;
+    size_t num_states;
+    char const * lock_id;
+    char const * led_priority;
+    char const * flash_type;
+    uint32_t flash_time_ms;
+};
+
+static bool
+all_led_ids_resolved(
+    struct ledcmd_ctx_st const * const ctx,
+    char const * const * const led_names,
+    size_t const num_leds)
+{
+    bool all_resolved;
+
+    for (size_t i = 0; i < num_leds; i++)
+    {
+        if (led_id_lookup(ctx, led_names[i]) == LED_ID_NONE)
+        {
+            all_resolved = false;
+            goto done;
+        }
+    }
+
+    all_resolved = num_leds > 0;
+
+done:
+    return all_resolved;
+}
+
+static void
+append_led_ids(
+    struct ledcmd_ctx_st const * const ctx,
+    struct blob_buf * const msg,
+    char const * const * const led_names,
+    size_t const num_leds)
+{
+    void * const cookie = blobmsg_open_array(msg, _led_ids);
+
+    for (size_t i = 0; i < num_leds; i++)
+    {
+        blobmsg_add_u32(msg, NULL, led_id_lookup(ctx, led_names[i]));
+    }
+
+    blobmsg_close_array(msg, cookie);
+    blobmsg_add_u32(msg, _led_generation, ctx->led_id_cache->generation);
+}
+
+static void
+append_string_array(
+    struct blob_buf * const msg,
+    char const * const name,
+    char const * const * const strings,
+    size_t const num_strings)
+{
+    void * const cookie = blobmsg_open_array(msg, name);
+
+    for (size_t i = 0; i < num_strings; i++)
+    {
+        blobmsg_add_string(msg, NULL, strings[i]);
+    }
+
+    blobmsg_close_array(msg, cookie);
+}
+
+static void
+append_u32_array(
+    struct blob_buf * const msg,
+    char const * const name,
+    uint32_t const * const values,
+    size_t const num_values)
+{
+    void * const cookie = blobmsg_open_array(msg, name);
+
+    for (size_t i = 0; i < num_values; i++)
+    {
+        blobmsg_add_u32(msg, NULL, values[i]);
+    }
+
+    blobmsg_close_array(msg, cookie);
+}
+
+static void
+build_set_many_request(
+    struct ledcmd_ctx_st const * const ctx,
+    void const * const request_in,
+    struct blob_buf * const msg)
+{
+    struct set_many_request_st const * const request = request_in;
+
+    /* IDs are only used if every LED in the request has been resolved. */
+    if (all_led_ids_resolved(ctx, request->led_names, request->num_leds))
+    {
+        append_led_ids(ctx, msg, request->led_names, request->num_leds);
+    }
+    else
+    {
+        append_string_array(msg, _led_names, request->led_names, request->num_leds);
+    }
+    if (request->state_values != NULL)
+    {
+        append_u32_array(msg, _led_states, request->state_values, request->num_states);
+    }
+    else
+    {
+        append_string_array(msg, _led_states, request->states, request->num_states);
+    }
+    if (request->lock_id != NULL)
+    {
+        blobmsg_add_string(msg, _led_lock_id, request->lock_id);
+    }
+    if (request->led_priority != NULL)
+    {
+        blobmsg_add_string(msg, _led_priority, request->led_priority);
+    }
+    if (request->flash_type != NULL)
+    {
+        blobmsg_add_string(msg, _led_flash_type, request->flash_type);
+    }
+    if (request->flash_time_ms)
+    {
+        blobmsg_add_u32(msg, _led_flash_time_ms, request->flash_time_ms);
+    }
+    append_response_verbosity(ctx, msg);
+}
+
+static bool
+set_many_request(
+    struct ledcmd_ctx_st const * const ledcmd_ctx,
+    struct set_many_request_st const * const request,
+    led_get_set_cb const cb,
+    void * const cb_context)
+{
+    struct ledcmd_led_ctx_st ctx =
+    {
+        .ledcmd_ctx = ledcmd_ctx,
+        .success = false,
+        .cb = cb,
+        .cb_context = cb_context
+    };
+
+    invoke_led_request(
+        ledcmd_ctx, _led_set_many, build_set_many_request, request,
+        led_response_handler, &ctx);
+
+    return ctx.success;
+}
+
+bool
+led_set_many_request(
+    struct ledcmd_ctx_st const * const ledcmd_ctx,
+    char const * const * const led_names,
+    size_t const num_leds,
+    char const * const * const states,
+    size_t const num_states,
+    char const * const lock_id,
+    char const * const led_priority,
+    char const * const flash_type,
+    uint32_t const flash_time_ms,
+    led_get_set_cb const cb,
+    void * const cb_context)
+{
+    struct set_many_request_st const request =
+    {
+        .led_names = led_names,
+        .num_leds = num_leds,
+        .states = states,
+        .num_states = num_states,
+        .lock_id = lock_id,
+        .led_priority = led_priority,
+        .flash_type = flash_type,
+        .flash_time_ms = flash_time_ms
+    };
+
+    return set_many_request(ledcmd_ctx, &request, cb, cb_context);
+}
+
+bool
+led_set_many_values_request(
+    struct ledcmd_ctx_st const * const ledcmd_ctx,
+    char const * const * const led_names,
+    size_t const num_leds,
+    uint32_t const * const states,
+    size_t const num_states,
+    char const * const lock_id,
+    char const * const led_priority,
+    char const * const flash_type,
+    uint32_t const flash_time_ms,
+    led_get_set_cb const cb,
+    void * const cb_context)
+{
+    struct set_many_request_st const request =
+    {
+        .led_names = led_names,
+        .num_leds = num_leds,
+        .state_values = states,
+        .num_states = num_states,
+        .lock_id = lock_id,
+        .led_priority = led_priority,
+        .flash_type = flash_type,
+        .flash_time_ms = flash_time_ms
+    };
+
+    return set_many_request(ledcmd_ctx, &request, cb, cb_context);
+}
+
+void
+led_set_response_verbosity(
+    struct ledcmd_ctx_st * const ledcmd_ctx,
+    enum led_response_verbosity_t const verbosity,
+    led_response_summary_cb const summary_cb,
+    void * const summary_cb_context)
+{
+    ledcmd_ctx->verbosity = verbosity;
+    ledcmd_ctx->summary_cb = summary_cb;
+    ledcmd_ctx->summary_cb_context = summary_cb_context;
+}
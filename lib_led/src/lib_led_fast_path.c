@@ -0,0 +1,412 @@
+#include "lib_led_fast_path.h"
+#include "led_fast_path_layout.h"
+#include "lib_led_private.h"
+#include "string_constants.h"
+
+#include <ubus_utils/ubus_utils.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct led_fast_path_st
+{
+    struct ledcmd_ctx_st * ledcmd_ctx;
+    int fd;
+    uint32_t seq;
+    /* Set when the daemon rejects a frame because the LED IDs have changed. */
+    bool ids_are_stale;
+    /*
+     * Set when a frame sent without waiting for an acknowledgement was
+     * rejected for stale IDs, until led_fast_path_set() reports it.
+     */
+    bool updates_lost;
+    union
+    {
+        struct led_fast_path_header_st header;
+        uint8_t bytes[LED_FAST_PATH_MAX_FRAME_SIZE];
+    } frame;
+};
+
+bool
+led_fast_path_state_value(char const * const state, uint32_t * const value)
+{
+    static struct
+    {
+        char const * name;
+        enum led_fast_path_state_t value;
+    } const states[] =
+    {
+        { .name = _led_off, .value = LED_FAST_PATH_STATE_OFF },
+        { .name = _led_on, .value = LED_FAST_PATH_STATE_ON },
+        { .name = _led_flash, .value = LED_FAST_PATH_STATE_FLASH },
+        { .name = _led_fast_flash, .value = LED_FAST_PATH_STATE_FAST_FLASH }
+    };
+    bool found = false;
+
+    if (state == NULL)
+    {
+        goto done;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(states); i++)
+    {
+        if (strcasecmp(state, states[i].name) == 0)
+        {
+            *value = states[i].value;
+            found = true;
+            break;
+        }
+    }
+
+done:
+    return found;
+}
+
+static bool
+copy_string_field(char * const field, size_t const field_size, char const * const value)
+{
+    bool success;
+
+    if (value == NULL)
+    {
+        field[0] = '\0';
+        success = true;
+        goto done;
+    }
+
+    size_t const len = strlen(value);
+
+    if (len >= field_size)
+    {
+        success = false;
+        goto done;
+    }
+
+    memcpy(field, value, len + 1);
+    success = true;
+
+done:
+    return success;
+}
+
+static size_t
+build_frame(
+    struct led_fast_path_st * const fast_path,
+    struct led_fast_path_update_st const * const updates,
+    size_t const num_updates,
+    char const * const led_priority,
+    char const * const lock_id,
+    uint16_t const flags)
+{
+    size_t frame_len = 0;
+    struct led_fast_path_header_st * const header = &fast_path->frame.header;
+    struct led_fast_path_entry_st * const entries =
+        (struct led_fast_path_entry_st *)(header + 1);
+
+    if (num_updates > LED_FAST_PATH_MAX_ENTRIES
+        || !copy_string_field(header->priority, sizeof header->priority, led_priority)
+        || !copy_string_field(header->lock_id, sizeof header->lock_id, lock_id))
+    {
+        goto done;
+    }
+
+    for (size_t i = 0; i < num_updates; i++)
+    {
+        entries[i].led_id = led_id_lookup(fast_path->ledcmd_ctx, updates[i].led_name);
+        if (entries[i].led_id == LED_ID_NONE
+            || !led_fast_path_state_value(updates[i].state, &entries[i].state))
+        {
+            goto done;
+        }
+    }
+
+    fast_path->seq++;
+    header->magic = LED_FAST_PATH_MAGIC;
+    header->version = LED_FAST_PATH_VERSION;
+    header->flags = flags;
+    header->seq = fast_path->seq;
+    header->generation = fast_path->ledcmd_ctx->led_id_cache->generation;
+    header->num_entries = num_updates;
+
+    frame_len = sizeof *header + num_updates * sizeof *entries;
+
+done:
+    return frame_len;
+}
+
+/*
+ * Wait up to timeout_ms for a reply. Returns true if the acknowledgement was
+ * read. The replies to frames that were rejected without an acknowledgement
+ * having been requested are also processed.
+ */
+static bool
+read_ack(
+    struct led_fast_path_st * const fast_path,
+    int const timeout_ms,
+    struct led_fast_path_ack_st * const ack)
+{
+    bool got_ack = false;
+    struct pollfd pfd =
+    {
+        .fd = fast_path->fd,
+        .events = POLLIN
+    };
+
+    while (poll(&pfd, 1, timeout_ms) > 0)
+    {
+        ssize_t const len = recv(fast_path->fd, ack, sizeof *ack, MSG_DONTWAIT);
+
+        if (len < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            continue;
+        }
+        if (len != sizeof *ack)
+        {
+            break;
+        }
+        if (ack->status == LED_FAST_PATH_STATUS_STALE_IDS)
+        {
+            fast_path->ids_are_stale = true;
+        }
+        got_ack = true;
+        break;
+    }
+
+    return got_ack;
+}
+
+/*
+ * Any replies waiting are to frames whose acknowledgements weren't waited
+ * for, so they are only sent if the frame was rejected.
+ */
+static void
+drain_replies(struct led_fast_path_st * const fast_path)
+{
+    struct led_fast_path_ack_st ack;
+
+    while (read_ack(fast_path, 0, &ack))
+    {
+        /* Only the stale ID indication is of interest. */
+        if (ack.status == LED_FAST_PATH_STATUS_STALE_IDS)
+        {
+            fast_path->updates_lost = true;
+        }
+    }
+
+    /* Also set by the acknowledgement of a frame that was waited for. */
+    if (fast_path->ids_are_stale)
+    {
+        fast_path->ids_are_stale = false;
+        led_resolve_ids(fast_path->ledcmd_ctx);
+    }
+}
+
+static bool
+send_frame(
+    struct led_fast_path_st * const fast_path,
+    struct led_fast_path_update_st const * const updates,
+    size_t const num_updates,
+    char const * const led_priority,
+    char const * const lock_id,
+    uint16_t const flags)
+{
+    bool success;
+    size_t const frame_len =
+        build_frame(fast_path, updates, num_updates, led_priority, lock_id, flags);
+
+    if (frame_len == 0)
+    {
+        success = false;
+        goto done;
+    }
+
+    success = send(fast_path->fd, fast_path->frame.bytes, frame_len, MSG_NOSIGNAL)
+              == (ssize_t)frame_len;
+
+done:
+    return success;
+}
+
+bool
+led_fast_path_set(
+    struct led_fast_path_st * const fast_path,
+    struct led_fast_path_update_st const * const updates,
+    size_t const num_updates,
+    char const * const led_priority,
+    char const * const lock_id)
+{
+    bool success;
+
+    if (fast_path == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    drain_replies(fast_path);
+    if (fast_path->updates_lost)
+    {
+        /* The IDs have been resolved again, so the caller may resend. */
+        fast_path->updates_lost = false;
+        success = false;
+        goto done;
+    }
+
+    success = send_frame(fast_path, updates, num_updates, led_priority, lock_id, 0);
+
+done:
+    return success;
+}
+
+static bool
+set_and_wait(
+    struct led_fast_path_st * const fast_path,
+    struct led_fast_path_update_st const * const updates,
+    size_t const num_updates,
+    char const * const led_priority,
+    char const * const lock_id,
+    enum led_fast_path_status_t * const status)
+{
+    bool success;
+
+    drain_replies(fast_path);
+    if (!send_frame(
+            fast_path, updates, num_updates, led_priority, lock_id, LED_FAST_PATH_FLAG_ACK))
+    {
+        success = false;
+        goto done;
+    }
+
+    uint32_t const seq = fast_path->seq;
+    struct led_fast_path_ack_st ack;
+
+    /* Skip the replies to earlier frames, noting any that were rejected. */
+    do
+    {
+        if (!read_ack(fast_path, LEDCMD_UBUS_REQUEST_TIMEOUT_MS, &ack))
+        {
+            success = false;
+            goto done;
+        }
+        if (ack.seq != seq && ack.status == LED_FAST_PATH_STATUS_STALE_IDS)
+        {
+            fast_path->updates_lost = true;
+        }
+    } while (ack.seq != seq);
+
+    *status = ack.status;
+    success = true;
+
+done:
+    return success;
+}
+
+bool
+led_fast_path_set_and_wait(
+    struct led_fast_path_st * const fast_path,
+    struct led_fast_path_update_st const * const updates,
+    size_t const num_updates,
+    char const * const led_priority,
+    char const * const lock_id)
+{
+    bool success;
+    enum led_fast_path_status_t status;
+
+    if (fast_path == NULL
+        || !set_and_wait(fast_path, updates, num_updates, led_priority, lock_id, &status))
+    {
+        success = false;
+        goto done;
+    }
+
+    /* The IDs are resolved again before the frame is resent. */
+    if (status == LED_FAST_PATH_STATUS_STALE_IDS
+        && !set_and_wait(fast_path, updates, num_updates, led_priority, lock_id, &status))
+    {
+        success = false;
+        goto done;
+    }
+
+    success = status == LED_FAST_PATH_STATUS_OK;
+
+done:
+    return success;
+}
+
+int
+led_fast_path_fd(struct led_fast_path_st const * const fast_path)
+{
+    return fast_path->fd;
+}
+
+struct ledcmd_ctx_st *
+led_fast_path_ledcmd_ctx(struct led_fast_path_st const * const fast_path)
+{
+    return fast_path->ledcmd_ctx;
+}
+
+void
+led_fast_path_close(struct led_fast_path_st * const fast_path)
+{
+    if (fast_path == NULL)
+    {
+        goto done;
+    }
+
+    if (fast_path->fd >= 0)
+    {
+        close(fast_path->fd);
+    }
+    free(fast_path);
+
+done:
+    return;
+}
+
+struct led_fast_path_st *
+led_fast_path_connect(struct ledcmd_ctx_st * const ledcmd_ctx, char const * const socket_path)
+{
+    struct led_fast_path_st * fast_path = NULL;
+    struct sockaddr_un addr =
+    {
+        .sun_family = AF_UNIX
+    };
+
+    if (ledcmd_ctx == NULL
+        || socket_path == NULL
+        || strlen(socket_path) >= sizeof addr.sun_path)
+    {
+        goto done;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    if (!led_ids_are_cached(ledcmd_ctx) && !led_resolve_ids(ledcmd_ctx))
+    {
+        goto done;
+    }
+
+    fast_path = calloc(1, sizeof *fast_path);
+    if (fast_path == NULL)
+    {
+        goto done;
+    }
+
+    fast_path->ledcmd_ctx = ledcmd_ctx;
+    fast_path->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fast_path->fd < 0
+        || connect(fast_path->fd, (struct sockaddr const *)&addr, sizeof addr) < 0)
+    {
+        led_fast_path_close(fast_path);
+        fast_path = NULL;
+        goto done;
+    }
+
+done:
+    return fast_path;
+}
@@ -0,0 +1,281 @@
+#include "lib_led_control.h"
+#include "lib_led_private.h"
+#include "string_constants.h"
+
+#include <ubus_utils/ubus_utils.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+struct led_id_entry_st
+{
+    struct avl_node node;
+    uint32_t led_id;
+    char name[];
+};
+
+struct resolve_ctx_st
+{
+    struct led_id_cache_st * cache;
+    bool success;
+};
+
+static int
+led_name_cmp(void const * const k1, void const * const k2, void * const ptr)
+{
+    UNUSED_ARG(ptr);
+
+    /* The daemon matches LED names without regard to case. */
+    return strcasecmp(k1, k2);
+}
+
+static void
+led_ids_flush(struct led_id_cache_st * const cache)
+{
+    struct led_id_entry_st * entry;
+    struct led_id_entry_st * tmp;
+
+    avl_remove_all_elements(&cache->led_ids, entry, node, tmp)
+    {
+        free(entry);
+    }
+}
+
+bool
+led_ids_init(struct ledcmd_ctx_st * const ledcmd_ctx)
+{
+    bool const duplicates_allowed = false;
+
+    ledcmd_ctx->led_id_cache = calloc(1, sizeof *ledcmd_ctx->led_id_cache);
+    if (ledcmd_ctx->led_id_cache != NULL)
+    {
+        avl_init(&ledcmd_ctx->led_id_cache->led_ids, led_name_cmp, duplicates_allowed, NULL);
+    }
+
+    return ledcmd_ctx->led_id_cache != NULL;
+}
+
+void
+led_ids_free(struct ledcmd_ctx_st * const ledcmd_ctx)
+{
+    if (ledcmd_ctx->led_id_cache == NULL)
+    {
+        goto done;
+    }
+
+    led_ids_flush(ledcmd_ctx->led_id_cache);
+    free(ledcmd_ctx->led_id_cache);
+    ledcmd_ctx->led_id_cache = NULL;
+
+done:
+    return;
+}
+
+bool
+led_ids_are_cached(struct ledcmd_ctx_st const * const ledcmd_ctx)
+{
+    return !avl_is_empty(&ledcmd_ctx->led_id_cache->led_ids);
+}
+
+uint32_t
+led_id_lookup(struct ledcmd_ctx_st const * const ledcmd_ctx, char const * const led_name)
+{
+    uint32_t led_id;
+
+    if (led_name == NULL)
+    {
+        led_id = LED_ID_NONE;
+        goto done;
+    }
+
+    struct led_id_entry_st const * const entry =
+        avl_find_element(&ledcmd_ctx->led_id_cache->led_ids, led_name, entry, node);
+
+    led_id = (entry != NULL) ? entry->led_id : LED_ID_NONE;
+
+done:
+    return led_id;
+}
+
+static void
+add_led_id(
+    struct led_id_cache_st * const cache,
+    char const * const led_name,
+    uint32_t const led_id)
+{
+    size_t const name_size = strlen(led_name) + 1;
+    struct led_id_entry_st * const entry = calloc(1, sizeof *entry + name_size);
+
+    if (entry == NULL)
+    {
+        goto done;
+    }
+
+    memcpy(entry->name, led_name, name_size);
+    entry->led_id = led_id;
+    entry->node.key = entry->name;
+    if (avl_insert(&cache->led_ids, &entry->node) != 0)
+    {
+        free(entry);
+    }
+
+done:
+    return;
+}
+
+static void
+process_resolve_response(
+    struct blob_attr const * const array_blob,
+    struct led_id_cache_st * const cache)
+{
+    struct blob_attr * cur;
+    int rem;
+
+    blobmsg_for_each_attr(cur, array_blob, rem)
+    {
+        enum
+        {
+            LED_NAME,
+            LED_ID,
+            LED_MAX__
+        };
+        struct blob_attr * fields[LED_MAX__];
+        struct blobmsg_policy const resolve_led_policy[] =
+        {
+            [LED_NAME] = { .name = _led_name, .type = BLOBMSG_TYPE_STRING },
+            [LED_ID] = { .name = _led_id, .type = BLOBMSG_TYPE_INT32 }
+        };
+
+        blobmsg_parse(
+            resolve_led_policy, ARRAY_SIZE(fields), fields,
+            blobmsg_data(cur), blobmsg_len(cur));
+
+        if (fields[LED_NAME] != NULL && fields[LED_ID] != NULL)
+        {
+            add_led_id(
+                cache,
+                blobmsg_get_string(fields[LED_NAME]),
+                blobmsg_get_u32(fields[LED_ID]));
+        }
+    }
+}
+
+static bool
+cache_resolve_response(
+    struct led_id_cache_st * const cache, struct blob_attr * const response)
+{
+    bool success;
+    enum
+    {
+        RESOLVE_LEDS,
+        RESOLVE_GENERATION,
+        RESOLVE_MAX__
+    };
+    struct blob_attr * fields[RESOLVE_MAX__];
+    struct blobmsg_policy const resolve_policy[] =
+    {
+        [RESOLVE_LEDS] = { .name = _led_leds, .type = BLOBMSG_TYPE_ARRAY },
+        [RESOLVE_GENERATION] = { .name = _led_generation, .type = BLOBMSG_TYPE_INT32 }
+    };
+
+    blobmsg_parse(
+        resolve_policy, ARRAY_SIZE(fields), fields,
+        blobmsg_data(response), blobmsg_len(response));
+
+    if (!blobmsg_array_is_type(fields[RESOLVE_LEDS], BLOBMSG_TYPE_TABLE)
+        || fields[RESOLVE_GENERATION] == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    cache->generation = blobmsg_get_u32(fields[RESOLVE_GENERATION]);
+    process_resolve_response(fields[RESOLVE_LEDS], cache);
+    success = true;
+
+done:
+    return success;
+}
+
+static void
+resolve_response_handler(
+    struct ubus_request * const req, int const type, struct blob_attr * const response)
+{
+    UNUSED_ARG(type);
+
+    struct resolve_ctx_st * const ctx = req->priv;
+
+    ctx->success = cache_resolve_response(ctx->cache, response);
+}
+
+static void
+resolve_async_response_handler(
+    struct ubus_request * const req, int const type, struct blob_attr * const response)
+{
+    UNUSED_ARG(type);
+
+    struct led_id_cache_st * const cache = req->priv;
+
+    if (!cache_resolve_response(cache, response))
+    {
+        led_ids_flush(cache);
+    }
+}
+
+bool
+led_resolve_ids(struct ledcmd_ctx_st const * const ledcmd_ctx)
+{
+    struct resolve_ctx_st ctx =
+    {
+        .cache = ledcmd_ctx->led_id_cache,
+        .success = false
+    };
+    struct blob_buf msg;
+
+    led_ids_flush(ctx.cache);
+
+    blob_buf_full_init(&msg, 0);
+    ledcmd_ubus_invoke(_led_resolve, &msg, resolve_response_handler, &ctx, ledcmd_ctx);
+    blob_buf_free(&msg);
+
+    if (!ctx.success)
+    {
+        led_ids_flush(ctx.cache);
+    }
+
+    return ctx.success;
+}
+
+bool
+led_resolve_ids_async(
+    struct ledcmd_ctx_st const * const ledcmd_ctx,
+    struct blob_buf * const msg,
+    struct ubus_request * const req,
+    ubus_complete_handler_t const complete_cb)
+{
+    bool success;
+
+    led_ids_flush(ledcmd_ctx->led_id_cache);
+
+    blob_buf_init(msg, 0);
+    if (ubus_invoke_async(
+            ledcmd_ctx->ubus_ctx,
+            ledcmd_ctx->ledcmd_ubus_id,
+            _led_resolve,
+            msg->head,
+            req) != UBUS_STATUS_OK)
+    {
+        success = false;
+        goto done;
+    }
+
+    req->data_cb = resolve_async_response_handler;
+    req->complete_cb = complete_cb;
+    req->priv = ledcmd_ctx->led_id_cache;
+    ubus_complete_request_async(ledcmd_ctx->ubus_ctx, req);
+
+    success = true;
+
+done:
+    return success;
+}
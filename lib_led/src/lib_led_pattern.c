@@ -3,6 +3,11 @@
 #include "string_constants.h"
 
 #include <ubus_utils/ubus_utils.h>
+#include <libubox/uloop.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
 static bool
 send_ubus_led_pattern_request(
@@ -27,6 +32,10 @@ struct ledcmd_led_pattern_ctx_st
     bool success;
     led_list_patterns_cb const cb;
     void * const cb_context;
+    /* Set to look up the pattern with this name instead of calling cb. */
+    char const * const find_name;
+    bool found;
+    bool plays_forever;
 };
 
 struct led_pattern_st
@@ -146,7 +155,7 @@ process_led_pattern_response(
 
     ctx->success = true;
 
-    if (ctx->cb == NULL)
+    if (ctx->cb == NULL && ctx->find_name == NULL)
     {
         goto done;
     }
@@ -158,11 +167,21 @@ process_led_pattern_response(
     {
         struct led_pattern_st const * const pattern = parse_led_pattern(cur);
 
-        if (pattern != NULL)
+        if (pattern == NULL)
+        {
+            continue;
+        }
+
+        if (ctx->find_name == NULL)
         {
             ctx->cb(pattern->name, ctx->cb_context);
-            free_led_pattern(pattern);
         }
+        else if (strcasecmp(pattern->name, ctx->find_name) == 0)
+        {
+            ctx->found = true;
+            ctx->plays_forever = pattern->repeat || pattern->play_count == 0;
+        }
+        free_led_pattern(pattern);
     }
 
 done:
@@ -214,6 +233,30 @@ led_list_patterns(
     return ctx.success;
 }
 
+bool
+led_pattern_plays_forever(
+    struct ledcmd_ctx_st const * const ledcmd_ctx,
+    char const * const pattern_name,
+    bool * const plays_forever)
+{
+    struct ledcmd_led_pattern_ctx_st ctx =
+    {
+        .success = false,
+        .cb = NULL,
+        .cb_context = NULL,
+        .find_name = pattern_name
+    };
+
+    send_ubus_led_pattern_request(
+        ledcmd_ctx, _led_pattern_list, led_list_pattern_response_handler, &ctx);
+    if (ctx.found)
+    {
+        *plays_forever = ctx.plays_forever;
+    }
+
+    return ctx.success && ctx.found;
+}
+
 bool
 led_list_playing_patterns(
     struct ledcmd_ctx_st const * const ledcmd_ctx,
@@ -259,8 +302,8 @@ send_ubus_led_play_pattern_request(
 struct ledcmd_led_play_pattern_ctx_st
 {
     bool success;
-    led_play_pattern_cb const cb;
-    void * const cb_context;
+    led_play_pattern_cb cb;
+    void * cb_context;
 };
 
 static void
@@ -281,7 +324,7 @@ led_play_pattern_response_handler(
     struct blobmsg_policy const pattern_reply_policy[] =
     {
         [PLAY_SUCCESS] = { .name = _led_success, .type = BLOBMSG_TYPE_BOOL },
-        [PLAY_ERROR_MSG] = { .name = _led_success, .type = BLOBMSG_TYPE_STRING }
+        [PLAY_ERROR_MSG] = { .name = _led_error, .type = BLOBMSG_TYPE_STRING }
     };
 
     blobmsg_parse(
@@ -293,6 +336,7 @@ led_play_pattern_response_handler(
     char const * const error_msg = blobmsg_get_string(fields[PLAY_ERROR_MSG]);
 
     ctx->cb(success, error_msg, ctx->cb_context);
+    ctx->success = true;
 }
 
 bool
@@ -346,3 +390,243 @@ led_stop_pattern(
     return ctx.success;
 }
 
+struct pattern_request_async_st
+{
+    struct ledcmd_ctx_st const * ledcmd_ctx;
+    struct ubus_request req;
+    struct uloop_timeout timeout;
+    struct blob_buf msg;
+    struct ledcmd_led_play_pattern_ctx_st response_ctx;
+    led_async_complete_cb complete_cb;
+};
+
+static void
+pattern_request_async_finish(
+    struct pattern_request_async_st * const request, bool const success)
+{
+    uloop_timeout_cancel(&request->timeout);
+    if (request->complete_cb != NULL)
+    {
+        request->complete_cb(success, request->response_ctx.cb_context);
+    }
+    blob_buf_free(&request->msg);
+    free(request);
+}
+
+static void
+pattern_request_async_complete(struct ubus_request * const req, int const ret)
+{
+    struct pattern_request_async_st * const request =
+        container_of(req, struct pattern_request_async_st, req);
+
+    pattern_request_async_finish(
+        request, ret == UBUS_STATUS_OK && request->response_ctx.success);
+}
+
+static void
+pattern_request_async_timeout(struct uloop_timeout * const timeout)
+{
+    struct pattern_request_async_st * const request =
+        container_of(timeout, struct pattern_request_async_st, timeout);
+
+    ubus_abort_request(request->ledcmd_ctx->ubus_ctx, &request->req);
+    pattern_request_async_finish(request, false);
+}
+
+static bool
+send_pattern_request_async(
+    struct ledcmd_ctx_st const * const ledcmd_ctx,
+    char const * const cmd,
+    char const * const pattern_name,
+    bool const retrigger,
+    led_play_pattern_cb const cb,
+    led_async_complete_cb const complete_cb,
+    void * const cb_context)
+{
+    bool success;
+    struct pattern_request_async_st * const request = calloc(1, sizeof *request);
+
+    if (request == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    request->ledcmd_ctx = ledcmd_ctx;
+    request->response_ctx.cb = cb;
+    request->response_ctx.cb_context = cb_context;
+    request->complete_cb = complete_cb;
+    request->timeout.cb = pattern_request_async_timeout;
+
+    blob_buf_full_init(&request->msg, 0);
+    blobmsg_add_string(&request->msg, _led_pattern_name, pattern_name);
+    blobmsg_add_u8(&request->msg, _led_pattern_retrigger, retrigger);
+
+    if (ubus_invoke_async(
+            ledcmd_ctx->ubus_ctx,
+            ledcmd_ctx->ledcmd_ubus_id,
+            cmd,
+            request->msg.head,
+            &request->req) != UBUS_STATUS_OK)
+    {
+        blob_buf_free(&request->msg);
+        free(request);
+        success = false;
+        goto done;
+    }
+
+    request->req.data_cb = led_play_pattern_response_handler;
+    request->req.complete_cb = pattern_request_async_complete;
+    request->req.priv = &request->response_ctx;
+    ubus_complete_request_async(ledcmd_ctx->ubus_ctx, &request->req);
+    uloop_timeout_set(&request->timeout, LEDCMD_UBUS_REQUEST_TIMEOUT_MS);
+
+    success = true;
+
+done:
+    return success;
+}
+
+bool
+led_play_pattern_async(
+    struct ledcmd_ctx_st const * const ledcmd_ctx,
+    char const * const pattern_name,
+    bool const retrigger,
+    led_play_pattern_cb const cb,
+    led_async_complete_cb const complete_cb,
+    void * const cb_context)
+{
+    return send_pattern_request_async(
+        ledcmd_ctx, _led_pattern_play, pattern_name, retrigger, cb, complete_cb, cb_context);
+}
+
+bool
+led_stop_pattern_async(
+    struct ledcmd_ctx_st const * const ledcmd_ctx,
+    char const * const pattern_name,
+    led_play_pattern_cb const cb,
+    led_async_complete_cb const complete_cb,
+    void * const cb_context)
+{
+    return send_pattern_request_async(
+        ledcmd_ctx, _led_pattern_stop, pattern_name, false, cb, complete_cb, cb_context);
+}
+
+
+struct led_pattern_watch_st
+{
+    struct ubus_event_handler handler;
+    struct ledcmd_ctx_st const * ledcmd_ctx;
+    led_pattern_event_cb cb;
+    void * cb_context;
+};
+
+static bool
+pattern_event_ends_pattern(char const * const event)
+{
+    return strcmp(event, _led_pattern_finished) == 0
+           || strcmp(event, _led_pattern_stopped) == 0
+           || strcmp(event, _led_pattern_preempted) == 0;
+}
+
+static void
+led_pattern_event_handler(
+    struct ubus_context * const ctx,
+    struct ubus_event_handler * const ev,
+    char const * const type,
+    struct blob_attr * const msg)
+{
+    UNUSED_ARG(ctx);
+    UNUSED_ARG(type);
+
+    struct led_pattern_watch_st * const watch =
+        container_of(ev, struct led_pattern_watch_st, handler);
+    enum
+    {
+        EVENT_NAME,
+        EVENT_EVENT,
+        EVENT_PREEMPTED_BY,
+        EVENT_MAX__
+    };
+    struct blob_attr * fields[EVENT_MAX__];
+    struct blobmsg_policy const pattern_event_policy[] =
+    {
+        [EVENT_NAME] = { .name = _led_pattern_name, .type = BLOBMSG_TYPE_STRING },
+        [EVENT_EVENT] = { .name = _led_event, .type = BLOBMSG_TYPE_STRING },
+        [EVENT_PREEMPTED_BY] =
+            { .name = _led_pattern_preempted_by, .type = BLOBMSG_TYPE_STRING }
+    };
+
+    blobmsg_parse(
+        pattern_event_policy, ARRAY_SIZE(fields), fields,
+        blobmsg_data(msg), blobmsg_len(msg));
+
+    if (fields[EVENT_NAME] == NULL || fields[EVENT_EVENT] == NULL)
+    {
+        goto done;
+    }
+
+    struct led_pattern_event_st event =
+    {
+        .pattern_name = blobmsg_get_string(fields[EVENT_NAME]),
+        .event = blobmsg_get_string(fields[EVENT_EVENT]),
+        .preempted_by = blobmsg_get_string(fields[EVENT_PREEMPTED_BY])
+    };
+
+    event.pattern_ended = pattern_event_ends_pattern(event.event);
+    watch->cb(&event, watch->cb_context);
+
+done:
+    return;
+}
+
+void
+led_unwatch_pattern_events(struct led_pattern_watch_st * const watch)
+{
+    if (watch == NULL)
+    {
+        goto done;
+    }
+
+    ubus_unregister_event_handler(watch->ledcmd_ctx->ubus_ctx, &watch->handler);
+    free(watch);
+
+done:
+    return;
+}
+
+struct led_pattern_watch_st *
+led_watch_pattern_events(
+    struct ledcmd_ctx_st const * const ledcmd_ctx,
+    led_pattern_event_cb const cb,
+    void * const cb_context)
+{
+    struct led_pattern_watch_st * watch = NULL;
+
+    if (cb == NULL)
+    {
+        goto done;
+    }
+
+    watch = calloc(1, sizeof *watch);
+    if (watch == NULL)
+    {
+        goto done;
+    }
+
+    watch->ledcmd_ctx = ledcmd_ctx;
+    watch->cb = cb;
+    watch->cb_context = cb_context;
+    watch->handler.cb = led_pattern_event_handler;
+
+    if (ubus_register_event_handler(
+            ledcmd_ctx->ubus_ctx, &watch->handler, _led_pattern_event)
+        != UBUS_STATUS_OK)
+    {
+        free(watch);
+        watch = NULL;
+    }
+
+done:
+    return watch;
+}
@@ -1,13 +1,71 @@
 #ifndef __LIB_LED_PRIVATE_H__
 #define __LIB_LED_PRIVATE_H__
 
+#include "lib_led_control.h"
+
 #include <libubus.h>
+#include <libubox/avl.h>
 
 typedef struct ledcmd_ctx_st ledcmd_ctx_st;
 
+/*
+ * LED IDs resolved by the daemon. Requests are made with a const context, but
+ * may need to resolve the IDs again, so the cache is held by pointer.
+ */
+struct led_id_cache_st
+{
+    /* Keyed by LED name. */
+    struct avl_tree led_ids;
+    uint32_t generation;
+};
+
+struct ledcmd_ctx_st
+{
+    struct ubus_context * ubus_ctx;
+    uint32_t ledcmd_ubus_id;
+
+    enum led_response_verbosity_t verbosity;
+    led_response_summary_cb summary_cb;
+    void * summary_cb_context;
+
+    struct led_id_cache_st * led_id_cache;
+};
+
+/* Never assigned by the daemon, so used when a name hasn't been resolved. */
+#define LED_ID_NONE 0
+
+#define LEDCMD_UBUS_REQUEST_TIMEOUT_MS 1000
+
+struct led_request_st
+{
+    char const * led_name;
+    char const * state;
+    char const * lock_id;
+    char const * led_priority;
+    char const * flash_type;
+    uint32_t flash_time_ms;
+};
+
+/* The context passed to led_response_handler(). */
+struct ledcmd_led_ctx_st
+{
+    struct ledcmd_ctx_st const * ledcmd_ctx;
+    bool success;
+    led_get_set_cb cb;
+    void * cb_context;
+};
+
 typedef void (*ubus_cb)
     (struct ubus_request * req, int type, struct blob_attr * response);
 
+int
+ledcmd_ubus_invoke_status(
+    char const * cmd,
+    struct blob_buf * msg,
+    ubus_cb cb,
+    void * cb_context,
+    struct ledcmd_ctx_st const * ledcmd_ctx);
+
 bool
 ledcmd_ubus_invoke(
     char const * cmd,
@@ -16,5 +74,84 @@ ledcmd_ubus_invoke(
     void * cb_context,
     struct ledcmd_ctx_st const * ledcmd_ctx);
 
+typedef void (*build_request_fn)(
+    struct ledcmd_ctx_st const * ctx, void const * request, struct blob_buf * msg);
+
+/*
+ * LEDs whose IDs have been resolved are identified by ID rather than by name,
+ * along with the generation of the IDs. Returns true if the ID was used.
+ */
+bool
+append_led_request_fields(
+    struct ledcmd_ctx_st const * ctx,
+    char const * led_name,
+    char const * state,
+    char const * lock_id,
+    char const * led_priority,
+    char const * flash_type,
+    uint32_t flash_time_ms,
+    struct blob_buf * msg);
+
+void
+append_response_verbosity(struct ledcmd_ctx_st const * ctx, struct blob_buf * msg);
+
+/*
+ * Build and send a request. If the daemon's LED IDs have changed since they
+ * were resolved they are resolved again and the request is rebuilt and resent.
+ */
+bool
+invoke_led_request(
+    struct ledcmd_ctx_st const * ctx,
+    char const * cmd,
+    build_request_fn build_request,
+    void const * request,
+    ubus_cb cb,
+    void * cb_context);
+
+void
+populate_get_set_result(
+    struct led_get_set_result_st * result, struct blob_attr * response);
+
+/* Handles the responses to get, set, activate and deactivate requests. */
+void
+led_response_handler(struct ubus_request * req, int type, struct blob_attr * response);
+
+bool
+led_ids_init(struct ledcmd_ctx_st * ledcmd_ctx);
+
+void
+led_ids_free(struct ledcmd_ctx_st * ledcmd_ctx);
+
+bool
+led_ids_are_cached(struct ledcmd_ctx_st const * ledcmd_ctx);
+
+uint32_t
+led_id_lookup(struct ledcmd_ctx_st const * ledcmd_ctx, char const * led_name);
+
+/*
+ * Starts resolving the LED IDs again without waiting for the daemon's reply,
+ * using msg and req, which must remain valid until complete_cb is called as
+ * for ubus_invoke_async(). Until the reply arrives no IDs are cached, so
+ * requests name their LEDs instead.
+ */
+bool
+led_resolve_ids_async(
+    struct ledcmd_ctx_st const * ledcmd_ctx,
+    struct blob_buf * msg,
+    struct ubus_request * req,
+    ubus_complete_handler_t complete_cb);
+
+struct led_fast_path_st;
+
+/* Converts a state name to one of enum led_fast_path_state_t. */
+bool
+led_fast_path_state_value(char const * state, uint32_t * value);
+
+int
+led_fast_path_fd(struct led_fast_path_st const * fast_path);
+
+struct ledcmd_ctx_st *
+led_fast_path_ledcmd_ctx(struct led_fast_path_st const * fast_path);
+
 #endif /* __LIB_LED_PRIVATE_H__ */
 
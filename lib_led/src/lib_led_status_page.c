@@ -0,0 +1,262 @@
+#include "lib_led_status_page.h"
+#include "led_status_page_layout.h"
+
+#include <ubus_utils/ubus_utils.h>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Times a read yields to a daemon holding the seqlock before it gives up. */
+#define LED_STATUS_PAGE_READ_ATTEMPTS 10000
+
+struct led_status_page_map_st
+{
+    char const * base;
+    size_t size;
+    struct led_status_page_header_st const * header;
+    struct led_status_page_entry_st const * entries;
+    size_t num_leds;
+};
+
+static bool
+page_is_valid(char const * const base, size_t const size)
+{
+    bool valid;
+    struct led_status_page_header_st const * const header =
+        (struct led_status_page_header_st const *)base;
+
+    if (size < sizeof *header
+        || __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != LED_STATUS_PAGE_MAGIC
+        || header->version != LED_STATUS_PAGE_VERSION
+        || header->size != size)
+    {
+        valid = false;
+        goto done;
+    }
+
+    size_t const entries_size =
+        (size_t)header->num_leds * sizeof(struct led_status_page_entry_st);
+
+    if (header->entries_offset < sizeof *header
+        || header->entries_offset > size
+        || entries_size > size - header->entries_offset)
+    {
+        valid = false;
+        goto done;
+    }
+
+    /* Ensures that every string in the page is terminated. */
+    valid = base[size - 1] == '\0';
+
+done:
+    return valid;
+}
+
+void
+led_status_page_unmap(struct led_status_page_map_st * const map)
+{
+    if (map == NULL)
+    {
+        goto done;
+    }
+
+    if (map->base != NULL)
+    {
+        munmap(UNCONST(map->base), map->size);
+    }
+    free(map);
+
+done:
+    return;
+}
+
+struct led_status_page_map_st *
+led_status_page_map(char const * const name)
+{
+    bool success;
+    struct led_status_page_map_st * map = NULL;
+    char const * const page_name = (name != NULL) ? name : LED_STATUS_PAGE_DEFAULT_NAME;
+    int const fd = shm_open(page_name, O_RDONLY | O_CLOEXEC, 0);
+
+    if (fd < 0)
+    {
+        success = false;
+        goto done;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || st.st_size <= 0)
+    {
+        success = false;
+        goto done;
+    }
+
+    map = calloc(1, sizeof *map);
+    if (map == NULL)
+    {
+        success = false;
+        goto done;
+    }
+
+    void * const base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    if (base == MAP_FAILED)
+    {
+        success = false;
+        goto done;
+    }
+
+    map->base = base;
+    map->size = st.st_size;
+
+    if (!page_is_valid(map->base, map->size))
+    {
+        success = false;
+        goto done;
+    }
+
+    map->header = base;
+    map->entries =
+        (struct led_status_page_entry_st const *)(map->base + map->header->entries_offset);
+    map->num_leds = map->header->num_leds;
+
+    success = true;
+
+done:
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    if (!success)
+    {
+        led_status_page_unmap(map);
+        map = NULL;
+    }
+
+    return map;
+}
+
+size_t
+led_status_page_num_leds(struct led_status_page_map_st const * const map)
+{
+    return map->num_leds;
+}
+
+static char const *
+page_string(struct led_status_page_map_st const * const map, uint32_t const offset)
+{
+    return (offset < map->size) ? map->base + offset : "";
+}
+
+bool
+led_status_page_find(
+    struct led_status_page_map_st const * const map,
+    char const * const led_name,
+    size_t * const index)
+{
+    bool found = false;
+    size_t low = 0;
+    size_t high = map->num_leds;
+
+    /* The entries are sorted by name, and the names never change. */
+    while (low < high)
+    {
+        size_t const mid = low + (high - low) / 2;
+        int const cmp =
+            strcasecmp(led_name, page_string(map, map->entries[mid].name_offset));
+
+        if (cmp == 0)
+        {
+            *index = mid;
+            found = true;
+            break;
+        }
+        if (cmp < 0)
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    return found;
+}
+
+bool
+led_status_page_read(
+    struct led_status_page_map_st const * const map,
+    size_t const index,
+    struct led_page_status_st * const status,
+    uint32_t * const change_seq)
+{
+    bool success;
+
+    if (index >= map->num_leds)
+    {
+        success = false;
+        goto done;
+    }
+
+    struct led_status_page_header_st const * const header = map->header;
+    struct led_status_page_entry_st const * const entry = &map->entries[index];
+    uint32_t state_offset = 0;
+    uint32_t priority_offset = 0;
+    uint32_t locked = 0;
+    uint32_t last_changed_seq = 0;
+    uint32_t seq = 0;
+    uint32_t begin;
+    bool consistent = false;
+
+    /*
+     * The daemon only holds the seqlock for the length of an update, so a
+     * reader that keeps finding it held has found a daemon that died part way
+     * through one, and gives up rather than spinning.
+     */
+    for (size_t attempt = 0; attempt < LED_STATUS_PAGE_READ_ATTEMPTS && !consistent; attempt++)
+    {
+        begin = __atomic_load_n(&header->seqlock, __ATOMIC_ACQUIRE);
+        if ((begin & 1) != 0)
+        {
+            sched_yield();
+            continue;
+        }
+
+        state_offset = __atomic_load_n(&entry->state_offset, __ATOMIC_RELAXED);
+        priority_offset = __atomic_load_n(&entry->priority_offset, __ATOMIC_RELAXED);
+        locked = __atomic_load_n(&entry->locked, __ATOMIC_RELAXED);
+        last_changed_seq = __atomic_load_n(&entry->last_changed_seq, __ATOMIC_RELAXED);
+        seq = __atomic_load_n(&header->change_seq, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        consistent = begin == __atomic_load_n(&header->seqlock, __ATOMIC_RELAXED);
+    }
+
+    if (!consistent || __atomic_load_n(&header->closed, __ATOMIC_ACQUIRE) != 0)
+    {
+        success = false;
+        goto done;
+    }
+
+    status->led_name = page_string(map, entry->name_offset);
+    status->led_state = page_string(map, state_offset);
+    status->led_priority = page_string(map, priority_offset);
+    status->locked = locked != 0;
+    status->last_changed_seq = last_changed_seq;
+    if (change_seq != NULL)
+    {
+        *change_seq = seq;
+    }
+
+    success = true;
+
+done:
+    return success;
+}
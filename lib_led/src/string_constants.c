@@ -68,3 +68,75 @@ char const _led_alias_aliases[] = "aliases";
 char const _led_pattern_step_time_ms[] = "time_ms";
 char const _led_pattern_step_leds[] = "leds";
 
+char const _led_verbosity[] = "verbosity";
+char const _led_verbosity_full[] = "full";
+char const _led_verbosity_errors[] = "errors";
+char const _led_verbosity_summary[] = "summary";
+char const _led_succeeded[] = "succeeded";
+char const _led_failed[] = "failed";
+
+char const _led_set_many[] = "set_many";
+char const _led_names[] = "names";
+char const _led_states[] = "states";
+
+char const _led_resolve[] = "resolve";
+char const _led_id[] = "id";
+char const _led_ids[] = "ids";
+char const _led_generation[] = "generation";
+
+char const _led_leds_changed[] = "leds_changed";
+char const _led_seq[] = "seq";
+char const _led_locked[] = "locked";
+
+char const _led_get_changes[] = "get_changes";
+char const _led_since[] = "since";
+char const _led_resync[] = "resync";
+char const _led_epoch[] = "epoch";
+
+char const _led_pattern_event[] = "ledcmd.pattern";
+char const _led_event[] = "event";
+char const _led_pattern_started[] = "started";
+char const _led_pattern_step_wrapped[] = "step_wrapped";
+char const _led_pattern_finished[] = "finished";
+char const _led_pattern_stopped[] = "stopped";
+char const _led_pattern_preempted[] = "preempted";
+char const _led_pattern_preempted_by[] = "preempted_by";
+
+char const _led_batch[] = "batch";
+char const _led_ops[] = "ops";
+char const _led_op[] = "op";
+char const _led_results[] = "results";
+char const _led_skipped[] = "skipped";
+char const _led_stop_on_error[] = "stop_on_error";
+
+char const _led_line[] = "line";
+char const _led_command[] = "command";
+
+char const _led_stats[] = "stats";
+char const _led_stats_reset[] = "stats_reset";
+char const _led_methods[] = "methods";
+char const _led_backend[] = "backend";
+char const _led_calls[] = "calls";
+char const _led_errors[] = "errors";
+char const _led_latency[] = "latency";
+char const _led_count[] = "count";
+char const _led_mean_ns[] = "mean_ns";
+char const _led_p50_ns[] = "p50_ns";
+char const _led_p90_ns[] = "p90_ns";
+char const _led_p99_ns[] = "p99_ns";
+char const _led_max_ns[] = "max_ns";
+char const _led_histogram[] = "histogram";
+char const _led_set_led_state[] = "set_led_state";
+char const _led_get_led_state[] = "get_led_state";
+char const _led_flash_timer_firings[] = "flash_timer_firings";
+char const _led_pattern_timer_firings[] = "pattern_timer_firings";
+char const _led_pattern_steps[] = "pattern_steps";
+char const _led_write_elisions[] = "write_elisions";
+char const _led_response_buffer[] = "response_buffer";
+char const _led_high_water[] = "high_water";
+char const _led_allocations[] = "allocations";
+char const _led_elapsed_ms[] = "elapsed_ms";
+char const _led_timer_lateness[] = "timer_lateness";
+char const _led_timer_trace_dump[] = "timer_trace_dump";
+char const _led_path[] = "path";
+char const _led_records[] = "records";
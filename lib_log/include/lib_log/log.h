@@ -3,11 +3,46 @@
 
 #include <stdbool.h>
 
-int
-log_error(char const *fmt, ...);
+enum log_level_t
+{
+    LOG_LEVEL_NONE = -1,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG
+};
+
+/*
+ * Messages at levels above this are discarded. It is LOG_LEVEL_NONE until a
+ * logging plugin is loaded, and is otherwise the level set with
+ * log_set_level() (default LOG_LEVEL_INFO).
+ */
+extern enum log_level_t log_enabled_level;
+
+#define log_level_enabled(level) ((level) <= log_enabled_level)
+
+/*
+ * The level is checked before the arguments are evaluated, so a discarded
+ * message costs only a comparison.
+ */
+#define log_at_level(level, ...) \
+    (log_level_enabled(level) ? log_message((level), __VA_ARGS__) : 0)
+
+#define log_error(...) log_at_level(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define log_warn(...) log_at_level(LOG_LEVEL_WARN, __VA_ARGS__)
+#define log_info(...) log_at_level(LOG_LEVEL_INFO, __VA_ARGS__)
+#define log_debug(...) log_at_level(LOG_LEVEL_DEBUG, __VA_ARGS__)
 
 int
-log_info(char const *fmt, ...);
+log_message(enum log_level_t level, char const *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void
+log_set_level(enum log_level_t level);
+
+/* Returns LOG_LEVEL_NONE if the name isn't that of a level. */
+enum log_level_t
+log_level_by_name(char const * name);
 
 bool
 logging_plugin_load(char const * plugin_path, char const * progname, int a, int b);
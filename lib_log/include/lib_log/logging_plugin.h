@@ -1,15 +1,26 @@
 #ifndef LOGGING_PLUGIN_H__
 #define LOGGING_PLUGIN_H__
 
+#include "log.h"
+
 #include <stdarg.h>
 
-#define LIB_LOG_PLUGIN_VERSION 1
+/*
+ * Version 2 added log_message. Plugins that support it should return their
+ * methods for both versions. Version 1 plugins are still loaded, with warning
+ * messages passed to log_error and debug messages to log_info.
+ */
+#define LIB_LOG_PLUGIN_VERSION 2
+#define LIB_LOG_PLUGIN_VERSION_MIN 1
 
 typedef struct logging_plugin_context_st logging_plugin_context_st;
 
 typedef int (*plugin_log_fn)
     (logging_plugin_context_st * context, char const * fmt, va_list ap);
 
+typedef int (*plugin_log_message_fn)
+    (logging_plugin_context_st * context, enum log_level_t level, char const * fmt, va_list ap);
+
 typedef logging_plugin_context_st * (*plugin_log_init_fn)
     (char const * program_name, int a, int b);
 
@@ -21,6 +32,8 @@ struct logging_plugin_methods_st
     plugin_log_unload_fn log_unload;
     plugin_log_fn log_error;
     plugin_log_fn log_info;
+    /* Version 2. */
+    plugin_log_message_fn log_message;
 };
 
 typedef struct logging_plugin_methods_st const *
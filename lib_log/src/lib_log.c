@@ -5,11 +5,13 @@
 #include <linux/limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 struct logging_context_st
 {
     void * lib_handle;
     struct logging_plugin_methods_st const * plugin_methods;
+    int plugin_version;
     void * plugin_context;
 };
 
@@ -22,8 +24,25 @@ struct logging_context_st
  */
 struct logging_context_st * logging_context;
 
+/*
+ * The threshold set by the application. The effective threshold,
+ * log_enabled_level, is only this while a plugin is loaded, so that messages
+ * aren't formatted when there's nowhere to send them.
+ */
+static enum log_level_t log_threshold = LOG_LEVEL_INFO;
+enum log_level_t log_enabled_level = LOG_LEVEL_NONE;
+
+static void
+update_enabled_level(void)
+{
+    bool const have_plugin =
+        logging_context != NULL && logging_context->plugin_methods != NULL;
+
+    log_enabled_level = have_plugin ? log_threshold : LOG_LEVEL_NONE;
+}
+
 static struct logging_plugin_methods_st const *
-get_plugin_methods(void * const lib_handle)
+get_plugin_methods(void * const lib_handle, int * const plugin_version)
 {
     struct logging_plugin_methods_st const * methods;
     char const _logging_plugin_methods[] = "log_methods";
@@ -38,14 +57,27 @@ get_plugin_methods(void * const lib_handle)
         goto done;
     }
 
-    methods = logging_plugin_methods(LIB_LOG_PLUGIN_VERSION);
+    /* Use the newest version of the plugin API that the plugin supports. */
+    for (int version = LIB_LOG_PLUGIN_VERSION;
+         version >= LIB_LOG_PLUGIN_VERSION_MIN;
+         version--)
+    {
+        methods = logging_plugin_methods(version);
+        if (methods != NULL)
+        {
+            *plugin_version = version;
+            goto done;
+        }
+    }
+
+    methods = NULL;
 
 done:
     return methods;
 }
 
-int
-log_error(char const * const fmt, ...)
+static int
+log_message_va(enum log_level_t const level, char const * const fmt, va_list args)
 {
     int res;
 
@@ -64,48 +96,114 @@ log_error(char const * const fmt, ...)
         goto done;
     }
 
-    va_list args;
-
-    va_start(args, fmt);
-    res = plugin_methods->log_error(
-        logging_context->plugin_context, fmt, args);
-    va_end(args);
+    if (logging_context->plugin_version >= 2)
+    {
+        res = plugin_methods->log_message(
+            logging_context->plugin_context, level, fmt, args);
+    }
+    else if (level <= LOG_LEVEL_WARN)
+    {
+        res = (plugin_methods->log_error)(
+            logging_context->plugin_context, fmt, args);
+    }
+    else
+    {
+        res = (plugin_methods->log_info)(
+            logging_context->plugin_context, fmt, args);
+    }
 
 done:
     return res;
 }
 
 int
-log_info(char const * const fmt, ...)
+log_message(enum log_level_t const level, char const * const fmt, ...)
 {
     int res;
+    va_list args;
 
-    if (logging_context == NULL)
+    if (!log_level_enabled(level))
     {
-        res = -1;
+        res = 0;
         goto done;
     }
 
-    struct logging_plugin_methods_st const * const plugin_methods =
-        logging_context->plugin_methods;
+    va_start(args, fmt);
+    res = log_message_va(level, fmt, args);
+    va_end(args);
 
-    if (plugin_methods == NULL)
-    {
-        res = -1;
-        goto done;
-    }
+done:
+    return res;
+}
 
+/*
+ * log_error() and log_info() are now macros, but the functions are kept for
+ * applications built against earlier versions of this library. They aren't
+ * filtered by the level.
+ */
+int (log_error)(char const * fmt, ...);
+int (log_info)(char const * fmt, ...);
+
+int
+(log_error)(char const * const fmt, ...)
+{
+    int res;
     va_list args;
 
     va_start(args, fmt);
-    res = plugin_methods->log_info(
-        logging_context->plugin_context, fmt, args);
+    res = log_message_va(LOG_LEVEL_ERROR, fmt, args);
+    va_end(args);
+
+    return res;
+}
+
+int
+(log_info)(char const * const fmt, ...)
+{
+    int res;
+    va_list args;
+
+    va_start(args, fmt);
+    res = log_message_va(LOG_LEVEL_INFO, fmt, args);
     va_end(args);
 
-done:
     return res;
 }
 
+void
+log_set_level(enum log_level_t const level)
+{
+    log_threshold = level;
+    update_enabled_level();
+}
+
+enum log_level_t
+log_level_by_name(char const * const name)
+{
+    static char const * const level_names[] =
+    {
+        [LOG_LEVEL_ERROR] = "error",
+        [LOG_LEVEL_WARN] = "warn",
+        [LOG_LEVEL_INFO] = "info",
+        [LOG_LEVEL_DEBUG] = "debug"
+    };
+    enum log_level_t level;
+
+    for (size_t i = 0; i < sizeof level_names / sizeof level_names[0]; i++)
+    {
+        if (strcmp(name, level_names[i]) == 0)
+        {
+            level = i;
+            goto done;
+        }
+    }
+
+    level = LOG_LEVEL_NONE;
+
+done:
+    return level;
+}
+
 static int
 log_init(char const * const program_name, int const a, int const b)
 {
@@ -157,6 +255,7 @@ logging_plugin_unload(void)
 
     free(logging_context);
     logging_context = NULL;
+    update_enabled_level();
 
 done:
     return;
@@ -187,7 +286,8 @@ logging_plugin_load(
     }
 
     logging_context->lib_handle = lib_handle;
-    logging_context->plugin_methods = get_plugin_methods(lib_handle);
+    logging_context->plugin_methods =
+        get_plugin_methods(lib_handle, &logging_context->plugin_version);
 
     if (log_init(program_name, a, b) < 0)
     {
@@ -203,6 +303,7 @@ done:
         logging_plugin_unload();
         logging_context = NULL;
     }
+    update_enabled_level();
 
     return success;
 }
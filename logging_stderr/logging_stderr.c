@@ -33,6 +33,27 @@ plugin_log_info(
     return do_log("info", fmt, ap);
 }
 
+static int
+plugin_log_message(
+    logging_plugin_context_st * const context,
+    enum log_level_t const level,
+    char const * const fmt,
+    va_list ap)
+{
+    static char const * const prefixes[] =
+    {
+        [LOG_LEVEL_ERROR] = "error",
+        [LOG_LEVEL_WARN] = "warn",
+        [LOG_LEVEL_INFO] = "info",
+        [LOG_LEVEL_DEBUG] = "debug"
+    };
+    bool const known_level = level >= 0 && (size_t)level < ARRAY_SIZE(prefixes);
+
+    UNUSED_ARG(context);
+
+    return do_log(known_level ? prefixes[level] : "log", fmt, ap);
+}
+
 static void
 plugin_unload(logging_plugin_context_st * const context)
 {
@@ -57,10 +78,14 @@ log_methods(int const plugin_version)
         .log_init = plugin_log_init,
         .log_unload = plugin_unload,
         .log_error = plugin_log_error,
-        .log_info = plugin_log_info
+        .log_info = plugin_log_info,
+        .log_message = plugin_log_message
     };
     struct logging_plugin_methods_st const * plugin_methods;
-    bool const version_ok = plugin_version == LIB_LOG_PLUGIN_VERSION;
+    /* Version 2 only appended to the methods, so they also suit version 1. */
+    bool const version_ok =
+        plugin_version >= LIB_LOG_PLUGIN_VERSION_MIN
+        && plugin_version <= LIB_LOG_PLUGIN_VERSION;
 
     if (!version_ok)
     {